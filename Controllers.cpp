@@ -8,6 +8,8 @@
 
 #include "Controllers.h"
 #include "Application.h"
+#include "NetworkAdaptiveJitterBuffer.h"
+#include "NetworkTransportApplication.h"
 #include <string>
 #include <windows.h>
 #include <XInput.h>
@@ -57,6 +59,12 @@ bool Controllers::State::operator!=(const State& rhs)
 	return !(*this == rhs);
 }
 
+void Controllers::setNetworkControllerState(const State & state, const State & statePrevious)
+{
+	memcpy(&m_networkControllerPrevious, &statePrevious, sizeof(State));
+	memcpy(&m_networkController, &state, sizeof(State));
+}
+
 bool Controllers::init()
 {
 	// Get initial state of the controlers
@@ -65,8 +73,48 @@ bool Controllers::init()
 	return true;
 }
 
+void Controllers::updateNetwork()
+{
+	if (m_networkHandler == nullptr)
+	{
+		m_numNetworkTicks = 0;
+		return;
+	}
+
+	if (Application::getInstance().networkThread.getNetworkState() != NetworkThread::NET_STATE_IN_GAME)
+	{
+		m_numNetworkTicks = 0;
+	}
+	else
+	{
+		if (m_numNetworkTicks)
+		{
+			m_networkHandler->onTickSimulated(m_numNetworkTicks - 1);
+		}
+
+		m_numNetworkTicks++;
+	}
+
+	// After the hash, since they're for the tick that's starting. Rematch requests come in after the match, so this
+	// happens in or out of one
+	m_networkHandler->applyGameEvents();
+}
+
+float Controllers::getNetworkTickScale()
+{
+	if (m_networkHandler == nullptr || m_numNetworkTicks == 0)
+	{
+		return 1.0f;
+	}
+
+	return m_networkHandler->getTickScale();
+}
+
 void Controllers::update()
 {
+	// The match runs whether or not we have focus, so its ticks and events are dealt with first
+	updateNetwork();
+
 	// If the application doesn't have window focus, then we ignore inputs
 	if (Application::getInstance().hasWindowFocus == false)
 	{
@@ -81,9 +129,16 @@ void Controllers::update()
 	memcpy(&m_networkControllerPrevious, &m_networkController, sizeof(State));
 	
 	// If we're in a network game, then get the next input that was received, from the jitter buffer
-	if (Application::getInstance().networkThread.getNetworkState() == NetworkThread::NET_STATE_IN_GAME)
+	if (Application::getInstance().networkThread.getNetworkState() == NetworkThread::NET_STATE_IN_GAME && m_isNetworkRollbackMode == false)
 	{
-		m_networkController = Application::getInstance().networkThread.getNetJitterBuffer()->getNextState();
+		if (m_networkJitterBuffer)
+		{
+			m_networkController = m_networkJitterBuffer->getNextState(m_canNetworkTimeStretch);
+		}
+		else
+		{
+			m_networkController = Application::getInstance().networkThread.getNetJitterBuffer()->getNextState();
+		}
 	}
 
 	///////////////////////////////////////////////
@@ -17,6 +17,9 @@
 
 namespace shd
 {
+	class NetworkAdaptiveJitterBuffer;
+	class NetworkApplicationHandler;
+
 	class Controllers
 	{
 	public:
@@ -70,7 +73,7 @@ namespace shd
 			bool operator!=(const State& rhs);
 		};
 
-		Controllers() : m_mousePosPrevSet(false), m_isAnyKeyboardKeyPressed(false) {}
+		Controllers() : m_mousePosPrevSet(false), m_isAnyKeyboardKeyPressed(false), m_isNetworkRollbackMode(false), m_networkJitterBuffer(nullptr), m_canNetworkTimeStretch(false), m_networkHandler(nullptr), m_numNetworkTicks(0) {}
 		bool init();
 		void update();
 		void refreshControllerList();
@@ -89,8 +92,34 @@ namespace shd
 		void setAnyKeyoboardKeyPressed(bool isPressed) { m_isAnyKeyboardKeyPressed = isPressed; }
 		bool isAnyKeyoboardKeyPressed() { return m_isAnyKeyboardKeyPressed; }
 
+		// In rollback mode the network controller isn't read from the jitter buffer. NetworkRollback sets it for every frame it runs instead
+		void setNetworkRollbackMode(bool isRollbackMode) { m_isNetworkRollbackMode = isRollbackMode; }
+		bool isNetworkRollbackMode() { return m_isNetworkRollbackMode; }
+		void setNetworkControllerState(const State & state, const State & statePrevious);
+
+		// Read the network controller from an adaptive jitter buffer instead of the network thread's one. Set it to null to go back
+		void setNetworkJitterBuffer(NetworkAdaptiveJitterBuffer * jitterBuffer) { m_networkJitterBuffer = jitterBuffer; }
+		NetworkAdaptiveJitterBuffer * getNetworkJitterBuffer() { return m_networkJitterBuffer; }
+
+		// Can the adaptive jitter buffer repeat or skip a frame of the network controller right now? Only while the ball isn't
+		// in play, so the match sets it as the ball goes out of play and back in. Off until it does
+		void setNetworkTimeStretchAllowed(bool isAllowed) { m_canNetworkTimeStretch = isAllowed; }
+
+		// The network transport's handler, which is told each time a tick of a network match has been simulated, and
+		// whose received special events are applied. update() runs once at the start of every tick, so it's where the
+		// tick before is finished
+		void setNetworkHandler(NetworkApplicationHandler * handler) { m_networkHandler = handler; }
+
+		// The game's fixed step loop multiplies the length of the next tick by this, so our simulation speeds up or slows
+		// down a little to stay in line with the other peer's. Always 1 outside a network match
+		float getNetworkTickScale();
+
 	private:
 
+		// Tell the network handler the last tick has finished, count this one, and apply the special events the other
+		// side has sent since last time
+		void updateNetwork();
+
 		// This is used for game controllers
 		State m_controllers[SHD_MAX_CONTROLLERS];
 
@@ -121,5 +150,20 @@ namespace shd
 
 		// Used for the "press any button" screen 
 		bool m_isAnyKeyboardKeyPressed;
+
+		// Is the network controller driven by NetworkRollback instead of the jitter buffer
+		bool m_isNetworkRollbackMode;
+
+		// The adaptive jitter buffer the network controller is read from, if there is one
+		NetworkAdaptiveJitterBuffer * m_networkJitterBuffer;
+
+		// Can the adaptive jitter buffer repeat or skip frames
+		bool m_canNetworkTimeStretch;
+
+		// Told about every tick of a network match
+		NetworkApplicationHandler * m_networkHandler;
+
+		// Ticks started since the network match did. Both peers count from the start of the match
+		uint32_t m_numNetworkTicks;
 	};
 }
\ No newline at end of file
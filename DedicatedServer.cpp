@@ -0,0 +1,676 @@
+//
+//  DedicatedServer.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "DedicatedServer.h"
+#include "NetworkClock.h"
+#include "Common.h"
+
+using namespace shd;
+
+// The most players a worker handles each time it wakes up. Any more are still ready the next time
+#define SHD_WORKER_MAX_READY 64
+
+// Packets to one player waiting for the send thread. A tick's game packet, its fragments and some events
+#define SHD_MATCH_SEND_QUEUE_SIZE 16
+
+// A connected player who sends nothing for this long is dropped
+#define SHD_MATCH_PLAYER_TIMEOUT_US 5000000
+
+MatchInstance::Player::Player() :	transport(nullptr),
+									opponent(nullptr),
+									match(nullptr),
+									index(0),
+									isConnected(false),
+									teamColourPrimary(0),
+									teamColourSecondary(0),
+									relayQueue(nullptr),
+									relayHead(0),
+									relayCount(0),
+									eventHead(0),
+									eventCount(0),
+									lastReceiveUs(0),
+									lastBytesReceived(0)
+{
+}
+
+void MatchInstance::Player::getTeamColours(uint8_t * primary, uint8_t * secondary)
+{
+	// The handshake ACK tells this player what the opponent is wearing, if we know yet
+	Player * source = (opponent && opponent->isConnected) ? opponent : this;
+
+	*primary = source->teamColourPrimary;
+	*secondary = source->teamColourSecondary;
+}
+
+void MatchInstance::Player::onHandshakeReceived(uint8_t primary, uint8_t secondary)
+{
+	teamColourPrimary = primary;
+	teamColourSecondary = secondary;
+}
+
+void MatchInstance::Player::onHandshakeAckReceived(uint8_t primary, uint8_t secondary)
+{
+	// The server never sends a handshake, so it never gets ACKed
+	(void)primary;
+	(void)secondary;
+}
+
+void MatchInstance::Player::fillSendBuffer(uint8_t * buffer, size_t bufferSize, size_t * bytesWritten, bool * isFullStateUpdate)
+{
+	*bytesWritten = 0;
+	*isFullStateUpdate = false;
+
+	if (relayCount == 0)
+	{
+		return;
+	}
+
+	RelayedBody & body = relayQueue[relayHead];
+
+	if (body.size <= bufferSize)
+	{
+		memcpy(buffer, body.data, body.size);
+		*bytesWritten = body.size;
+		*isFullStateUpdate = body.isFullStateUpdate;
+	}
+
+	relayHead = (relayHead + 1) % RELAY_QUEUE_SIZE;
+	relayCount--;
+}
+
+void MatchInstance::Player::parseRecvBuffer(void * buffer, size_t bufferSize, bool isFullStateUpdate)
+{
+	uint32_t tail = 0;
+
+	if (opponent == nullptr || opponent->relayQueue == nullptr || bufferSize > NetworkPacketPool::PACKET_BUFFER_SIZE)
+	{
+		return;
+	}
+
+	// If the opponent is falling behind, the oldest body goes. A newer one has the same inputs in it
+	if (opponent->relayCount == RELAY_QUEUE_SIZE)
+	{
+		opponent->relayHead = (opponent->relayHead + 1) % RELAY_QUEUE_SIZE;
+		opponent->relayCount--;
+	}
+
+	tail = (opponent->relayHead + opponent->relayCount) % RELAY_QUEUE_SIZE;
+	opponent->relayQueue[tail].size = (uint32_t)bufferSize;
+	opponent->relayQueue[tail].isFullStateUpdate = isFullStateUpdate;
+	memcpy(opponent->relayQueue[tail].data, buffer, bufferSize);
+	opponent->relayCount++;
+}
+
+uint16_t MatchInstance::Player::getLastReceivedSeqNum()
+{
+	// The bodies are relayed without being read, so this ACKs the newest packet from the player rather than the
+	// newest input in it
+	if (transport == nullptr || transport->hasReceivedGamePacket() == false)
+	{
+		return 0;
+	}
+
+	return transport->getNewestSequenceReceived();
+}
+
+bool MatchInstance::Player::popGameEvent(GameEvent * event)
+{
+	if (eventCount == 0)
+	{
+		return false;
+	}
+
+	*event = eventQueue[eventHead];
+	eventHead = (eventHead + 1) % RELAY_EVENT_QUEUE_SIZE;
+	eventCount--;
+
+	return true;
+}
+
+void MatchInstance::Player::onGameEvent(const GameEvent & event)
+{
+	if (opponent == nullptr)
+	{
+		return;
+	}
+
+	if (opponent->eventCount == RELAY_EVENT_QUEUE_SIZE)
+	{
+		SHD_PRINTF("Relay event queue is full!\n");
+		return;
+	}
+
+	opponent->eventQueue[(opponent->eventHead + opponent->eventCount) % RELAY_EVENT_QUEUE_SIZE] = event;
+	opponent->eventCount++;
+}
+
+MatchInstance::MatchInstance() : m_matchIndex(0)
+{
+}
+
+MatchInstance::~MatchInstance()
+{
+	term();
+}
+
+bool MatchInstance::init(uint32_t matchIndex, uint16_t firstPort, NetworkSendThread * sendThread)
+{
+	term();
+
+	m_matchIndex = matchIndex;
+
+	for (uint32_t i = 0; i < PLAYERS_PER_MATCH; i++)
+	{
+		Player & player = m_players[i];
+
+		player.opponent = &m_players[(i + 1) % PLAYERS_PER_MATCH];
+		player.match = this;
+		player.index = i;
+		player.isConnected = false;
+		player.relayHead = 0;
+		player.relayCount = 0;
+		player.eventHead = 0;
+		player.eventCount = 0;
+		player.lastReceiveUs = 0;
+		player.lastBytesReceived = 0;
+
+		player.relayQueue = (Player::RelayedBody *)SHD_MALLOC(sizeof(Player::RelayedBody) * RELAY_QUEUE_SIZE);
+		if (player.relayQueue == nullptr)
+		{
+			term();
+			return false;
+		}
+
+		// The server doesn't know the players' addresses, so whoever sends to the port first is the player. If they
+		// don't shake hands in time, or go quiet later, the port is freed up for someone else
+		if (player.backend.init(firstPort + i, nullptr, 0) == false)
+		{
+			SHD_PRINTF("Match %u couldn't open port %u\n", matchIndex, firstPort + i);
+			term();
+			return false;
+		}
+
+		// Each tick's packets go out with one system call. NetworkTransport flushes them
+		player.backend.setSendBatching(true);
+
+		player.transport = new NetworkTransport();
+		player.transport->setBackend(&player.backend);
+
+		if (sendThread)
+		{
+			if (player.sendChannel.init(&player.backend, SHD_MATCH_SEND_QUEUE_SIZE) == false)
+			{
+				term();
+				return false;
+			}
+
+			player.transport->setBackend(&player.sendChannel);
+		}
+		player.transport->setHandler(&player);
+		player.transport->accept();
+	}
+
+	// Only once nothing else can fail, since the send thread holds on to its channels until it's stopped
+	for (uint32_t i = 0; sendThread && i < PLAYERS_PER_MATCH; i++)
+	{
+		if (sendThread->addChannel(&m_players[i].sendChannel) == false)
+		{
+			SHD_PRINTF("Match %u couldn't use the send thread\n", matchIndex);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void MatchInstance::term()
+{
+	for (uint32_t i = 0; i < PLAYERS_PER_MATCH; i++)
+	{
+		Player & player = m_players[i];
+
+		if (player.transport)
+		{
+			delete player.transport;
+			player.transport = nullptr;
+		}
+
+		if (player.relayQueue)
+		{
+			SHD_FREE(player.relayQueue);
+			player.relayQueue = nullptr;
+		}
+
+		player.sendChannel.term();
+		player.backend.term();
+		player.isConnected = false;
+	}
+}
+
+bool MatchInstance::isRunning()
+{
+	for (uint32_t i = 0; i < PLAYERS_PER_MATCH; i++)
+	{
+		if (m_players[i].isConnected == false)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool MatchInstance::addToPoller(NetworkPoller & poller)
+{
+	for (uint32_t i = 0; i < PLAYERS_PER_MATCH; i++)
+	{
+		if (poller.addSocket(&m_players[i].backend, &m_players[i]) == false)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void MatchInstance::onPacketsReady(void * userData)
+{
+	Player * player = (Player *)userData;
+
+	player->match->receive(*player);
+}
+
+void MatchInstance::receive(Player & player)
+{
+	int64_t bytesReceived = 0;
+
+	if (player.transport == nullptr)
+	{
+		return;
+	}
+
+	if (player.isConnected)
+	{
+		player.transport->receiveData();
+	}
+	else
+	{
+		NetworkTransport::ConnectState connectState = player.transport->updateConnect();
+
+		if (connectState == NetworkTransport::CONNECT_STATE_CONNECTED)
+		{
+			SHD_PRINTF("Match %u player %u connected\n", m_matchIndex, player.index);
+			player.isConnected = true;
+		}
+		else if (connectState == NetworkTransport::CONNECT_STATE_TIMED_OUT)
+		{
+			// A match waits for its players for as long as it takes, but whoever took the port without shaking
+			// hands gives it up
+			player.backend.clearRemotePeer();
+			player.transport->accept();
+		}
+	}
+
+	bytesReceived = player.transport->getTotalBytesReceived();
+
+	if (bytesReceived != player.lastBytesReceived)
+	{
+		player.lastBytesReceived = bytesReceived;
+		player.lastReceiveUs = NetworkClock::getTimeMicroseconds();
+	}
+}
+
+void MatchInstance::disconnect(Player & player)
+{
+	SHD_PRINTF("Match %u player %u timed out\n", m_matchIndex, player.index);
+
+	player.isConnected = false;
+
+	// Nothing that was waiting for or from them is any use to whoever takes their place
+	player.relayHead = 0;
+	player.relayCount = 0;
+	player.eventHead = 0;
+	player.eventCount = 0;
+
+	if (player.opponent)
+	{
+		player.opponent->relayHead = 0;
+		player.opponent->relayCount = 0;
+		player.opponent->eventHead = 0;
+		player.opponent->eventCount = 0;
+	}
+
+	player.backend.clearRemotePeer();
+	player.transport->reset();
+	player.transport->accept();
+}
+
+void MatchInstance::update(bool receiveFirst)
+{
+	uint64_t nowUs = 0;
+
+	for (uint32_t i = 0; receiveFirst && i < PLAYERS_PER_MATCH; i++)
+	{
+		receive(m_players[i]);
+	}
+
+	nowUs = NetworkClock::getTimeMicroseconds();
+
+	for (uint32_t i = 0; i < PLAYERS_PER_MATCH; i++)
+	{
+		Player & player = m_players[i];
+
+		if (player.transport && player.isConnected && nowUs - player.lastReceiveUs >= SHD_MATCH_PLAYER_TIMEOUT_US)
+		{
+			disconnect(player);
+		}
+	}
+
+	tick();
+
+	for (uint32_t i = 0; i < PLAYERS_PER_MATCH; i++)
+	{
+		Player & player = m_players[i];
+
+		if (player.transport && player.isConnected)
+		{
+			player.transport->sendSpecialEvents();
+			player.transport->sendData();
+		}
+	}
+}
+
+DedicatedServer::DedicatedServer() :	m_matches(nullptr),
+										m_sendThread(nullptr),
+										m_numWorkersStarted(0),
+										m_endThreads(0),
+										m_statsStartUs(0)
+{
+	memset(&m_config, 0, sizeof(Config));
+}
+
+DedicatedServer::~DedicatedServer()
+{
+	term();
+}
+
+bool DedicatedServer::init(const Config & config)
+{
+	Threading::ThreadStartParams threadParams;
+
+	term();
+
+	if (config.numMatches == 0 || config.numWorkers == 0 || config.numWorkers > MAX_WORKERS || config.ticksPerSecond == 0)
+	{
+		SHD_ASSERT(false);
+		return false;
+	}
+
+	if ((uint32_t)config.firstPort + config.numMatches * MatchInstance::PLAYERS_PER_MATCH > 0xFFFF)
+	{
+		SHD_PRINTF("Not enough ports for %u matches from port %u\n", config.numMatches, config.firstPort);
+		return false;
+	}
+
+	m_config = config;
+
+	if (config.useSendThread)
+	{
+		m_sendThread = new NetworkSendThread();
+
+		if (m_sendThread->init(config.sendBytesPerSecond) == false)
+		{
+			term();
+			return false;
+		}
+	}
+
+	m_matches = new MatchInstance[config.numMatches];
+
+	for (uint32_t i = 0; i < config.numMatches; i++)
+	{
+		if (m_matches[i].init(i, (uint16_t)(config.firstPort + i * MatchInstance::PLAYERS_PER_MATCH), m_sendThread) == false)
+		{
+			term();
+			return false;
+		}
+	}
+
+	m_endThreads = 0;
+	m_statsStartUs = NetworkClock::getTimeMicroseconds();
+
+	for (uint32_t i = 0; i < config.numWorkers; i++)
+	{
+		Worker & worker = m_workers[i];
+
+		worker.server = this;
+		worker.index = i;
+		worker.threadHandle = 0;
+		worker.busyUs = 0;
+		worker.numTicks = 0;
+		worker.numOverruns = 0;
+		worker.numWakeups = 0;
+		worker.poller = new NetworkPoller();
+
+		if (worker.poller->init() == false)
+		{
+			SHD_PRINTF("Worker %u has no poller, so it will check every match each tick\n", i);
+		}
+
+		for (uint32_t j = i; j < config.numMatches; j += config.numWorkers)
+		{
+			if (m_matches[j].addToPoller(*worker.poller) == false)
+			{
+				SHD_PRINTF("Worker %u can't wait on match %u, so it will check every match each tick\n", i, j);
+				worker.poller->term();
+				break;
+			}
+		}
+
+		threadParams.entryPoint = &workerEntry;
+		threadParams.userArgs = &worker;
+
+		if (Threading::startThread(threadParams, &worker.threadHandle) == false)
+		{
+			delete worker.poller;
+			worker.poller = nullptr;
+			term();
+			return false;
+		}
+
+		m_numWorkersStarted++;
+	}
+
+	SHD_PRINTF("Dedicated server running %u matches on %u workers, ports %u to %u\n",
+		config.numMatches,
+		config.numWorkers,
+		config.firstPort,
+		config.firstPort + config.numMatches * MatchInstance::PLAYERS_PER_MATCH - 1);
+
+	return true;
+}
+
+void DedicatedServer::term()
+{
+	Atomic::exchange32(&m_endThreads, 1);
+
+	// Wait for the workers to end before closing the matches they're using. Waking them means they don't sleep
+	// out the rest of the tick first
+	for (uint32_t i = 0; i < m_numWorkersStarted; i++)
+	{
+		m_workers[i].poller->wake();
+		Threading::joinThread(m_workers[i].threadHandle);
+
+		delete m_workers[i].poller;
+		m_workers[i].poller = nullptr;
+	}
+
+	m_numWorkersStarted = 0;
+
+	// Then for the send thread to send what they left queued
+	if (m_sendThread)
+	{
+		delete m_sendThread;
+		m_sendThread = nullptr;
+	}
+
+	if (m_matches)
+	{
+		delete[] m_matches;
+		m_matches = nullptr;
+	}
+}
+
+void DedicatedServer::workerEntry(void * args)
+{
+	Worker * worker = (Worker *)args;
+	DedicatedServer * server = worker->server;
+	uint64_t tickUs = 1000000 / server->m_config.ticksPerSecond;
+	uint64_t nextTickUs = NetworkClock::getTimeMicroseconds();
+	NetworkPoller * poller = worker->poller;
+	void * ready[SHD_WORKER_MAX_READY];
+
+	while (server->m_endThreads == 0)
+	{
+		uint64_t startUs = NetworkClock::getTimeMicroseconds();
+		uint64_t endUs = 0;
+
+		// If the poller can say when packets arrive, they've already been received
+		bool receiveFirst = (poller->isEventDriven() == false);
+
+		// Each worker has every numWorkers'th match, so no two workers ever touch the same one
+		for (uint32_t i = worker->index; i < server->m_config.numMatches; i += server->m_config.numWorkers)
+		{
+			server->m_matches[i].update(receiveFirst);
+		}
+
+		endUs = NetworkClock::getTimeMicroseconds();
+		Atomic::add64(&worker->busyUs, (int64_t)(endUs - startUs));
+		Atomic::add32(&worker->numTicks, 1);
+
+		nextTickUs += tickUs;
+
+		if (endUs >= nextTickUs)
+		{
+			// Too slow to keep up, so don't try to catch up on the missed ticks
+			Atomic::add32(&worker->numOverruns, 1);
+			nextTickUs = endUs;
+		}
+
+		// Sleep until the next tick, receiving from players as their packets arrive rather than all at once on the tick
+		while (server->m_endThreads == 0 && endUs < nextTickUs)
+		{
+			bool wasWoken = false;
+			uint32_t numReady = poller->wait(nextTickUs - endUs, ready, SHD_WORKER_MAX_READY, &wasWoken);
+
+			if (receiveFirst)
+			{
+				// It slept for the whole time, and update() receives from everyone
+				break;
+			}
+
+			startUs = NetworkClock::getTimeMicroseconds();
+
+			for (uint32_t i = 0; i < numReady; i++)
+			{
+				MatchInstance::onPacketsReady(ready[i]);
+			}
+
+			endUs = NetworkClock::getTimeMicroseconds();
+
+			if (numReady)
+			{
+				Atomic::add64(&worker->busyUs, (int64_t)(endUs - startUs));
+				Atomic::add32(&worker->numWakeups, 1);
+			}
+		}
+	}
+}
+
+uint32_t DedicatedServer::getNumMatchesRunning()
+{
+	uint32_t numRunning = 0;
+
+	for (uint32_t i = 0; i < m_config.numMatches; i++)
+	{
+		if (m_matches[i].isRunning())
+		{
+			numRunning++;
+		}
+	}
+
+	return numRunning;
+}
+
+float DedicatedServer::getMatchesPerCore()
+{
+	uint64_t nowUs = NetworkClock::getTimeMicroseconds();
+	uint64_t elapsedUs = nowUs - m_statsStartUs;
+	uint32_t numRunning = getNumMatchesRunning();
+	int64_t busyUs = 0;
+
+	for (uint32_t i = 0; i < m_numWorkersStarted; i++)
+	{
+		busyUs += Atomic::exchange64(&m_workers[i].busyUs, 0);
+	}
+
+	m_statsStartUs = nowUs;
+
+	// Waiting for players costs next to nothing, so idle matches would make the figure meaningless
+	if (numRunning == 0 || busyUs <= 0 || elapsedUs == 0)
+	{
+		return 0.0f;
+	}
+
+	// How many cores' worth of time the workers used, and so how many matches fit on one
+	return (float)numRunning / ((float)busyUs / (float)elapsedUs);
+}
+
+void DedicatedServer::printStats()
+{
+	uint64_t elapsedUs = NetworkClock::getTimeMicroseconds() - m_statsStartUs;
+	uint32_t numRunning = getNumMatchesRunning();
+	float matchesPerCore = 0.0f;
+
+	for (uint32_t i = 0; i < m_numWorkersStarted; i++)
+	{
+		Worker & worker = m_workers[i];
+
+		SHD_PRINTF("Worker %u: %.1f%% busy, %u ticks, %u overruns, %u wakeups for packets\n",
+			i,
+			(elapsedUs) ? 100.0f * (float)worker.busyUs / (float)elapsedUs : 0.0f,
+			Atomic::exchange32(&worker.numTicks, 0),
+			Atomic::exchange32(&worker.numOverruns, 0),
+			Atomic::exchange32(&worker.numWakeups, 0));
+	}
+
+	if (m_sendThread)
+	{
+		SHD_PRINTF("Send thread: %u packets in %u flushes, %llu cycles to queue one, %llu cycles to send one, %llu us queued, %u paced waits\n",
+			m_sendThread->getNumPacketsSent(),
+			m_sendThread->getNumFlushes(),
+			(unsigned long long)m_sendThread->getAverageEnqueueCycles(),
+			(unsigned long long)m_sendThread->getAverageSendCycles(),
+			(unsigned long long)m_sendThread->getAverageQueueMicroseconds(),
+			m_sendThread->getNumPacedWaits());
+
+		m_sendThread->resetCounters();
+	}
+
+	// Resets the busy times, so it's only worked out once the workers have been printed
+	matchesPerCore = getMatchesPerCore();
+
+	if (numRunning > 0)
+	{
+		SHD_PRINTF("%u of %u matches running, %.1f matches per core\n", numRunning, m_config.numMatches, matchesPerCore);
+	}
+	else
+	{
+		SHD_PRINTF("0 of %u matches running\n", m_config.numMatches);
+	}
+}
@@ -0,0 +1,217 @@
+//
+//  DedicatedServer.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include "NetworkTransport.h"
+#include "NetworkBackendUdp.h"
+#include "NetworkPoller.h"
+#include "NetworkSendThread.h"
+#include "Threading.h"
+
+// The headless server is built with SHD_DEDICATED_SERVER defined, from DedicatedServerMain.cpp, DedicatedServer.cpp
+// and the Network*.cpp files, leaving out NetworkTransportApplication.cpp. There's no Application, Renderer,
+// AudioThread, XInput or Steam in it
+
+namespace shd
+{
+	// One match on the server. Each player connects to their own UDP port and gets their own NetworkTransport.
+	// For now the server relays: game packet bodies and special events from one player are sent on to the other.
+	// An authoritative match overrides tick() and the Player handler calls to run the match here instead
+	class MatchInstance
+	{
+	public:
+
+		static const uint32_t PLAYERS_PER_MATCH = 2;
+
+		// The most game packet bodies from one player waiting to be sent to the other
+		static const uint32_t RELAY_QUEUE_SIZE = 8;
+		static const uint32_t RELAY_EVENT_QUEUE_SIZE = 16;
+
+		MatchInstance();
+		virtual ~MatchInstance();
+
+		// Player n listens on firstPort + n. With a sendThread, packets to the players are sent by it instead of by the worker
+		bool init(uint32_t matchIndex, uint16_t firstPort, NetworkSendThread * sendThread);
+		void term();
+
+		// Run the match and send to both players. Called once a tick by a worker. receiveFirst receives from both
+		// players first, for workers that don't know when packets arrive
+		void update(bool receiveFirst);
+
+		// Wait on both players' sockets. onPacketsReady() is what to call with the userData the poller hands back
+		bool addToPoller(NetworkPoller & poller);
+		static void onPacketsReady(void * userData);
+
+		// Both players have shaken hands
+		bool isRunning();
+
+		inline uint32_t getMatchIndex() { return m_matchIndex; }
+		inline NetworkTransport * getTransport(uint32_t player) { return m_players[player].transport; }
+
+	protected:
+
+		// Run one tick of the match, between receiving and sending
+		virtual void tick() {}
+
+		class Player : public NetworkTransportHandler
+		{
+		public:
+
+			Player();
+
+			virtual void getTeamColours(uint8_t * primary, uint8_t * secondary);
+			virtual void onHandshakeReceived(uint8_t primary, uint8_t secondary);
+			virtual void onHandshakeAckReceived(uint8_t primary, uint8_t secondary);
+			virtual void fillSendBuffer(uint8_t * buffer, size_t bufferSize, size_t * bytesWritten, bool * isFullStateUpdate);
+			virtual void parseRecvBuffer(void * buffer, size_t bufferSize, bool isFullStateUpdate);
+			virtual uint16_t getLastReceivedSeqNum();
+			virtual bool popGameEvent(GameEvent * event);
+			virtual void onGameEvent(const GameEvent & event);
+
+			struct RelayedBody
+			{
+				uint32_t size;
+				bool isFullStateUpdate;
+				uint8_t data[NetworkPacketPool::PACKET_BUFFER_SIZE];
+			};
+
+			NetworkBackendUdp backend;
+
+			// Queues packets for the send thread, when there is one
+			NetworkSendChannel sendChannel;
+
+			// Big, so it lives on the heap
+			NetworkTransport * transport;
+
+			// The other player in the match
+			Player * opponent;
+
+			// The match this player is in, and which player they are
+			MatchInstance * match;
+			uint32_t index;
+
+			// Has this player's handshake arrived, and been ACKed
+			bool isConnected;
+
+			// Team colours from the handshake, passed on to the opponent's handshake ACK
+			uint8_t teamColourPrimary;
+			uint8_t teamColourSecondary;
+
+			// Bodies and events from the opponent, waiting to be sent to this player
+			RelayedBody * relayQueue;
+			uint32_t relayHead;
+			uint32_t relayCount;
+			GameEvent eventQueue[RELAY_EVENT_QUEUE_SIZE];
+			uint32_t eventHead;
+			uint32_t eventCount;
+
+			// When something last arrived from this player, and how many bytes had arrived by then
+			uint64_t lastReceiveUs;
+			int64_t lastBytesReceived;
+		};
+
+		Player m_players[PLAYERS_PER_MATCH];
+
+	private:
+
+		// Disable copying
+		MatchInstance(const MatchInstance &);
+		MatchInstance & operator=(const MatchInstance &);
+
+		// Receive whatever has arrived from one player
+		void receive(Player & player);
+
+		// Drop a player who has gone quiet, and wait for someone to take their place
+		void disconnect(Player & player);
+
+		uint32_t m_matchIndex;
+	};
+
+	// Runs many matches in one process. Matches are shared out between a pool of worker threads, and each worker
+	// updates its matches once a tick. Between ticks it sleeps on its matches' sockets, and receives from a player as
+	// soon as their packets arrive. The time the workers spend busy is used to work out how many matches one core can run
+	class DedicatedServer
+	{
+	public:
+
+		static const uint32_t MAX_WORKERS = 64;
+
+		struct Config
+		{
+			uint32_t numMatches;
+			uint32_t numWorkers;
+			uint16_t firstPort;			// Match n uses ports firstPort + n * PLAYERS_PER_MATCH and up
+			uint32_t ticksPerSecond;
+			bool useSendThread;			// Send from one thread of its own instead of from the workers
+			uint32_t sendBytesPerSecond;	// Cap on the send thread's rate, or 0 for none
+		};
+
+		DedicatedServer();
+		~DedicatedServer();
+
+		bool init(const Config & config);
+
+		// Stop the workers and close every match
+		void term();
+
+		// Matches where both players are connected
+		uint32_t getNumMatchesRunning();
+
+		// Running matches per core, from how busy the workers have been since the last call. 0 if none are running
+		float getMatchesPerCore();
+
+		// Print the load on each worker since the last call
+		void printStats();
+
+	private:
+
+		struct Worker
+		{
+			DedicatedServer * server;
+			uint32_t index;
+			Threading::ThreadHandle threadHandle;
+
+			// Sleeps until the next tick, or until one of the worker's matches has packets waiting
+			NetworkPoller * poller;
+
+			// Time spent updating matches, and the number of ticks run. Reset by the stats calls
+			volatile int64_t busyUs;
+			volatile uint32_t numTicks;
+
+			// Ticks that took longer than the tick time
+			volatile uint32_t numOverruns;
+
+			// Times the worker woke up between ticks because packets arrived
+			volatile uint32_t numWakeups;
+		};
+
+		// Disable copying
+		DedicatedServer(const DedicatedServer &);
+		DedicatedServer & operator=(const DedicatedServer &);
+
+		// Entry func for the worker threads
+		static void workerEntry(void * args);
+
+		Config m_config;
+
+		MatchInstance * m_matches;
+
+		// Sends every match's packets, if Config::useSendThread is set
+		NetworkSendThread * m_sendThread;
+
+		Worker m_workers[MAX_WORKERS];
+		uint32_t m_numWorkersStarted;
+
+		// Should the workers stop?
+		volatile uint32_t m_endThreads;
+
+		// When the stats were last reset
+		uint64_t m_statsStartUs;
+	};
+}
@@ -0,0 +1,94 @@
+//
+//  DedicatedServerMain.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#ifdef SHD_DEDICATED_SERVER
+
+#include "Common.h"
+#include "DedicatedServer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace shd;
+
+// How often the stats are printed
+#define SHD_DEDICATED_SERVER_STATS_PERIOD_MS 5000
+
+// Usage: -matches <n> -workers <n> -port <first port> -tickrate <ticks per second> -seconds <run time, 0 for forever>
+//        -sendthread <bytes per second, 0 for no cap>, to send from a thread of its own instead of from the workers
+// The benchmarks and offline tools are in NetworkToolsMain.cpp
+int main(int argc, char ** argv)
+{
+	DedicatedServer server;
+	DedicatedServer::Config config;
+	uint32_t runTimeSeconds = 0;
+	uint32_t elapsedMs = 0;
+
+	config.numMatches = 16;
+	config.numWorkers = 1;
+	config.firstPort = 27100;
+	config.ticksPerSecond = 60;
+	config.useSendThread = false;
+	config.sendBytesPerSecond = 0;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		uint32_t value = (uint32_t)atoi(argv[i + 1]);
+
+		if (strcmp(argv[i], "-matches") == 0)
+		{
+			config.numMatches = value;
+		}
+		else if (strcmp(argv[i], "-workers") == 0)
+		{
+			config.numWorkers = value;
+		}
+		else if (strcmp(argv[i], "-port") == 0)
+		{
+			config.firstPort = (uint16_t)value;
+		}
+		else if (strcmp(argv[i], "-tickrate") == 0)
+		{
+			config.ticksPerSecond = value;
+		}
+		else if (strcmp(argv[i], "-seconds") == 0)
+		{
+			runTimeSeconds = value;
+		}
+		else if (strcmp(argv[i], "-sendthread") == 0)
+		{
+			config.useSendThread = true;
+			config.sendBytesPerSecond = value;
+		}
+		else
+		{
+			SHD_PRINTF("Unknown argument: %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	if (server.init(config) == false)
+	{
+		SHD_PRINTF("Failed to start the dedicated server\n");
+		return 1;
+	}
+
+	while (runTimeSeconds == 0 || elapsedMs < runTimeSeconds * 1000)
+	{
+		Threading::sleep(SHD_DEDICATED_SERVER_STATS_PERIOD_MS);
+		elapsedMs += SHD_DEDICATED_SERVER_STATS_PERIOD_MS;
+
+		server.printStats();
+	}
+
+	server.term();
+
+	return 0;
+}
+
+#endif
@@ -0,0 +1,303 @@
+//
+//  NetworkAdaptiveJitterBuffer.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkAdaptiveJitterBuffer.h"
+#include "NetworkSequence.h"
+#include <math.h>
+
+using namespace shd;
+
+// How many standard deviations of arrival jitter the buffer should cover
+#define SHD_JITTER_BUFFER_DEVIATIONS 2.5f
+
+// Weight of each new arrival in the running mean and variance. About the last 64 inputs count
+#define SHD_JITTER_BUFFER_STATS_WEIGHT (1.0f / 64.0f)
+
+// How much of the gap between the target depth and the depth the jitter calls for is closed each frame.
+// Growing is quicker than shrinking, since running dry is worse than a little extra latency
+#define SHD_JITTER_BUFFER_GROW_RATE 0.1f
+#define SHD_JITTER_BUFFER_SHRINK_RATE 0.005f
+
+// Weight of each frame's depth in the average depth. The depth wobbles by a frame or two with every late arrival,
+// so it's the average that decides whether to stretch or skip
+#define SHD_JITTER_BUFFER_DEPTH_WEIGHT 0.05f
+
+// 60 frames a second
+#define SHD_JITTER_BUFFER_DEFAULT_FRAME_US 16667
+
+NetworkAdaptiveJitterBuffer::NetworkAdaptiveJitterBuffer() : m_frameUs(SHD_JITTER_BUFFER_DEFAULT_FRAME_US)
+{
+	reset();
+}
+
+void NetworkAdaptiveJitterBuffer::init(uint32_t frameUs)
+{
+	SHD_ASSERT(frameUs > 0);
+
+	m_frameUs = (frameUs) ? frameUs : SHD_JITTER_BUFFER_DEFAULT_FRAME_US;
+	reset();
+}
+
+void NetworkAdaptiveJitterBuffer::reset()
+{
+	for (uint32_t i = 0; i < RING_SIZE; i++)
+	{
+		m_ring[i].isValid = false;
+	}
+
+	m_queueWriteIndex = 0;
+	m_queueReadIndex = 0;
+	m_currentInput = Controllers::State();
+	m_nextSequenceNum = 0;
+	m_newestSequenceNum = 0;
+	m_hasReceived = false;
+	m_isPlaying = false;
+	m_hasArrivalStats = false;
+	m_firstArrivalTimeUs = 0;
+	m_firstSequenceNum = 0;
+	m_delayMeanUs = 0.0f;
+	m_delayVarianceUs = 0.0f;
+	m_desiredDepth = (float)MIN_DEPTH;
+	m_targetDepth = (float)MIN_DEPTH;
+	m_averageDepth = 0.0f;
+	m_depth = 0;
+	m_jitterUs = 0;
+
+	resetCounters();
+}
+
+void NetworkAdaptiveJitterBuffer::resetCounters()
+{
+	Atomic::exchange32(&m_numUnderruns, 0);
+	Atomic::exchange32(&m_numOverruns, 0);
+	Atomic::exchange32(&m_numLateInputs, 0);
+	Atomic::exchange32(&m_numFramesStretched, 0);
+	Atomic::exchange32(&m_numFramesSkipped, 0);
+	Atomic::exchange32(&m_numFramesConcealed, 0);
+}
+
+bool NetworkAdaptiveJitterBuffer::addRemoteInput(uint16_t sequenceNum, const Controllers::State & input, uint64_t arrivalTimeUs)
+{
+	uint32_t writeIndex = m_queueWriteIndex;
+
+	if (writeIndex - m_queueReadIndex >= QUEUE_SIZE)
+	{
+		SHD_PRINTF("Jitter buffer input queue is full!\n");
+		Atomic::add32(&m_numOverruns, 1);
+		return false;
+	}
+
+	QueuedInput & queued = m_queue[writeIndex % QUEUE_SIZE];
+	queued.sequenceNum = sequenceNum;
+	queued.arrivalTimeUs = arrivalTimeUs;
+	queued.input = input;
+
+	// Publish the slot only after it has been filled
+	Atomic::exchange32(&m_queueWriteIndex, writeIndex + 1);
+
+	return true;
+}
+
+void NetworkAdaptiveJitterBuffer::measureArrival(uint16_t sequenceNum, uint64_t arrivalTimeUs)
+{
+	float delayUs = 0.0f;
+	float deviationUs = 0.0f;
+	float jitterUs = 0.0f;
+
+	if (m_hasArrivalStats == false)
+	{
+		m_firstArrivalTimeUs = arrivalTimeUs;
+		m_firstSequenceNum = sequenceNum;
+		m_hasArrivalStats = true;
+		return;
+	}
+
+	// How much later than the send rate says it should have, this input turned up
+	delayUs = (float)((int64_t)(arrivalTimeUs - m_firstArrivalTimeUs) - (int64_t)NetworkSequence::difference(sequenceNum, m_firstSequenceNum) * m_frameUs);
+
+	deviationUs = delayUs - m_delayMeanUs;
+	m_delayMeanUs += SHD_JITTER_BUFFER_STATS_WEIGHT * deviationUs;
+	m_delayVarianceUs = (1.0f - SHD_JITTER_BUFFER_STATS_WEIGHT) * (m_delayVarianceUs + SHD_JITTER_BUFFER_STATS_WEIGHT * deviationUs * deviationUs);
+
+	// Measure from the newest input from now on, so the sequence numbers never get far enough apart to wrap
+	if (NetworkSequence::isNewer(sequenceNum, m_firstSequenceNum))
+	{
+		m_firstArrivalTimeUs = arrivalTimeUs - (int64_t)delayUs;
+		m_firstSequenceNum = sequenceNum;
+	}
+
+	jitterUs = sqrtf(m_delayVarianceUs);
+	Atomic::exchange32(&m_jitterUs, (uint32_t)jitterUs);
+
+	m_desiredDepth = (float)MIN_DEPTH + SHD_JITTER_BUFFER_DEVIATIONS * jitterUs / (float)m_frameUs;
+
+	if (m_desiredDepth > (float)MAX_DEPTH)
+	{
+		m_desiredDepth = (float)MAX_DEPTH;
+	}
+}
+
+void NetworkAdaptiveJitterBuffer::processQueue()
+{
+	uint32_t readIndex = m_queueReadIndex;
+
+	while (readIndex != m_queueWriteIndex)
+	{
+		QueuedInput & queued = m_queue[readIndex % QUEUE_SIZE];
+
+		measureArrival(queued.sequenceNum, queued.arrivalTimeUs);
+
+		if (m_hasReceived == false)
+		{
+			m_nextSequenceNum = queued.sequenceNum;
+			m_newestSequenceNum = queued.sequenceNum;
+			m_hasReceived = true;
+		}
+		else if (m_isPlaying == false && NetworkSequence::isNewer(m_nextSequenceNum, queued.sequenceNum) &&
+				 NetworkSequence::difference(m_newestSequenceNum, queued.sequenceNum) < (int32_t)RING_SIZE)
+		{
+			// Still filling up, so an earlier input that was overtaken can go in front
+			m_nextSequenceNum = queued.sequenceNum;
+		}
+
+		if (NetworkSequence::isNewer(m_nextSequenceNum, queued.sequenceNum))
+		{
+			// Its frame has already been played
+			Atomic::add32(&m_numLateInputs, 1);
+		}
+		else if (NetworkSequence::difference(queued.sequenceNum, m_nextSequenceNum) >= (int32_t)RING_SIZE)
+		{
+			// Too far ahead to fit
+			Atomic::add32(&m_numOverruns, 1);
+		}
+		else
+		{
+			Slot & slot = m_ring[queued.sequenceNum % RING_SIZE];
+			slot.sequenceNum = queued.sequenceNum;
+			slot.input = queued.input;
+			slot.isValid = true;
+
+			if (NetworkSequence::isNewer(queued.sequenceNum, m_newestSequenceNum))
+			{
+				m_newestSequenceNum = queued.sequenceNum;
+			}
+		}
+
+		readIndex++;
+	}
+
+	// Give the slots back to the network thread
+	Atomic::exchange32(&m_queueReadIndex, readIndex);
+}
+
+void NetworkAdaptiveJitterBuffer::updateTargetDepth()
+{
+	float rate = (m_desiredDepth > m_targetDepth) ? SHD_JITTER_BUFFER_GROW_RATE : SHD_JITTER_BUFFER_SHRINK_RATE;
+
+	m_targetDepth += (m_desiredDepth - m_targetDepth) * rate;
+}
+
+void NetworkAdaptiveJitterBuffer::playNext()
+{
+	Slot & slot = m_ring[m_nextSequenceNum % RING_SIZE];
+
+	if (slot.isValid && slot.sequenceNum == m_nextSequenceNum)
+	{
+		m_currentInput = slot.input;
+		slot.isValid = false;
+	}
+	else
+	{
+		// Lost, so keep doing whatever they were doing
+		Atomic::add32(&m_numFramesConcealed, 1);
+	}
+
+	m_nextSequenceNum++;
+}
+
+const Controllers::State & NetworkAdaptiveJitterBuffer::getNextState(bool canTimeStretch)
+{
+	int32_t depth = 0;
+	uint32_t targetDepth = 0;
+
+	processQueue();
+	updateTargetDepth();
+
+	targetDepth = (uint32_t)(m_targetDepth + 0.5f);
+	depth = (m_hasReceived) ? NetworkSequence::difference(m_newestSequenceNum, m_nextSequenceNum) + 1 : 0;
+
+	if (depth < 0)
+	{
+		depth = 0;
+	}
+
+	if (m_isPlaying == false)
+	{
+		// Fill up to the target depth before playing anything
+		if (m_hasReceived && depth >= (int32_t)targetDepth)
+		{
+			m_isPlaying = true;
+		}
+		else
+		{
+			Atomic::exchange32(&m_depth, (uint32_t)depth);
+			return m_currentInput;
+		}
+
+		m_averageDepth = (float)depth;
+	}
+
+	// Way too deep, and it can't wait for the ball to go out of play. Throw away the oldest inputs
+	while (depth > (int32_t)MAX_DEPTH)
+	{
+		Slot & slot = m_ring[m_nextSequenceNum % RING_SIZE];
+
+		if (slot.isValid && slot.sequenceNum == m_nextSequenceNum)
+		{
+			m_currentInput = slot.input;
+			slot.isValid = false;
+		}
+
+		m_nextSequenceNum++;
+		depth--;
+		Atomic::add32(&m_numOverruns, 1);
+	}
+
+	m_averageDepth += ((float)depth - m_averageDepth) * SHD_JITTER_BUFFER_DEPTH_WEIGHT;
+
+	if (depth == 0)
+	{
+		// Nothing to play, so play the last input again. The buffer is a frame deeper from now on
+		Atomic::add32(&m_numUnderruns, 1);
+	}
+	else if (canTimeStretch && m_averageDepth < m_targetDepth - 0.5f)
+	{
+		// Play the last input again, to let the buffer fill up
+		m_averageDepth += 1.0f;
+		Atomic::add32(&m_numFramesStretched, 1);
+	}
+	else if (canTimeStretch && depth > 1 && m_averageDepth > m_targetDepth + 1.0f)
+	{
+		// Skip a frame, to let the buffer drain. Up to a frame over the target is left alone, so it doesn't skip and
+		// then stretch straight back again
+		playNext();
+		playNext();
+		depth -= 2;
+		m_averageDepth -= 1.0f;
+		Atomic::add32(&m_numFramesSkipped, 1);
+	}
+	else
+	{
+		playNext();
+		depth--;
+	}
+
+	Atomic::exchange32(&m_depth, (uint32_t)depth);
+
+	return m_currentInput;
+}
@@ -0,0 +1,157 @@
+//
+//  NetworkAdaptiveJitterBuffer.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include "Controllers.h"
+
+namespace shd
+{
+	// A jitter buffer for the other player's inputs that sizes itself to the connection. It measures how much the
+	// arrival times wobble, and holds back just enough frames to ride that out. On a steady connection it runs
+	// shallow and adds little latency, and on a bad one it runs deeper so inputs don't run dry.
+	// The depth only moves a frame at a time, by playing a frame twice or skipping one, and only while the ball
+	// isn't in play. Running dry or overflowing while it is in play is counted, so the trade off can be seen.
+	// Remote inputs are added from the network thread, and everything else happens on the game thread.
+	// The match doesn't use it yet. It has to hand over the remote inputs as the NetworkInputBuffer parses them, which
+	// this tree can't see into, give it to Controllers::setNetworkJitterBuffer(), and say when the ball is out of play
+	// with Controllers::setNetworkTimeStretchAllowed()
+	class NetworkAdaptiveJitterBuffer
+	{
+	public:
+
+		// Inputs are kept by sequence number in a ring this big, so it's also the deepest the buffer can get
+		static const uint32_t RING_SIZE = 64;
+
+		// Remote inputs waiting to be picked up by the game thread
+		static const uint32_t QUEUE_SIZE = 64;
+
+		// The range the target depth is kept in, in frames
+		static const uint32_t MIN_DEPTH = 1;
+		static const uint32_t MAX_DEPTH = 16;
+
+		NetworkAdaptiveJitterBuffer();
+
+		// frameUs is how often inputs are sent and played, in microseconds
+		void init(uint32_t frameUs);
+
+		// Forget everything, for a new match
+		void reset();
+
+		// The other player's input, using the 16 bit sequence number it was sent with, and when it arrived in
+		// NetworkClock::getTimeMicroseconds(). Called from the network thread
+		bool addRemoteInput(uint16_t sequenceNum, const Controllers::State & input, uint64_t arrivalTimeUs);
+
+		// The input to play this frame. canTimeStretch should be true when a frame can be repeated or skipped
+		// without anyone noticing, like while the ball isn't in play
+		const Controllers::State & getNextState(bool canTimeStretch);
+
+		// How many frames are waiting to be played, and how many we're aiming for
+		inline uint32_t getDepth() { return m_depth; }
+		inline float getTargetDepth() { return m_targetDepth; }
+
+		// Standard deviation of the arrival times, after taking out the send rate
+		inline uint32_t getJitterMicroseconds() { return m_jitterUs; }
+
+		// Frames where there was nothing to play, so the last input was played again
+		inline uint32_t getNumUnderruns() { return m_numUnderruns; }
+
+		// Inputs that were thrown away because the buffer was too deep, or too far ahead to fit
+		inline uint32_t getNumOverruns() { return m_numOverruns; }
+
+		// Inputs that arrived after their frame was played
+		inline uint32_t getNumLateInputs() { return m_numLateInputs; }
+
+		// Frames that were played twice or skipped on purpose, to change the depth
+		inline uint32_t getNumFramesStretched() { return m_numFramesStretched; }
+		inline uint32_t getNumFramesSkipped() { return m_numFramesSkipped; }
+
+		// Frames that were never received, so the input before them was played instead
+		inline uint32_t getNumFramesConcealed() { return m_numFramesConcealed; }
+
+		void resetCounters();
+
+	private:
+
+		struct Slot
+		{
+			uint16_t sequenceNum;
+			bool isValid;
+			Controllers::State input;
+		};
+
+		struct QueuedInput
+		{
+			uint16_t sequenceNum;
+			uint64_t arrivalTimeUs;
+			Controllers::State input;
+		};
+
+		// Disable copying
+		NetworkAdaptiveJitterBuffer(const NetworkAdaptiveJitterBuffer &);
+		NetworkAdaptiveJitterBuffer & operator=(const NetworkAdaptiveJitterBuffer &);
+
+		// Move inputs from the network thread's queue into the ring
+		void processQueue();
+
+		// Update the arrival time statistics, and the depth we want, with an input that just arrived
+		void measureArrival(uint16_t sequenceNum, uint64_t arrivalTimeUs);
+
+		// Move the target depth towards the depth the jitter calls for
+		void updateTargetDepth();
+
+		// Play the input for m_nextSequenceNum, or the last one again if it never arrived, and move on to the next frame
+		void playNext();
+
+		uint32_t m_frameUs;
+
+		// Received inputs, indexed by sequence number
+		Slot m_ring[RING_SIZE];
+
+		// Single producer, single consumer queue from the network thread
+		QueuedInput m_queue[QUEUE_SIZE];
+		volatile uint32_t m_queueWriteIndex;
+		volatile uint32_t m_queueReadIndex;
+
+		// The input being played, and what's played before anything has arrived
+		Controllers::State m_currentInput;
+
+		// The next sequence number to be played, and the newest one received
+		uint16_t m_nextSequenceNum;
+		uint16_t m_newestSequenceNum;
+		bool m_hasReceived;
+
+		// Nothing is played until the buffer first fills up to the target depth
+		bool m_isPlaying;
+
+		// Arrival time minus sequence number times the frame time, relative to the first input. A steady connection
+		// keeps this constant, so its spread is the jitter. Running mean and variance, in microseconds
+		bool m_hasArrivalStats;
+		uint64_t m_firstArrivalTimeUs;
+		uint16_t m_firstSequenceNum;
+		float m_delayMeanUs;
+		float m_delayVarianceUs;
+
+		// The depth the jitter calls for, and the depth we're aiming for, which follows it slowly
+		float m_desiredDepth;
+		float m_targetDepth;
+
+		// Running average of the depth, which is what's compared with the target
+		float m_averageDepth;
+
+		// Written on the game thread, safe to read from anywhere
+		volatile uint32_t m_depth;
+		volatile uint32_t m_jitterUs;
+		volatile uint32_t m_numUnderruns;
+		volatile uint32_t m_numOverruns;
+		volatile uint32_t m_numLateInputs;
+		volatile uint32_t m_numFramesStretched;
+		volatile uint32_t m_numFramesSkipped;
+		volatile uint32_t m_numFramesConcealed;
+	};
+}
@@ -0,0 +1,64 @@
+//
+//  NetworkBackend.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+namespace shd
+{
+	// The thing that actually moves packets between us and the other peer.
+	// NetworkTransport builds and parses the packets, a backend just sends and receives the bytes.
+	class NetworkBackend
+	{
+	public:
+
+		enum SendType
+		{
+			SEND_TYPE_UNRELIABLE = 0,
+			SEND_TYPE_RELIABLE
+		};
+
+		virtual ~NetworkBackend() {}
+
+		// Send a packet to the other peer
+		virtual bool sendPacket(const void * data, uint32_t size, SendType sendType) = 0;
+
+		// Is there a packet waiting to be read? If so, msgSize is set to its size
+		virtual bool isPacketAvailable(uint32_t * msgSize) = 0;
+
+		// Read the next packet. Returns false if nothing was read, or if the packet didn't come from the other peer
+		virtual bool readPacket(void * buffer, uint32_t bufferSize, uint32_t * bytesRead) = 0;
+
+		// Read up to maxPackets waiting packets in one go. Packet i goes in buffers + i * bufferSize, and sizes[i] is set to
+		// its size, or 0 if it was thrown away. Returns how many were read, so if that's maxPackets there may be more.
+		// Backends that can read many packets with one system call should, this just reads them one at a time
+		virtual uint32_t readPackets(uint8_t * buffers, uint32_t bufferSize, uint32_t * sizes, uint32_t maxPackets)
+		{
+			uint32_t numRead = 0;
+			uint32_t msgSize = 0;
+
+			while (numRead < maxPackets && isPacketAvailable(&msgSize))
+			{
+				// Anything too big is still read, so it doesn't block the packets behind it, but it's not kept
+				if (readPacket(buffers + numRead * bufferSize, bufferSize, &sizes[numRead]) == false || msgSize > bufferSize)
+				{
+					sizes[numRead] = 0;
+				}
+
+				numRead++;
+			}
+
+			return numRead;
+		}
+
+		// Send anything the backend has been holding on to, so it could send it all together. Called by NetworkTransport
+		// after each batch of sends. Most backends send straight away, so there's nothing to do
+		virtual bool flushSends() { return true; }
+	};
+}
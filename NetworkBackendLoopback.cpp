@@ -0,0 +1,129 @@
+//
+//  NetworkBackendLoopback.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkBackendLoopback.h"
+#include "Common.h"
+
+using namespace shd;
+
+NetworkBackendLoopback::NetworkBackendLoopback() :	m_incoming(nullptr),
+													m_queueSize(0),
+													m_writeIndex(0),
+													m_readIndex(0),
+													m_peer(nullptr),
+													m_numDropped(0)
+{
+
+}
+
+NetworkBackendLoopback::~NetworkBackendLoopback()
+{
+	term();
+}
+
+bool NetworkBackendLoopback::init(uint32_t queueSize)
+{
+	term();
+
+	// The indices wrap around at 2^32, so the queue size has to divide into that
+	if (queueSize == 0 || (queueSize & (queueSize - 1)) != 0)
+	{
+		SHD_ASSERT(false);
+		return false;
+	}
+
+	m_incoming = (Slot *)SHD_MALLOC(sizeof(Slot) * queueSize);
+	if (m_incoming == nullptr)
+	{
+		return false;
+	}
+
+	m_queueSize = queueSize;
+	m_writeIndex = 0;
+	m_readIndex = 0;
+	m_numDropped = 0;
+
+	return true;
+}
+
+void NetworkBackendLoopback::term()
+{
+	if (m_incoming)
+	{
+		SHD_FREE(m_incoming);
+		m_incoming = nullptr;
+	}
+
+	m_peer = nullptr;
+}
+
+void NetworkBackendLoopback::connect(NetworkBackendLoopback & a, NetworkBackendLoopback & b)
+{
+	a.m_peer = &b;
+	b.m_peer = &a;
+}
+
+bool NetworkBackendLoopback::sendPacket(const void * data, uint32_t size, SendType sendType)
+{
+	(void)sendType;
+
+	if (m_peer == nullptr || m_peer->m_incoming == nullptr || size > LOOPBACK_MAX_PACKET_SIZE)
+	{
+		return false;
+	}
+
+	uint32_t writeIndex = m_peer->m_writeIndex;
+
+	// Queue is full, so the packet is lost. Same as a real network would do
+	if (writeIndex - m_peer->m_readIndex >= m_peer->m_queueSize)
+	{
+		Atomic::add32(&m_peer->m_numDropped, 1);
+		return false;
+	}
+
+	Slot * slot = &m_peer->m_incoming[writeIndex % m_peer->m_queueSize];
+	memcpy(slot->data, data, size);
+	slot->size = size;
+
+	// Publish the slot only after it has been filled
+	Atomic::exchange32(&m_peer->m_writeIndex, writeIndex + 1);
+
+	return true;
+}
+
+bool NetworkBackendLoopback::isPacketAvailable(uint32_t * msgSize)
+{
+	if (m_incoming == nullptr || m_readIndex == m_writeIndex)
+	{
+		return false;
+	}
+
+	*msgSize = m_incoming[m_readIndex % m_queueSize].size;
+	return true;
+}
+
+bool NetworkBackendLoopback::readPacket(void * buffer, uint32_t bufferSize, uint32_t * bytesRead)
+{
+	uint32_t readIndex = m_readIndex;
+
+	if (m_incoming == nullptr || readIndex == m_writeIndex)
+	{
+		return false;
+	}
+
+	Slot * slot = &m_incoming[readIndex % m_queueSize];
+	uint32_t size = (slot->size < bufferSize) ? slot->size : bufferSize;
+
+	memcpy(buffer, slot->data, size);
+	*bytesRead = size;
+
+	// Give the slot back to the other side
+	Atomic::exchange32(&m_readIndex, readIndex + 1);
+
+	return true;
+}
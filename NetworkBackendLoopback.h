@@ -0,0 +1,67 @@
+//
+//  NetworkBackendLoopback.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include "NetworkBackend.h"
+
+namespace shd
+{
+	// An in-process backend. Two of these are connected together and packets sent by one are read by the other.
+	// Each side can live on its own thread: every direction is a single producer, single consumer queue
+	class NetworkBackendLoopback : public NetworkBackend
+	{
+	public:
+
+		static const uint32_t LOOPBACK_MAX_PACKET_SIZE = 4 * 1024;
+		static const uint32_t LOOPBACK_QUEUE_SIZE = 256;
+
+		NetworkBackendLoopback();
+		~NetworkBackendLoopback();
+
+		// queueSize is how many packets can be waiting to be read before new ones are dropped. Must be a power of 2
+		bool init(uint32_t queueSize = LOOPBACK_QUEUE_SIZE);
+		void term();
+
+		// Connect two loopback backends together
+		static void connect(NetworkBackendLoopback & a, NetworkBackendLoopback & b);
+
+		virtual bool sendPacket(const void * data, uint32_t size, SendType sendType);
+		virtual bool isPacketAvailable(uint32_t * msgSize);
+		virtual bool readPacket(void * buffer, uint32_t bufferSize, uint32_t * bytesRead);
+		inline uint32_t getNumDropped() { return m_numDropped; }
+
+	private:
+
+		struct Slot
+		{
+			uint32_t size;
+			uint8_t data[LOOPBACK_MAX_PACKET_SIZE];
+		};
+
+		// Disable copying
+		NetworkBackendLoopback(const NetworkBackendLoopback &);
+		NetworkBackendLoopback & operator=(const NetworkBackendLoopback &);
+
+		// Packets sent to us by the other side
+		Slot * m_incoming;
+		uint32_t m_queueSize;
+
+		// Written by the other side after it fills a slot, read by us
+		volatile uint32_t m_writeIndex;
+
+		// Written by us after we read a slot, read by the other side
+		volatile uint32_t m_readIndex;
+
+		// The backend we send to
+		NetworkBackendLoopback * m_peer;
+
+		// Packets the other side tried to send us while our queue was full
+		volatile uint32_t m_numDropped;
+	};
+}
@@ -0,0 +1,79 @@
+//
+//  NetworkBackendSteam.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkBackendSteam.h"
+#include "Application.h"
+
+using namespace shd;
+
+NetworkBackendSteam::NetworkBackendSteam() :	m_callbackP2PSessionRequest(this, &NetworkBackendSteam::onP2PSessionRequest),
+												m_callbackP2PSessionConnectFail(this, &NetworkBackendSteam::onP2PSessionConnectFail)
+{
+
+}
+
+bool NetworkBackendSteam::sendPacket(const void * data, uint32_t size, SendType sendType)
+{
+	return SteamNetworking()->SendP2PPacket(Application::getInstance().networkThread.getLobby().getOpponentID(),
+											data,
+											size,
+											(sendType == SEND_TYPE_RELIABLE) ? k_EP2PSendReliable : k_EP2PSendUnreliable);
+}
+
+bool NetworkBackendSteam::isPacketAvailable(uint32_t * msgSize)
+{
+	return SteamNetworking()->IsP2PPacketAvailable(msgSize);
+}
+
+bool NetworkBackendSteam::readPacket(void * buffer, uint32_t bufferSize, uint32_t * bytesRead)
+{
+	CSteamID steamIDRemote;
+
+	if (SteamNetworking()->ReadP2PPacket(buffer, bufferSize, bytesRead, &steamIDRemote) == false)
+	{
+		return false;
+	}
+
+	// If the message was received from someone who isn't our opponent, ignore it
+	if (steamIDRemote != Application::getInstance().networkThread.getLobby().getOpponentID())
+	{
+		return false;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: another user has sent us a packet - do we accept?
+//-----------------------------------------------------------------------------
+void NetworkBackendSteam::onP2PSessionRequest(P2PSessionRequest_t *pP2PSessionRequest)
+{
+	SHD_PRINTF("A user wants to create a session with us...\n");
+
+	if (Application::getInstance().networkThread.getLobby().getOpponentID() == pP2PSessionRequest->m_steamIDRemote)
+	{
+		SteamNetworking()->AcceptP2PSessionWithUser(pP2PSessionRequest->m_steamIDRemote);
+		SHD_PRINTF("The user was the other member of the lobby. Accepting communication.\n");
+	}
+	else
+	{
+		SHD_PRINTF("The requesting user is not in a lobby with us... Who is it? Denied.\n");
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: We sent a packet to another user but it failed
+//-----------------------------------------------------------------------------
+void NetworkBackendSteam::onP2PSessionConnectFail(P2PSessionConnectFail_t *pP2PSessionConnectFail)
+{
+	(void)pP2PSessionConnectFail;
+
+	// we've sent a packet to the user, but it never got through
+	// we can just use the normal timeout
+	SHD_PRINTF("Failed to send a packet to the other user.\n");
+}
@@ -0,0 +1,34 @@
+//
+//  NetworkBackendSteam.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include "NetworkBackend.h"
+#include <steam_api.h>
+
+namespace shd
+{
+	// Sends and receives packets through Steam P2P networking, to the opponent in our lobby
+	class NetworkBackendSteam : public NetworkBackend
+	{
+	public:
+
+		NetworkBackendSteam();
+		virtual bool sendPacket(const void * data, uint32_t size, SendType sendType);
+		virtual bool isPacketAvailable(uint32_t * msgSize);
+		virtual bool readPacket(void * buffer, uint32_t bufferSize, uint32_t * bytesRead);
+
+	private:
+
+		// Callback used when initial connection is made. Asks if we should accept a connection with the other user
+		STEAM_CALLBACK(NetworkBackendSteam, onP2PSessionRequest, P2PSessionRequest_t, m_callbackP2PSessionRequest);
+
+		// Callback used when a connection error occurs
+		STEAM_CALLBACK(NetworkBackendSteam, onP2PSessionConnectFail, P2PSessionConnectFail_t, m_callbackP2PSessionConnectFail);
+	};
+}
@@ -0,0 +1,539 @@
+//
+//  NetworkBackendUdp.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+// recvmmsg() and sendmmsg() are GNU extensions
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "NetworkBackendUdp.h"
+#include "NetworkClock.h"
+#include "Common.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#define SHD_INVALID_SOCKET		INVALID_SOCKET
+#define shdCloseSocket(s)		closesocket(s)
+typedef int socklen_t;
+#else
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define SHD_INVALID_SOCKET		-1
+#define shdCloseSocket(s)		close(s)
+#endif
+
+#ifdef __linux__
+#define SHD_UDP_HAS_MMSG
+#endif
+
+// Size of the packets the benchmark sends, and how many go out before they're all read back
+#define SHD_UDP_BENCHMARK_PACKET_SIZE 128
+#define SHD_UDP_BENCHMARK_BURST_SIZE 16
+
+// Give up on packets the benchmark never got back after this long
+#define SHD_UDP_BENCHMARK_TIMEOUT_US 1000000
+
+using namespace shd;
+
+NetworkBackendUdp::NetworkBackendUdp() :	m_socket(SHD_INVALID_SOCKET),
+											m_isOpen(false),
+											m_localPort(0),
+											m_remoteAddress(0),
+											m_remotePort(0),
+											m_hasRemotePeer(false),
+											m_isSendBatching(false),
+											m_isReceiveBatching(true),
+											m_numQueuedSends(0),
+											m_numSendCalls(0),
+											m_numReceiveCalls(0),
+											m_numPacketsSent(0),
+											m_numPacketsReceived(0)
+{
+
+}
+
+NetworkBackendUdp::~NetworkBackendUdp()
+{
+	term();
+}
+
+bool NetworkBackendUdp::init(uint16_t localPort, const char * remoteAddress, uint16_t remotePort)
+{
+	sockaddr_in localAddr;
+	socklen_t localAddrLen = sizeof(localAddr);
+
+	term();
+
+#ifdef _WIN32
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+	{
+		SHD_PRINTF("WSAStartup failed.\n");
+		return false;
+	}
+#endif
+
+	m_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (m_socket == SHD_INVALID_SOCKET)
+	{
+		SHD_PRINTF("Failed to create UDP socket.\n");
+#ifdef _WIN32
+		WSACleanup();
+#endif
+		return false;
+	}
+
+	m_isOpen = true;
+
+	memset(&localAddr, 0, sizeof(localAddr));
+	localAddr.sin_family = AF_INET;
+	localAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+	localAddr.sin_port = htons(localPort);
+
+	if (bind(m_socket, (sockaddr *)&localAddr, sizeof(localAddr)) != 0)
+	{
+		SHD_PRINTF("Failed to bind UDP socket to port %d.\n", localPort);
+		term();
+		return false;
+	}
+
+	// If we asked for any port, find out which one we got
+	if (getsockname(m_socket, (sockaddr *)&localAddr, &localAddrLen) == 0)
+	{
+		m_localPort = ntohs(localAddr.sin_port);
+	}
+
+	// Never block the network thread
+#ifdef _WIN32
+	u_long nonBlocking = 1;
+	if (ioctlsocket(m_socket, FIONBIO, &nonBlocking) != 0)
+#else
+	if (fcntl(m_socket, F_SETFL, fcntl(m_socket, F_GETFL, 0) | O_NONBLOCK) != 0)
+#endif
+	{
+		SHD_PRINTF("Failed to set UDP socket to non-blocking.\n");
+		term();
+		return false;
+	}
+
+	if (remoteAddress)
+	{
+		in_addr addr;
+		if (inet_pton(AF_INET, remoteAddress, &addr) != 1)
+		{
+			SHD_PRINTF("Invalid remote address: %s\n", remoteAddress);
+			term();
+			return false;
+		}
+
+		m_remoteAddress = addr.s_addr;
+		m_remotePort = htons(remotePort);
+		m_hasRemotePeer = true;
+	}
+
+	return true;
+}
+
+void NetworkBackendUdp::term()
+{
+	if (m_isOpen == false)
+	{
+		return;
+	}
+
+	shdCloseSocket(m_socket);
+	m_socket = SHD_INVALID_SOCKET;
+	m_isOpen = false;
+	m_hasRemotePeer = false;
+	m_numQueuedSends = 0;
+
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
+
+bool NetworkBackendUdp::sendPacket(const void * data, uint32_t size, SendType sendType)
+{
+	(void)sendType;
+	sockaddr_in remoteAddr;
+
+	if (m_isOpen == false || m_hasRemotePeer == false)
+	{
+		return false;
+	}
+
+	if (m_isSendBatching)
+	{
+		if (size <= MAX_QUEUED_PACKET_SIZE)
+		{
+			if (m_numQueuedSends == MAX_BATCH_SIZE)
+			{
+				flushSends();
+			}
+
+			memcpy(m_sendQueue[m_numQueuedSends], data, size);
+			m_sendSizes[m_numQueuedSends] = size;
+			m_numQueuedSends++;
+
+			return true;
+		}
+
+		// Too big to queue, but it still has to go out after the ones that are queued
+		flushSends();
+	}
+
+	Atomic::add32(&m_numSendCalls, 1);
+	Atomic::add32(&m_numPacketsSent, 1);
+
+	memset(&remoteAddr, 0, sizeof(remoteAddr));
+	remoteAddr.sin_family = AF_INET;
+	remoteAddr.sin_addr.s_addr = m_remoteAddress;
+	remoteAddr.sin_port = m_remotePort;
+
+	return sendto(m_socket, (const char *)data, size, 0, (sockaddr *)&remoteAddr, sizeof(remoteAddr)) == (int)size;
+}
+
+bool NetworkBackendUdp::isPacketAvailable(uint32_t * msgSize)
+{
+	if (m_isOpen == false)
+	{
+		return false;
+	}
+
+	Atomic::add32(&m_numReceiveCalls, 1);
+
+	// For datagram sockets this gives the size of the next datagram in the queue
+#ifdef _WIN32
+	u_long bytesAvailable = 0;
+	if (ioctlsocket(m_socket, FIONREAD, &bytesAvailable) != 0)
+#else
+	int bytesAvailable = 0;
+	if (ioctl(m_socket, FIONREAD, &bytesAvailable) != 0)
+#endif
+	{
+		return false;
+	}
+
+	if (bytesAvailable == 0)
+	{
+		return false;
+	}
+
+	*msgSize = (uint32_t)bytesAvailable;
+	return true;
+}
+
+bool NetworkBackendUdp::readPacket(void * buffer, uint32_t bufferSize, uint32_t * bytesRead)
+{
+	sockaddr_in fromAddr;
+	socklen_t fromAddrLen = sizeof(fromAddr);
+
+	Atomic::add32(&m_numReceiveCalls, 1);
+
+	int ret = recvfrom(m_socket, (char *)buffer, bufferSize, 0, (sockaddr *)&fromAddr, &fromAddrLen);
+	if (ret <= 0)
+	{
+		return false;
+	}
+
+	// If the message was received from someone who isn't our peer, ignore it
+	if (acceptSender(fromAddr.sin_addr.s_addr, fromAddr.sin_port) == false)
+	{
+		return false;
+	}
+
+	Atomic::add32(&m_numPacketsReceived, 1);
+
+	*bytesRead = (uint32_t)ret;
+	return true;
+}
+
+bool NetworkBackendUdp::acceptSender(uint32_t address, uint16_t port)
+{
+	// The first packet we get decides who we're talking to
+	if (m_hasRemotePeer == false)
+	{
+		m_remoteAddress = address;
+		m_remotePort = port;
+		m_hasRemotePeer = true;
+	}
+
+	return address == m_remoteAddress && port == m_remotePort;
+}
+
+uint32_t NetworkBackendUdp::readPackets(uint8_t * buffers, uint32_t bufferSize, uint32_t * sizes, uint32_t maxPackets)
+{
+	if (m_isOpen == false)
+	{
+		return 0;
+	}
+
+#ifdef SHD_UDP_HAS_MMSG
+	if (m_isReceiveBatching)
+	{
+		return readPacketsBatched(buffers, bufferSize, sizes, maxPackets);
+	}
+#endif
+
+	return NetworkBackend::readPackets(buffers, bufferSize, sizes, maxPackets);
+}
+
+uint32_t NetworkBackendUdp::readPacketsBatched(uint8_t * buffers, uint32_t bufferSize, uint32_t * sizes, uint32_t maxPackets)
+{
+	uint32_t numRead = 0;
+
+#ifdef SHD_UDP_HAS_MMSG
+	mmsghdr msgs[MAX_BATCH_SIZE];
+	iovec iovecs[MAX_BATCH_SIZE];
+	sockaddr_in fromAddrs[MAX_BATCH_SIZE];
+
+	while (numRead < maxPackets)
+	{
+		uint32_t batchSize = (maxPackets - numRead < MAX_BATCH_SIZE) ? maxPackets - numRead : MAX_BATCH_SIZE;
+		int ret = 0;
+
+		memset(msgs, 0, sizeof(mmsghdr) * batchSize);
+
+		for (uint32_t i = 0; i < batchSize; i++)
+		{
+			iovecs[i].iov_base = buffers + (numRead + i) * bufferSize;
+			iovecs[i].iov_len = bufferSize;
+			msgs[i].msg_hdr.msg_iov = &iovecs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_name = &fromAddrs[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+		}
+
+		Atomic::add32(&m_numReceiveCalls, 1);
+
+		ret = recvmmsg(m_socket, msgs, batchSize, MSG_DONTWAIT, nullptr);
+		if (ret <= 0)
+		{
+			break;
+		}
+
+		for (int i = 0; i < ret; i++)
+		{
+			uint32_t * size = &sizes[numRead + i];
+
+			*size = msgs[i].msg_len;
+
+			// Anything truncated, or that didn't come from the other peer, is thrown away
+			if ((msgs[i].msg_hdr.msg_flags & MSG_TRUNC) || acceptSender(fromAddrs[i].sin_addr.s_addr, fromAddrs[i].sin_port) == false)
+			{
+				*size = 0;
+				continue;
+			}
+
+			Atomic::add32(&m_numPacketsReceived, 1);
+		}
+
+		numRead += (uint32_t)ret;
+
+		// Nothing else is waiting
+		if ((uint32_t)ret < batchSize)
+		{
+			break;
+		}
+	}
+#else
+	(void)buffers;
+	(void)bufferSize;
+	(void)sizes;
+	(void)maxPackets;
+#endif
+
+	return numRead;
+}
+
+bool NetworkBackendUdp::flushSends()
+{
+	sockaddr_in remoteAddr;
+	uint32_t numSent = 0;
+	bool ret = true;
+
+	if (m_numQueuedSends == 0)
+	{
+		return true;
+	}
+
+	if (m_isOpen == false || m_hasRemotePeer == false)
+	{
+		m_numQueuedSends = 0;
+		return false;
+	}
+
+	memset(&remoteAddr, 0, sizeof(remoteAddr));
+	remoteAddr.sin_family = AF_INET;
+	remoteAddr.sin_addr.s_addr = m_remoteAddress;
+	remoteAddr.sin_port = m_remotePort;
+
+#ifdef SHD_UDP_HAS_MMSG
+	mmsghdr msgs[MAX_BATCH_SIZE];
+	iovec iovecs[MAX_BATCH_SIZE];
+
+	memset(msgs, 0, sizeof(mmsghdr) * m_numQueuedSends);
+
+	for (uint32_t i = 0; i < m_numQueuedSends; i++)
+	{
+		iovecs[i].iov_base = m_sendQueue[i];
+		iovecs[i].iov_len = m_sendSizes[i];
+		msgs[i].msg_hdr.msg_iov = &iovecs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_name = &remoteAddr;
+		msgs[i].msg_hdr.msg_namelen = sizeof(remoteAddr);
+	}
+
+	// It can stop part way through, so keep going from where it got to
+	while (numSent < m_numQueuedSends)
+	{
+		int sent = 0;
+
+		Atomic::add32(&m_numSendCalls, 1);
+
+		sent = sendmmsg(m_socket, msgs + numSent, m_numQueuedSends - numSent, 0);
+		if (sent <= 0)
+		{
+			// The socket's buffer is full, so the rest are lost, the same as they would be on the wire
+			ret = false;
+			break;
+		}
+
+		numSent += (uint32_t)sent;
+	}
+#else
+	for (; numSent < m_numQueuedSends; numSent++)
+	{
+		Atomic::add32(&m_numSendCalls, 1);
+
+		if (sendto(m_socket, (const char *)m_sendQueue[numSent], m_sendSizes[numSent], 0, (sockaddr *)&remoteAddr, sizeof(remoteAddr)) != (int)m_sendSizes[numSent])
+		{
+			ret = false;
+		}
+	}
+#endif
+
+	Atomic::add32(&m_numPacketsSent, numSent);
+	m_numQueuedSends = 0;
+
+	return ret;
+}
+
+void NetworkBackendUdp::setSendBatching(bool enable)
+{
+	// Anything already queued goes out now, so it isn't left behind
+	if (enable == false)
+	{
+		flushSends();
+	}
+
+	m_isSendBatching = enable;
+}
+
+void NetworkBackendUdp::resetCounters()
+{
+	Atomic::exchange32(&m_numSendCalls, 0);
+	Atomic::exchange32(&m_numReceiveCalls, 0);
+	Atomic::exchange32(&m_numPacketsSent, 0);
+	Atomic::exchange32(&m_numPacketsReceived, 0);
+}
+
+bool NetworkBackendUdp::runBenchmark(uint32_t numPackets)
+{
+	NetworkBackendUdp * sender = new NetworkBackendUdp();
+	NetworkBackendUdp * receiver = new NetworkBackendUdp();
+	uint8_t * buffers = (uint8_t *)SHD_MALLOC(MAX_QUEUED_PACKET_SIZE * MAX_BATCH_SIZE);
+	uint32_t sizes[MAX_BATCH_SIZE];
+	uint8_t packet[SHD_UDP_BENCHMARK_PACKET_SIZE];
+	bool ret = true;
+
+	memset(packet, 0xab, sizeof(packet));
+
+	if (buffers == nullptr || receiver->init(0, nullptr, 0) == false || sender->init(0, "127.0.0.1", receiver->getLocalPort()) == false)
+	{
+		ret = false;
+	}
+
+	for (uint32_t batched = 0; ret && batched < 2; batched++)
+	{
+		uint32_t numSent = 0;
+		uint32_t numReceived = 0;
+		uint64_t startUs = NetworkClock::getTimeMicroseconds();
+		uint64_t lastReceiveUs = startUs;
+		uint64_t elapsedUs = 0;
+
+		sender->setSendBatching(batched != 0);
+		receiver->setReceiveBatching(batched != 0);
+		sender->resetCounters();
+		receiver->resetCounters();
+
+		// Everything runs on this thread, so this is what one core gets through, sending and receiving
+		while (numReceived < numPackets)
+		{
+			uint64_t nowUs = 0;
+			uint32_t numRead = 0;
+
+			for (uint32_t i = 0; i < SHD_UDP_BENCHMARK_BURST_SIZE && numSent < numPackets; i++, numSent++)
+			{
+				sender->sendPacket(packet, sizeof(packet), SEND_TYPE_UNRELIABLE);
+			}
+
+			sender->flushSends();
+
+			do
+			{
+				numRead = receiver->readPackets(buffers, MAX_QUEUED_PACKET_SIZE, sizes, MAX_BATCH_SIZE);
+
+				for (uint32_t i = 0; i < numRead; i++)
+				{
+					numReceived += (sizes[i]) ? 1 : 0;
+				}
+			}
+			while (numRead == MAX_BATCH_SIZE);
+
+			nowUs = NetworkClock::getTimeMicroseconds();
+
+			if (numRead)
+			{
+				lastReceiveUs = nowUs;
+			}
+			else if (numSent == numPackets && nowUs - lastReceiveUs > SHD_UDP_BENCHMARK_TIMEOUT_US)
+			{
+				// The rest were dropped
+				break;
+			}
+		}
+
+		elapsedUs = NetworkClock::getTimeMicroseconds() - startUs;
+
+		SHD_PRINTF("%s: %u of %u packets in %llu us, %.0f packets a second, %.3f send calls and %.3f receive calls a packet\n",
+			(batched) ? "sendmmsg/recvmmsg" : "sendto/recvfrom",
+			numReceived,
+			numPackets,
+			(unsigned long long)elapsedUs,
+			(elapsedUs) ? (double)numReceived * 1000000.0 / (double)elapsedUs : 0.0,
+			(numSent) ? (double)sender->getNumSendCalls() / (double)numSent : 0.0,
+			(numReceived) ? (double)receiver->getNumReceiveCalls() / (double)numReceived : 0.0);
+	}
+
+	if (buffers)
+	{
+		SHD_FREE(buffers);
+	}
+
+	delete sender;
+	delete receiver;
+
+	return ret;
+}
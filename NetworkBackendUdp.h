@@ -0,0 +1,113 @@
+//
+//  NetworkBackendUdp.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include "NetworkBackend.h"
+
+namespace shd
+{
+	// Sends and receives packets over a plain non-blocking UDP socket (IPv4).
+	// There is no reliability here, so reliable sends are sent the same way as unreliable ones.
+	// On Linux, everything that's waiting is read with recvmmsg(), and sends can be queued up and sent with one
+	// sendmmsg() in flushSends(). A server with lots of matches spends most of its network time in system calls otherwise
+	class NetworkBackendUdp : public NetworkBackend
+	{
+	public:
+
+		// The most packets sent or received with one system call
+		static const uint32_t MAX_BATCH_SIZE = 16;
+
+		// Sends bigger than this aren't queued up, they're sent straight away. Ethernet's MTU
+		static const uint32_t MAX_QUEUED_PACKET_SIZE = 1500;
+
+#ifdef _WIN32
+		typedef uintptr_t SocketHandle;
+#else
+		typedef int SocketHandle;
+#endif
+
+		NetworkBackendUdp();
+		~NetworkBackendUdp();
+
+		// Open the socket on localPort. If remoteAddress is null, the first peer that sends us a packet becomes the remote peer
+		bool init(uint16_t localPort, const char * remoteAddress, uint16_t remotePort);
+		void term();
+		virtual bool sendPacket(const void * data, uint32_t size, SendType sendType);
+		virtual bool isPacketAvailable(uint32_t * msgSize);
+		virtual bool readPacket(void * buffer, uint32_t bufferSize, uint32_t * bytesRead);
+		virtual uint32_t readPackets(uint8_t * buffers, uint32_t bufferSize, uint32_t * sizes, uint32_t maxPackets);
+		virtual bool flushSends();
+		inline bool hasRemotePeer() { return m_hasRemotePeer; }
+
+		// Forget the remote peer, so the next one to send us a packet takes its place. For sockets opened without a remote address
+		inline void clearRemotePeer() { m_hasRemotePeer = false; }
+		inline uint16_t getLocalPort() { return m_localPort; }
+
+		// For waiting on with NetworkPoller
+		inline SocketHandle getSocket() { return m_socket; }
+
+		// Hold on to sends until flushSends(). Off by default, so sendPacket() sends straight away
+		void setSendBatching(bool enable);
+
+		// Read many packets with one system call where that's possible. On by default
+		inline void setReceiveBatching(bool enable) { m_isReceiveBatching = enable; }
+
+		// How many system calls have been made to send and receive, and how many packets they moved
+		inline uint32_t getNumSendCalls() { return m_numSendCalls; }
+		inline uint32_t getNumReceiveCalls() { return m_numReceiveCalls; }
+		inline uint32_t getNumPacketsSent() { return m_numPacketsSent; }
+		inline uint32_t getNumPacketsReceived() { return m_numPacketsReceived; }
+		void resetCounters();
+
+		// Send numPackets packets to ourselves over localhost, one at a time and then in batches, and print how many
+		// packets a second one core gets through each way
+		static bool runBenchmark(uint32_t numPackets);
+
+	private:
+
+		// Disable copying
+		NetworkBackendUdp(const NetworkBackendUdp &);
+		NetworkBackendUdp & operator=(const NetworkBackendUdp &);
+
+		// The socket
+		SocketHandle m_socket;
+
+		// Is the socket open
+		bool m_isOpen;
+
+		// Port we're bound to, in host byte order
+		uint16_t m_localPort;
+
+		// Address and port of the other peer, in network byte order
+		uint32_t m_remoteAddress;
+		uint16_t m_remotePort;
+
+		// Do we know who the other peer is yet
+		bool m_hasRemotePeer;
+
+		// readPackets() with recvmmsg()
+		uint32_t readPacketsBatched(uint8_t * buffers, uint32_t bufferSize, uint32_t * sizes, uint32_t maxPackets);
+
+		// Is the packet from the other peer. The first packet we get decides who that is
+		bool acceptSender(uint32_t address, uint16_t port);
+
+		bool m_isSendBatching;
+		bool m_isReceiveBatching;
+
+		// Sends waiting for flushSends()
+		uint8_t m_sendQueue[MAX_BATCH_SIZE][MAX_QUEUED_PACKET_SIZE];
+		uint32_t m_sendSizes[MAX_BATCH_SIZE];
+		uint32_t m_numQueuedSends;
+
+		volatile uint32_t m_numSendCalls;
+		volatile uint32_t m_numReceiveCalls;
+		volatile uint32_t m_numPacketsSent;
+		volatile uint32_t m_numPacketsReceived;
+	};
+}
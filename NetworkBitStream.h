@@ -0,0 +1,314 @@
+//
+//  NetworkBitStream.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+namespace shd
+{
+	// Number of bits needed to store values from 0 to N, worked out at compile time
+	template <uint32_t N> struct BitsRequired
+	{
+		static const uint32_t value = 1 + BitsRequired<(N >> 1)>::value;
+	};
+
+	template <> struct BitsRequired<0>
+	{
+		static const uint32_t value = 0;
+	};
+
+	template <> struct BitsRequired<1>
+	{
+		static const uint32_t value = 1;
+	};
+
+	// Schema for a float that is sent as an integer. Values are clamped to [MinValue, MaxValue] and
+	// rounded to 1 / StepsPerUnit, and the number of bits on the wire is worked out from that at compile time
+	template <int MinValue, int MaxValue, int StepsPerUnit> struct QuantizedFloat
+	{
+		static const uint32_t maxInteger = (uint32_t)((MaxValue - MinValue) * StepsPerUnit);
+		static const uint32_t bits = BitsRequired<maxInteger>::value;
+
+		static inline uint32_t quantize(float value)
+		{
+			if (value < (float)MinValue) value = (float)MinValue;
+			if (value > (float)MaxValue) value = (float)MaxValue;
+
+			return (uint32_t)((value - (float)MinValue) * (float)StepsPerUnit + 0.5f);
+		}
+
+		static inline float dequantize(uint32_t value)
+		{
+			if (value > maxInteger) value = maxInteger;
+
+			return (float)MinValue + (float)value / (float)StepsPerUnit;
+		}
+	};
+
+	// Writes values into a buffer a few bits at a time. Bytes are always written least significant first,
+	// so the format doesn't depend on the endianness or struct padding of whoever wrote it
+	class BitWriter
+	{
+	public:
+
+		enum { IsWriting = 1, IsReading = 0 };
+
+		BitWriter(uint8_t * buffer, uint32_t bufferSize) :	m_buffer(buffer),
+															m_bufferSize(bufferSize),
+															m_bytesWritten(0),
+															m_scratch(0),
+															m_scratchBits(0),
+															m_overflow(false)
+		{}
+
+		inline void writeBits(uint32_t value, uint32_t bits)
+		{
+			if (bits < 32)
+			{
+				value &= (1u << bits) - 1;
+			}
+
+			m_scratch |= (uint64_t)value << m_scratchBits;
+			m_scratchBits += bits;
+
+			while (m_scratchBits >= 8)
+			{
+				if (m_bytesWritten >= m_bufferSize)
+				{
+					m_overflow = true;
+					m_scratchBits = 0;
+					m_scratch = 0;
+					return;
+				}
+
+				m_buffer[m_bytesWritten++] = (uint8_t)m_scratch;
+				m_scratch >>= 8;
+				m_scratchBits -= 8;
+			}
+		}
+
+		// Pad with zeros up to the next byte
+		inline void align()
+		{
+			if (m_scratchBits)
+			{
+				writeBits(0, 8 - m_scratchBits);
+			}
+		}
+
+		inline void writeBytes(const uint8_t * data, uint32_t size)
+		{
+			align();
+
+			if (m_bytesWritten + size > m_bufferSize)
+			{
+				m_overflow = true;
+				return;
+			}
+
+			memcpy(m_buffer + m_bytesWritten, data, size);
+			m_bytesWritten += size;
+		}
+
+		// Call when done writing. Returns the number of bytes used
+		inline uint32_t flush()
+		{
+			align();
+			return m_bytesWritten;
+		}
+
+		inline bool hasOverflowed() { return m_overflow; }
+		inline uint32_t getBitsWritten() { return m_bytesWritten * 8 + m_scratchBits; }
+
+		inline bool serializeBits(uint32_t & value, uint32_t bits) { writeBits(value, bits); return m_overflow == false; }
+		inline bool serializeBytes(uint8_t * data, uint32_t size) { writeBytes(data, size); return m_overflow == false; }
+		inline bool serializeAlign() { align(); return m_overflow == false; }
+
+	private:
+
+		uint8_t * m_buffer;
+		uint32_t m_bufferSize;
+		uint32_t m_bytesWritten;
+		uint64_t m_scratch;
+		uint32_t m_scratchBits;
+		bool m_overflow;
+	};
+
+	// Reads values written by BitWriter. Never reads past the end of the buffer, so it's safe to point at anything that came off the network
+	class BitReader
+	{
+	public:
+
+		enum { IsWriting = 0, IsReading = 1 };
+
+		BitReader(const uint8_t * buffer, uint32_t bufferSize) :	m_buffer(buffer),
+																	m_bufferSize(bufferSize),
+																	m_bytesRead(0),
+																	m_scratch(0),
+																	m_scratchBits(0),
+																	m_overflow(false)
+		{}
+
+		inline uint32_t readBits(uint32_t bits)
+		{
+			while (m_scratchBits < bits)
+			{
+				if (m_bytesRead >= m_bufferSize)
+				{
+					m_overflow = true;
+					return 0;
+				}
+
+				m_scratch |= (uint64_t)m_buffer[m_bytesRead++] << m_scratchBits;
+				m_scratchBits += 8;
+			}
+
+			uint32_t value = (uint32_t)(m_scratch & ((bits < 32) ? ((1ull << bits) - 1) : 0xFFFFFFFFull));
+			m_scratch >>= bits;
+			m_scratchBits -= bits;
+
+			return value;
+		}
+
+		// Skip the padding up to the next byte
+		inline void align()
+		{
+			m_scratch = 0;
+			m_scratchBits = 0;
+		}
+
+		inline void readBytes(uint8_t * data, uint32_t size)
+		{
+			align();
+
+			if (m_bytesRead + size > m_bufferSize)
+			{
+				m_overflow = true;
+				return;
+			}
+
+			memcpy(data, m_buffer + m_bytesRead, size);
+			m_bytesRead += size;
+		}
+
+		inline bool hasOverflowed() { return m_overflow; }
+
+		// Bytes consumed so far, counting a partly read byte as used
+		inline uint32_t getBytesRead() { return m_bytesRead; }
+
+		inline bool serializeBits(uint32_t & value, uint32_t bits) { value = readBits(bits); return m_overflow == false; }
+		inline bool serializeBytes(uint8_t * data, uint32_t size) { readBytes(data, size); return m_overflow == false; }
+		inline bool serializeAlign() { align(); return m_overflow == false; }
+
+	private:
+
+		const uint8_t * m_buffer;
+		uint32_t m_bufferSize;
+		uint32_t m_bytesRead;
+		uint64_t m_scratch;
+		uint32_t m_scratchBits;
+		bool m_overflow;
+	};
+
+	// The serialize functions below work with either a BitWriter or a BitReader, so each message
+	// only has to describe its layout once and reading and writing can never get out of step
+
+	template <typename Stream, typename T> inline bool serializeInt(Stream & stream, T & value, uint32_t bits)
+	{
+		uint32_t temp = 0;
+
+		if (Stream::IsWriting)
+		{
+			temp = (uint32_t)value;
+		}
+
+		if (stream.serializeBits(temp, bits) == false)
+		{
+			return false;
+		}
+
+		if (Stream::IsReading)
+		{
+			value = (T)temp;
+		}
+
+		return true;
+	}
+
+	template <typename Stream> inline bool serializeBool(Stream & stream, bool & value)
+	{
+		uint32_t temp = (value) ? 1 : 0;
+
+		if (stream.serializeBits(temp, 1) == false)
+		{
+			return false;
+		}
+
+		value = (temp != 0);
+		return true;
+	}
+
+	// Small values take fewer bits: 7 bits at a time, each followed by a bit saying if there's more
+	template <typename Stream, typename T> inline bool serializeVarint(Stream & stream, T & value)
+	{
+		uint32_t temp = (Stream::IsWriting) ? (uint32_t)value : 0;
+		uint32_t result = 0;
+		uint32_t more = 0;
+
+		for (uint32_t shift = 0; shift < 35; shift += 7)
+		{
+			uint32_t chunk = temp & 0x7F;
+			temp >>= 7;
+			more = (temp) ? 1 : 0;
+
+			if (stream.serializeBits(chunk, 7) == false || stream.serializeBits(more, 1) == false)
+			{
+				return false;
+			}
+
+			result |= chunk << shift;
+
+			if (more == 0)
+			{
+				if (Stream::IsReading)
+				{
+					value = (T)result;
+				}
+
+				return true;
+			}
+		}
+
+		// Too many continuation bits, so it's garbage
+		return false;
+	}
+
+	template <typename Schema, typename Stream> inline bool serializeQuantizedFloat(Stream & stream, float & value)
+	{
+		uint32_t temp = 0;
+
+		if (Stream::IsWriting)
+		{
+			temp = Schema::quantize(value);
+		}
+
+		if (stream.serializeBits(temp, Schema::bits) == false)
+		{
+			return false;
+		}
+
+		if (Stream::IsReading)
+		{
+			value = Schema::dequantize(temp);
+		}
+
+		return true;
+	}
+}
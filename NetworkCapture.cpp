@@ -0,0 +1,485 @@
+//
+//  NetworkCapture.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkCapture.h"
+#include "NetworkTransport.h"
+#include "NetworkClock.h"
+#include "Common.h"
+
+using namespace shd;
+
+namespace
+{
+	// Counts what the transport parses out of a replayed capture, and sends nothing
+	class NetworkReplayHandler : public shd::NetworkTransportHandler
+	{
+	public:
+
+		NetworkReplayHandler() : numBodies(0), numFullStateUpdates(0), numEvents(0), lastReceivedSeqNum(0) {}
+
+		virtual void getTeamColours(uint8_t * primary, uint8_t * secondary) { *primary = 0; *secondary = 1; }
+		virtual void onHandshakeReceived(uint8_t primary, uint8_t secondary) { (void)primary; (void)secondary; }
+		virtual void onHandshakeAckReceived(uint8_t primary, uint8_t secondary) { (void)primary; (void)secondary; }
+
+		virtual void fillSendBuffer(uint8_t * buffer, size_t bufferSize, size_t * bytesWritten, bool * isFullStateUpdate)
+		{
+			(void)buffer;
+			(void)bufferSize;
+			*bytesWritten = 0;
+			*isFullStateUpdate = false;
+		}
+
+		virtual void parseRecvBuffer(void * buffer, size_t bufferSize, bool isFullStateUpdate)
+		{
+			(void)buffer;
+			(void)bufferSize;
+
+			numBodies++;
+			numFullStateUpdates += (isFullStateUpdate) ? 1 : 0;
+		}
+
+		virtual uint16_t getLastReceivedSeqNum() { return lastReceivedSeqNum; }
+		virtual bool popGameEvent(GameEvent * event) { (void)event; return false; }
+		virtual void onGameEvent(const GameEvent & event) { (void)event; numEvents++; }
+
+		uint32_t numBodies;
+		uint32_t numFullStateUpdates;
+		uint32_t numEvents;
+		uint16_t lastReceivedSeqNum;
+	};
+}
+
+NetworkCaptureRecorder::NetworkCaptureRecorder() :	m_backend(nullptr),
+													m_file(nullptr),
+													m_buffer(nullptr),
+													m_bufferUsed(0),
+													m_numRecords(0)
+{
+}
+
+NetworkCaptureRecorder::~NetworkCaptureRecorder()
+{
+	term();
+}
+
+bool NetworkCaptureRecorder::init(NetworkBackend * backend, const char * filename)
+{
+	uint32_t magic = NetworkCapture::CAPTURE_MAGIC;
+	uint16_t version = NetworkCapture::CAPTURE_VERSION;
+	uint16_t reserved = 0;
+
+	term();
+
+	if (backend == nullptr)
+	{
+		SHD_ASSERT(false);
+		return false;
+	}
+
+	m_buffer = (uint8_t *)SHD_MALLOC(RECORDER_BUFFER_SIZE);
+	if (m_buffer == nullptr)
+	{
+		return false;
+	}
+
+	m_file = fopen(filename, "wb");
+	if (m_file == nullptr)
+	{
+		SHD_PRINTF("Couldn't open capture file %s\n", filename);
+		term();
+		return false;
+	}
+
+	memcpy(m_buffer, &magic, sizeof(magic));
+	memcpy(m_buffer + 4, &version, sizeof(version));
+	memcpy(m_buffer + 6, &reserved, sizeof(reserved));
+	m_bufferUsed = NetworkCapture::CAPTURE_FILE_HEADER_SIZE;
+
+	m_backend = backend;
+	m_numRecords = 0;
+
+	return true;
+}
+
+void NetworkCaptureRecorder::term()
+{
+	if (m_file)
+	{
+		flush();
+		fclose(m_file);
+		m_file = nullptr;
+	}
+
+	if (m_buffer)
+	{
+		SHD_FREE(m_buffer);
+		m_buffer = nullptr;
+	}
+
+	m_bufferUsed = 0;
+	m_backend = nullptr;
+}
+
+bool NetworkCaptureRecorder::flush()
+{
+	bool ret = true;
+
+	if (m_file && m_bufferUsed)
+	{
+		ret = fwrite(m_buffer, 1, m_bufferUsed, m_file) == m_bufferUsed;
+		m_bufferUsed = 0;
+	}
+
+	return ret;
+}
+
+void NetworkCaptureRecorder::record(NetworkCapture::Direction direction, const void * data, uint32_t size)
+{
+	uint64_t timeUs = NetworkClock::getTimeMicroseconds();
+	uint8_t dir = (uint8_t)direction;
+	uint8_t messageType = NetworkCapture::CAPTURE_UNKNOWN_MESSAGE_TYPE;
+	uint16_t sequenceNum = 0;
+	uint16_t recordSize = (uint16_t)size;
+	uint8_t * record = nullptr;
+
+	if (m_file == nullptr)
+	{
+		return;
+	}
+
+	// Packets never get near this big, but the size has to fit in 16 bits
+	if (size > 0xFFFF || NetworkCapture::CAPTURE_RECORD_HEADER_SIZE + size > RECORDER_BUFFER_SIZE)
+	{
+		SHD_ASSERT(false);
+		return;
+	}
+
+	if (m_bufferUsed + NetworkCapture::CAPTURE_RECORD_HEADER_SIZE + size > RECORDER_BUFFER_SIZE && flush() == false)
+	{
+		SHD_PRINTF("Couldn't write to the capture file!\n");
+		return;
+	}
+
+	NetworkTransport::readPacketInfo((const uint8_t *)data, size, &messageType, &sequenceNum);
+
+	record = m_buffer + m_bufferUsed;
+	memcpy(record, &timeUs, sizeof(timeUs));
+	memcpy(record + 8, &dir, sizeof(dir));
+	memcpy(record + 9, &messageType, sizeof(messageType));
+	memcpy(record + 10, &sequenceNum, sizeof(sequenceNum));
+	memcpy(record + 12, &recordSize, sizeof(recordSize));
+	memcpy(record + NetworkCapture::CAPTURE_RECORD_HEADER_SIZE, data, size);
+
+	m_bufferUsed += NetworkCapture::CAPTURE_RECORD_HEADER_SIZE + size;
+	m_numRecords++;
+}
+
+bool NetworkCaptureRecorder::sendPacket(const void * data, uint32_t size, SendType sendType)
+{
+	if (m_backend == nullptr)
+	{
+		return false;
+	}
+
+	record(NetworkCapture::CAPTURE_DIRECTION_SENT, data, size);
+
+	return m_backend->sendPacket(data, size, sendType);
+}
+
+bool NetworkCaptureRecorder::isPacketAvailable(uint32_t * msgSize)
+{
+	if (m_backend == nullptr)
+	{
+		return false;
+	}
+
+	return m_backend->isPacketAvailable(msgSize);
+}
+
+bool NetworkCaptureRecorder::readPacket(void * buffer, uint32_t bufferSize, uint32_t * bytesRead)
+{
+	if (m_backend == nullptr || m_backend->readPacket(buffer, bufferSize, bytesRead) == false)
+	{
+		return false;
+	}
+
+	record(NetworkCapture::CAPTURE_DIRECTION_RECEIVED, buffer, *bytesRead);
+
+	return true;
+}
+
+uint32_t NetworkCaptureRecorder::readPackets(uint8_t * buffers, uint32_t bufferSize, uint32_t * sizes, uint32_t maxPackets)
+{
+	uint32_t numRead = 0;
+
+	if (m_backend == nullptr)
+	{
+		return 0;
+	}
+
+	// Let the real backend read them all in one go, then record them in the order they came in
+	numRead = m_backend->readPackets(buffers, bufferSize, sizes, maxPackets);
+
+	for (uint32_t i = 0; i < numRead; i++)
+	{
+		if (sizes[i])
+		{
+			record(NetworkCapture::CAPTURE_DIRECTION_RECEIVED, buffers + i * bufferSize, sizes[i]);
+		}
+	}
+
+	return numRead;
+}
+
+bool NetworkCaptureRecorder::flushSends()
+{
+	return m_backend && m_backend->flushSends();
+}
+
+NetworkCaptureReplay::NetworkCaptureReplay() :	m_data(nullptr),
+												m_size(0),
+												m_readOffset(0),
+												m_numPacketsRead(0)
+{
+}
+
+NetworkCaptureReplay::~NetworkCaptureReplay()
+{
+	term();
+}
+
+bool NetworkCaptureReplay::init(const char * filename)
+{
+	uint32_t magic = 0;
+	uint16_t version = 0;
+	long fileSize = 0;
+	FILE * file = nullptr;
+
+	term();
+
+	file = fopen(filename, "rb");
+	if (file == nullptr)
+	{
+		SHD_PRINTF("Couldn't open capture file %s\n", filename);
+		return false;
+	}
+
+	if (fseek(file, 0, SEEK_END) != 0 || (fileSize = ftell(file)) < (long)NetworkCapture::CAPTURE_FILE_HEADER_SIZE || fseek(file, 0, SEEK_SET) != 0)
+	{
+		fclose(file);
+		return false;
+	}
+
+	m_data = (uint8_t *)SHD_MALLOC(fileSize);
+	if (m_data == nullptr)
+	{
+		fclose(file);
+		return false;
+	}
+
+	m_size = (uint32_t)fread(m_data, 1, fileSize, file);
+	fclose(file);
+
+	memcpy(&magic, m_data, sizeof(magic));
+	memcpy(&version, m_data + 4, sizeof(version));
+
+	if (m_size != (uint32_t)fileSize || magic != NetworkCapture::CAPTURE_MAGIC || version != NetworkCapture::CAPTURE_VERSION)
+	{
+		SHD_PRINTF("%s isn't a capture file we can read\n", filename);
+		term();
+		return false;
+	}
+
+	rewind();
+
+	return true;
+}
+
+void NetworkCaptureReplay::term()
+{
+	if (m_data)
+	{
+		SHD_FREE(m_data);
+		m_data = nullptr;
+	}
+
+	m_size = 0;
+	m_readOffset = 0;
+}
+
+void NetworkCaptureReplay::rewind()
+{
+	m_readOffset = NetworkCapture::CAPTURE_FILE_HEADER_SIZE;
+	m_numPacketsRead = 0;
+}
+
+bool NetworkCaptureReplay::skipToNextReceived()
+{
+	while (m_data && m_readOffset + NetworkCapture::CAPTURE_RECORD_HEADER_SIZE <= m_size)
+	{
+		uint8_t direction = m_data[m_readOffset + 8];
+		uint16_t size = 0;
+
+		memcpy(&size, m_data + m_readOffset + 12, sizeof(size));
+
+		// A capture that was cut off part way through a record just ends there
+		if (m_readOffset + NetworkCapture::CAPTURE_RECORD_HEADER_SIZE + size > m_size)
+		{
+			m_readOffset = m_size;
+			break;
+		}
+
+		if (direction == NetworkCapture::CAPTURE_DIRECTION_RECEIVED)
+		{
+			return true;
+		}
+
+		m_readOffset += NetworkCapture::CAPTURE_RECORD_HEADER_SIZE + size;
+	}
+
+	return false;
+}
+
+bool NetworkCaptureReplay::getNextReceiveTime(uint64_t * receiveTimeUs)
+{
+	if (skipToNextReceived() == false)
+	{
+		return false;
+	}
+
+	memcpy(receiveTimeUs, m_data + m_readOffset, sizeof(uint64_t));
+
+	return true;
+}
+
+bool NetworkCaptureReplay::nextRecord(const uint8_t ** packet, uint32_t * size, NetworkCapture::Direction * direction)
+{
+	uint16_t recordSize = 0;
+
+	if (m_data == nullptr || m_readOffset + NetworkCapture::CAPTURE_RECORD_HEADER_SIZE > m_size)
+	{
+		return false;
+	}
+
+	memcpy(&recordSize, m_data + m_readOffset + 12, sizeof(recordSize));
+
+	// Cut off part way through
+	if (m_readOffset + NetworkCapture::CAPTURE_RECORD_HEADER_SIZE + recordSize > m_size)
+	{
+		m_readOffset = m_size;
+		return false;
+	}
+
+	*packet = m_data + m_readOffset + NetworkCapture::CAPTURE_RECORD_HEADER_SIZE;
+	*size = recordSize;
+	*direction = (NetworkCapture::Direction)m_data[m_readOffset + 8];
+
+	m_readOffset += NetworkCapture::CAPTURE_RECORD_HEADER_SIZE + recordSize;
+
+	return true;
+}
+
+bool NetworkCaptureReplay::sendPacket(const void * data, uint32_t size, SendType sendType)
+{
+	(void)data;
+	(void)size;
+	(void)sendType;
+
+	// Nobody is listening, so whatever the transport sends back is dropped
+	return true;
+}
+
+bool NetworkCaptureReplay::isPacketAvailable(uint32_t * msgSize)
+{
+	uint64_t receiveTimeUs = 0;
+	uint16_t size = 0;
+
+	if (getNextReceiveTime(&receiveTimeUs) == false || receiveTimeUs > NetworkClock::getTimeMicroseconds())
+	{
+		return false;
+	}
+
+	memcpy(&size, m_data + m_readOffset + 12, sizeof(size));
+	*msgSize = size;
+
+	return true;
+}
+
+bool NetworkCaptureReplay::readPacket(void * buffer, uint32_t bufferSize, uint32_t * bytesRead)
+{
+	uint32_t msgSize = 0;
+
+	if (isPacketAvailable(&msgSize) == false || msgSize > bufferSize)
+	{
+		return false;
+	}
+
+	memcpy(buffer, m_data + m_readOffset + NetworkCapture::CAPTURE_RECORD_HEADER_SIZE, msgSize);
+	*bytesRead = msgSize;
+	m_readOffset += NetworkCapture::CAPTURE_RECORD_HEADER_SIZE + msgSize;
+	m_numPacketsRead++;
+
+	return true;
+}
+
+bool NetworkCaptureReplay::replay(const char * filename, Result * result)
+{
+	NetworkCaptureReplay * capture = new NetworkCaptureReplay();
+	NetworkTransport * transport = nullptr;
+	NetworkReplayHandler handler;
+	uint64_t receiveTimeUs = 0;
+	uint64_t startCycles = 0;
+
+	if (capture->init(filename) == false)
+	{
+		delete capture;
+		return false;
+	}
+
+	transport = new NetworkTransport();
+	transport->setBackend(capture);
+	transport->setHandler(&handler);
+
+	startCycles = NetworkClock::getCycles();
+
+	// Jump the clock straight to each packet, so there's no waiting around
+	while (capture->getNextReceiveTime(&receiveTimeUs))
+	{
+		NetworkClock::setSimulatedTimeMicroseconds(receiveTimeUs);
+		transport->receiveData();
+	}
+
+	// Back to the real clock
+	NetworkClock::setSimulatedTimeMicroseconds(0);
+
+	if (result)
+	{
+		result->numPackets = capture->getNumPacketsRead();
+		result->numBodies = handler.numBodies;
+		result->numFullStateUpdates = handler.numFullStateUpdates;
+		result->numEvents = handler.numEvents;
+		result->numBytes = transport->getTotalBytesReceived();
+		result->totalCycles = (int64_t)(NetworkClock::getCycles() - startCycles);
+		result->averageReceiveCycles = transport->getAverageReceiveCycles();
+	}
+
+	SHD_PRINTF("Replayed %s: %u packets, %u bodies, %u full state updates, %u events, %lld bytes in %lld cycles, %llu cycles per packet\n",
+		filename,
+		capture->getNumPacketsRead(),
+		handler.numBodies,
+		handler.numFullStateUpdates,
+		handler.numEvents,
+		(long long)transport->getTotalBytesReceived(),
+		(long long)(NetworkClock::getCycles() - startCycles),
+		(unsigned long long)transport->getAverageReceiveCycles());
+
+	delete transport;
+	delete capture;
+
+	return true;
+}
@@ -0,0 +1,149 @@
+//
+//  NetworkCapture.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include "NetworkBackend.h"
+#include <stdio.h>
+
+namespace shd
+{
+	// Capture files are a small header, then one record per packet:
+	//
+	//   uint64_t timeUs		When it was sent or read, from NetworkClock::getTimeMicroseconds()
+	//   uint8_t  direction		CAPTURE_DIRECTION_*
+	//   uint8_t  messageType	From the packet header, or 0xFF if the header couldn't be read
+	//   uint16_t sequenceNum	From the packet header
+	//   uint16_t size			Then this many bytes of the packet, exactly as they were on the wire
+	//
+	// Everything is written in the machine's byte order, which is little endian on everything we ship on
+	class NetworkCapture
+	{
+	public:
+
+		static const uint32_t CAPTURE_MAGIC = 0x50414E53;	// "SNAP"
+		static const uint16_t CAPTURE_VERSION = 1;
+		static const uint32_t CAPTURE_FILE_HEADER_SIZE = 8;
+		static const uint32_t CAPTURE_RECORD_HEADER_SIZE = 14;
+		static const uint8_t CAPTURE_UNKNOWN_MESSAGE_TYPE = 0xFF;
+
+		enum Direction
+		{
+			CAPTURE_DIRECTION_SENT = 0,
+			CAPTURE_DIRECTION_RECEIVED
+		};
+	};
+
+	// Sits between NetworkTransport and a real backend and writes every packet that goes through it to a capture file.
+	// Turn it on with init(transport.getBackend(), filename) and then transport.setBackend(&recorder).
+	// Records are buffered and written out in big chunks, so keep all the sends and reads on one thread
+	class NetworkCaptureRecorder : public NetworkBackend
+	{
+	public:
+
+		static const uint32_t RECORDER_BUFFER_SIZE = 64 * 1024;
+
+		NetworkCaptureRecorder();
+		~NetworkCaptureRecorder();
+		bool init(NetworkBackend * backend, const char * filename);
+
+		// Write out anything still buffered and close the file
+		void term();
+
+		virtual bool sendPacket(const void * data, uint32_t size, SendType sendType);
+		virtual bool isPacketAvailable(uint32_t * msgSize);
+		virtual bool readPacket(void * buffer, uint32_t bufferSize, uint32_t * bytesRead);
+		virtual uint32_t readPackets(uint8_t * buffers, uint32_t bufferSize, uint32_t * sizes, uint32_t maxPackets);
+		virtual bool flushSends();
+
+		inline uint32_t getNumRecords() { return m_numRecords; }
+
+	private:
+
+		// Disable copying
+		NetworkCaptureRecorder(const NetworkCaptureRecorder &);
+		NetworkCaptureRecorder & operator=(const NetworkCaptureRecorder &);
+
+		void record(NetworkCapture::Direction direction, const void * data, uint32_t size);
+		bool flush();
+
+		// The backend that really sends the packets
+		NetworkBackend * m_backend;
+
+		FILE * m_file;
+
+		// Records waiting to be written to the file
+		uint8_t * m_buffer;
+		uint32_t m_bufferUsed;
+
+		uint32_t m_numRecords;
+	};
+
+	// A backend that plays back the received packets from a capture file, for reproducing a match offline.
+	// A packet is only available once the clock reaches the time it was originally read at, so run it on the
+	// simulated clock. Anything sent to it is thrown away
+	class NetworkCaptureReplay : public NetworkBackend
+	{
+	public:
+
+		struct Result
+		{
+			uint32_t numPackets;
+			uint32_t numBodies;				// Game packet bodies that came out of them, and how many were full state updates
+			uint32_t numFullStateUpdates;
+			uint32_t numEvents;
+			int64_t numBytes;
+			int64_t totalCycles;
+			uint64_t averageReceiveCycles;
+		};
+
+		NetworkCaptureReplay();
+		~NetworkCaptureReplay();
+		bool init(const char * filename);
+		void term();
+
+		// Start again from the first record
+		void rewind();
+
+		// Is there another received packet left? If so, receiveTimeUs is set to when it was read
+		bool getNextReceiveTime(uint64_t * receiveTimeUs);
+
+		// Step through every record, sent and received, without waiting for the clock. For tools that look at the
+		// traffic rather than replaying it. The packet points into the capture, and is good until term()
+		bool nextRecord(const uint8_t ** packet, uint32_t * size, NetworkCapture::Direction * direction);
+
+		virtual bool sendPacket(const void * data, uint32_t size, SendType sendType);
+		virtual bool isPacketAvailable(uint32_t * msgSize);
+		virtual bool readPacket(void * buffer, uint32_t bufferSize, uint32_t * bytesRead);
+
+		inline uint32_t getNumPacketsRead() { return m_numPacketsRead; }
+
+		// Feed every received packet in a capture through a fresh NetworkTransport, as fast as it will go.
+		// The transport gets a handler of its own that only counts what comes out, so nothing in the game is touched
+		static bool replay(const char * filename, Result * result);
+
+	private:
+
+		// Disable copying
+		NetworkCaptureReplay(const NetworkCaptureReplay &);
+		NetworkCaptureReplay & operator=(const NetworkCaptureReplay &);
+
+		// Move m_readOffset on to the next received record. Returns false at the end of the capture
+		bool skipToNextReceived();
+
+		// The whole capture file
+		uint8_t * m_data;
+		uint32_t m_size;
+
+		// Where the next record starts
+		uint32_t m_readOffset;
+
+		// Number of packets read since the last rewind
+		uint32_t m_numPacketsRead;
+	};
+}
@@ -0,0 +1,63 @@
+//
+//  NetworkClock.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define SHD_HAS_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SHD_HAS_RDTSC
+#endif
+
+namespace shd
+{
+	namespace NetworkClock
+	{
+		// When this is non zero, getTimeMicroseconds() returns it instead of the real time.
+		// Lets the network simulator run a match on a clock it controls, so runs are repeatable
+		inline volatile uint64_t & getSimulatedTimeMicroseconds()
+		{
+			static volatile uint64_t simulatedTimeUs = 0;
+			return simulatedTimeUs;
+		}
+
+		inline void setSimulatedTimeMicroseconds(uint64_t timeUs)
+		{
+			getSimulatedTimeMicroseconds() = timeUs;
+		}
+
+		// Monotonic time in microseconds, used for timeouts and timestamps in the network code
+		inline uint64_t getTimeMicroseconds()
+		{
+			uint64_t simulatedTimeUs = getSimulatedTimeMicroseconds();
+
+			if (simulatedTimeUs)
+			{
+				return simulatedTimeUs;
+			}
+
+			return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		// A cheap counter for measuring how long short bits of code take. CPU cycles where there's a
+		// time stamp counter, nanoseconds everywhere else. Only differences between two calls mean anything
+		inline uint64_t getCycles()
+		{
+#ifdef SHD_HAS_RDTSC
+			return (uint64_t)__rdtsc();
+#else
+			return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+		}
+	}
+}
@@ -0,0 +1,203 @@
+//
+//  NetworkClockSync.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkClockSync.h"
+#include "Common.h"
+
+using namespace shd;
+
+// How much of the gap to the best sample's offset is closed with each new sample
+#define SHD_CLOCK_SYNC_OFFSET_SMOOTHING 4
+
+// Weight of each new measurement in the smoothed tick error
+#define SHD_CLOCK_SYNC_TICK_ERROR_WEIGHT 0.1f
+
+// How much longer a tick gets for each tick we're ahead, and the most it can change by either way.
+// Half a percent a tick, up to 1%: at 60 ticks a second, a whole tick is made up in under two seconds
+// without the player being able to feel it
+#define SHD_CLOCK_SYNC_TICK_GAIN 0.005f
+#define SHD_CLOCK_SYNC_MAX_TICK_ADJUST 0.01f
+
+#define SHD_CLOCK_SYNC_DEFAULT_TICK_RATE 60
+
+NetworkClockSync::NetworkClockSync() :	m_ticksPerSecond(SHD_CLOCK_SYNC_DEFAULT_TICK_RATE),
+										m_localTick(0),
+										m_localTickTimeUs(0),
+										m_hasLocalTick(0)
+{
+	reset();
+}
+
+void NetworkClockSync::reset()
+{
+	memset(m_samples, 0, sizeof(m_samples));
+	m_numSamples = 0;
+	m_numSectionsSent = 0;
+	m_offsetUs = 0;
+	m_rttUs = 0;
+	m_hasEcho = false;
+	m_echoTimeUs = 0;
+	m_echoReceivedUs = 0;
+	m_tickError = 0.0f;
+	m_tickErrorMilliTicks = 0;
+	m_tickAdjustPpm = 0;
+}
+
+void NetworkClockSync::setTickRate(uint32_t ticksPerSecond)
+{
+	SHD_ASSERT(ticksPerSecond > 0);
+	m_ticksPerSecond = (ticksPerSecond) ? ticksPerSecond : SHD_CLOCK_SYNC_DEFAULT_TICK_RATE;
+}
+
+void NetworkClockSync::setLocalTick(uint32_t tick, uint64_t timeUs)
+{
+	Atomic::exchange64(&m_localTickTimeUs, (int64_t)timeUs);
+	Atomic::exchange32(&m_localTick, tick);
+	Atomic::exchange32(&m_hasLocalTick, 1);
+}
+
+bool NetworkClockSync::isSectionDue(uint16_t packetSequenceNum)
+{
+	return m_numSectionsSent < NUM_SAMPLES || (packetSequenceNum % SECTION_INTERVAL) == 0;
+}
+
+void NetworkClockSync::writeSection(BitWriter & writer, uint64_t nowUs)
+{
+	TimeSection section;
+
+	memset(&section, 0, sizeof(TimeSection));
+	section.sendTimeUs = (uint32_t)nowUs;
+
+	if (m_hasEcho && nowUs - m_echoReceivedUs <= MAX_ECHO_DELAY_US)
+	{
+		section.hasEcho = true;
+		section.echoTimeUs = m_echoTimeUs;
+		section.echoDelayUs = (uint32_t)(nowUs - m_echoReceivedUs);
+	}
+
+	if (m_hasLocalTick)
+	{
+		// Where we're up to right now, not when the tick started
+		int64_t sinceTickUs = (int64_t)nowUs - m_localTickTimeUs;
+
+		section.hasTick = true;
+		section.tick = m_localTick * 256 + (uint32_t)(sinceTickUs * m_ticksPerSecond * 256 / 1000000);
+	}
+
+	serializeTimeSection(writer, section);
+	m_numSectionsSent++;
+}
+
+bool NetworkClockSync::readSection(BitReader & reader, uint64_t nowUs)
+{
+	TimeSection section;
+
+	memset(&section, 0, sizeof(TimeSection));
+
+	if (serializeTimeSection(reader, section) == false)
+	{
+		return false;
+	}
+
+	if (section.hasEcho)
+	{
+		addSample(section, (uint32_t)nowUs);
+	}
+
+	updateTickError(section);
+
+	// Echo the newest one back. One that was overtaken on the way would just give a longer round trip
+	if (m_hasEcho == false || (int32_t)(section.sendTimeUs - m_echoTimeUs) > 0)
+	{
+		m_hasEcho = true;
+		m_echoTimeUs = section.sendTimeUs;
+		m_echoReceivedUs = nowUs;
+	}
+
+	return true;
+}
+
+void NetworkClockSync::addSample(const TimeSection & section, uint32_t nowUs)
+{
+	// Our send time, their receive time, their send time, our receive time
+	uint32_t t0 = section.echoTimeUs;
+	uint32_t t2 = section.sendTimeUs;
+	uint32_t t3 = nowUs;
+	int32_t roundTripUs = (int32_t)(t3 - t0);
+	Sample & sample = m_samples[m_numSamples % NUM_SAMPLES];
+	const Sample * best = nullptr;
+	uint32_t numStored = 0;
+
+	if (roundTripUs < 0 || (uint32_t)roundTripUs < section.echoDelayUs)
+	{
+		return;
+	}
+
+	// Assuming the trip took as long each way, their clock read t2 half a round trip before ours read t3
+	sample.rttUs = (uint32_t)roundTripUs - section.echoDelayUs;
+	sample.offsetUs = t2 - t3 + sample.rttUs / 2;
+	m_numSamples++;
+
+	// The sample with the shortest round trip spent the least time queued up somewhere, so it's the most accurate
+	numStored = (m_numSamples < NUM_SAMPLES) ? m_numSamples : NUM_SAMPLES;
+
+	for (uint32_t i = 0; i < numStored; i++)
+	{
+		if (best == nullptr || m_samples[i].rttUs < best->rttUs)
+		{
+			best = &m_samples[i];
+		}
+	}
+
+	if (m_numSamples == 1)
+	{
+		m_offsetUs = best->offsetUs;
+	}
+	else
+	{
+		m_offsetUs += (uint32_t)((int32_t)(best->offsetUs - m_offsetUs) / SHD_CLOCK_SYNC_OFFSET_SMOOTHING);
+	}
+
+	Atomic::exchange32(&m_rttUs, best->rttUs);
+}
+
+void NetworkClockSync::updateTickError(const TimeSection & section)
+{
+	uint32_t localTick = m_localTick;
+	uint32_t localTickTimeUs = (uint32_t)m_localTickTimeUs;
+	uint32_t remoteSendTimeUs = 0;
+	float errorTicks = 0.0f;
+	float adjust = 0.0f;
+
+	if (section.hasTick == false || m_hasLocalTick == 0 || hasOffset() == false)
+	{
+		return;
+	}
+
+	// Where our simulation was up to when they sent this, on our clock, compared with where theirs was
+	remoteSendTimeUs = toLocalTime(section.sendTimeUs);
+	errorTicks = (float)(int32_t)(localTick * 256 - section.tick) / 256.0f +
+				 (float)(int32_t)(remoteSendTimeUs - localTickTimeUs) * (float)m_ticksPerSecond / 1000000.0f;
+
+	m_tickError += (errorTicks - m_tickError) * SHD_CLOCK_SYNC_TICK_ERROR_WEIGHT;
+
+	// Slow down when we're ahead, speed up when we're behind. The other side does the same, so they meet in the middle
+	adjust = m_tickError * SHD_CLOCK_SYNC_TICK_GAIN;
+
+	if (adjust > SHD_CLOCK_SYNC_MAX_TICK_ADJUST)
+	{
+		adjust = SHD_CLOCK_SYNC_MAX_TICK_ADJUST;
+	}
+	else if (adjust < -SHD_CLOCK_SYNC_MAX_TICK_ADJUST)
+	{
+		adjust = -SHD_CLOCK_SYNC_MAX_TICK_ADJUST;
+	}
+
+	Atomic::exchange32(&m_tickErrorMilliTicks, (uint32_t)(int32_t)(m_tickError * 1000.0f));
+	Atomic::exchange32(&m_tickAdjustPpm, (uint32_t)(int32_t)(adjust * 1000000.0f));
+}
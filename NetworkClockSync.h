@@ -0,0 +1,151 @@
+//
+//  NetworkClockSync.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include "NetworkBitStream.h"
+#include <stdint.h>
+
+namespace shd
+{
+	// Works out how the other peer's clock and simulation line up with ours, NTP style. Every so often a packet carries
+	// a time section: when it was sent, the send time of the last time section we got from the other side, and how long
+	// we held on to that before replying. That gives a round trip time and a clock offset for each reply. The samples
+	// with the shortest round trips are the least delayed by queuing, so those are the ones that are trusted.
+	// Each time section also says which simulation tick the sender was on, so we can tell if our simulation is ahead
+	// of theirs, and getTickScale() says how much to stretch or shrink our ticks to bring them back in line.
+	// Times are the low 32 bits of NetworkClock::getTimeMicroseconds(), and everything is done modulo 2^32, so the
+	// offset is only good for converting between the two clocks and not for anything absolute.
+	// Sections are written and read on the network thread. The tick is set and the tick scale read on the game thread
+	class NetworkClockSync
+	{
+	public:
+
+		// How many of the most recent samples the best one is picked from
+		static const uint32_t NUM_SAMPLES = 8;
+
+		// A time section goes in every this many game packets, once the first NUM_SAMPLES have been sent
+		static const uint32_t SECTION_INTERVAL = 10;
+
+		// Echoes held for longer than this aren't sent, since the round trip would be mostly waiting
+		static const uint32_t MAX_ECHO_DELAY_US = (1 << 20) - 1;
+
+		// The most bytes a time section can take up
+		static const uint32_t MAX_SECTION_SIZE = 20;
+
+		struct TimeSection
+		{
+			uint32_t sendTimeUs;		// Sender's clock when this was sent
+			bool hasEcho;
+			uint32_t echoTimeUs;		// The sendTimeUs of the last time section the sender got from us
+			uint32_t echoDelayUs;		// How long ago the sender got it
+			bool hasTick;
+			uint32_t tick;				// The sender's simulation tick at sendTimeUs, in 256ths of a tick
+		};
+
+		template <typename Stream> static bool serializeTimeSection(Stream & stream, TimeSection & section)
+		{
+			if (serializeInt(stream, section.sendTimeUs, 32) == false || serializeBool(stream, section.hasEcho) == false)
+			{
+				return false;
+			}
+
+			if (section.hasEcho && (serializeInt(stream, section.echoTimeUs, 32) == false || serializeInt(stream, section.echoDelayUs, 20) == false))
+			{
+				return false;
+			}
+
+			if (serializeBool(stream, section.hasTick) == false || (section.hasTick && serializeVarint(stream, section.tick) == false))
+			{
+				return false;
+			}
+
+			return stream.serializeAlign();
+		}
+
+		NetworkClockSync();
+		void reset();
+
+		// How many simulation ticks a second both sides run at
+		void setTickRate(uint32_t ticksPerSecond);
+
+		// The simulation tick we're on, and when it started. Called by the game thread every tick. Both sides have to
+		// count ticks from the same point, like kickoff
+		void setLocalTick(uint32_t tick, uint64_t timeUs);
+
+		// Should a game packet with this sequence number carry a time section
+		bool isSectionDue(uint16_t packetSequenceNum);
+
+		// Write a time section, or read one and take a sample from it. nowUs is NetworkClock::getTimeMicroseconds()
+		void writeSection(BitWriter & writer, uint64_t nowUs);
+		bool readSection(BitReader & reader, uint64_t nowUs);
+
+		// Have we had a reply to one of our time sections yet
+		inline bool hasOffset() { return m_numSamples > 0; }
+
+		// Their clock minus ours, modulo 2^32
+		inline int32_t getOffsetMicroseconds() { return (int32_t)m_offsetUs; }
+
+		// Round trip time of the sample the offset came from
+		inline uint32_t getRttMicroseconds() { return m_rttUs; }
+
+		// Convert a time on their clock to ours, keeping only the low 32 bits
+		inline uint32_t toLocalTime(uint32_t remoteTimeUs) { return remoteTimeUs - m_offsetUs; }
+
+		// How many ticks our simulation is ahead of theirs, right now. Negative if we're behind
+		inline float getTickError() { return (float)(int32_t)m_tickErrorMilliTicks / 1000.0f; }
+
+		// Multiply the length of each tick by this to stay in line with the other side. Above 1 when we're ahead
+		inline float getTickScale() { return (float)(int32_t)m_tickAdjustPpm / 1000000.0f + 1.0f; }
+
+		inline uint32_t getNumSamples() { return m_numSamples; }
+
+	private:
+
+		struct Sample
+		{
+			uint32_t rttUs;
+			uint32_t offsetUs;
+		};
+
+		// Take a sample from a time section that echoed one of ours
+		void addSample(const TimeSection & section, uint32_t nowUs);
+
+		// Compare our tick with theirs, and work out the new tick scale
+		void updateTickError(const TimeSection & section);
+
+		// The last NUM_SAMPLES samples, and how many there have been altogether
+		Sample m_samples[NUM_SAMPLES];
+		uint32_t m_numSamples;
+
+		// The first NUM_SAMPLES time sections go in every game packet, so the other side gets going quickly
+		uint32_t m_numSectionsSent;
+
+		// Smoothed offset, and the round trip time of the best sample
+		uint32_t m_offsetUs;
+		volatile uint32_t m_rttUs;
+
+		// The last time section we got from the other side, and when we got it, to echo back
+		bool m_hasEcho;
+		uint32_t m_echoTimeUs;
+		uint64_t m_echoReceivedUs;
+
+		uint32_t m_ticksPerSecond;
+
+		// Written by the game thread
+		volatile uint32_t m_localTick;
+		volatile int64_t m_localTickTimeUs;
+		volatile uint32_t m_hasLocalTick;
+
+		// Smoothed tick error in thousandths of a tick, and the tick scale in parts per million away from 1.
+		// Both are really signed
+		float m_tickError;
+		volatile uint32_t m_tickErrorMilliTicks;
+		volatile uint32_t m_tickAdjustPpm;
+	};
+}
@@ -0,0 +1,363 @@
+//
+//  NetworkConditionSimulator.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkConditionSimulator.h"
+#include "NetworkClock.h"
+#include "Common.h"
+#include <math.h>
+
+using namespace shd;
+
+NetworkConditionSimulator::Config NetworkConditionSimulator::getProfileConfig(Profile profile, uint32_t seed)
+{
+	Config config;
+
+	memset(&config, 0, sizeof(Config));
+	config.seed = seed;
+	config.jitterDistribution = JITTER_DISTRIBUTION_NORMAL;
+	config.maxQueueDelayUs = 250 * 1000;
+
+	switch (profile)
+	{
+	case PROFILE_PERFECT:
+		break;
+
+	case PROFILE_GOOD_BROADBAND:
+		config.latencyUs = 15 * 1000;
+		config.jitterUs = 2 * 1000;
+		config.lossPercent = 0.1f;
+		break;
+
+	case PROFILE_AVERAGE_WIFI:
+		config.latencyUs = 40 * 1000;
+		config.jitterUs = 10 * 1000;
+		config.lossPercent = 1.0f;
+		config.badStateEnterPercent = 0.5f;
+		config.badStateExitPercent = 20.0f;
+		config.badStateLossPercent = 30.0f;
+		config.duplicatePercent = 0.2f;
+		config.reorderPercent = 1.0f;
+		config.reorderDelayUs = 20 * 1000;
+		break;
+
+	case PROFILE_BAD_MOBILE:
+		config.latencyUs = 90 * 1000;
+		config.jitterUs = 35 * 1000;
+		config.lossPercent = 3.0f;
+		config.badStateEnterPercent = 2.0f;
+		config.badStateExitPercent = 10.0f;
+		config.badStateLossPercent = 60.0f;
+		config.duplicatePercent = 1.0f;
+		config.reorderPercent = 5.0f;
+		config.reorderDelayUs = 40 * 1000;
+		config.bandwidthBytesPerSecond = 32 * 1024;
+		break;
+
+	default:
+		SHD_ASSERT(false);
+		break;
+	}
+
+	return config;
+}
+
+NetworkConditionSimulator::NetworkConditionSimulator() :	m_backend(nullptr),
+															m_queue(nullptr),
+															m_nextOrder(0),
+															m_randomState(1),
+															m_isInBadState(false),
+															m_linkFreeTimeUs(0),
+															m_lastReliableReleaseTimeUs(0),
+															m_numDropped(0),
+															m_numDuplicated(0),
+															m_numReordered(0),
+															m_numOverBandwidth(0)
+{
+	memset(&m_config, 0, sizeof(Config));
+}
+
+NetworkConditionSimulator::~NetworkConditionSimulator()
+{
+	term();
+}
+
+bool NetworkConditionSimulator::init(NetworkBackend * backend, const Config & config)
+{
+	term();
+
+	m_queue = (Slot *)SHD_MALLOC(sizeof(Slot) * SIM_QUEUE_SIZE);
+	if (m_queue == nullptr)
+	{
+		return false;
+	}
+
+	for (uint32_t i = 0; i < SIM_QUEUE_SIZE; i++)
+	{
+		m_queue[i].inUse = false;
+	}
+
+	m_backend = backend;
+	m_nextOrder = 0;
+	m_isInBadState = false;
+	m_linkFreeTimeUs = 0;
+	m_lastReliableReleaseTimeUs = 0;
+	m_numDropped = 0;
+	m_numDuplicated = 0;
+	m_numReordered = 0;
+	m_numOverBandwidth = 0;
+	setConfig(config);
+
+	return true;
+}
+
+void NetworkConditionSimulator::term()
+{
+	if (m_queue)
+	{
+		SHD_FREE(m_queue);
+		m_queue = nullptr;
+	}
+
+	m_backend = nullptr;
+}
+
+void NetworkConditionSimulator::setConfig(const Config & config)
+{
+	m_config = config;
+
+	// xorshift gets stuck on 0
+	m_randomState = (config.seed) ? config.seed : 0x9E3779B9;
+}
+
+uint32_t NetworkConditionSimulator::random()
+{
+	m_randomState ^= m_randomState << 13;
+	m_randomState ^= m_randomState >> 17;
+	m_randomState ^= m_randomState << 5;
+
+	return m_randomState;
+}
+
+float NetworkConditionSimulator::randomPercent()
+{
+	return (float)(random() >> 8) * (100.0f / 16777216.0f);
+}
+
+uint64_t NetworkConditionSimulator::randomJitterUs()
+{
+	float jitterUs = 0.0f;
+
+	if (m_config.jitterUs == 0)
+	{
+		return 0;
+	}
+
+	if (m_config.jitterDistribution == JITTER_DISTRIBUTION_UNIFORM)
+	{
+		return random() % (m_config.jitterUs + 1);
+	}
+
+	// Box-Muller, folded so it only ever adds delay
+	float u1 = ((float)(random() >> 8) + 1.0f) / 16777217.0f;
+	float u2 = (float)(random() >> 8) / 16777216.0f;
+	jitterUs = fabsf(sqrtf(-2.0f * logf(u1)) * cosf(6.2831853f * u2)) * (float)m_config.jitterUs;
+
+	return (uint64_t)jitterUs;
+}
+
+bool NetworkConditionSimulator::queuePacket(const void * data, uint32_t size, SendType sendType, uint64_t releaseTimeUs)
+{
+	for (uint32_t i = 0; i < SIM_QUEUE_SIZE; i++)
+	{
+		Slot & slot = m_queue[i];
+
+		if (slot.inUse == false)
+		{
+			slot.inUse = true;
+			slot.releaseTimeUs = releaseTimeUs;
+			slot.order = m_nextOrder++;
+			slot.size = size;
+			slot.sendType = sendType;
+			memcpy(slot.data, data, size);
+
+			return true;
+		}
+	}
+
+	SHD_PRINTF("Network simulator queue is full!\n");
+	return false;
+}
+
+bool NetworkConditionSimulator::sendPacket(const void * data, uint32_t size, SendType sendType)
+{
+	uint64_t timeUs = NetworkClock::getTimeMicroseconds();
+	uint64_t releaseTimeUs = timeUs + m_config.latencyUs + randomJitterUs();
+	bool isDuplicated = false;
+
+	if (m_backend == nullptr || m_queue == nullptr || size > SIM_MAX_PACKET_SIZE)
+	{
+		SHD_ASSERT(false);
+		return false;
+	}
+
+	update();
+
+	// Reliable packets always get there, and in order, so they only get the delay
+	if (sendType == SEND_TYPE_RELIABLE)
+	{
+		if (releaseTimeUs < m_lastReliableReleaseTimeUs)
+		{
+			releaseTimeUs = m_lastReliableReleaseTimeUs;
+		}
+
+		m_lastReliableReleaseTimeUs = releaseTimeUs;
+
+		return queuePacket(data, size, sendType, releaseTimeUs);
+	}
+
+	// Move between the good and bad states, then see if this packet is lost
+	if (m_isInBadState)
+	{
+		m_isInBadState = randomPercent() >= m_config.badStateExitPercent;
+	}
+	else
+	{
+		m_isInBadState = randomPercent() < m_config.badStateEnterPercent;
+	}
+
+	if (randomPercent() < ((m_isInBadState) ? m_config.badStateLossPercent : m_config.lossPercent))
+	{
+		m_numDropped++;
+		return true;
+	}
+
+	// Wait for the link to be free
+	if (m_config.bandwidthBytesPerSecond)
+	{
+		uint64_t departTimeUs = (m_linkFreeTimeUs > timeUs) ? m_linkFreeTimeUs : timeUs;
+
+		if (departTimeUs - timeUs > m_config.maxQueueDelayUs)
+		{
+			m_numOverBandwidth++;
+			m_numDropped++;
+			return true;
+		}
+
+		m_linkFreeTimeUs = departTimeUs + (uint64_t)size * 1000000 / m_config.bandwidthBytesPerSecond;
+		releaseTimeUs += m_linkFreeTimeUs - timeUs;
+	}
+
+	if (randomPercent() < m_config.reorderPercent)
+	{
+		releaseTimeUs += m_config.reorderDelayUs;
+		m_numReordered++;
+	}
+
+	isDuplicated = randomPercent() < m_config.duplicatePercent;
+
+	if (queuePacket(data, size, sendType, releaseTimeUs) == false)
+	{
+		m_numDropped++;
+		return true;
+	}
+
+	if (isDuplicated && queuePacket(data, size, sendType, releaseTimeUs + randomJitterUs()))
+	{
+		m_numDuplicated++;
+	}
+
+	return true;
+}
+
+void NetworkConditionSimulator::update()
+{
+	uint64_t timeUs = NetworkClock::getTimeMicroseconds();
+
+	if (m_backend == nullptr || m_queue == nullptr)
+	{
+		return;
+	}
+
+	// Send everything that's due, oldest release time first
+	for (;;)
+	{
+		Slot * next = nullptr;
+
+		for (uint32_t i = 0; i < SIM_QUEUE_SIZE; i++)
+		{
+			Slot & slot = m_queue[i];
+
+			if (slot.inUse == false || slot.releaseTimeUs > timeUs)
+			{
+				continue;
+			}
+
+			if (next == nullptr ||
+				slot.releaseTimeUs < next->releaseTimeUs ||
+				(slot.releaseTimeUs == next->releaseTimeUs && (int32_t)(slot.order - next->order) < 0))
+			{
+				next = &slot;
+			}
+		}
+
+		if (next == nullptr)
+		{
+			break;
+		}
+
+		m_backend->sendPacket(next->data, next->size, next->sendType);
+		next->inUse = false;
+	}
+}
+
+bool NetworkConditionSimulator::isPacketAvailable(uint32_t * msgSize)
+{
+	if (m_backend == nullptr)
+	{
+		return false;
+	}
+
+	update();
+
+	return m_backend->isPacketAvailable(msgSize);
+}
+
+bool NetworkConditionSimulator::readPacket(void * buffer, uint32_t bufferSize, uint32_t * bytesRead)
+{
+	if (m_backend == nullptr)
+	{
+		return false;
+	}
+
+	return m_backend->readPacket(buffer, bufferSize, bytesRead);
+}
+
+uint32_t NetworkConditionSimulator::readPackets(uint8_t * buffers, uint32_t bufferSize, uint32_t * sizes, uint32_t maxPackets)
+{
+	if (m_backend == nullptr)
+	{
+		return 0;
+	}
+
+	update();
+
+	return m_backend->readPackets(buffers, bufferSize, sizes, maxPackets);
+}
+
+bool NetworkConditionSimulator::flushSends()
+{
+	if (m_backend == nullptr)
+	{
+		return false;
+	}
+
+	// Whatever is due goes to the real backend, and then out together
+	update();
+
+	return m_backend->flushSends();
+}
@@ -0,0 +1,145 @@
+//
+//  NetworkConditionSimulator.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include "NetworkBackend.h"
+
+namespace shd
+{
+	// Sits between NetworkTransport and a real backend, and makes the connection worse on purpose:
+	// latency with jitter, random and bursty loss, duplicates, reordering and a bandwidth cap.
+	// Only packets we send are affected, so put one on each peer to make both directions bad.
+	// Everything random comes from the seed, so the same config and the same traffic always give the same result
+	class NetworkConditionSimulator : public NetworkBackend
+	{
+	public:
+
+		static const uint32_t SIM_MAX_PACKET_SIZE = 1536;
+		static const uint32_t SIM_QUEUE_SIZE = 256;
+
+		enum JitterDistribution
+		{
+			JITTER_DISTRIBUTION_UNIFORM = 0,	// Anywhere from 0 to jitterUs
+			JITTER_DISTRIBUTION_NORMAL			// Normal with a standard deviation of jitterUs, never below 0
+		};
+
+		enum Profile
+		{
+			PROFILE_PERFECT = 0,
+			PROFILE_GOOD_BROADBAND,
+			PROFILE_AVERAGE_WIFI,
+			PROFILE_BAD_MOBILE,
+			PROFILE_MAX
+		};
+
+		struct Config
+		{
+			uint32_t seed;
+
+			// One way delay added to every packet, plus a random extra amount on top
+			uint32_t latencyUs;
+			uint32_t jitterUs;
+			JitterDistribution jitterDistribution;
+
+			// Gilbert-Elliott loss. The link flips between a good and a bad state, and each state has its own loss rate.
+			// For plain random loss, leave badStateEnterPercent at 0
+			float lossPercent;
+			float badStateEnterPercent;
+			float badStateExitPercent;
+			float badStateLossPercent;
+
+			// Chance of a packet being sent twice
+			float duplicatePercent;
+
+			// Chance of a packet being held back, so the ones after it overtake it
+			float reorderPercent;
+			uint32_t reorderDelayUs;
+
+			// 0 for no cap. Packets wait their turn on the link, and are dropped if they'd wait longer than maxQueueDelayUs
+			uint32_t bandwidthBytesPerSecond;
+			uint32_t maxQueueDelayUs;
+		};
+
+		// Some typical connections to test against
+		static Config getProfileConfig(Profile profile, uint32_t seed);
+
+		NetworkConditionSimulator();
+		~NetworkConditionSimulator();
+		bool init(NetworkBackend * backend, const Config & config);
+		void term();
+
+		// Change how bad the connection is, without losing the packets that are already queued
+		void setConfig(const Config & config);
+
+		// Hand any queued packets that are due over to the real backend. Also done on every send and receive
+		void update();
+
+		virtual bool sendPacket(const void * data, uint32_t size, SendType sendType);
+		virtual bool isPacketAvailable(uint32_t * msgSize);
+		virtual bool readPacket(void * buffer, uint32_t bufferSize, uint32_t * bytesRead);
+		virtual uint32_t readPackets(uint8_t * buffers, uint32_t bufferSize, uint32_t * sizes, uint32_t maxPackets);
+		virtual bool flushSends();
+
+		inline uint32_t getNumDropped() { return m_numDropped; }
+		inline uint32_t getNumDuplicated() { return m_numDuplicated; }
+		inline uint32_t getNumReordered() { return m_numReordered; }
+		inline uint32_t getNumOverBandwidth() { return m_numOverBandwidth; }
+
+	private:
+
+		struct Slot
+		{
+			bool inUse;
+			uint64_t releaseTimeUs;
+			uint32_t order;
+			uint32_t size;
+			SendType sendType;
+			uint8_t data[SIM_MAX_PACKET_SIZE];
+		};
+
+		// Disable copying
+		NetworkConditionSimulator(const NetworkConditionSimulator &);
+		NetworkConditionSimulator & operator=(const NetworkConditionSimulator &);
+
+		// Random numbers from the seed. xorshift, so it's the same on every platform
+		uint32_t random();
+		float randomPercent();
+		uint64_t randomJitterUs();
+
+		// Put a packet in the queue to go out at releaseTimeUs
+		bool queuePacket(const void * data, uint32_t size, SendType sendType, uint64_t releaseTimeUs);
+
+		// The backend that really sends the packets
+		NetworkBackend * m_backend;
+
+		Config m_config;
+
+		// Packets waiting for their delay to be up
+		Slot * m_queue;
+
+		// Used to keep packets with the same release time in the order they were sent
+		uint32_t m_nextOrder;
+
+		uint32_t m_randomState;
+
+		// Is the link in the bad Gilbert-Elliott state
+		bool m_isInBadState;
+
+		// When the bandwidth capped link will be free to send the next packet
+		uint64_t m_linkFreeTimeUs;
+
+		// Reliable packets can't overtake each other
+		uint64_t m_lastReliableReleaseTimeUs;
+
+		uint32_t m_numDropped;
+		uint32_t m_numDuplicated;
+		uint32_t m_numReordered;
+		uint32_t m_numOverBandwidth;
+	};
+}
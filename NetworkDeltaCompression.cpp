@@ -0,0 +1,260 @@
+//
+//  NetworkDeltaCompression.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkDeltaCompression.h"
+#include "NetworkSequence.h"
+#include "Common.h"
+
+using namespace shd;
+
+NetworkSnapshotRing::NetworkSnapshotRing()
+{
+	reset();
+}
+
+void NetworkSnapshotRing::reset()
+{
+	for (int i = 0; i < SNAPSHOT_RING_SIZE; i++)
+	{
+		m_snapshots[i].valid = false;
+		m_snapshots[i].acked = false;
+	}
+
+	m_newestAckedSeqNum = 0;
+	m_hasAcked = false;
+}
+
+bool NetworkSnapshotRing::insert(uint16_t sequenceNum, const uint8_t * data, uint32_t size)
+{
+	if (size > SNAPSHOT_MAX_SIZE)
+	{
+		return false;
+	}
+
+	Snapshot * snapshot = beginInsert(sequenceNum);
+	memcpy(snapshot->data, data, size);
+	commit(snapshot, size);
+
+	return true;
+}
+
+NetworkSnapshotRing::Snapshot * NetworkSnapshotRing::beginInsert(uint16_t sequenceNum)
+{
+	Snapshot * snapshot = &m_snapshots[sequenceNum % SNAPSHOT_RING_SIZE];
+
+	snapshot->valid = false;
+	snapshot->acked = false;
+	snapshot->sequenceNum = sequenceNum;
+	snapshot->size = 0;
+
+	return snapshot;
+}
+
+void NetworkSnapshotRing::commit(Snapshot * snapshot, uint32_t size)
+{
+	snapshot->size = size;
+	snapshot->valid = true;
+}
+
+const NetworkSnapshotRing::Snapshot * NetworkSnapshotRing::find(uint16_t sequenceNum)
+{
+	Snapshot * snapshot = &m_snapshots[sequenceNum % SNAPSHOT_RING_SIZE];
+
+	if (snapshot->valid == false || snapshot->sequenceNum != sequenceNum)
+	{
+		return nullptr;
+	}
+
+	return snapshot;
+}
+
+void NetworkSnapshotRing::markAcked(uint16_t sequenceNum)
+{
+	Snapshot * snapshot = &m_snapshots[sequenceNum % SNAPSHOT_RING_SIZE];
+
+	if (snapshot->valid == false || snapshot->sequenceNum != sequenceNum)
+	{
+		return;
+	}
+
+	snapshot->acked = true;
+
+	if (m_hasAcked == false || NetworkSequence::isNewer(sequenceNum, m_newestAckedSeqNum))
+	{
+		m_newestAckedSeqNum = sequenceNum;
+		m_hasAcked = true;
+	}
+}
+
+const NetworkSnapshotRing::Snapshot * NetworkSnapshotRing::getNewestAcked()
+{
+	if (m_hasAcked == false)
+	{
+		return nullptr;
+	}
+
+	// If it has been overwritten since, there's no baseline we can trust
+	return find(m_newestAckedSeqNum);
+}
+
+// Variable length unsigned int, 7 bits per byte
+static inline bool writeVarint(uint32_t value, uint8_t * out, uint32_t outCapacity, uint32_t * pos)
+{
+	do
+	{
+		if (*pos >= outCapacity)
+		{
+			return false;
+		}
+
+		uint8_t byte = value & 0x7F;
+		value >>= 7;
+		out[(*pos)++] = byte | ((value) ? 0x80 : 0);
+	} while (value);
+
+	return true;
+}
+
+static inline bool readVarint(const uint8_t * in, uint32_t inSize, uint32_t * pos, uint32_t * value)
+{
+	uint32_t result = 0;
+
+	for (int shift = 0; shift < 32; shift += 7)
+	{
+		if (*pos >= inSize)
+		{
+			return false;
+		}
+
+		uint8_t byte = in[(*pos)++];
+		result |= (uint32_t)(byte & 0x7F) << shift;
+
+		if ((byte & 0x80) == 0)
+		{
+			*value = result;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static inline uint8_t baselineByte(const uint8_t * baseline, uint32_t baselineSize, uint32_t i)
+{
+	return (i < baselineSize) ? baseline[i] : 0;
+}
+
+// The delta is the XOR of the current and baseline data, stored as pairs of runs:
+// [number of unchanged bytes][number of changed bytes][the changed bytes XOR'd with the baseline]
+bool NetworkDelta::encode(const uint8_t * baseline, uint32_t baselineSize, const uint8_t * current, uint32_t currentSize, uint8_t * out, uint32_t outCapacity, uint32_t * outSize)
+{
+	uint32_t pos = 0;
+	uint32_t i = 0;
+
+	if (writeVarint(currentSize, out, outCapacity, &pos) == false)
+	{
+		return false;
+	}
+
+	while (i < currentSize)
+	{
+		uint32_t zeroRunStart = i;
+
+		while (i < currentSize && current[i] == baselineByte(baseline, baselineSize, i))
+		{
+			i++;
+		}
+
+		uint32_t literalStart = i;
+
+		// A single unchanged byte costs more to skip than to send, so only stop the literal at two or more
+		while (i < currentSize)
+		{
+			if (current[i] == baselineByte(baseline, baselineSize, i) &&
+				(i + 1 >= currentSize || current[i + 1] == baselineByte(baseline, baselineSize, i + 1)))
+			{
+				break;
+			}
+
+			i++;
+		}
+
+		if (writeVarint(literalStart - zeroRunStart, out, outCapacity, &pos) == false ||
+			writeVarint(i - literalStart, out, outCapacity, &pos) == false)
+		{
+			return false;
+		}
+
+		if (pos + (i - literalStart) > outCapacity)
+		{
+			return false;
+		}
+
+		for (uint32_t j = literalStart; j < i; j++)
+		{
+			out[pos++] = current[j] ^ baselineByte(baseline, baselineSize, j);
+		}
+
+		// Not worth it
+		if (pos >= currentSize)
+		{
+			return false;
+		}
+	}
+
+	*outSize = pos;
+	return true;
+}
+
+bool NetworkDelta::decode(const uint8_t * baseline, uint32_t baselineSize, const uint8_t * delta, uint32_t deltaSize, uint8_t * out, uint32_t outCapacity, uint32_t * outSize)
+{
+	uint32_t pos = 0;
+	uint32_t i = 0;
+	uint32_t currentSize = 0;
+
+	if (readVarint(delta, deltaSize, &pos, &currentSize) == false || currentSize > outCapacity)
+	{
+		return false;
+	}
+
+	while (i < currentSize)
+	{
+		uint32_t zeroRun = 0;
+		uint32_t literalLen = 0;
+
+		if (readVarint(delta, deltaSize, &pos, &zeroRun) == false ||
+			readVarint(delta, deltaSize, &pos, &literalLen) == false)
+		{
+			return false;
+		}
+
+		if (zeroRun > currentSize - i || literalLen > currentSize - i - zeroRun || literalLen > deltaSize - pos)
+		{
+			return false;
+		}
+
+		for (uint32_t j = 0; j < zeroRun; j++, i++)
+		{
+			out[i] = baselineByte(baseline, baselineSize, i);
+		}
+
+		for (uint32_t j = 0; j < literalLen; j++, i++)
+		{
+			out[i] = delta[pos++] ^ baselineByte(baseline, baselineSize, i);
+		}
+
+		// Guard against a malformed delta that never makes progress
+		if (zeroRun == 0 && literalLen == 0)
+		{
+			return false;
+		}
+	}
+
+	*outSize = currentSize;
+	return true;
+}
@@ -0,0 +1,69 @@
+//
+//  NetworkDeltaCompression.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+namespace shd
+{
+	// A ring of game state snapshots, indexed by the sequence number of the packet they were sent or received in
+	class NetworkSnapshotRing
+	{
+	public:
+
+		static const int SNAPSHOT_RING_SIZE = 32;
+		static const uint32_t SNAPSHOT_MAX_SIZE = 4 * 1024;
+
+		struct Snapshot
+		{
+			bool valid;
+			bool acked;
+			uint16_t sequenceNum;
+			uint32_t size;
+			uint8_t data[SNAPSHOT_MAX_SIZE];
+		};
+
+		NetworkSnapshotRing();
+		void reset();
+
+		// Store a copy of a snapshot, replacing whatever was in its slot before
+		bool insert(uint16_t sequenceNum, const uint8_t * data, uint32_t size);
+
+		// Get the slot for a snapshot so it can be written into directly. Call commit() once it's filled in
+		Snapshot * beginInsert(uint16_t sequenceNum);
+		void commit(Snapshot * snapshot, uint32_t size);
+
+		// Find a snapshot. Returns null if it isn't in the ring (never stored, or overwritten since)
+		const Snapshot * find(uint16_t sequenceNum);
+
+		// The other peer has told us it received this snapshot
+		void markAcked(uint16_t sequenceNum);
+
+		// The newest snapshot the other peer has received, or null if there isn't one we can use
+		const Snapshot * getNewestAcked();
+
+	private:
+
+		// The snapshots
+		Snapshot m_snapshots[SNAPSHOT_RING_SIZE];
+
+		// Sequence number of the newest acked snapshot
+		uint16_t m_newestAckedSeqNum;
+		bool m_hasAcked;
+	};
+
+	namespace NetworkDelta
+	{
+		// Encode current as a delta against baseline. Returns false if the delta wouldn't fit, or wouldn't be smaller than current itself
+		bool encode(const uint8_t * baseline, uint32_t baselineSize, const uint8_t * current, uint32_t currentSize, uint8_t * out, uint32_t outCapacity, uint32_t * outSize);
+
+		// Decode a delta against baseline back into the original data
+		bool decode(const uint8_t * baseline, uint32_t baselineSize, const uint8_t * delta, uint32_t deltaSize, uint8_t * out, uint32_t outCapacity, uint32_t * outSize);
+	}
+}
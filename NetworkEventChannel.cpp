@@ -0,0 +1,149 @@
+//
+//  NetworkEventChannel.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkEventChannel.h"
+#include "NetworkSequence.h"
+#include "Common.h"
+
+using namespace shd;
+
+NetworkEventChannel::NetworkEventChannel()
+{
+	reset();
+}
+
+void NetworkEventChannel::reset()
+{
+	m_nextSendId = 0;
+	m_oldestUnackedId = 0;
+	m_nextRecvId = 0;
+	m_hasReceived = false;
+}
+
+bool NetworkEventChannel::queue(const uint8_t * data, uint32_t size)
+{
+	if (size > EVENT_MAX_SIZE || isFull())
+	{
+		return false;
+	}
+
+	Event * event = &m_pending[m_nextSendId % EVENT_QUEUE_SIZE];
+	event->id = m_nextSendId;
+	event->size = size;
+	memcpy(event->data, data, size);
+
+	m_nextSendId++;
+
+	return true;
+}
+
+void NetworkEventChannel::writeSection(BitWriter & writer, uint32_t maxBytes)
+{
+	uint32_t numEvents = 0;
+	uint32_t sectionBits = 16 + 8;
+	uint16_t firstId = m_oldestUnackedId;
+
+	// Work out how many events fit. Sizes are small, so the varints are a byte each
+	for (uint16_t id = m_oldestUnackedId; id != m_nextSendId; id++)
+	{
+		uint32_t eventBits = 8 + m_pending[id % EVENT_QUEUE_SIZE].size * 8;
+
+		if (sectionBits + eventBits > maxBytes * 8)
+		{
+			break;
+		}
+
+		sectionBits += eventBits;
+		numEvents++;
+	}
+
+	serializeInt(writer, firstId, 16);
+	serializeVarint(writer, numEvents);
+
+	for (uint32_t i = 0; i < numEvents; i++)
+	{
+		Event * event = &m_pending[(uint16_t)(firstId + i) % EVENT_QUEUE_SIZE];
+
+		serializeVarint(writer, event->size);
+
+		for (uint32_t j = 0; j < event->size; j++)
+		{
+			writer.writeBits(event->data[j], 8);
+		}
+	}
+}
+
+bool NetworkEventChannel::readSection(BitReader & reader, Event * events, uint32_t maxEvents, uint32_t * numEvents)
+{
+	uint16_t firstId = 0;
+	uint32_t numInSection = 0;
+	Event event;
+
+	*numEvents = 0;
+
+	if (serializeInt(reader, firstId, 16) == false || serializeVarint(reader, numInSection) == false)
+	{
+		return false;
+	}
+
+	for (uint32_t i = 0; i < numInSection; i++)
+	{
+		event.id = (uint16_t)(firstId + i);
+
+		if (serializeVarint(reader, event.size) == false || event.size > EVENT_MAX_SIZE)
+		{
+			return false;
+		}
+
+		for (uint32_t j = 0; j < event.size; j++)
+		{
+			event.data[j] = (uint8_t)reader.readBits(8);
+		}
+
+		if (reader.hasOverflowed())
+		{
+			return false;
+		}
+
+		// Only take the next event in order. Older ones are resends we already have
+		if (event.id != m_nextRecvId || *numEvents >= maxEvents)
+		{
+			continue;
+		}
+
+		events[(*numEvents)++] = event;
+		m_nextRecvId++;
+		m_hasReceived = true;
+	}
+
+	return true;
+}
+
+void NetworkEventChannel::processAck(uint16_t lastIdReceived)
+{
+	uint16_t newOldest = lastIdReceived + 1;
+
+	// Ignore ACKs for things we haven't sent, or that are older than what's already been ACKed
+	if (NetworkSequence::isNewer(newOldest, m_nextSendId) || NetworkSequence::isNewer(m_oldestUnackedId, newOldest))
+	{
+		return;
+	}
+
+	m_oldestUnackedId = newOldest;
+}
+
+bool NetworkEventChannel::getAck(uint16_t * lastIdReceived)
+{
+	if (m_hasReceived == false)
+	{
+		return false;
+	}
+
+	*lastIdReceived = m_nextRecvId - 1;
+	return true;
+}
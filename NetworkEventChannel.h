@@ -0,0 +1,69 @@
+//
+//  NetworkEventChannel.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include "NetworkBitStream.h"
+
+namespace shd
+{
+	// Reliable, ordered events that ride along with the unreliable game packets.
+	// Every packet carries all of the events the other side hasn't ACKed yet, so a lost packet
+	// costs nothing more than waiting for the next one, and there's no separate reliable send to block on
+	class NetworkEventChannel
+	{
+	public:
+
+		static const uint32_t EVENT_MAX_SIZE = 16;
+		static const uint32_t EVENT_QUEUE_SIZE = 64;
+
+		struct Event
+		{
+			uint16_t id;
+			uint32_t size;
+			uint8_t data[EVENT_MAX_SIZE];
+		};
+
+		NetworkEventChannel();
+		void reset();
+
+		// Queue an encoded event to be sent. Returns false if the queue is full
+		bool queue(const uint8_t * data, uint32_t size);
+		inline bool isFull() { return (uint16_t)(m_nextSendId - m_oldestUnackedId) >= EVENT_QUEUE_SIZE; }
+		inline bool hasUnacked() { return m_nextSendId != m_oldestUnackedId; }
+
+		// Write as many unacked events as fit in maxBytes
+		void writeSection(BitWriter & writer, uint32_t maxBytes);
+
+		// Read the events from a packet. Only events we haven't seen before are returned, in the order they were sent
+		bool readSection(BitReader & reader, Event * events, uint32_t maxEvents, uint32_t * numEvents);
+
+		// The other side has received every event up to and including this one
+		void processAck(uint16_t lastIdReceived);
+
+		// What we should ACK back. Returns false if we haven't received any events yet
+		bool getAck(uint16_t * lastIdReceived);
+
+	private:
+
+		// Events waiting to be ACKed, indexed by id
+		Event m_pending[EVENT_QUEUE_SIZE];
+
+		// Id of the next event to be queued
+		uint16_t m_nextSendId;
+
+		// Id of the oldest event the other side hasn't ACKed
+		uint16_t m_oldestUnackedId;
+
+		// Id of the next event we expect to receive
+		uint16_t m_nextRecvId;
+
+		// Have we received anything yet
+		bool m_hasReceived;
+	};
+}
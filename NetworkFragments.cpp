@@ -0,0 +1,128 @@
+//
+//  NetworkFragments.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkFragments.h"
+#include "Common.h"
+
+using namespace shd;
+
+NetworkFragmentReassembler::NetworkFragmentReassembler()
+{
+	reset();
+}
+
+void NetworkFragmentReassembler::reset()
+{
+	for (int i = 0; i < REASSEMBLY_WINDOW_SIZE; i++)
+	{
+		m_slots[i].inUse = false;
+	}
+
+	m_numEvicted = 0;
+	m_numReassembled = 0;
+}
+
+bool NetworkFragmentReassembler::addFragment(uint16_t sequenceNum, uint8_t fragmentDetails, const uint8_t * data, uint32_t size, uint64_t timeUs, const uint8_t ** packet, uint32_t * packetSize)
+{
+	uint32_t numFragments = getNumFragments(fragmentDetails);
+	uint32_t fragmentIndex = getFragmentIndex(fragmentDetails);
+	Slot * slot = nullptr;
+	Slot * oldestSlot = nullptr;
+
+	// Sanity check the fragment. All fragments apart from the last one are full
+	if (numFragments < 2 || numFragments > MAX_FRAGMENTS || fragmentIndex >= numFragments || size == 0 || size > FRAGMENT_DATA_MAX_SIZE)
+	{
+		return false;
+	}
+
+	if (fragmentIndex < numFragments - 1 && size != FRAGMENT_DATA_MAX_SIZE)
+	{
+		return false;
+	}
+
+	// Find the packet this fragment belongs to
+	for (int i = 0; i < REASSEMBLY_WINDOW_SIZE; i++)
+	{
+		if (m_slots[i].inUse && m_slots[i].sequenceNum == sequenceNum)
+		{
+			slot = &m_slots[i];
+			break;
+		}
+	}
+
+	// Otherwise start a new one, throwing away the oldest packet if the window is full
+	if (slot == nullptr)
+	{
+		for (int i = 0; i < REASSEMBLY_WINDOW_SIZE; i++)
+		{
+			if (m_slots[i].inUse == false)
+			{
+				slot = &m_slots[i];
+				break;
+			}
+
+			if (oldestSlot == nullptr || m_slots[i].firstFragmentTimeUs < oldestSlot->firstFragmentTimeUs)
+			{
+				oldestSlot = &m_slots[i];
+			}
+		}
+
+		if (slot == nullptr)
+		{
+			slot = oldestSlot;
+			m_numEvicted++;
+		}
+
+		slot->inUse = true;
+		slot->sequenceNum = sequenceNum;
+		slot->numFragments = (uint8_t)numFragments;
+		slot->receivedMask = 0;
+		slot->lastFragmentSize = 0;
+		slot->firstFragmentTimeUs = timeUs;
+	}
+
+	if (slot->numFragments != numFragments || (slot->receivedMask & (1 << fragmentIndex)))
+	{
+		// Duplicate, or doesn't match what we have so far
+		return false;
+	}
+
+	memcpy(slot->data + fragmentIndex * FRAGMENT_DATA_MAX_SIZE, data, size);
+	slot->receivedMask |= (1 << fragmentIndex);
+
+	if (fragmentIndex == numFragments - 1)
+	{
+		slot->lastFragmentSize = size;
+	}
+
+	if (slot->receivedMask != (1 << numFragments) - 1)
+	{
+		return false;
+	}
+
+	// All fragments are here. The slot can be reused from now on, but the data stays put until then
+	slot->inUse = false;
+	m_numReassembled++;
+
+	*packet = slot->data;
+	*packetSize = (numFragments - 1) * FRAGMENT_DATA_MAX_SIZE + slot->lastFragmentSize;
+
+	return true;
+}
+
+void NetworkFragmentReassembler::evictExpired(uint64_t timeUs)
+{
+	for (int i = 0; i < REASSEMBLY_WINDOW_SIZE; i++)
+	{
+		if (m_slots[i].inUse && timeUs - m_slots[i].firstFragmentTimeUs > REASSEMBLY_TIMEOUT_US)
+		{
+			m_slots[i].inUse = false;
+			m_numEvicted++;
+		}
+	}
+}
@@ -0,0 +1,66 @@
+//
+//  NetworkFragments.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+namespace shd
+{
+	// Puts packets that were split into fragments back together again.
+	// Only a few packets can be in flight at once, and any that don't complete in time are thrown away
+	class NetworkFragmentReassembler
+	{
+	public:
+
+		static const int FRAGMENT_DATA_MAX_SIZE = 1024;
+		static const int MAX_FRAGMENTS = 4;
+		static const int REASSEMBLY_WINDOW_SIZE = 8;
+		static const uint64_t REASSEMBLY_TIMEOUT_US = 250 * 1000;
+
+		// fragmentDetails is packed as: top 4 bits are the number of fragments, bottom 4 bits are the fragment index
+		static inline uint8_t packFragmentDetails(uint32_t numFragments, uint32_t fragmentIndex) { return (uint8_t)((numFragments << 4) | (fragmentIndex & 0x0F)); }
+		static inline uint32_t getNumFragments(uint8_t fragmentDetails) { return fragmentDetails >> 4; }
+		static inline uint32_t getFragmentIndex(uint8_t fragmentDetails) { return fragmentDetails & 0x0F; }
+
+		NetworkFragmentReassembler();
+
+		// Add a received fragment. When it completes a packet, returns true and points packet at the reassembled data.
+		// The reassembled data is only valid until the next call to addFragment
+		bool addFragment(uint16_t sequenceNum, uint8_t fragmentDetails, const uint8_t * data, uint32_t size, uint64_t timeUs, const uint8_t ** packet, uint32_t * packetSize);
+
+		// Throw away any packets that have been waiting on fragments for too long
+		void evictExpired(uint64_t timeUs);
+
+		void reset();
+		inline uint32_t getNumEvicted() { return m_numEvicted; }
+		inline uint32_t getNumReassembled() { return m_numReassembled; }
+
+	private:
+
+		struct Slot
+		{
+			bool inUse;
+			uint16_t sequenceNum;
+			uint8_t numFragments;
+			uint8_t receivedMask;
+			uint32_t lastFragmentSize;
+			uint64_t firstFragmentTimeUs;
+			uint8_t data[FRAGMENT_DATA_MAX_SIZE * MAX_FRAGMENTS];
+		};
+
+		// Packets that are currently being put back together
+		Slot m_slots[REASSEMBLY_WINDOW_SIZE];
+
+		// Number of incomplete packets that were thrown away
+		uint32_t m_numEvicted;
+
+		// Number of packets that were put back together
+		uint32_t m_numReassembled;
+	};
+}
@@ -0,0 +1,74 @@
+//
+//  NetworkGameEventQueue.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkGameEventQueue.h"
+#include "Common.h"
+
+using namespace shd;
+
+NetworkGameEventQueue::NetworkGameEventQueue()
+{
+	reset();
+}
+
+void NetworkGameEventQueue::reset()
+{
+	m_writeIndex = 0;
+	m_readIndex = 0;
+	m_nextOrder = 0;
+	m_numDropped = 0;
+}
+
+bool NetworkGameEventQueue::push(const NetworkTransportHandler::GameEvent & event, uint64_t receiveTimeUs)
+{
+	uint32_t writeIndex = m_writeIndex;
+	uint32_t order = m_nextOrder++;
+
+	if (writeIndex - m_readIndex >= QUEUE_SIZE)
+	{
+		SHD_PRINTF("Game event queue is full!\n");
+		Atomic::add32(&m_numDropped, 1);
+		return false;
+	}
+
+	Entry & entry = m_entries[writeIndex % QUEUE_SIZE];
+	entry.order = order;
+	entry.receiveTimeUs = receiveTimeUs;
+	entry.event = event;
+
+	// Publish the slot only after it has been filled
+	Atomic::exchange32(&m_writeIndex, writeIndex + 1);
+
+	return true;
+}
+
+bool NetworkGameEventQueue::pop(Entry * entry)
+{
+	return drain(entry, 1) == 1;
+}
+
+uint32_t NetworkGameEventQueue::drain(Entry * entries, uint32_t maxEntries)
+{
+	uint32_t readIndex = m_readIndex;
+	uint32_t writeIndex = m_writeIndex;
+	uint32_t numRead = 0;
+
+	while (readIndex != writeIndex && numRead < maxEntries)
+	{
+		entries[numRead++] = m_entries[readIndex % QUEUE_SIZE];
+		readIndex++;
+	}
+
+	// Give the slots back to the network thread, all at once
+	if (numRead)
+	{
+		Atomic::exchange32(&m_readIndex, readIndex);
+	}
+
+	return numRead;
+}
@@ -0,0 +1,69 @@
+//
+//  NetworkGameEventQueue.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include "NetworkTransportHandler.h"
+
+namespace shd
+{
+	// Hands special events the other side sent us from the network thread to the game thread, in the order they
+	// arrived, each with the time it arrived. Nothing is merged, so two goals before the game thread looks are still
+	// two goals, and an event's fields can't be half written when it's read.
+	// Single producer, single consumer, no locks: push() is only called from the network thread, and pop() and
+	// drain() only from the game thread
+	class NetworkGameEventQueue
+	{
+	public:
+
+		// Far more than can arrive in one tick
+		static const uint32_t QUEUE_SIZE = 64;
+
+		struct Entry
+		{
+			uint32_t order;									// Counts up by one for every event pushed, so a gap means some were dropped
+			uint64_t receiveTimeUs;							// From NetworkClock::getTimeMicroseconds()
+			NetworkTransportHandler::GameEvent event;
+		};
+
+		NetworkGameEventQueue();
+
+		// Forget everything. Only when neither thread is using it
+		void reset();
+
+		// Add an event. Returns false, and counts it as dropped, if the game thread has fallen that far behind
+		bool push(const NetworkTransportHandler::GameEvent & event, uint64_t receiveTimeUs);
+
+		// Take the oldest event
+		bool pop(Entry * entry);
+
+		// Take every waiting event, up to maxEntries, oldest first. Call once a tick
+		uint32_t drain(Entry * entries, uint32_t maxEntries);
+
+		inline uint32_t getNumWaiting() { return m_writeIndex - m_readIndex; }
+
+		// Events that didn't fit
+		inline uint32_t getNumDropped() { return m_numDropped; }
+
+	private:
+
+		// Disable copying
+		NetworkGameEventQueue(const NetworkGameEventQueue &);
+		NetworkGameEventQueue & operator=(const NetworkGameEventQueue &);
+
+		Entry m_entries[QUEUE_SIZE];
+
+		// Only ever count up. Each is written by one thread and read by the other
+		volatile uint32_t m_writeIndex;
+		volatile uint32_t m_readIndex;
+
+		// Written by the network thread
+		uint32_t m_nextOrder;
+		volatile uint32_t m_numDropped;
+	};
+}
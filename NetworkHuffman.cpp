@@ -0,0 +1,537 @@
+//
+//  NetworkHuffman.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkHuffman.h"
+#include "NetworkCapture.h"
+#include "NetworkClock.h"
+#include "Common.h"
+#include <stdio.h>
+#include <string.h>
+
+using namespace shd;
+
+// The benchmark goes through the packets this many times each way, so the timings aren't just noise
+#define SHD_HUFFMAN_BENCHMARK_REPEATS 100
+
+// Work out the Huffman code length of each symbol, with the usual pairing of the two lightest nodes. Only ever
+// done offline, so a simple search for the lightest nodes is quick enough. Returns the longest length
+static uint32_t buildCodeLengths(const uint64_t * weights, uint8_t * lengths)
+{
+	const uint32_t numSymbols = NetworkHuffmanModel::NUM_SYMBOLS;
+	uint64_t nodeWeights[numSymbols * 2];
+	uint32_t parents[numSymbols * 2];
+	bool isActive[numSymbols * 2];
+	uint32_t numNodes = numSymbols;
+	uint32_t maxLength = 0;
+
+	for (uint32_t i = 0; i < numSymbols; i++)
+	{
+		nodeWeights[i] = weights[i];
+		parents[i] = 0;
+		isActive[i] = true;
+	}
+
+	// Every merge makes a new node from the two lightest ones, until there's only the root left
+	while (numNodes < numSymbols * 2 - 1)
+	{
+		uint32_t lightest[2] = { 0, 0 };
+
+		for (uint32_t pick = 0; pick < 2; pick++)
+		{
+			bool found = false;
+
+			for (uint32_t i = 0; i < numNodes; i++)
+			{
+				if (isActive[i] && (found == false || nodeWeights[i] < nodeWeights[lightest[pick]]))
+				{
+					lightest[pick] = i;
+					found = true;
+				}
+			}
+
+			isActive[lightest[pick]] = false;
+			parents[lightest[pick]] = numNodes;
+		}
+
+		nodeWeights[numNodes] = nodeWeights[lightest[0]] + nodeWeights[lightest[1]];
+		parents[numNodes] = 0;
+		isActive[numNodes] = true;
+		numNodes++;
+	}
+
+	for (uint32_t i = 0; i < numSymbols; i++)
+	{
+		uint32_t length = 0;
+
+		for (uint32_t node = i; node != numNodes - 1; node = parents[node])
+		{
+			length++;
+		}
+
+		lengths[i] = (uint8_t)((length < 0xFF) ? length : 0xFF);
+		maxLength = (length > maxLength) ? length : maxLength;
+	}
+
+	return maxLength;
+}
+
+NetworkHuffmanModel::NetworkHuffmanModel() : m_isValid(false)
+{
+	memset(m_lengths, 0, sizeof(m_lengths));
+	memset(m_codes, 0, sizeof(m_codes));
+	memset(m_decodeTable, 0, sizeof(m_decodeTable));
+}
+
+bool NetworkHuffmanModel::build(const uint32_t * counts)
+{
+	uint64_t weights[NUM_SYMBOLS];
+
+	// Plus one, so bytes that were never seen can still be sent
+	for (uint32_t i = 0; i < NUM_SYMBOLS; i++)
+	{
+		weights[i] = (uint64_t)counts[i] + 1;
+	}
+
+	// Rare bytes can end up with codes longer than the decode table. Flattening the weights and building again
+	// shortens them, for a tiny loss in compression
+	while (buildCodeLengths(weights, m_lengths) > MAX_CODE_LENGTH)
+	{
+		for (uint32_t i = 0; i < NUM_SYMBOLS; i++)
+		{
+			weights[i] = (weights[i] >> 1) | 1;
+		}
+	}
+
+	return buildCodes();
+}
+
+bool NetworkHuffmanModel::setCodeLengths(const uint8_t * lengths)
+{
+	memcpy(m_lengths, lengths, NUM_SYMBOLS);
+
+	return buildCodes();
+}
+
+bool NetworkHuffmanModel::buildCodes()
+{
+	uint32_t lengthCounts[MAX_CODE_LENGTH + 1];
+	uint32_t nextCode[MAX_CODE_LENGTH + 1];
+	uint32_t kraftSum = 0;
+	uint32_t code = 0;
+
+	m_isValid = false;
+	memset(lengthCounts, 0, sizeof(lengthCounts));
+
+	// Every byte needs a code, and together they have to use up every bit pattern exactly, or the decode table
+	// would have holes in it
+	for (uint32_t i = 0; i < NUM_SYMBOLS; i++)
+	{
+		if (m_lengths[i] == 0 || m_lengths[i] > MAX_CODE_LENGTH)
+		{
+			return false;
+		}
+
+		lengthCounts[m_lengths[i]]++;
+		kraftSum += 1u << (MAX_CODE_LENGTH - m_lengths[i]);
+	}
+
+	if (kraftSum != (1u << MAX_CODE_LENGTH))
+	{
+		return false;
+	}
+
+	// Canonical codes, so the lengths are all that needs storing
+	for (uint32_t length = 1; length <= MAX_CODE_LENGTH; length++)
+	{
+		code = (code + lengthCounts[length - 1]) << 1;
+		nextCode[length] = code;
+	}
+
+	for (uint32_t i = 0; i < NUM_SYMBOLS; i++)
+	{
+		uint32_t length = m_lengths[i];
+		uint32_t canonical = nextCode[length]++;
+		uint32_t reversed = 0;
+
+		for (uint32_t bit = 0; bit < length; bit++)
+		{
+			reversed |= ((canonical >> bit) & 1) << (length - 1 - bit);
+		}
+
+		m_codes[i] = (uint16_t)reversed;
+
+		// Every pattern of the table's bits that starts with this code decodes to this byte
+		for (uint32_t entry = reversed; entry < (1u << MAX_CODE_LENGTH); entry += 1u << length)
+		{
+			m_decodeTable[entry] = (uint16_t)((i << 4) | length);
+		}
+	}
+
+	m_isValid = true;
+
+	return true;
+}
+
+bool NetworkHuffmanModel::trainFromCapture(const char * captureFilename)
+{
+	NetworkCaptureReplay replay;
+	uint32_t counts[NUM_SYMBOLS];
+	const uint8_t * packet = nullptr;
+	uint32_t size = 0;
+	uint32_t numPackets = 0;
+	NetworkCapture::Direction direction;
+
+	if (replay.init(captureFilename) == false)
+	{
+		return false;
+	}
+
+	memset(counts, 0, sizeof(counts));
+
+	while (replay.nextRecord(&packet, &size, &direction))
+	{
+		countBytes(packet, size, counts);
+		numPackets++;
+	}
+
+	if (numPackets == 0)
+	{
+		SHD_PRINTF("No packets in %s to train on\n", captureFilename);
+		return false;
+	}
+
+	return build(counts);
+}
+
+void NetworkHuffmanModel::countBytes(const uint8_t * data, uint32_t size, uint32_t * counts)
+{
+	for (uint32_t i = 0; i < size; i++)
+	{
+		counts[data[i]]++;
+	}
+}
+
+bool NetworkHuffmanModel::load(const char * filename)
+{
+	uint32_t magic = 0;
+	uint8_t lengths[NUM_SYMBOLS];
+	FILE * file = fopen(filename, "rb");
+
+	if (file == nullptr)
+	{
+		SHD_PRINTF("Couldn't open model file %s\n", filename);
+		return false;
+	}
+
+	if (fread(&magic, sizeof(magic), 1, file) != 1 || magic != MODEL_MAGIC || fread(lengths, 1, NUM_SYMBOLS, file) != NUM_SYMBOLS)
+	{
+		SHD_PRINTF("%s isn't a model file we can read\n", filename);
+		fclose(file);
+		return false;
+	}
+
+	fclose(file);
+
+	return setCodeLengths(lengths);
+}
+
+bool NetworkHuffmanModel::save(const char * filename)
+{
+	uint32_t magic = MODEL_MAGIC;
+	bool ret = true;
+	FILE * file = nullptr;
+
+	if (m_isValid == false)
+	{
+		return false;
+	}
+
+	file = fopen(filename, "wb");
+	if (file == nullptr)
+	{
+		SHD_PRINTF("Couldn't open model file %s\n", filename);
+		return false;
+	}
+
+	if (fwrite(&magic, sizeof(magic), 1, file) != 1 || fwrite(m_lengths, 1, NUM_SYMBOLS, file) != NUM_SYMBOLS)
+	{
+		SHD_PRINTF("Failed to write model file %s\n", filename);
+		ret = false;
+	}
+
+	fclose(file);
+
+	return ret;
+}
+
+bool NetworkHuffmanModel::encode(const uint8_t * src, uint32_t size, uint8_t * dst, uint32_t dstCapacity, uint32_t * encodedSize)
+{
+	uint64_t bits = 0;
+	uint32_t numBits = 0;
+	uint32_t bytesWritten = SIZE_PREFIX_BYTES;
+
+	if (m_isValid == false || size > 0xFFFF || dstCapacity < SIZE_PREFIX_BYTES)
+	{
+		return false;
+	}
+
+	dst[0] = (uint8_t)size;
+	dst[1] = (uint8_t)(size >> 8);
+
+	for (uint32_t i = 0; i < size; i++)
+	{
+		bits |= (uint64_t)m_codes[src[i]] << numBits;
+		numBits += m_lengths[src[i]];
+
+		while (numBits >= 8)
+		{
+			if (bytesWritten == dstCapacity)
+			{
+				return false;
+			}
+
+			dst[bytesWritten++] = (uint8_t)bits;
+			bits >>= 8;
+			numBits -= 8;
+		}
+	}
+
+	if (numBits)
+	{
+		if (bytesWritten == dstCapacity)
+		{
+			return false;
+		}
+
+		dst[bytesWritten++] = (uint8_t)bits;
+	}
+
+	*encodedSize = bytesWritten;
+
+	return true;
+}
+
+bool NetworkHuffmanModel::decode(const uint8_t * src, uint32_t size, uint8_t * dst, uint32_t dstCapacity, uint32_t * decodedSize)
+{
+	uint64_t bits = 0;
+	uint32_t numBits = 0;
+	uint32_t bytesRead = SIZE_PREFIX_BYTES;
+	uint32_t numSymbols = 0;
+
+	if (m_isValid == false || size < SIZE_PREFIX_BYTES)
+	{
+		return false;
+	}
+
+	numSymbols = (uint32_t)src[0] | ((uint32_t)src[1] << 8);
+
+	if (numSymbols > dstCapacity)
+	{
+		return false;
+	}
+
+	for (uint32_t i = 0; i < numSymbols; i++)
+	{
+		uint32_t entry = 0;
+
+		// Top up with whole bytes. Past the end it's zeros, and whether they were used is checked at the end
+		while (numBits <= 56)
+		{
+			bits |= (uint64_t)((bytesRead < size) ? src[bytesRead] : 0) << numBits;
+			bytesRead++;
+			numBits += 8;
+		}
+
+		entry = m_decodeTable[bits & ((1u << MAX_CODE_LENGTH) - 1)];
+
+		if ((entry & 0xF) == 0)
+		{
+			return false;
+		}
+
+		dst[i] = (uint8_t)(entry >> 4);
+		bits >>= entry & 0xF;
+		numBits -= entry & 0xF;
+	}
+
+	// Ran off the end
+	if ((uint64_t)(bytesRead - SIZE_PREFIX_BYTES) * 8 - numBits > (uint64_t)(size - SIZE_PREFIX_BYTES) * 8)
+	{
+		return false;
+	}
+
+	*decodedSize = numSymbols;
+
+	return true;
+}
+
+bool NetworkHuffmanModel::runBenchmark(const char * captureFilename)
+{
+	NetworkCaptureReplay replay;
+	NetworkHuffmanModel model;
+	NetworkCapture::Direction direction;
+	uint32_t counts[NUM_SYMBOLS];
+	uint8_t decoded[0x10000];
+	uint8_t * encoded = nullptr;
+	uint32_t * encodedSizes = nullptr;
+	const uint8_t * packet = nullptr;
+	uint32_t size = 0;
+	uint32_t numPackets = 0;
+	uint32_t numTrainingPackets = 0;
+	uint32_t numSmaller = 0;
+	int64_t originalBytes = 0;
+	int64_t encodedBytes = 0;
+	int64_t sentBytes = 0;
+	uint64_t encodeUs = 0;
+	uint64_t decodeUs = 0;
+	uint32_t offset = 0;
+	uint32_t encodedSize = 0;
+	uint32_t decodedSize = 0;
+	bool ret = true;
+
+	if (replay.init(captureFilename) == false)
+	{
+		return false;
+	}
+
+	// Train on the first half, and measure on the second, so the model isn't judged on the packets it learned from
+	while (replay.nextRecord(&packet, &size, &direction))
+	{
+		numPackets++;
+	}
+
+	numTrainingPackets = numPackets / 2;
+	numPackets -= numTrainingPackets;
+
+	if (numTrainingPackets == 0)
+	{
+		SHD_PRINTF("Not enough packets in %s to benchmark\n", captureFilename);
+		return false;
+	}
+
+	memset(counts, 0, sizeof(counts));
+	replay.rewind();
+
+	for (uint32_t i = 0; i < numTrainingPackets && replay.nextRecord(&packet, &size, &direction); i++)
+	{
+		countBytes(packet, size, counts);
+	}
+
+	if (model.build(counts) == false)
+	{
+		return false;
+	}
+
+	// A code is never longer than MAX_CODE_LENGTH bits, so no packet can grow by more than that
+	for (uint32_t i = 0; replay.nextRecord(&packet, &size, &direction); i++)
+	{
+		originalBytes += size;
+	}
+
+	encoded = (uint8_t *)SHD_MALLOC((size_t)originalBytes * MAX_CODE_LENGTH / 8 + (size_t)numPackets * (SIZE_PREFIX_BYTES + 1));
+	encodedSizes = (uint32_t *)SHD_MALLOC(sizeof(uint32_t) * numPackets);
+
+	if (encoded == nullptr || encodedSizes == nullptr)
+	{
+		ret = false;
+	}
+
+	// Check everything comes back the same, and keep the encoded packets for timing the decode
+	replay.rewind();
+
+	for (uint32_t i = 0; ret && replay.nextRecord(&packet, &size, &direction); i++)
+	{
+		if (i < numTrainingPackets)
+		{
+			continue;
+		}
+
+		if (model.encode(packet, size, encoded + offset, size * MAX_CODE_LENGTH / 8 + SIZE_PREFIX_BYTES + 1, &encodedSize) == false ||
+			model.decode(encoded + offset, encodedSize, decoded, sizeof(decoded), &decodedSize) == false ||
+			decodedSize != size || memcmp(packet, decoded, size) != 0)
+		{
+			SHD_PRINTF("Packet %u didn't survive encoding!\n", i);
+			ret = false;
+			break;
+		}
+
+		encodedSizes[i - numTrainingPackets] = encodedSize;
+		offset += encodedSize;
+		encodedBytes += encodedSize;
+
+		// NetworkTransport only sends it compressed when that's smaller, with its own byte of header
+		if (encodedSize + 1 < size)
+		{
+			sentBytes += encodedSize + 1;
+			numSmaller++;
+		}
+		else
+		{
+			sentBytes += size;
+		}
+	}
+
+	if (ret)
+	{
+		uint64_t startUs = NetworkClock::getTimeMicroseconds();
+
+		for (uint32_t repeat = 0; repeat < SHD_HUFFMAN_BENCHMARK_REPEATS; repeat++)
+		{
+			replay.rewind();
+
+			for (uint32_t i = 0; replay.nextRecord(&packet, &size, &direction); i++)
+			{
+				if (i >= numTrainingPackets)
+				{
+					model.encode(packet, size, decoded, sizeof(decoded), &encodedSize);
+				}
+			}
+		}
+
+		encodeUs = NetworkClock::getTimeMicroseconds() - startUs;
+		startUs = NetworkClock::getTimeMicroseconds();
+
+		for (uint32_t repeat = 0; repeat < SHD_HUFFMAN_BENCHMARK_REPEATS; repeat++)
+		{
+			offset = 0;
+
+			for (uint32_t i = 0; i < numPackets; i++)
+			{
+				model.decode(encoded + offset, encodedSizes[i], decoded, sizeof(decoded), &decodedSize);
+				offset += encodedSizes[i];
+			}
+		}
+
+		decodeUs = NetworkClock::getTimeMicroseconds() - startUs;
+
+		SHD_PRINTF("%u packets, %lld bytes encoded to %lld (%.1f%%), %u of them smaller. With the transport's fallback %lld bytes would be sent (%.1f%%)\n",
+			numPackets,
+			(long long)originalBytes,
+			(long long)encodedBytes,
+			(originalBytes) ? 100.0 * (double)encodedBytes / (double)originalBytes : 0.0,
+			numSmaller,
+			(long long)sentBytes,
+			(originalBytes) ? 100.0 * (double)sentBytes / (double)originalBytes : 0.0);
+
+		SHD_PRINTF("%.0f ns to encode a packet, %.0f ns to decode one\n",
+			1000.0 * (double)encodeUs / ((double)numPackets * SHD_HUFFMAN_BENCHMARK_REPEATS),
+			1000.0 * (double)decodeUs / ((double)numPackets * SHD_HUFFMAN_BENCHMARK_REPEATS));
+	}
+
+	if (encoded)
+	{
+		SHD_FREE(encoded);
+	}
+
+	if (encodedSizes)
+	{
+		SHD_FREE(encodedSizes);
+	}
+
+	return ret;
+}
@@ -0,0 +1,78 @@
+//
+//  NetworkHuffman.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+namespace shd
+{
+	// A fixed Huffman code for packet bytes, trained offline from captured traffic. Packets are small and look much the
+	// same as each other, so there's nothing for an adaptive coder to learn from inside one packet, but a code that
+	// already knows which bytes turn up most can still squeeze them. Both peers must use the same model.
+	// Codes are at most MAX_CODE_LENGTH bits, so decoding is one table lookup per byte.
+	// A model is only ever read once it's built, so one can be shared between threads
+	class NetworkHuffmanModel
+	{
+	public:
+
+		static const uint32_t NUM_SYMBOLS = 256;
+		static const uint32_t MAX_CODE_LENGTH = 12;
+
+		// Model files are this, then NUM_SYMBOLS code lengths, one byte each
+		static const uint32_t MODEL_MAGIC = 0x46465548;	// "HUFF"
+
+		// Encoded data starts with the decoded size, in this many bytes
+		static const uint32_t SIZE_PREFIX_BYTES = 2;
+
+		NetworkHuffmanModel();
+
+		// Build the code from how many times each byte turned up. Every byte gets a code, even ones that never did
+		bool build(const uint32_t * counts);
+
+		// Build the code from every packet in a capture file. Record it with compression turned off
+		bool trainFromCapture(const char * captureFilename);
+
+		// Use code lengths that came from getCodeLengths(), like a model built into the game
+		bool setCodeLengths(const uint8_t * lengths);
+		inline const uint8_t * getCodeLengths() { return m_lengths; }
+		inline bool isValid() { return m_isValid; }
+
+		bool load(const char * filename);
+		bool save(const char * filename);
+
+		// Encode size bytes of src into dst. Returns false if it wouldn't fit in dstCapacity, so pass one less than the
+		// original size to only get output that's smaller
+		bool encode(const uint8_t * src, uint32_t size, uint8_t * dst, uint32_t dstCapacity, uint32_t * encodedSize);
+
+		// Decode what encode() wrote. Returns false if it's corrupt, or won't fit in dstCapacity
+		bool decode(const uint8_t * src, uint32_t size, uint8_t * dst, uint32_t dstCapacity, uint32_t * decodedSize);
+
+		// Count the bytes in data, adding to counts
+		static void countBytes(const uint8_t * data, uint32_t size, uint32_t * counts);
+
+		// Train a model on the first half of the packets in a capture, then encode and decode the second half, and
+		// print the compression ratio and the time per packet each way
+		static bool runBenchmark(const char * captureFilename);
+
+	private:
+
+		// Turn code lengths into codes and the decode table
+		bool buildCodes();
+
+		// Code length of each byte, and its code with the bits reversed, since the bit stream is least significant first
+		uint8_t m_lengths[NUM_SYMBOLS];
+		uint16_t m_codes[NUM_SYMBOLS];
+
+		// Indexed by the next MAX_CODE_LENGTH bits of input. Each entry is the byte in the top bits, and how many bits
+		// its code is in the bottom 4. Zero length means the bits aren't a valid code
+		uint16_t m_decodeTable[1 << MAX_CODE_LENGTH];
+
+		bool m_isValid;
+	};
+}
@@ -0,0 +1,179 @@
+//
+//  NetworkInputRedundancy.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkInputRedundancy.h"
+#include "Common.h"
+
+using namespace shd;
+
+// Payloads are sent as an offset back from the packet they ride along with, from 1 to REDUNDANCY_WINDOW_SIZE
+static const uint32_t OFFSET_BITS = BitsRequired<NetworkInputRedundancy::REDUNDANCY_WINDOW_SIZE - 1>::value;
+
+NetworkInputRedundancy::NetworkInputRedundancy()
+{
+	reset();
+}
+
+void NetworkInputRedundancy::reset()
+{
+	for (uint32_t i = 0; i < REDUNDANCY_WINDOW_SIZE; i++)
+	{
+		m_slots[i].valid = false;
+		m_slots[i].acked = false;
+	}
+}
+
+NetworkInputRedundancy::Slot * NetworkInputRedundancy::findSlot(uint16_t sequenceNum)
+{
+	Slot * slot = &m_slots[sequenceNum % REDUNDANCY_WINDOW_SIZE];
+
+	if (slot->valid == false || slot->payload.sequenceNum != sequenceNum)
+	{
+		return nullptr;
+	}
+
+	return slot;
+}
+
+void NetworkInputRedundancy::store(uint16_t sequenceNum, const uint8_t * data, uint32_t size)
+{
+	Slot * slot = &m_slots[sequenceNum % REDUNDANCY_WINDOW_SIZE];
+
+	// Too big to resend, so make sure an old payload doesn't go out in its place
+	if (size > PAYLOAD_MAX_SIZE)
+	{
+		slot->valid = false;
+		return;
+	}
+
+	slot->valid = true;
+	slot->acked = false;
+	slot->payload.sequenceNum = sequenceNum;
+	slot->payload.size = size;
+	memcpy(slot->payload.data, data, size);
+}
+
+void NetworkInputRedundancy::processAck(uint16_t lastSequenceReceived, uint32_t ackBits)
+{
+	Slot * slot = findSlot(lastSequenceReceived);
+
+	if (slot)
+	{
+		slot->acked = true;
+	}
+
+	for (uint32_t i = 0; i < 32; i++)
+	{
+		if ((ackBits & (1u << i)) && (slot = findSlot((uint16_t)(lastSequenceReceived - 1 - i))) != nullptr)
+		{
+			slot->acked = true;
+		}
+	}
+}
+
+bool NetworkInputRedundancy::hasUnacked(uint16_t sequenceNum)
+{
+	for (uint32_t offset = 1; offset <= REDUNDANCY_WINDOW_SIZE; offset++)
+	{
+		Slot * slot = findSlot((uint16_t)(sequenceNum - offset));
+
+		if (slot && slot->acked == false)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void NetworkInputRedundancy::writeSection(BitWriter & writer, uint16_t sequenceNum, uint32_t maxBytes)
+{
+	Slot * chosen[MAX_REDUNDANT_PAYLOADS];
+	uint32_t numChosen = 0;
+	uint32_t sectionBits = 8;
+
+	// Newest first, since those are the ones the jitter buffer will need soonest
+	for (uint32_t offset = 1; offset <= REDUNDANCY_WINDOW_SIZE && numChosen < MAX_REDUNDANT_PAYLOADS; offset++)
+	{
+		Slot * slot = findSlot((uint16_t)(sequenceNum - offset));
+
+		if (slot == nullptr || slot->acked)
+		{
+			continue;
+		}
+
+		// Offset, a size varint of up to two bytes, and the data
+		uint32_t payloadBits = OFFSET_BITS + 16 + slot->payload.size * 8;
+
+		if (sectionBits + payloadBits > maxBytes * 8)
+		{
+			break;
+		}
+
+		sectionBits += payloadBits;
+		chosen[numChosen++] = slot;
+	}
+
+	serializeVarint(writer, numChosen);
+
+	// Written oldest first, so they can be applied in order
+	for (uint32_t i = numChosen; i > 0; i--)
+	{
+		Payload & payload = chosen[i - 1]->payload;
+		uint32_t offset = (uint16_t)(sequenceNum - payload.sequenceNum) - 1;
+
+		serializeInt(writer, offset, OFFSET_BITS);
+		serializeVarint(writer, payload.size);
+
+		for (uint32_t j = 0; j < payload.size; j++)
+		{
+			writer.writeBits(payload.data[j], 8);
+		}
+	}
+}
+
+bool NetworkInputRedundancy::readSection(BitReader & reader, uint16_t sequenceNum, Payload * payloads, uint32_t maxPayloads, uint32_t * numPayloads)
+{
+	uint32_t numInSection = 0;
+
+	*numPayloads = 0;
+
+	if (serializeVarint(reader, numInSection) == false || numInSection > maxPayloads)
+	{
+		return false;
+	}
+
+	for (uint32_t i = 0; i < numInSection; i++)
+	{
+		Payload & payload = payloads[i];
+		uint32_t offset = 0;
+
+		if (serializeInt(reader, offset, OFFSET_BITS) == false ||
+			serializeVarint(reader, payload.size) == false ||
+			payload.size > PAYLOAD_MAX_SIZE)
+		{
+			return false;
+		}
+
+		payload.sequenceNum = (uint16_t)(sequenceNum - offset - 1);
+
+		for (uint32_t j = 0; j < payload.size; j++)
+		{
+			payload.data[j] = (uint8_t)reader.readBits(8);
+		}
+
+		if (reader.hasOverflowed())
+		{
+			return false;
+		}
+	}
+
+	*numPayloads = numInSection;
+
+	return true;
+}
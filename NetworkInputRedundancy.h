@@ -0,0 +1,71 @@
+//
+//  NetworkInputRedundancy.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include "NetworkBitStream.h"
+
+namespace shd
+{
+	// Keeps the input payloads of recent game packets, and sends copies of the ones the other side hasn't ACKed
+	// along with each new packet. When a packet is lost, its inputs turn up in the next one, so the jitter buffer
+	// gets refilled straight away instead of waiting a round trip
+	class NetworkInputRedundancy
+	{
+	public:
+
+		// How far back a payload can be resent. Matches the 32 packets covered by the ACK bitfield
+		static const uint32_t REDUNDANCY_WINDOW_SIZE = 32;
+
+		// How many old payloads go out with each packet
+		static const uint32_t MAX_REDUNDANT_PAYLOADS = 3;
+
+		// Payloads bigger than this aren't kept. Standard packets are only a few input frames
+		static const uint32_t PAYLOAD_MAX_SIZE = 256;
+
+		struct Payload
+		{
+			uint16_t sequenceNum;
+			uint32_t size;
+			uint8_t data[PAYLOAD_MAX_SIZE];
+		};
+
+		NetworkInputRedundancy();
+		void reset();
+
+		// Keep a copy of the payload sent in this packet, so it can be sent again
+		void store(uint16_t sequenceNum, const uint8_t * data, uint32_t size);
+
+		// The other side has received lastSequenceReceived, and each packet before it that has its bit set in ackBits
+		void processAck(uint16_t lastSequenceReceived, uint32_t ackBits);
+
+		// Is there anything unACKed that could go out with this packet
+		bool hasUnacked(uint16_t sequenceNum);
+
+		// Write the newest unACKed payloads that fit in maxBytes. sequenceNum is the packet they're going out with
+		void writeSection(BitWriter & writer, uint16_t sequenceNum, uint32_t maxBytes);
+
+		// Read the payloads from a packet, oldest first
+		static bool readSection(BitReader & reader, uint16_t sequenceNum, Payload * payloads, uint32_t maxPayloads, uint32_t * numPayloads);
+
+	private:
+
+		struct Slot
+		{
+			bool valid;
+			bool acked;
+			Payload payload;
+		};
+
+		// Returns the slot if it holds this sequence number, otherwise null
+		Slot * findSlot(uint16_t sequenceNum);
+
+		// Recently sent payloads, indexed by sequence number
+		Slot m_slots[REDUNDANCY_WINDOW_SIZE];
+	};
+}
@@ -0,0 +1,107 @@
+//
+//  NetworkInterpolation.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkInterpolation.h"
+#include "Common.h"
+
+using namespace shd;
+
+NetworkInterpolationBuffer::NetworkInterpolationBuffer() :	m_writeIndex(0),
+															m_renderDelayUs(DEFAULT_RENDER_DELAY_US),
+															m_maxExtrapolationUs(DEFAULT_MAX_EXTRAPOLATION_US),
+															m_numExtrapolated(0)
+{
+}
+
+void NetworkInterpolationBuffer::reset()
+{
+	Atomic::exchange32(&m_writeIndex, 0);
+	m_numExtrapolated = 0;
+}
+
+bool NetworkInterpolationBuffer::addSnapshot(uint64_t timeUs, const State & state)
+{
+	uint32_t writeIndex = m_writeIndex;
+
+	// Time has to go forwards, or the game thread could find the snapshots out of order
+	if (writeIndex && timeUs < m_snapshots[(writeIndex - 1) % SNAPSHOT_BUFFER_SIZE].timeUs)
+	{
+		return false;
+	}
+
+	Snapshot & snapshot = m_snapshots[writeIndex % SNAPSHOT_BUFFER_SIZE];
+	snapshot.timeUs = timeUs;
+	snapshot.state = state;
+
+	// Publish the snapshot only after it has been filled
+	Atomic::exchange32(&m_writeIndex, writeIndex + 1);
+
+	return true;
+}
+
+NetworkInterpolationBuffer::SampleResult NetworkInterpolationBuffer::sample(uint64_t timeUs, State * state)
+{
+	uint32_t writeIndex = m_writeIndex;
+	uint64_t renderTimeUs = (timeUs > m_renderDelayUs) ? timeUs - m_renderDelayUs : 0;
+	uint32_t oldestIndex = (writeIndex > SNAPSHOT_BUFFER_SIZE - 1) ? writeIndex - (SNAPSHOT_BUFFER_SIZE - 1) : 0;
+	Snapshot newest;
+
+	if (writeIndex == 0)
+	{
+		return SAMPLE_RESULT_NONE;
+	}
+
+	newest = m_snapshots[(writeIndex - 1) % SNAPSHOT_BUFFER_SIZE];
+
+	// Past the newest snapshot, so carry on in a straight line for a while
+	if (renderTimeUs >= newest.timeUs)
+	{
+		uint64_t aheadUs = renderTimeUs - newest.timeUs;
+		float dt = (float)((aheadUs < m_maxExtrapolationUs) ? aheadUs : m_maxExtrapolationUs) / 1000000.0f;
+
+		*state = newest.state;
+		state->posX += newest.state.velocityX * dt;
+		state->posY += newest.state.velocityY * dt;
+		m_numExtrapolated++;
+
+		return (aheadUs <= m_maxExtrapolationUs) ? SAMPLE_RESULT_EXTRAPOLATED : SAMPLE_RESULT_CLAMPED;
+	}
+
+	// Find the two snapshots either side of the render time. Only the newest SNAPSHOT_BUFFER_SIZE - 1 are looked at,
+	// since the network thread could be writing the next snapshot over the one before them
+	for (uint32_t i = writeIndex - 1; i > oldestIndex; i--)
+	{
+		Snapshot from = m_snapshots[(i - 1) % SNAPSHOT_BUFFER_SIZE];
+		Snapshot to = m_snapshots[i % SNAPSHOT_BUFFER_SIZE];
+
+		if (from.timeUs > renderTimeUs)
+		{
+			continue;
+		}
+
+		// Overwritten while we were reading it, so it's gone
+		if (m_writeIndex - (i - 1) >= SNAPSHOT_BUFFER_SIZE)
+		{
+			break;
+		}
+
+		float t = (to.timeUs > from.timeUs) ? (float)(renderTimeUs - from.timeUs) / (float)(to.timeUs - from.timeUs) : 1.0f;
+
+		state->posX = shd::lerp(from.state.posX, to.state.posX, t);
+		state->posY = shd::lerp(from.state.posY, to.state.posY, t);
+		state->velocityX = shd::lerp(from.state.velocityX, to.state.velocityX, t);
+		state->velocityY = shd::lerp(from.state.velocityY, to.state.velocityY, t);
+
+		return SAMPLE_RESULT_INTERPOLATED;
+	}
+
+	// Older than anything we have. Only happens just after the first snapshots arrive
+	*state = m_snapshots[oldestIndex % SNAPSHOT_BUFFER_SIZE].state;
+
+	return SAMPLE_RESULT_CLAMPED;
+}
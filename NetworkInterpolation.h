@@ -0,0 +1,87 @@
+//
+//  NetworkInterpolation.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+namespace shd
+{
+	// Time stamped snapshots of one remote object (the ball, a thrown weapon). Instead of snapping to each update
+	// as it arrives, the game samples the object a little in the past, between two updates, so a late or lost
+	// packet doesn't show up on screen. If the updates run out, the object carries on with its last velocity for a bit.
+	// Sample once per game tick into the object's position, and Renderer::draw lerps between ticks the same as
+	// it does for everything else.
+	// Snapshots are added from the network thread and sampled from the game thread.
+	// Nothing uses it yet. The ball travels inside the NetworkInputBuffer's payload and is drawn by the game's match code,
+	// neither of which is in this tree, so the game has to add the snapshots and sample them itself
+	class NetworkInterpolationBuffer
+	{
+	public:
+
+		static const uint32_t SNAPSHOT_BUFFER_SIZE = 32;
+
+		// Long enough to cover two updates at 20 a second, plus some jitter
+		static const uint32_t DEFAULT_RENDER_DELAY_US = 100 * 1000;
+
+		// How long to carry on past the newest snapshot before stopping
+		static const uint32_t DEFAULT_MAX_EXTRAPOLATION_US = 100 * 1000;
+
+		// Velocity is in world units a second, the same as the physics
+		struct State
+		{
+			float posX;
+			float posY;
+			float velocityX;
+			float velocityY;
+		};
+
+		enum SampleResult
+		{
+			SAMPLE_RESULT_NONE = 0,			// No snapshots yet
+			SAMPLE_RESULT_INTERPOLATED,		// Between two snapshots
+			SAMPLE_RESULT_EXTRAPOLATED,		// Past the newest snapshot
+			SAMPLE_RESULT_CLAMPED			// Before the oldest snapshot, or too far past the newest
+		};
+
+		NetworkInterpolationBuffer();
+
+		// Forget all the snapshots. Only call from the thread that adds them
+		void reset();
+
+		// Add the state the object was in at timeUs. Snapshots older than the newest one are dropped
+		bool addSnapshot(uint64_t timeUs, const State & state);
+
+		// Where the object should be drawn at timeUs. The render delay is taken off timeUs first
+		SampleResult sample(uint64_t timeUs, State * state);
+
+		inline void setRenderDelayMicroseconds(uint32_t delayUs) { m_renderDelayUs = delayUs; }
+		inline uint32_t getRenderDelayMicroseconds() { return m_renderDelayUs; }
+		inline void setMaxExtrapolationMicroseconds(uint32_t extrapolationUs) { m_maxExtrapolationUs = extrapolationUs; }
+
+		inline uint32_t getNumSnapshots() { return m_writeIndex; }
+		inline uint32_t getNumExtrapolated() { return m_numExtrapolated; }
+
+	private:
+
+		struct Snapshot
+		{
+			uint64_t timeUs;
+			State state;
+		};
+
+		// Snapshots indexed by m_writeIndex, which is only ever written by the network thread
+		Snapshot m_snapshots[SNAPSHOT_BUFFER_SIZE];
+		volatile uint32_t m_writeIndex;
+
+		uint32_t m_renderDelayUs;
+		uint32_t m_maxExtrapolationUs;
+
+		uint32_t m_numExtrapolated;
+	};
+}
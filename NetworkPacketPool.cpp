@@ -0,0 +1,63 @@
+//
+//  NetworkPacketPool.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkPacketPool.h"
+#include "Common.h"
+
+using namespace shd;
+
+NetworkPacketPool::NetworkPacketPool() :	m_packets(nullptr),
+											m_numFree(0)
+{
+	m_packets = (Packet *)SHD_MALLOC(sizeof(Packet) * POOL_SIZE);
+	SHD_ASSERT(m_packets);
+
+	if (m_packets == nullptr)
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; i < POOL_SIZE; i++)
+	{
+		m_free[m_numFree++] = &m_packets[i];
+	}
+}
+
+NetworkPacketPool::~NetworkPacketPool()
+{
+	// Everything should have been given back by now
+	SHD_ASSERT(m_packets == nullptr || m_numFree == POOL_SIZE);
+
+	if (m_packets)
+	{
+		SHD_FREE(m_packets);
+		m_packets = nullptr;
+	}
+}
+
+NetworkPacketPool::Packet * NetworkPacketPool::acquire()
+{
+	if (m_numFree == 0)
+	{
+		SHD_PRINTF("Out of packet buffers!\n");
+		return nullptr;
+	}
+
+	Packet * packet = m_free[--m_numFree];
+	packet->size = 0;
+
+	return packet;
+}
+
+void NetworkPacketPool::release(Packet * packet)
+{
+	SHD_ASSERT(packet >= m_packets && packet < m_packets + POOL_SIZE);
+	SHD_ASSERT(m_numFree < POOL_SIZE);
+
+	m_free[m_numFree++] = packet;
+}
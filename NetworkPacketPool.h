@@ -0,0 +1,56 @@
+//
+//  NetworkPacketPool.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+namespace shd
+{
+	// A fixed set of packet sized buffers, handed out and given back instead of using one big buffer per direction.
+	// Buffers are never cleared: whoever fills one only writes, and only sends, the bytes it actually uses.
+	// Not thread safe, it belongs to whichever thread owns the NetworkTransport
+	class NetworkPacketPool
+	{
+	public:
+
+		// Big enough for the largest game packet before it's split into fragments, plus room for headers in front of it
+		static const uint32_t PACKET_BUFFER_SIZE = 4 * 1024 + 512;
+		static const uint32_t POOL_SIZE = 8;
+
+		struct Packet
+		{
+			uint32_t size;
+			uint8_t data[PACKET_BUFFER_SIZE];
+		};
+
+		NetworkPacketPool();
+		~NetworkPacketPool();
+
+		// Get a buffer. Returns null if they're all in use
+		Packet * acquire();
+
+		// Give a buffer back to the pool
+		void release(Packet * packet);
+
+		inline uint32_t getNumFree() { return m_numFree; }
+
+	private:
+
+		// Disable copying
+		NetworkPacketPool(const NetworkPacketPool &);
+		NetworkPacketPool & operator=(const NetworkPacketPool &);
+
+		// All of the buffers, in one allocation
+		Packet * m_packets;
+
+		// Buffers that aren't in use
+		Packet * m_free[POOL_SIZE];
+		uint32_t m_numFree;
+	};
+}
@@ -0,0 +1,262 @@
+//
+//  NetworkPoller.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkPoller.h"
+#include "Threading.h"
+#include "Common.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#define SHD_POLLER_HAS_EPOLL
+#endif
+
+using namespace shd;
+
+// The most events taken from epoll with each wait
+#define SHD_POLLER_MAX_EVENTS 64
+
+NetworkPoller::NetworkPoller() :	m_epoll(-1),
+									m_wakeEvent(-1),
+									m_numSockets(0),
+									m_wakeRequested(0),
+									m_numWaits(0),
+									m_numWakeups(0)
+{
+
+}
+
+NetworkPoller::~NetworkPoller()
+{
+	term();
+}
+
+bool NetworkPoller::init()
+{
+	term();
+
+#ifdef SHD_POLLER_HAS_EPOLL
+	epoll_event event;
+
+	m_epoll = epoll_create1(0);
+	if (m_epoll < 0)
+	{
+		SHD_PRINTF("Failed to create epoll.\n");
+		return false;
+	}
+
+	m_wakeEvent = eventfd(0, EFD_NONBLOCK);
+	if (m_wakeEvent < 0)
+	{
+		SHD_PRINTF("Failed to create eventfd.\n");
+		term();
+		return false;
+	}
+
+	// The wake event has no userData, that's how wait() tells it apart from the sockets
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = nullptr;
+
+	if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeEvent, &event) != 0)
+	{
+		SHD_PRINTF("Failed to add eventfd to epoll.\n");
+		term();
+		return false;
+	}
+#endif
+
+	return true;
+}
+
+void NetworkPoller::term()
+{
+#ifdef SHD_POLLER_HAS_EPOLL
+	if (m_wakeEvent >= 0)
+	{
+		close(m_wakeEvent);
+	}
+
+	if (m_epoll >= 0)
+	{
+		close(m_epoll);
+	}
+#endif
+
+	m_wakeEvent = -1;
+	m_epoll = -1;
+	m_numSockets = 0;
+	m_wakeRequested = 0;
+}
+
+bool NetworkPoller::isEventDriven()
+{
+	return m_epoll >= 0;
+}
+
+bool NetworkPoller::addSocket(NetworkBackendUdp * backend, void * userData)
+{
+	if (backend == nullptr || m_numSockets == MAX_SOCKETS)
+	{
+		return false;
+	}
+
+#ifdef SHD_POLLER_HAS_EPOLL
+	if (m_epoll >= 0)
+	{
+		epoll_event event;
+
+		// Level triggered, so a socket that wasn't read dry is reported again next time
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.ptr = &m_sockets[m_numSockets];
+
+		if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, backend->getSocket(), &event) != 0)
+		{
+			SHD_PRINTF("Failed to add socket to epoll.\n");
+			return false;
+		}
+	}
+#endif
+
+	m_sockets[m_numSockets].backend = backend;
+	m_sockets[m_numSockets].userData = userData;
+	m_numSockets++;
+
+	return true;
+}
+
+bool NetworkPoller::removeSocket(NetworkBackendUdp * backend)
+{
+	for (uint32_t i = 0; i < m_numSockets; i++)
+	{
+		if (m_sockets[i].backend != backend)
+		{
+			continue;
+		}
+
+#ifdef SHD_POLLER_HAS_EPOLL
+		if (m_epoll >= 0)
+		{
+			epoll_event event;
+
+			epoll_ctl(m_epoll, EPOLL_CTL_DEL, backend->getSocket(), &event);
+
+			// epoll points at the slot, so the one that fills the gap has to be pointed at its new slot
+			if (i != m_numSockets - 1)
+			{
+				memset(&event, 0, sizeof(event));
+				event.events = EPOLLIN;
+				event.data.ptr = &m_sockets[i];
+
+				epoll_ctl(m_epoll, EPOLL_CTL_MOD, m_sockets[m_numSockets - 1].backend->getSocket(), &event);
+			}
+		}
+#endif
+
+		// Order doesn't matter, so the last one fills the gap
+		m_sockets[i] = m_sockets[--m_numSockets];
+		return true;
+	}
+
+	return false;
+}
+
+uint32_t NetworkPoller::wait(uint64_t timeoutUs, void ** ready, uint32_t maxReady, bool * wasWoken)
+{
+	uint32_t numReady = 0;
+
+	*wasWoken = false;
+	Atomic::add32(&m_numWaits, 1);
+
+#ifdef SHD_POLLER_HAS_EPOLL
+	if (m_epoll >= 0)
+	{
+		epoll_event events[SHD_POLLER_MAX_EVENTS];
+		uint32_t maxEvents = (maxReady + 1 < SHD_POLLER_MAX_EVENTS) ? maxReady + 1 : SHD_POLLER_MAX_EVENTS;
+
+		// Round up, so it never wakes just before the time and has to wait again
+		int numEvents = epoll_wait(m_epoll, events, (int)maxEvents, (int)((timeoutUs + 999) / 1000));
+
+		for (int i = 0; i < numEvents; i++)
+		{
+			Socket * socket = (Socket *)events[i].data.ptr;
+
+			if (socket == nullptr)
+			{
+				uint64_t count = 0;
+
+				// Reset the event, however many times wake() was called
+				if (read(m_wakeEvent, &count, sizeof(count)) < 0 && errno != EAGAIN)
+				{
+					SHD_PRINTF("Failed to read eventfd.\n");
+				}
+
+				*wasWoken = true;
+			}
+			else if (numReady < maxReady)
+			{
+				ready[numReady++] = socket->userData;
+			}
+		}
+
+		if (numEvents > 0)
+		{
+			Atomic::add32(&m_numWakeups, 1);
+		}
+
+		return numReady;
+	}
+#endif
+
+	// No way of knowing when a packet arrives, so sleep and then check everything
+	if (m_wakeRequested == 0)
+	{
+		Threading::sleep((uint32_t)(timeoutUs / 1000));
+	}
+
+	if (Atomic::exchange32(&m_wakeRequested, 0))
+	{
+		*wasWoken = true;
+		Atomic::add32(&m_numWakeups, 1);
+	}
+
+	for (uint32_t i = 0; i < m_numSockets && numReady < maxReady; i++)
+	{
+		ready[numReady++] = m_sockets[i].userData;
+	}
+
+	return numReady;
+}
+
+void NetworkPoller::wake()
+{
+#ifdef SHD_POLLER_HAS_EPOLL
+	if (m_wakeEvent >= 0)
+	{
+		uint64_t one = 1;
+
+		if (write(m_wakeEvent, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		{
+			SHD_PRINTF("Failed to write eventfd.\n");
+		}
+
+		return;
+	}
+#endif
+
+	Atomic::exchange32(&m_wakeRequested, 1);
+}
+
+void NetworkPoller::resetCounters()
+{
+	Atomic::exchange32(&m_numWaits, 0);
+	Atomic::exchange32(&m_numWakeups, 0);
+}
@@ -0,0 +1,79 @@
+//
+//  NetworkPoller.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include "NetworkBackendUdp.h"
+#include <stdint.h>
+
+namespace shd
+{
+	// Lets a network thread sleep until there's something to do, instead of waking up every so often to check.
+	// wait() returns as soon as one of the sockets has a packet waiting, or another thread calls wake() because it
+	// has something to send, or the timeout runs out. On Linux that's epoll, with an eventfd for wake().
+	// Anywhere else wait() just sleeps for the timeout and says every socket is ready, which is the same as polling.
+	// wait() and the socket list belong to one thread. wake() can be called from any thread
+	class NetworkPoller
+	{
+	public:
+
+		// The most sockets that can be waited on
+		static const uint32_t MAX_SOCKETS = 1024;
+
+		NetworkPoller();
+		~NetworkPoller();
+
+		bool init();
+		void term();
+
+		// Wait on a socket. userData is handed back by wait() when the socket has packets waiting
+		bool addSocket(NetworkBackendUdp * backend, void * userData);
+		bool removeSocket(NetworkBackendUdp * backend);
+		inline uint32_t getNumSockets() { return m_numSockets; }
+
+		// Sleep until a socket has packets waiting, wake() is called, or timeoutUs has passed. The userData of each ready
+		// socket goes in ready, and the number of them is returned. wasWoken is set if wake() was called
+		uint32_t wait(uint64_t timeoutUs, void ** ready, uint32_t maxReady, bool * wasWoken);
+
+		// Make wait() return straight away, or the next time it's called
+		void wake();
+
+		// Can wait() tell which sockets are ready, or does it just sleep
+		bool isEventDriven();
+
+		// How many times wait() returned, and how many of those were because of wake() or a packet
+		inline uint32_t getNumWaits() { return m_numWaits; }
+		inline uint32_t getNumWakeups() { return m_numWakeups; }
+		void resetCounters();
+
+	private:
+
+		struct Socket
+		{
+			NetworkBackendUdp * backend;
+			void * userData;
+		};
+
+		// Disable copying
+		NetworkPoller(const NetworkPoller &);
+		NetworkPoller & operator=(const NetworkPoller &);
+
+		// epoll and eventfd handles, or -1
+		int m_epoll;
+		int m_wakeEvent;
+
+		Socket m_sockets[MAX_SOCKETS];
+		uint32_t m_numSockets;
+
+		// Set by wake() when there's no eventfd
+		volatile uint32_t m_wakeRequested;
+
+		volatile uint32_t m_numWaits;
+		volatile uint32_t m_numWakeups;
+	};
+}
@@ -0,0 +1,418 @@
+//
+//  NetworkPriorityAccumulator.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkPriorityAccumulator.h"
+#include "NetworkTransport.h"
+#include "Common.h"
+#include <math.h>
+
+using namespace shd;
+
+// Marks the end of the entities in a packet, in place of an entity number
+#define SHD_PRIORITY_END_MARKER 0xFF
+
+// Bytes per packet until setBudget() says otherwise. At 60 packets a second that's about 15KB/s
+#define SHD_PRIORITY_DEFAULT_BUDGET_BYTES 256
+
+// How much more slowly an entity that hasn't changed gains priority
+#define SHD_PRIORITY_UNCHANGED_SCALE 0.1f
+
+// getDistanceRelevance() is a half at this distance
+#define SHD_PRIORITY_DISTANCE_FALLOFF 16.0f
+
+// The benchmark's entities. The ball wants to go every tick, and the rest a few times a second when they're near it
+#define SHD_PRIORITY_BENCHMARK_TICK_SECONDS (1.0f / 60.0f)
+#define SHD_PRIORITY_BENCHMARK_BALL_PRIORITY 60.0f
+#define SHD_PRIORITY_BENCHMARK_ENTITY_PRIORITY 20.0f
+
+NetworkPriorityAccumulator::NetworkPriorityAccumulator() :	m_numEntities(0),
+															m_budgetBytes(SHD_PRIORITY_DEFAULT_BUDGET_BYTES),
+															m_numEntitiesWritten(0),
+															m_numEntitiesSent(0),
+															m_numEntitiesDeferred(0)
+{
+}
+
+void NetworkPriorityAccumulator::init(uint32_t numEntities, uint32_t budgetBytes)
+{
+	SHD_ASSERT(numEntities <= MAX_ENTITIES);
+
+	m_numEntities = (numEntities <= MAX_ENTITIES) ? numEntities : MAX_ENTITIES;
+
+	for (uint32_t i = 0; i < m_numEntities; i++)
+	{
+		m_entities[i].basePriority = 1.0f;
+		m_entities[i].relevance = 1.0f;
+	}
+
+	setBudget(budgetBytes);
+	reset();
+}
+
+void NetworkPriorityAccumulator::reset()
+{
+	for (uint32_t i = 0; i < m_numEntities; i++)
+	{
+		m_entities[i].priority = 0.0f;
+
+		// Everything has to be sent at least once
+		m_entities[i].hasChanged = true;
+	}
+
+	m_numEntitiesWritten = 0;
+	resetCounters();
+}
+
+void NetworkPriorityAccumulator::resetCounters()
+{
+	Atomic::exchange32(&m_numEntitiesSent, 0);
+	Atomic::exchange32(&m_numEntitiesDeferred, 0);
+}
+
+void NetworkPriorityAccumulator::setBudget(uint32_t budgetBytes)
+{
+	m_budgetBytes = budgetBytes;
+}
+
+void NetworkPriorityAccumulator::setBasePriority(uint32_t entity, float priorityPerSecond)
+{
+	SHD_ASSERT(entity < m_numEntities);
+
+	if (entity < m_numEntities)
+	{
+		m_entities[entity].basePriority = (priorityPerSecond > 0.0f) ? priorityPerSecond : 0.0f;
+	}
+}
+
+void NetworkPriorityAccumulator::setRelevance(uint32_t entity, float relevance)
+{
+	SHD_ASSERT(entity < m_numEntities);
+
+	if (entity < m_numEntities)
+	{
+		m_entities[entity].relevance = (relevance > 0.0f) ? relevance : 0.0f;
+	}
+}
+
+void NetworkPriorityAccumulator::markChanged(uint32_t entity)
+{
+	SHD_ASSERT(entity < m_numEntities);
+
+	if (entity < m_numEntities)
+	{
+		m_entities[entity].hasChanged = true;
+	}
+}
+
+float NetworkPriorityAccumulator::getDistanceRelevance(float distance)
+{
+	if (distance < 0.0f)
+	{
+		distance = -distance;
+	}
+
+	return 1.0f / (1.0f + distance / SHD_PRIORITY_DISTANCE_FALLOFF);
+}
+
+uint32_t NetworkPriorityAccumulator::write(uint8_t * buffer, uint32_t bufferSize, float elapsedSeconds, NetworkEntitySerializer & serializer)
+{
+	uint8_t entityData[MAX_ENTITY_SIZE];
+	uint32_t budget = (m_budgetBytes < bufferSize) ? m_budgetBytes : bufferSize;
+	uint32_t numOrdered = 0;
+	uint32_t bytesWritten = 0;
+
+	m_numEntitiesWritten = 0;
+
+	// Room for an entity number, at least a byte of state, and the end marker
+	if (budget < 3)
+	{
+		return 0;
+	}
+
+	// Build up priority, and sort everything that has some, highest first. There are few enough entities that an
+	// insertion sort is quicker than anything cleverer
+	for (uint32_t i = 0; i < m_numEntities; i++)
+	{
+		Entity & entity = m_entities[i];
+		uint32_t j = numOrdered;
+
+		entity.priority += elapsedSeconds * entity.basePriority * entity.relevance * ((entity.hasChanged) ? 1.0f : SHD_PRIORITY_UNCHANGED_SCALE);
+
+		if (entity.priority <= 0.0f)
+		{
+			continue;
+		}
+
+		while (j > 0 && m_entities[m_order[j - 1]].priority < entity.priority)
+		{
+			m_order[j] = m_order[j - 1];
+			j--;
+		}
+
+		m_order[j] = (uint8_t)i;
+		numOrdered++;
+	}
+
+	for (uint32_t i = 0; i < numOrdered; i++)
+	{
+		uint32_t index = m_order[i];
+		uint32_t entitySize = 0;
+		BitWriter writer(entityData, MAX_ENTITY_SIZE);
+
+		// Nothing else can fit
+		if (bytesWritten + 3 > budget)
+		{
+			Atomic::add32(&m_numEntitiesDeferred, numOrdered - i);
+			break;
+		}
+
+		if (serializer.writeEntity(index, writer) == false || writer.hasOverflowed())
+		{
+			SHD_PRINTF("Couldn't write entity %u!\n", index);
+			continue;
+		}
+
+		entitySize = writer.flush();
+
+		// Too big for what's left, but something further down might not be
+		if (bytesWritten + 1 + entitySize + 1 > budget)
+		{
+			Atomic::add32(&m_numEntitiesDeferred, 1);
+			continue;
+		}
+
+		buffer[bytesWritten++] = (uint8_t)index;
+		memcpy(buffer + bytesWritten, entityData, entitySize);
+		bytesWritten += entitySize;
+
+		m_entities[index].priority = 0.0f;
+		m_entities[index].hasChanged = false;
+		m_numEntitiesWritten++;
+	}
+
+	if (m_numEntitiesWritten == 0)
+	{
+		return 0;
+	}
+
+	buffer[bytesWritten++] = SHD_PRIORITY_END_MARKER;
+	Atomic::add32(&m_numEntitiesSent, m_numEntitiesWritten);
+
+	return bytesWritten;
+}
+
+bool NetworkPriorityAccumulator::read(const uint8_t * buffer, uint32_t size, NetworkEntitySerializer & serializer)
+{
+	BitReader reader(buffer, size);
+
+	if (size == 0)
+	{
+		return true;
+	}
+
+	for (;;)
+	{
+		uint32_t index = reader.readBits(8);
+
+		if (reader.hasOverflowed())
+		{
+			return false;
+		}
+
+		if (index == SHD_PRIORITY_END_MARKER)
+		{
+			return true;
+		}
+
+		// Each entity starts on a byte, the way write() copied it in
+		if (serializer.readEntity(index, reader) == false || reader.hasOverflowed())
+		{
+			return false;
+		}
+
+		reader.align();
+	}
+}
+
+namespace
+{
+	// Entities that wander around the pitch, with entity 0 as the ball
+	class BenchmarkEntities : public NetworkEntitySerializer
+	{
+	public:
+
+		struct State
+		{
+			float posX;
+			float posY;
+			float velocityX;
+			float velocityY;
+		};
+
+		State states[NetworkPriorityAccumulator::MAX_ENTITIES];
+		uint32_t numEntities;
+
+		// The receiver's tick, and the last tick each entity was read on
+		uint32_t tick;
+		uint32_t lastReadTick[NetworkPriorityAccumulator::MAX_ENTITIES];
+
+		virtual bool writeEntity(uint32_t entity, BitWriter & writer)
+		{
+			return serializeState(writer, states[entity]);
+		}
+
+		virtual bool readEntity(uint32_t entity, BitReader & reader)
+		{
+			if (entity >= numEntities)
+			{
+				return false;
+			}
+
+			lastReadTick[entity] = tick;
+
+			return serializeState(reader, states[entity]);
+		}
+
+		template <typename Stream> static bool serializeState(Stream & stream, State & state)
+		{
+			return	serializeQuantizedFloat<NetworkTransport::NetSchemaPosition>(stream, state.posX) &&
+					serializeQuantizedFloat<NetworkTransport::NetSchemaPosition>(stream, state.posY) &&
+					serializeQuantizedFloat<NetworkTransport::NetSchemaVelocity>(stream, state.velocityX) &&
+					serializeQuantizedFloat<NetworkTransport::NetSchemaVelocity>(stream, state.velocityY);
+		}
+	};
+}
+
+bool NetworkPriorityAccumulator::runBenchmark(uint32_t maxEntities, uint32_t numTicks)
+{
+	NetworkPriorityAccumulator * accumulator = nullptr;
+	BenchmarkEntities * sender = nullptr;
+	BenchmarkEntities * receiver = nullptr;
+	uint8_t packet[NetworkTransport::NET_TRANSPORT_MAX_PACKET_SIZE];
+	uint32_t random = 1;
+	bool ret = true;
+
+	if (maxEntities == 0 || maxEntities > MAX_ENTITIES || numTicks == 0)
+	{
+		return false;
+	}
+
+	accumulator = new NetworkPriorityAccumulator();
+	sender = new BenchmarkEntities();
+	receiver = new BenchmarkEntities();
+
+	// 8, 16, 32, ... and then maxEntities itself
+	for (uint32_t numEntities = (maxEntities < 8) ? maxEntities : 8; ret; numEntities = (numEntities * 2 < maxEntities) ? numEntities * 2 : maxEntities)
+	{
+		uint64_t totalBytes = 0;
+		uint32_t maxBytes = 0;
+		uint32_t maxBallGap = 0;
+		uint32_t maxGap = 0;
+
+		accumulator->init(numEntities, SHD_PRIORITY_DEFAULT_BUDGET_BYTES);
+		accumulator->setBasePriority(0, SHD_PRIORITY_BENCHMARK_BALL_PRIORITY);
+		sender->numEntities = numEntities;
+		receiver->numEntities = numEntities;
+
+		for (uint32_t i = 0; i < numEntities; i++)
+		{
+			BenchmarkEntities::State & state = sender->states[i];
+
+			state.posX = (float)(i % 16) * 8.0f - 64.0f;
+			state.posY = (float)(i / 16) * 8.0f - 64.0f;
+			state.velocityX = 0.0f;
+			state.velocityY = 0.0f;
+			receiver->lastReadTick[i] = 0;
+
+			if (i > 0)
+			{
+				accumulator->setBasePriority(i, SHD_PRIORITY_BENCHMARK_ENTITY_PRIORITY);
+			}
+		}
+
+		for (uint32_t tick = 1; ret && tick <= numTicks; tick++)
+		{
+			const BenchmarkEntities::State & ball = sender->states[0];
+			uint32_t size = 0;
+
+			receiver->tick = tick;
+
+			for (uint32_t i = 0; i < numEntities; i++)
+			{
+				BenchmarkEntities::State & state = sender->states[i];
+				float dx = state.posX - ball.posX;
+				float dy = state.posY - ball.posY;
+
+				// Nudge the velocity a little each tick, and keep everything on the pitch
+				random = random * 1103515245 + 12345;
+				state.velocityX += ((float)((random >> 16) & 0xFF) - 127.5f) / 256.0f;
+				random = random * 1103515245 + 12345;
+				state.velocityY += ((float)((random >> 16) & 0xFF) - 127.5f) / 256.0f;
+				state.posX += state.velocityX * SHD_PRIORITY_BENCHMARK_TICK_SECONDS;
+				state.posY += state.velocityY * SHD_PRIORITY_BENCHMARK_TICK_SECONDS;
+
+				if (state.posX < -100.0f || state.posX > 100.0f) state.velocityX = -state.velocityX;
+				if (state.posY < -100.0f || state.posY > 100.0f) state.velocityY = -state.velocityY;
+
+				accumulator->markChanged(i);
+
+				if (i > 0)
+				{
+					accumulator->setRelevance(i, getDistanceRelevance(sqrtf(dx * dx + dy * dy)));
+				}
+			}
+
+			size = accumulator->write(packet, sizeof(packet), SHD_PRIORITY_BENCHMARK_TICK_SECONDS, *sender);
+
+			if (size > SHD_PRIORITY_DEFAULT_BUDGET_BYTES || read(packet, size, *receiver) == false)
+			{
+				SHD_PRINTF("Priority accumulator benchmark packet %u was bad!\n", tick);
+				ret = false;
+				break;
+			}
+
+			totalBytes += size;
+			maxBytes = (size > maxBytes) ? size : maxBytes;
+
+			for (uint32_t i = 0; i < numEntities; i++)
+			{
+				uint32_t gap = tick - receiver->lastReadTick[i];
+
+				if (i == 0)
+				{
+					maxBallGap = (gap > maxBallGap) ? gap : maxBallGap;
+				}
+				else
+				{
+					maxGap = (gap > maxGap) ? gap : maxGap;
+				}
+			}
+		}
+
+		SHD_PRINTF("%u entities: %.1f bytes a packet (most %u, budget %u), %u entities sent, %u deferred, the ball went at most %u ticks without being sent, anything else %u\n",
+			numEntities,
+			(double)totalBytes / (double)numTicks,
+			maxBytes,
+			SHD_PRIORITY_DEFAULT_BUDGET_BYTES,
+			accumulator->getNumEntitiesSent(),
+			accumulator->getNumEntitiesDeferred(),
+			maxBallGap,
+			maxGap);
+
+		if (numEntities == maxEntities)
+		{
+			break;
+		}
+	}
+
+	delete accumulator;
+	delete sender;
+	delete receiver;
+
+	return ret;
+}
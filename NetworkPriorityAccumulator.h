@@ -0,0 +1,124 @@
+//
+//  NetworkPriorityAccumulator.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include "NetworkBitStream.h"
+#include <stdint.h>
+
+namespace shd
+{
+	// Reads and writes the state of one replicated entity. Implemented by whatever owns the game state, like
+	// NetworkApplicationHandler for thrown weapons
+	class NetworkEntitySerializer
+	{
+	public:
+
+		virtual ~NetworkEntitySerializer() {}
+
+		// Write an entity's current state. Return false if it can't be written
+		virtual bool writeEntity(uint32_t entity, BitWriter & writer) = 0;
+
+		// Read what writeEntity() wrote, and apply it
+		virtual bool readEntity(uint32_t entity, BitReader & reader) = 0;
+	};
+
+	// Decides which entities go in each state packet, so a packet never goes over a fixed number of bytes however many
+	// entities there are. Every entity builds up priority each tick, at a rate set by how important that kind of entity
+	// is, scaled by how relevant it is right now, like how close it is to the ball. Each packet takes the entities
+	// with the most priority until the budget runs out, and their priority goes back to zero. Anything that didn't
+	// fit goes up the list for next time, so nothing is starved, it's just sent less often.
+	// The ball, each player and each weapon are entities, numbered however the game likes, up to MAX_ENTITIES.
+	// Not thread safe, it belongs to the network thread
+	class NetworkPriorityAccumulator
+	{
+	public:
+
+		// Entity numbers go from 0 to MAX_ENTITIES - 1. One less than a byte, so the end marker fits in one
+		static const uint32_t MAX_ENTITIES = 255;
+
+		// The most bytes one entity's state can take up
+		static const uint32_t MAX_ENTITY_SIZE = 64;
+
+		NetworkPriorityAccumulator();
+
+		// Start again with numEntities entities, all at priority zero, and budgetBytes bytes for each packet
+		void init(uint32_t numEntities, uint32_t budgetBytes);
+		void reset();
+
+		// The most bytes write() fills a packet with, including the end marker
+		void setBudget(uint32_t budgetBytes);
+		inline uint32_t getBudget() { return m_budgetBytes; }
+
+		inline uint32_t getNumEntities() { return m_numEntities; }
+
+		// How much priority an entity gains per second. The ball should gain more than a player, and a player more than a weapon
+		void setBasePriority(uint32_t entity, float priorityPerSecond);
+
+		// Scales how fast an entity gains priority, from 0 (never sent) upwards. Set every tick from whatever makes it
+		// matter right now, like getDistanceRelevance() from the ball
+		void setRelevance(uint32_t entity, float relevance);
+
+		// The entity has changed since it was last sent. Entities that haven't still gain priority, but much more slowly,
+		// so a lost packet doesn't leave the other side with the wrong state forever
+		void markChanged(uint32_t entity);
+
+		// 1 right next to something, falling off with distance, in the game's units
+		static float getDistanceRelevance(float distance);
+
+		// Add elapsedSeconds worth of priority to every entity, and fill buffer with the ones that have the most, up to
+		// the budget. Returns the number of bytes written, which is never more than the budget or bufferSize
+		uint32_t write(uint8_t * buffer, uint32_t bufferSize, float elapsedSeconds, NetworkEntitySerializer & serializer);
+
+		// Read a packet written by write(), and hand each entity in it to serializer
+		static bool read(const uint8_t * buffer, uint32_t size, NetworkEntitySerializer & serializer);
+
+		inline float getPriority(uint32_t entity) { return (entity < m_numEntities) ? m_entities[entity].priority : 0.0f; }
+
+		// How many entities went in the last packet
+		inline uint32_t getNumEntitiesWritten() { return m_numEntitiesWritten; }
+
+		// Entities that have been sent, and ones that had priority but didn't fit, since the counters were reset
+		inline uint32_t getNumEntitiesSent() { return m_numEntitiesSent; }
+		inline uint32_t getNumEntitiesDeferred() { return m_numEntitiesDeferred; }
+		void resetCounters();
+
+		// Write numTicks packets from 8, 16, 32 and so on up to maxEntities moving entities, and print how many bytes
+		// each packet took and how long entities went between being sent
+		static bool runBenchmark(uint32_t maxEntities, uint32_t numTicks);
+
+	private:
+
+		struct Entity
+		{
+			float basePriority;
+			float relevance;
+			float priority;
+
+			// Changed since it was last sent
+			bool hasChanged;
+		};
+
+		// Disable copying
+		NetworkPriorityAccumulator(const NetworkPriorityAccumulator &);
+		NetworkPriorityAccumulator & operator=(const NetworkPriorityAccumulator &);
+
+		Entity m_entities[MAX_ENTITIES];
+		uint32_t m_numEntities;
+
+		uint32_t m_budgetBytes;
+
+		// Entity numbers, sorted by priority each write()
+		uint8_t m_order[MAX_ENTITIES];
+
+		uint32_t m_numEntitiesWritten;
+
+		volatile uint32_t m_numEntitiesSent;
+		volatile uint32_t m_numEntitiesDeferred;
+	};
+}
@@ -0,0 +1,296 @@
+//
+//  NetworkRollback.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkRollback.h"
+#include "NetworkSequence.h"
+
+using namespace shd;
+
+NetworkRollback::NetworkRollback() :	m_simulation(nullptr),
+										m_stateBuffer(nullptr),
+										m_maxStateSize(0),
+										m_queueWriteIndex(0),
+										m_queueReadIndex(0)
+{
+	reset();
+}
+
+NetworkRollback::~NetworkRollback()
+{
+	term();
+}
+
+bool NetworkRollback::init(NetworkRollbackSimulation * simulation, uint32_t maxStateSize)
+{
+	term();
+
+	if (simulation == nullptr || maxStateSize == 0)
+	{
+		SHD_ASSERT(false);
+		return false;
+	}
+
+	m_stateBuffer = (uint8_t *)SHD_MALLOC(maxStateSize * ROLLBACK_WINDOW_SIZE);
+	if (m_stateBuffer == nullptr)
+	{
+		return false;
+	}
+
+	for (uint32_t i = 0; i < ROLLBACK_WINDOW_SIZE; i++)
+	{
+		m_frames[i].state = m_stateBuffer + i * maxStateSize;
+	}
+
+	m_simulation = simulation;
+	m_maxStateSize = maxStateSize;
+	reset();
+
+	return true;
+}
+
+void NetworkRollback::term()
+{
+	if (m_stateBuffer)
+	{
+		SHD_FREE(m_stateBuffer);
+		m_stateBuffer = nullptr;
+	}
+
+	for (uint32_t i = 0; i < ROLLBACK_WINDOW_SIZE; i++)
+	{
+		m_frames[i].state = nullptr;
+	}
+
+	m_simulation = nullptr;
+	m_maxStateSize = 0;
+}
+
+void NetworkRollback::reset()
+{
+	for (uint32_t i = 0; i < ROLLBACK_WINDOW_SIZE; i++)
+	{
+		// Nothing will ever match this frame number
+		m_frames[i].frame = 0xFFFFFFFF;
+		m_frames[i].stateSize = 0;
+	}
+
+	for (uint32_t i = 0; i < REMOTE_INPUT_HISTORY_SIZE; i++)
+	{
+		m_remoteInputs[i].isValid = false;
+	}
+
+	// Throw away anything the network thread queued for the last match
+	Atomic::exchange32(&m_queueReadIndex, m_queueWriteIndex);
+
+	m_currentFrame = 0;
+	m_confirmedFrame = 0;
+	m_rollbackFrame = 0;
+	m_needsRollback = false;
+	m_isResimulating = false;
+	m_numRollbacks = 0;
+	m_numFramesResimulated = 0;
+	m_maxRollbackFrames = 0;
+	m_numStalls = 0;
+}
+
+bool NetworkRollback::isSameInput(const Controllers::State & a, const Controllers::State & b)
+{
+	return	memcmp(a.buttons, b.buttons, sizeof(a.buttons)) == 0 &&
+			a.leftStickXInt == b.leftStickXInt &&
+			a.leftStickYInt == b.leftStickYInt &&
+			a.rightStickXInt == b.rightStickXInt &&
+			a.rightStickYInt == b.rightStickYInt &&
+			a.leftStick.x == b.leftStick.x &&
+			a.leftStick.y == b.leftStick.y &&
+			a.rightStick.x == b.rightStick.x &&
+			a.rightStick.y == b.rightStick.y &&
+			a.leftTrigger == b.leftTrigger &&
+			a.rightTrigger == b.rightTrigger;
+}
+
+bool NetworkRollback::addRemoteInput(uint16_t sequenceNum, const Controllers::State & input)
+{
+	uint32_t writeIndex = m_queueWriteIndex;
+
+	if (writeIndex - m_queueReadIndex >= REMOTE_INPUT_QUEUE_SIZE)
+	{
+		SHD_PRINTF("Rollback input queue is full!\n");
+		return false;
+	}
+
+	QueuedInput & queued = m_queue[writeIndex % REMOTE_INPUT_QUEUE_SIZE];
+	queued.sequenceNum = sequenceNum;
+	queued.input = input;
+
+	// Publish the slot only after it has been filled
+	Atomic::exchange32(&m_queueWriteIndex, writeIndex + 1);
+
+	return true;
+}
+
+void NetworkRollback::processRemoteInputs()
+{
+	uint32_t readIndex = m_queueReadIndex;
+
+	while (readIndex != m_queueWriteIndex)
+	{
+		QueuedInput & queued = m_queue[readIndex % REMOTE_INPUT_QUEUE_SIZE];
+
+		// Turn the 16 bit sequence number into a frame number, using where we are now as the reference
+		int64_t frame = (int64_t)m_currentFrame + NetworkSequence::difference(queued.sequenceNum, (uint16_t)m_currentFrame);
+
+		// Skip it if we already have it, or if it's so far ahead that it would overwrite the last confirmed input,
+		// which is what guesses are made from
+		if (frame >= (int64_t)m_confirmedFrame && frame < (int64_t)m_confirmedFrame + REMOTE_INPUT_HISTORY_SIZE - 1)
+		{
+			RemoteInput & remote = m_remoteInputs[frame % REMOTE_INPUT_HISTORY_SIZE];
+
+			if (remote.isValid == false || remote.frame != (uint32_t)frame)
+			{
+				remote.frame = (uint32_t)frame;
+				remote.isValid = true;
+				remote.input = queued.input;
+
+				// If the frame has already been run with a different guess, it needs to be run again
+				if (frame < (int64_t)m_currentFrame && isSameInput(m_frames[frame % ROLLBACK_WINDOW_SIZE].remoteInput, queued.input) == false)
+				{
+					if (m_needsRollback == false || (uint32_t)frame < m_rollbackFrame)
+					{
+						m_rollbackFrame = (uint32_t)frame;
+					}
+
+					m_needsRollback = true;
+				}
+			}
+		}
+
+		readIndex++;
+	}
+
+	// Give the slots back to the network thread
+	Atomic::exchange32(&m_queueReadIndex, readIndex);
+
+	// Move the confirmed frame past every frame we now have the real input for
+	for (;;)
+	{
+		RemoteInput & remote = m_remoteInputs[m_confirmedFrame % REMOTE_INPUT_HISTORY_SIZE];
+
+		if (remote.isValid == false || remote.frame != m_confirmedFrame)
+		{
+			break;
+		}
+
+		m_confirmedFrame++;
+	}
+}
+
+const Controllers::State & NetworkRollback::getRemoteInput(uint32_t frame)
+{
+	// Every frame before m_confirmedFrame has a real input, so this never looks back further than that
+	for (uint32_t i = 0; i < REMOTE_INPUT_HISTORY_SIZE && i <= frame; i++)
+	{
+		RemoteInput & remote = m_remoteInputs[(frame - i) % REMOTE_INPUT_HISTORY_SIZE];
+
+		if (remote.isValid && remote.frame == frame - i)
+		{
+			return remote.input;
+		}
+	}
+
+	return m_defaultInput;
+}
+
+bool NetworkRollback::runFrame(uint32_t frame, const Controllers::State & localInput)
+{
+	Frame & saved = m_frames[frame % ROLLBACK_WINDOW_SIZE];
+
+	// localInput might be saved.localInput, when a frame is run again
+	Controllers::State input = localInput;
+
+	if (m_simulation->saveState(saved.state, m_maxStateSize, &saved.stateSize) == false)
+	{
+		SHD_PRINTF("Couldn't save the match state for frame %u!\n", frame);
+		SHD_ASSERT(false);
+		return false;
+	}
+
+	// The frame before is normally still saved. If it's been reused, this frame has been run before and kept a copy
+	if (frame == 0)
+	{
+		saved.remoteInputPrevious = m_defaultInput;
+	}
+	else if (m_frames[(frame - 1) % ROLLBACK_WINDOW_SIZE].frame == frame - 1)
+	{
+		saved.remoteInputPrevious = m_frames[(frame - 1) % ROLLBACK_WINDOW_SIZE].remoteInput;
+	}
+
+	saved.frame = frame;
+	saved.localInput = input;
+	saved.remoteInput = getRemoteInput(frame);
+
+	m_simulation->advance(frame, saved.localInput, saved.remoteInput, saved.remoteInputPrevious);
+
+	return true;
+}
+
+bool NetworkRollback::advanceFrame(const Controllers::State & localInput)
+{
+	if (m_simulation == nullptr)
+	{
+		return false;
+	}
+
+	processRemoteInputs();
+
+	if (m_needsRollback)
+	{
+		Frame & saved = m_frames[m_rollbackFrame % ROLLBACK_WINDOW_SIZE];
+		uint32_t numFrames = m_currentFrame - m_rollbackFrame;
+
+		SHD_ASSERT(saved.frame == m_rollbackFrame);
+
+		if (m_simulation->loadState(saved.state, saved.stateSize) == false)
+		{
+			SHD_PRINTF("Couldn't load the match state for frame %u!\n", m_rollbackFrame);
+			SHD_ASSERT(false);
+		}
+		else
+		{
+			m_isResimulating = true;
+
+			for (uint32_t frame = m_rollbackFrame; frame < m_currentFrame; frame++)
+			{
+				runFrame(frame, m_frames[frame % ROLLBACK_WINDOW_SIZE].localInput);
+			}
+
+			m_isResimulating = false;
+		}
+
+		m_numRollbacks++;
+		m_numFramesResimulated += numFrames;
+		m_maxRollbackFrames = (numFrames > m_maxRollbackFrames) ? numFrames : m_maxRollbackFrames;
+		m_needsRollback = false;
+	}
+
+	// Any further ahead and the frame we'd need to roll back to wouldn't be saved any more.
+	// The other player can be ahead of us too, so m_confirmedFrame can be past m_currentFrame
+	if (m_currentFrame > m_confirmedFrame && m_currentFrame - m_confirmedFrame >= ROLLBACK_WINDOW_SIZE)
+	{
+		m_numStalls++;
+		return false;
+	}
+
+	if (runFrame(m_currentFrame, localInput) == false)
+	{
+		return false;
+	}
+
+	m_currentFrame++;
+
+	return true;
+}
@@ -0,0 +1,162 @@
+//
+//  NetworkRollback.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include "Controllers.h"
+
+namespace shd
+{
+	// What the match has to provide so NetworkRollback can rewind and replay it
+	class NetworkRollbackSimulation
+	{
+	public:
+
+		virtual ~NetworkRollbackSimulation() {}
+
+		// Copy everything advance() reads or writes into buffer
+		virtual bool saveState(void * buffer, uint32_t bufferSize, uint32_t * stateSize) = 0;
+
+		// Put the match back the way it was when the state was saved
+		virtual bool loadState(const void * buffer, uint32_t stateSize) = 0;
+
+		// Run one tick of the match with these inputs. remoteInputPrevious is what the remote input was the frame before,
+		// for Controllers::setNetworkControllerState(). Called again for the same frame after a rollback, so it can't
+		// play sounds or do anything else that can't be undone without checking isResimulating()
+		virtual void advance(uint32_t frame, const Controllers::State & localInput, const Controllers::State & remoteInput, const Controllers::State & remoteInputPrevious) = 0;
+	};
+
+	// Rollback netcode. Instead of waiting for the other player's input to come out of the jitter buffer, the match
+	// runs straight away on a guess of what they pressed (whatever they pressed last). Every frame's state is saved,
+	// and when their real input turns up and the guess was wrong, the match is put back to that frame and run
+	// forward again with the right input.
+	// Remote inputs are added from the network thread, and everything else happens on the game thread.
+	// The match doesn't use it yet. It has to implement NetworkRollbackSimulation, call advanceFrame() every tick, and
+	// hand over the remote inputs as the NetworkInputBuffer parses them, which this tree can't see into
+	class NetworkRollback
+	{
+	public:
+
+		// How many frames back we can roll. If the other player falls this far behind, the match waits for them
+		static const uint32_t ROLLBACK_WINDOW_SIZE = 16;
+
+		// How many remote inputs are kept, so ones that arrive ahead of us aren't lost
+		static const uint32_t REMOTE_INPUT_HISTORY_SIZE = 64;
+
+		// Remote inputs waiting to be picked up by the game thread
+		static const uint32_t REMOTE_INPUT_QUEUE_SIZE = 64;
+
+		NetworkRollback();
+		~NetworkRollback();
+
+		// maxStateSize is the most bytes saveState() will ever need
+		bool init(NetworkRollbackSimulation * simulation, uint32_t maxStateSize);
+		void term();
+
+		// Start a new match from frame 0
+		void reset();
+
+		// The other player's real input for a frame, using the same 16 bit sequence number the input was sent with.
+		// Called from the network thread
+		bool addRemoteInput(uint16_t sequenceNum, const Controllers::State & input);
+
+		// Roll back if any guesses were wrong, then run the next frame with this local input. Returns false if
+		// the other player is too far behind to guess any more, in which case nothing was run and the local
+		// input should be given again next time
+		bool advanceFrame(const Controllers::State & localInput);
+
+		// Is advance() being called for a frame that has already been run once
+		inline bool isResimulating() { return m_isResimulating; }
+
+		// The next frame that will be run
+		inline uint32_t getCurrentFrame() { return m_currentFrame; }
+
+		// Every frame before this has the other player's real input
+		inline uint32_t getConfirmedFrame() { return m_confirmedFrame; }
+
+		inline uint32_t getNumRollbacks() { return m_numRollbacks; }
+		inline uint32_t getNumFramesResimulated() { return m_numFramesResimulated; }
+		inline uint32_t getMaxRollbackFrames() { return m_maxRollbackFrames; }
+		inline uint32_t getNumStalls() { return m_numStalls; }
+
+	private:
+
+		struct Frame
+		{
+			uint32_t frame;
+			Controllers::State localInput;
+			Controllers::State remoteInput;		// The remote input the frame was run with, real or guessed
+			Controllers::State remoteInputPrevious;	// And the one the frame before was run with
+			uint32_t stateSize;
+			uint8_t * state;					// The match state at the start of the frame
+		};
+
+		struct RemoteInput
+		{
+			uint32_t frame;
+			bool isValid;
+			Controllers::State input;
+		};
+
+		struct QueuedInput
+		{
+			uint16_t sequenceNum;
+			Controllers::State input;
+		};
+
+		// Disable copying
+		NetworkRollback(const NetworkRollback &);
+		NetworkRollback & operator=(const NetworkRollback &);
+
+		// Move remote inputs from the network thread's queue into m_remoteInputs, and note the earliest wrong guess
+		void processRemoteInputs();
+
+		// The real remote input for a frame if we have it, otherwise the last one we have before it
+		const Controllers::State & getRemoteInput(uint32_t frame);
+
+		// Save the state, then run the frame
+		bool runFrame(uint32_t frame, const Controllers::State & localInput);
+
+		// Controllers::State::operator== only looks at buttons and triggers, but a wrong stick guess needs a rollback too
+		static bool isSameInput(const Controllers::State & a, const Controllers::State & b);
+
+		NetworkRollbackSimulation * m_simulation;
+
+		// Saved states for the last ROLLBACK_WINDOW_SIZE frames, indexed by frame number
+		Frame m_frames[ROLLBACK_WINDOW_SIZE];
+
+		// One allocation that all the saved states live in
+		uint8_t * m_stateBuffer;
+		uint32_t m_maxStateSize;
+
+		// Real remote inputs, indexed by frame number
+		RemoteInput m_remoteInputs[REMOTE_INPUT_HISTORY_SIZE];
+
+		// Single producer, single consumer queue from the network thread
+		QueuedInput m_queue[REMOTE_INPUT_QUEUE_SIZE];
+		volatile uint32_t m_queueWriteIndex;
+		volatile uint32_t m_queueReadIndex;
+
+		// What's returned when we have nothing to guess from
+		Controllers::State m_defaultInput;
+
+		uint32_t m_currentFrame;
+		uint32_t m_confirmedFrame;
+
+		// The earliest frame that was run with a wrong guess
+		uint32_t m_rollbackFrame;
+		bool m_needsRollback;
+
+		bool m_isResimulating;
+
+		uint32_t m_numRollbacks;
+		uint32_t m_numFramesResimulated;
+		uint32_t m_maxRollbackFrames;
+		uint32_t m_numStalls;
+	};
+}
@@ -0,0 +1,557 @@
+//
+//  NetworkSendThread.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkSendThread.h"
+#include "NetworkBackendLoopback.h"
+#include "NetworkClock.h"
+#include "Common.h"
+
+using namespace shd;
+
+// How long the thread sleeps when nothing has been flushed, in case something was queued without a flush
+#define SHD_SEND_THREAD_IDLE_WAIT_US 10000
+
+// With a rate cap, the most bytes that can go out back to back after the thread has been idle
+#define SHD_SEND_THREAD_BURST_BYTES 4096
+
+// The benchmark's queues. Each channel is flushed at least once a queue's worth of packets
+#define SHD_SEND_THREAD_BENCHMARK_QUEUE_SIZE 64
+#define SHD_SEND_THREAD_BENCHMARK_RECEIVE_QUEUE_SIZE 256
+#define SHD_SEND_THREAD_BENCHMARK_PACKET_SIZE 1024
+
+NetworkSendChannel::NetworkSendChannel() :	m_backend(nullptr),
+											m_thread(nullptr),
+											m_slots(nullptr),
+											m_queueSize(0),
+											m_writeIndex(0),
+											m_readIndex(0),
+											m_numDropped(0)
+{
+}
+
+NetworkSendChannel::~NetworkSendChannel()
+{
+	term();
+}
+
+bool NetworkSendChannel::init(NetworkBackend * backend, uint32_t queueSize)
+{
+	term();
+
+	// Power of 2, so the indices can wrap around
+	if (backend == nullptr || queueSize == 0 || (queueSize & (queueSize - 1)) != 0)
+	{
+		SHD_ASSERT(false);
+		return false;
+	}
+
+	m_slots = (Slot *)SHD_MALLOC(sizeof(Slot) * queueSize);
+	SHD_ASSERT(m_slots);
+
+	if (m_slots == nullptr)
+	{
+		return false;
+	}
+
+	m_backend = backend;
+	m_queueSize = queueSize;
+	m_writeIndex = 0;
+	m_readIndex = 0;
+	m_numDropped = 0;
+
+	return true;
+}
+
+void NetworkSendChannel::term()
+{
+	// The send thread might still be reading the slots
+	SHD_ASSERT(m_thread == nullptr || m_thread->isRunning() == false);
+
+	if (m_slots)
+	{
+		SHD_FREE(m_slots);
+		m_slots = nullptr;
+	}
+
+	m_backend = nullptr;
+	m_queueSize = 0;
+}
+
+bool NetworkSendChannel::sendPacket(const void * data, uint32_t size, SendType sendType)
+{
+	uint64_t startCycles = NetworkClock::getCycles();
+	uint32_t writeIndex = m_writeIndex;
+	NetworkSendThread * thread = m_thread;
+
+	if (m_slots == nullptr || thread == nullptr)
+	{
+		return false;
+	}
+
+	if (size > MAX_PACKET_SIZE || writeIndex - m_readIndex >= m_queueSize)
+	{
+		// Same as the network dropping it
+		Atomic::add32(&m_numDropped, 1);
+		return false;
+	}
+
+	Slot & slot = m_slots[writeIndex & (m_queueSize - 1)];
+	slot.size = size;
+	slot.sendType = sendType;
+	slot.queuedUs = NetworkClock::getTimeMicroseconds();
+	memcpy(slot.data, data, size);
+
+	// Publish the slot only after it has been filled
+	Atomic::exchange32(&m_writeIndex, writeIndex + 1);
+
+	Atomic::add64(&thread->m_enqueueCycles, (int64_t)(NetworkClock::getCycles() - startCycles));
+	Atomic::add32(&thread->m_numPacketsQueued, 1);
+
+	return true;
+}
+
+bool NetworkSendChannel::isPacketAvailable(uint32_t * msgSize)
+{
+	return m_backend && m_backend->isPacketAvailable(msgSize);
+}
+
+bool NetworkSendChannel::readPacket(void * buffer, uint32_t bufferSize, uint32_t * bytesRead)
+{
+	return m_backend && m_backend->readPacket(buffer, bufferSize, bytesRead);
+}
+
+uint32_t NetworkSendChannel::readPackets(uint8_t * buffers, uint32_t bufferSize, uint32_t * sizes, uint32_t maxPackets)
+{
+	return (m_backend) ? m_backend->readPackets(buffers, bufferSize, sizes, maxPackets) : 0;
+}
+
+bool NetworkSendChannel::flushSends()
+{
+	NetworkSendThread * thread = m_thread;
+
+	if (thread == nullptr)
+	{
+		return false;
+	}
+
+	if (m_writeIndex != m_readIndex)
+	{
+		thread->wake();
+	}
+
+	return true;
+}
+
+uint32_t NetworkSendChannel::service(uint32_t maxBytes, bool * isEmpty)
+{
+	NetworkSendThread * thread = m_thread;
+	uint32_t readIndex = m_readIndex;
+	uint32_t writeIndex = m_writeIndex;
+	uint32_t bytesSent = 0;
+	uint32_t numSent = 0;
+	uint64_t startCycles = 0;
+	uint64_t nowUs = 0;
+	int64_t queueUs = 0;
+
+	if (readIndex == writeIndex)
+	{
+		*isEmpty = true;
+		return 0;
+	}
+
+	startCycles = NetworkClock::getCycles();
+	nowUs = NetworkClock::getTimeMicroseconds();
+
+	while (readIndex != writeIndex)
+	{
+		Slot & slot = m_slots[readIndex & (m_queueSize - 1)];
+
+		if (slot.size > maxBytes - bytesSent)
+		{
+			break;
+		}
+
+		// A failed send is the same as the network dropping it, so it isn't tried again
+		m_backend->sendPacket(slot.data, slot.size, slot.sendType);
+
+		queueUs += (int64_t)(nowUs - slot.queuedUs);
+		bytesSent += slot.size;
+		numSent++;
+		readIndex++;
+	}
+
+	// Give the slots back to the caller's thread
+	Atomic::exchange32(&m_readIndex, readIndex);
+
+	*isEmpty = (readIndex == writeIndex);
+
+	if (numSent == 0)
+	{
+		return 0;
+	}
+
+	// Everything from this channel goes out together
+	m_backend->flushSends();
+
+	Atomic::add64(&thread->m_sendCycles, (int64_t)(NetworkClock::getCycles() - startCycles));
+	Atomic::add64(&thread->m_queueUs, queueUs);
+	Atomic::add32(&thread->m_numPacketsSent, numSent);
+	Atomic::add64(&thread->m_bytesSent, bytesSent);
+	Atomic::add32(&thread->m_numFlushes, 1);
+
+	return bytesSent;
+}
+
+NetworkSendThread::NetworkSendThread() :	m_threadHandle(0),
+											m_isRunning(false),
+											m_endThread(0),
+											m_numChannels(0),
+											m_firstChannel(0),
+											m_bytesPerSecond(0),
+											m_budgetBytes(0.0),
+											m_budgetTimeUs(0),
+											m_enqueueCycles(0),
+											m_sendCycles(0),
+											m_queueUs(0),
+											m_numPacketsQueued(0),
+											m_numPacketsSent(0),
+											m_bytesSent(0),
+											m_numFlushes(0),
+											m_numPacedWaits(0)
+{
+	memset(m_channels, 0, sizeof(m_channels));
+}
+
+NetworkSendThread::~NetworkSendThread()
+{
+	term();
+}
+
+bool NetworkSendThread::init(uint32_t bytesPerSecond)
+{
+	Threading::ThreadStartParams threadParams;
+
+	term();
+
+	// Without eventfd it still works, it just sleeps for the idle time instead of waking on a flush
+	if (m_poller.init() == false)
+	{
+		SHD_PRINTF("Send thread has no poller, so sends will wait for it to wake up\n");
+	}
+
+	m_bytesPerSecond = bytesPerSecond;
+	m_budgetBytes = SHD_SEND_THREAD_BURST_BYTES;
+	m_budgetTimeUs = NetworkClock::getTimeMicroseconds();
+	m_firstChannel = 0;
+	m_endThread = 0;
+
+	threadParams.entryPoint = &threadEntry;
+	threadParams.userArgs = this;
+
+	if (Threading::startThread(threadParams, &m_threadHandle) == false)
+	{
+		SHD_PRINTF("Failed to start the send thread\n");
+		m_poller.term();
+		return false;
+	}
+
+	m_isRunning = true;
+
+	return true;
+}
+
+void NetworkSendThread::term()
+{
+	if (m_isRunning)
+	{
+		// It sends whatever is left before it ends
+		Atomic::exchange32(&m_endThread, 1);
+		m_poller.wake();
+		Threading::joinThread(m_threadHandle);
+
+		m_isRunning = false;
+		m_poller.term();
+	}
+
+	for (uint32_t i = 0; i < m_numChannels; i++)
+	{
+		m_channels[i]->m_thread = nullptr;
+		m_channels[i] = nullptr;
+	}
+
+	m_numChannels = 0;
+}
+
+bool NetworkSendThread::addChannel(NetworkSendChannel * channel)
+{
+	uint32_t numChannels = m_numChannels;
+
+	if (channel == nullptr || channel->m_slots == nullptr || channel->m_thread != nullptr || numChannels == MAX_CHANNELS)
+	{
+		return false;
+	}
+
+	channel->m_thread = this;
+	m_channels[numChannels] = channel;
+
+	// Publish the channel only after it's in place
+	Atomic::exchange32(&m_numChannels, numChannels + 1);
+
+	return true;
+}
+
+void NetworkSendThread::wake()
+{
+	m_poller.wake();
+}
+
+void NetworkSendThread::resetCounters()
+{
+	Atomic::exchange64(&m_enqueueCycles, 0);
+	Atomic::exchange64(&m_sendCycles, 0);
+	Atomic::exchange64(&m_queueUs, 0);
+	Atomic::exchange32(&m_numPacketsQueued, 0);
+	Atomic::exchange32(&m_numPacketsSent, 0);
+	Atomic::exchange64(&m_bytesSent, 0);
+	Atomic::exchange32(&m_numFlushes, 0);
+	Atomic::exchange32(&m_numPacedWaits, 0);
+}
+
+uint32_t NetworkSendThread::serviceChannels(uint32_t maxBytes, bool * isEmpty)
+{
+	uint32_t numChannels = m_numChannels;
+	uint32_t bytesSent = 0;
+
+	*isEmpty = true;
+
+	if (numChannels == 0)
+	{
+		return 0;
+	}
+
+	if (m_firstChannel >= numChannels)
+	{
+		m_firstChannel = 0;
+	}
+
+	for (uint32_t i = 0; i < numChannels; i++)
+	{
+		bool channelIsEmpty = true;
+
+		bytesSent += m_channels[(m_firstChannel + i) % numChannels]->service(maxBytes - bytesSent, &channelIsEmpty);
+
+		if (channelIsEmpty == false)
+		{
+			*isEmpty = false;
+		}
+	}
+
+	m_firstChannel++;
+
+	return bytesSent;
+}
+
+void NetworkSendThread::threadEntry(void * args)
+{
+	NetworkSendThread * thread = (NetworkSendThread *)args;
+	void * ready[1];
+
+	while (true)
+	{
+		bool isEnding = (thread->m_endThread != 0);
+		bool isEmpty = true;
+		bool wasWoken = false;
+		uint32_t maxBytes = 0xFFFFFFFF;
+		uint32_t bytesSent = 0;
+		uint64_t waitUs = SHD_SEND_THREAD_IDLE_WAIT_US;
+
+		// Once it's ending, everything left goes out whatever the cap
+		if (thread->m_bytesPerSecond && isEnding == false)
+		{
+			uint64_t nowUs = NetworkClock::getTimeMicroseconds();
+
+			thread->m_budgetBytes += (double)(nowUs - thread->m_budgetTimeUs) * (double)thread->m_bytesPerSecond / 1000000.0;
+			thread->m_budgetTimeUs = nowUs;
+
+			if (thread->m_budgetBytes > SHD_SEND_THREAD_BURST_BYTES)
+			{
+				thread->m_budgetBytes = SHD_SEND_THREAD_BURST_BYTES;
+			}
+
+			maxBytes = (uint32_t)thread->m_budgetBytes;
+		}
+
+		bytesSent = thread->serviceChannels(maxBytes, &isEmpty);
+
+		if (thread->m_bytesPerSecond)
+		{
+			thread->m_budgetBytes -= (double)bytesSent;
+		}
+
+		if (isEnding && isEmpty)
+		{
+			break;
+		}
+
+		if (isEmpty == false)
+		{
+			// Over the cap, so wait until there's enough budget for the biggest packet
+			double neededBytes = (double)NetworkSendChannel::MAX_PACKET_SIZE - thread->m_budgetBytes;
+
+			waitUs = (neededBytes > 0.0) ? (uint64_t)(neededBytes * 1000000.0 / (double)thread->m_bytesPerSecond) + 1 : 0;
+			Atomic::add32(&thread->m_numPacedWaits, 1);
+		}
+
+		if (waitUs)
+		{
+			thread->m_poller.wait(waitUs, ready, 0, &wasWoken);
+		}
+	}
+}
+
+bool NetworkSendThread::runBenchmark(uint32_t numChannels, uint32_t numPackets, uint32_t packetsPerFlush)
+{
+	NetworkSendThread * thread = nullptr;
+	NetworkSendChannel * channels = nullptr;
+	NetworkBackendLoopback * senders = nullptr;
+	NetworkBackendLoopback * receivers = nullptr;
+	uint8_t * packet = nullptr;
+	uint32_t numReceived = 0;
+	uint32_t bytesRead = 0;
+	uint64_t directCycles = 0;
+	bool ret = true;
+
+	if (numChannels == 0 || numChannels > MAX_CHANNELS || packetsPerFlush == 0 || packetsPerFlush > SHD_SEND_THREAD_BENCHMARK_QUEUE_SIZE)
+	{
+		return false;
+	}
+
+	thread = new NetworkSendThread();
+	channels = new NetworkSendChannel[numChannels];
+	senders = new NetworkBackendLoopback[numChannels];
+	receivers = new NetworkBackendLoopback[numChannels];
+	packet = (uint8_t *)SHD_MALLOC(NetworkBackendLoopback::LOOPBACK_MAX_PACKET_SIZE);
+
+	if (packet == nullptr)
+	{
+		ret = false;
+	}
+
+	for (uint32_t i = 0; ret && i < SHD_SEND_THREAD_BENCHMARK_PACKET_SIZE; i++)
+	{
+		packet[i] = (uint8_t)(i * 31);
+	}
+
+	for (uint32_t i = 0; ret && i < numChannels; i++)
+	{
+		if (receivers[i].init(SHD_SEND_THREAD_BENCHMARK_RECEIVE_QUEUE_SIZE) == false ||
+			channels[i].init(&senders[i], SHD_SEND_THREAD_BENCHMARK_QUEUE_SIZE) == false)
+		{
+			ret = false;
+			break;
+		}
+
+		NetworkBackendLoopback::connect(senders[i], receivers[i]);
+	}
+
+	// What it costs to send straight to the backends, for comparison
+	for (uint32_t sent = 0; ret && sent < numPackets; sent += packetsPerFlush)
+	{
+		for (uint32_t i = 0; i < numChannels; i++)
+		{
+			uint64_t startCycles = NetworkClock::getCycles();
+
+			for (uint32_t j = 0; j < packetsPerFlush; j++)
+			{
+				senders[i].sendPacket(packet, SHD_SEND_THREAD_BENCHMARK_PACKET_SIZE, NetworkBackend::SEND_TYPE_UNRELIABLE);
+			}
+
+			senders[i].flushSends();
+			directCycles += NetworkClock::getCycles() - startCycles;
+
+			while (receivers[i].readPacket(packet, NetworkBackendLoopback::LOOPBACK_MAX_PACKET_SIZE, &bytesRead))
+			{
+			}
+		}
+	}
+
+	if (ret && thread->init(0) == false)
+	{
+		ret = false;
+	}
+
+	for (uint32_t i = 0; ret && i < numChannels; i++)
+	{
+		thread->addChannel(&channels[i]);
+	}
+
+	for (uint32_t sent = 0; ret && sent < numPackets; sent += packetsPerFlush)
+	{
+		for (uint32_t i = 0; i < numChannels; i++)
+		{
+			// Only a queue's worth can be waiting, so give the thread a chance to catch up
+			while (channels[i].getNumWaiting() + packetsPerFlush > SHD_SEND_THREAD_BENCHMARK_QUEUE_SIZE)
+			{
+				Threading::sleep(0);
+			}
+
+			for (uint32_t j = 0; j < packetsPerFlush; j++)
+			{
+				channels[i].sendPacket(packet, SHD_SEND_THREAD_BENCHMARK_PACKET_SIZE, NetworkBackend::SEND_TYPE_UNRELIABLE);
+			}
+
+			channels[i].flushSends();
+
+			while (receivers[i].readPacket(packet, NetworkBackendLoopback::LOOPBACK_MAX_PACKET_SIZE, &bytesRead))
+			{
+				numReceived++;
+			}
+		}
+	}
+
+	// Sends whatever is left
+	thread->term();
+
+	for (uint32_t i = 0; ret && i < numChannels; i++)
+	{
+		while (receivers[i].readPacket(packet, NetworkBackendLoopback::LOOPBACK_MAX_PACKET_SIZE, &bytesRead))
+		{
+			numReceived++;
+		}
+	}
+
+	if (ret)
+	{
+		uint32_t numQueued = thread->getNumPacketsQueued();
+
+		SHD_PRINTF("%u channels: %llu cycles to send a packet directly, %llu cycles to queue one, %llu cycles on the send thread\n",
+			numChannels,
+			(unsigned long long)((numQueued) ? directCycles / numQueued : 0),
+			(unsigned long long)thread->getAverageEnqueueCycles(),
+			(unsigned long long)thread->getAverageSendCycles());
+
+		SHD_PRINTF("%u packets queued, %u sent in %u flushes, %u received, %llu us average wait in the queue\n",
+			numQueued,
+			thread->getNumPacketsSent(),
+			thread->getNumFlushes(),
+			numReceived,
+			(unsigned long long)thread->getAverageQueueMicroseconds());
+	}
+
+	if (packet)
+	{
+		SHD_FREE(packet);
+	}
+
+	delete thread;
+	delete[] channels;
+	delete[] senders;
+	delete[] receivers;
+
+	return ret;
+}
@@ -0,0 +1,194 @@
+//
+//  NetworkSendThread.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include "NetworkBackend.h"
+#include "NetworkPoller.h"
+#include "Threading.h"
+#include <stdint.h>
+
+namespace shd
+{
+	class NetworkSendThread;
+
+	// Sits between NetworkTransport and a real backend, and hands its packets to a NetworkSendThread instead of sending
+	// them. sendPacket() only copies the packet into the next of a fixed number of pre-allocated slots, and
+	// flushSends() wakes the send thread, which sends everything queued since the last flush with one flush of the
+	// real backend. Reads go straight through to the real backend on the caller's thread, so it has to be happy being
+	// read on one thread while it sends on another, which the UDP and Steam backends are.
+	// Each channel is a single producer, single consumer queue, and the send thread services all of them, so every
+	// NetworkTransport on every thread has its own channel
+	class NetworkSendChannel : public NetworkBackend
+	{
+	public:
+
+		// The biggest packet a channel will take
+		static const uint32_t MAX_PACKET_SIZE = 1536;
+
+		NetworkSendChannel();
+		~NetworkSendChannel();
+
+		// queueSize packets can be waiting to be sent, and must be a power of 2. The channel isn't used until it's
+		// added to a send thread, and the thread has to be stopped before term()
+		bool init(NetworkBackend * backend, uint32_t queueSize);
+		void term();
+
+		virtual bool sendPacket(const void * data, uint32_t size, SendType sendType);
+		virtual bool isPacketAvailable(uint32_t * msgSize);
+		virtual bool readPacket(void * buffer, uint32_t bufferSize, uint32_t * bytesRead);
+		virtual uint32_t readPackets(uint8_t * buffers, uint32_t bufferSize, uint32_t * sizes, uint32_t maxPackets);
+		virtual bool flushSends();
+
+		inline NetworkBackend * getBackend() { return m_backend; }
+
+		// How many packets are waiting for the send thread
+		inline uint32_t getNumWaiting() { return m_writeIndex - m_readIndex; }
+
+		// Packets thrown away because the queue was full or they were too big
+		inline uint32_t getNumDropped() { return m_numDropped; }
+
+	private:
+
+		friend class NetworkSendThread;
+
+		struct Slot
+		{
+			uint32_t size;
+			SendType sendType;
+
+			// NetworkClock::getTimeMicroseconds() when it was queued
+			uint64_t queuedUs;
+
+			uint8_t data[MAX_PACKET_SIZE];
+		};
+
+		// Disable copying
+		NetworkSendChannel(const NetworkSendChannel &);
+		NetworkSendChannel & operator=(const NetworkSendChannel &);
+
+		// Send queued packets until the queue is empty or the next one won't fit in maxBytes, then flush the real
+		// backend if anything was sent. Called on the send thread. Returns how many bytes were sent
+		uint32_t service(uint32_t maxBytes, bool * isEmpty);
+
+		// The backend that really sends the packets
+		NetworkBackend * m_backend;
+
+		// Woken by flushSends(). Set while the channel is added to one
+		NetworkSendThread * volatile m_thread;
+
+		// All of the slots, in one allocation
+		Slot * m_slots;
+		uint32_t m_queueSize;
+
+		// Written by the caller's thread and the send thread respectively
+		volatile uint32_t m_writeIndex;
+		volatile uint32_t m_readIndex;
+
+		volatile uint32_t m_numDropped;
+	};
+
+	// Sends the packets queued on any number of NetworkSendChannels, so whoever owns each NetworkTransport only pays
+	// for serializing a packet and copying it into a slot, not for the system calls. Everything queued on a channel
+	// before a flush goes out with one flush of its backend. The total rate can be capped, in which case the thread
+	// sends no faster than that, in bursts of up to a few packets, rather than letting a whole tick's packets go at once
+	class NetworkSendThread
+	{
+	public:
+
+		// The most channels one send thread can service
+		static const uint32_t MAX_CHANNELS = 4096;
+
+		NetworkSendThread();
+		~NetworkSendThread();
+
+		// Start the thread. bytesPerSecond caps how fast it sends, or 0 for as fast as it can
+		bool init(uint32_t bytesPerSecond);
+
+		// Send whatever is still queued, stop the thread and let go of every channel
+		void term();
+
+		inline bool isRunning() { return m_isRunning; }
+
+		// Start servicing a channel. Channels can be added while the thread is running, but only from one thread at a
+		// time, and they're only let go of by term()
+		bool addChannel(NetworkSendChannel * channel);
+		inline uint32_t getNumChannels() { return m_numChannels; }
+
+		// Get the thread to look at its channels. Called by NetworkSendChannel::flushSends()
+		void wake();
+
+		// Time from a packet being queued to it being sent, cost of queuing one and of sending one.
+		// Cycles are NetworkClock::getCycles() units
+		inline uint64_t getAverageQueueMicroseconds() { return (m_numPacketsSent) ? (uint64_t)m_queueUs / m_numPacketsSent : 0; }
+		inline uint64_t getAverageEnqueueCycles() { return (m_numPacketsQueued) ? (uint64_t)m_enqueueCycles / m_numPacketsQueued : 0; }
+		inline uint64_t getAverageSendCycles() { return (m_numPacketsSent) ? (uint64_t)m_sendCycles / m_numPacketsSent : 0; }
+
+		inline uint32_t getNumPacketsQueued() { return m_numPacketsQueued; }
+		inline uint32_t getNumPacketsSent() { return m_numPacketsSent; }
+		inline int64_t getTotalBytesSent() { return m_bytesSent; }
+
+		// How many backend flushes the sends went out in
+		inline uint32_t getNumFlushes() { return m_numFlushes; }
+
+		// Times the thread had packets to send but waited, to stay under the rate cap
+		inline uint32_t getNumPacedWaits() { return m_numPacedWaits; }
+
+		void resetCounters();
+
+		// Queue numPackets packets on each of numChannels channels from this thread, with a flush after every
+		// packetsPerFlush, and print the cost of each stage. Loopback backends, so it's the thread's own cost
+		static bool runBenchmark(uint32_t numChannels, uint32_t numPackets, uint32_t packetsPerFlush);
+
+	private:
+
+		friend class NetworkSendChannel;
+
+		// Disable copying
+		NetworkSendThread(const NetworkSendThread &);
+		NetworkSendThread & operator=(const NetworkSendThread &);
+
+		// Entry func for the thread
+		static void threadEntry(void * args);
+
+		// Service every channel once, up to maxBytes between them. Returns how many bytes were sent, and sets
+		// isEmpty if nothing was left queued
+		uint32_t serviceChannels(uint32_t maxBytes, bool * isEmpty);
+
+		Threading::ThreadHandle m_threadHandle;
+		bool m_isRunning;
+
+		// Should the thread stop?
+		volatile uint32_t m_endThread;
+
+		// Sleeps until a channel is flushed
+		NetworkPoller m_poller;
+
+		// Channels are only ever appended, and the count is published after the channel is in place
+		NetworkSendChannel * m_channels[MAX_CHANNELS];
+		volatile uint32_t m_numChannels;
+
+		// Which channel is serviced first next time, so a rate cap doesn't always favour the first ones
+		uint32_t m_firstChannel;
+
+		// 0 for no cap, and bytes the thread can send right now, built up at bytesPerSecond
+		uint32_t m_bytesPerSecond;
+		double m_budgetBytes;
+		uint64_t m_budgetTimeUs;
+
+		// Stage timings, written by the channels' threads and the send thread
+		volatile int64_t m_enqueueCycles;
+		volatile int64_t m_sendCycles;
+		volatile int64_t m_queueUs;
+		volatile uint32_t m_numPacketsQueued;
+		volatile uint32_t m_numPacketsSent;
+		volatile int64_t m_bytesSent;
+		volatile uint32_t m_numFlushes;
+		volatile uint32_t m_numPacedWaits;
+	};
+}
@@ -0,0 +1,77 @@
+//
+//  NetworkSequence.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkSequence.h"
+
+using namespace shd;
+
+NetworkReceiveWindow::NetworkReceiveWindow()
+{
+	reset();
+}
+
+void NetworkReceiveWindow::reset()
+{
+	m_newest = 0;
+	m_receivedBits = 0;
+	m_hasReceived = false;
+}
+
+NetworkReceiveWindow::Result NetworkReceiveWindow::classify(uint16_t sequenceNum) const
+{
+	int32_t age = NetworkSequence::difference(m_newest, sequenceNum);
+
+	if (m_hasReceived == false || age < 0)
+	{
+		return RESULT_NEWEST;
+	}
+
+	if (age == 0)
+	{
+		return RESULT_DUPLICATE;
+	}
+
+	if (age > (int32_t)WINDOW_SIZE)
+	{
+		return RESULT_TOO_OLD;
+	}
+
+	return (m_receivedBits & (1u << (age - 1))) ? RESULT_DUPLICATE : RESULT_LATE;
+}
+
+NetworkReceiveWindow::Result NetworkReceiveWindow::markReceived(uint16_t sequenceNum)
+{
+	Result result = classify(sequenceNum);
+
+	if (result == RESULT_NEWEST)
+	{
+		if (m_hasReceived)
+		{
+			// Slide the window along. The old newest becomes one of the bits
+			uint32_t advance = (uint32_t)NetworkSequence::difference(sequenceNum, m_newest);
+
+			if (advance < WINDOW_SIZE)
+			{
+				m_receivedBits = (m_receivedBits << advance) | (1u << (advance - 1));
+			}
+			else
+			{
+				m_receivedBits = (advance == WINDOW_SIZE) ? (1u << (WINDOW_SIZE - 1)) : 0;
+			}
+		}
+
+		m_newest = sequenceNum;
+		m_hasReceived = true;
+	}
+	else if (result == RESULT_LATE)
+	{
+		m_receivedBits |= 1u << (NetworkSequence::difference(m_newest, sequenceNum) - 1);
+	}
+
+	return result;
+}
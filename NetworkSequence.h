@@ -0,0 +1,76 @@
+//
+//  NetworkSequence.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+namespace shd
+{
+	// 16 bit sequence numbers wrap around every 65536 packets (about 18 minutes at 60 a second),
+	// so they're compared with serial number arithmetic: a is newer than b if it's less than half the range ahead
+	namespace NetworkSequence
+	{
+		inline bool isNewer(uint16_t a, uint16_t b)
+		{
+			return (int16_t)(a - b) > 0;
+		}
+
+		// How far a is ahead of b. Negative if a is older
+		inline int32_t difference(uint16_t a, uint16_t b)
+		{
+			return (int16_t)(a - b);
+		}
+	}
+
+	// Tracks which sequence numbers have been received: the newest one, and a window of the ones just before it.
+	// The window doubles as the ACK bitfield that's sent back to the other side
+	class NetworkReceiveWindow
+	{
+	public:
+
+		static const uint32_t WINDOW_SIZE = 32;
+
+		enum Result
+		{
+			RESULT_NEWEST = 0,		// Newer than anything received so far
+			RESULT_LATE,			// Older than the newest, but inside the window and not seen before
+			RESULT_DUPLICATE,		// Already received
+			RESULT_TOO_OLD			// Fell out of the back of the window, so there's no telling
+		};
+
+		NetworkReceiveWindow();
+		void reset();
+
+		// What would receiving this sequence number mean. Doesn't change anything
+		Result classify(uint16_t sequenceNum) const;
+
+		// Has this been received, or is it too old to matter
+		inline bool isReceived(uint16_t sequenceNum) const { Result result = classify(sequenceNum); return result == RESULT_DUPLICATE || result == RESULT_TOO_OLD; }
+
+		// Record that a sequence number was received. Returns what it was classified as
+		Result markReceived(uint16_t sequenceNum);
+
+		inline bool hasReceived() const { return m_hasReceived; }
+		inline uint16_t getNewest() const { return m_newest; }
+
+		// Bit n is set if (getNewest() - 1 - n) was received
+		inline uint32_t getAckBits() const { return m_receivedBits; }
+
+	private:
+
+		// The newest sequence number received
+		uint16_t m_newest;
+
+		// Which of the WINDOW_SIZE sequence numbers before m_newest were received
+		uint32_t m_receivedBits;
+
+		// Has anything been received yet
+		bool m_hasReceived;
+	};
+}
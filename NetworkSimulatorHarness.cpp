@@ -0,0 +1,344 @@
+//
+//  NetworkSimulatorHarness.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkSimulatorHarness.h"
+#include "NetworkTransport.h"
+#include "NetworkClock.h"
+#include "NetworkSequence.h"
+#include "Common.h"
+
+using namespace shd;
+
+// Bytes of made up input in every body, and of made up state in a full state update
+#define SHD_HARNESS_INPUT_SIZE 8
+#define SHD_HARNESS_STATE_SIZE 256
+
+// The input number, and whether it's a full state update, go in front
+#define SHD_HARNESS_BODY_HEADER_SIZE 3
+
+// Peer A sends a full state update every this many inputs
+#define SHD_HARNESS_FULL_STATE_INTERVAL 30
+
+NetworkSimulatorHarness::Peer::Peer() :	sendsFullStateUpdates(false),
+										nextInputNum(0),
+										lastReceivedInputNum(0),
+										hasReceived(false),
+										numSent(0),
+										numReceived(0),
+										numInvalid(0)
+{
+}
+
+void NetworkSimulatorHarness::Peer::reset(bool sendsFullStateUpdatesIn)
+{
+	sendsFullStateUpdates = sendsFullStateUpdatesIn;
+	nextInputNum = 0;
+	lastReceivedInputNum = 0;
+	hasReceived = false;
+	numSent = 0;
+	numReceived = 0;
+	numInvalid = 0;
+}
+
+uint32_t NetworkSimulatorHarness::Peer::writeBody(uint16_t inputNum, bool isFullStateUpdate, uint8_t * buffer, uint32_t bufferSize)
+{
+	uint32_t size = SHD_HARNESS_BODY_HEADER_SIZE + SHD_HARNESS_INPUT_SIZE + ((isFullStateUpdate) ? SHD_HARNESS_STATE_SIZE : 0);
+
+	if (size > bufferSize)
+	{
+		return 0;
+	}
+
+	buffer[0] = (uint8_t)(inputNum & 0xFF);
+	buffer[1] = (uint8_t)(inputNum >> 8);
+	buffer[2] = (isFullStateUpdate) ? 1 : 0;
+	buffer += SHD_HARNESS_BODY_HEADER_SIZE;
+
+	for (uint32_t i = 0; i < SHD_HARNESS_INPUT_SIZE; i++)
+	{
+		buffer[i] = (uint8_t)(inputNum * 7 + i * 31);
+	}
+
+	buffer += SHD_HARNESS_INPUT_SIZE;
+
+	// Most of the state stays the same from one update to the next, like a real match, so there's something to delta against
+	for (uint32_t i = 0; isFullStateUpdate && i < SHD_HARNESS_STATE_SIZE; i++)
+	{
+		buffer[i] = (uint8_t)(i * 13 + ((i % 16 == 0) ? inputNum / SHD_HARNESS_FULL_STATE_INTERVAL : 0));
+	}
+
+	return size;
+}
+
+void NetworkSimulatorHarness::Peer::getTeamColours(uint8_t * primary, uint8_t * secondary)
+{
+	*primary = (sendsFullStateUpdates) ? 0 : 1;
+	*secondary = (sendsFullStateUpdates) ? 1 : 0;
+}
+
+void NetworkSimulatorHarness::Peer::onHandshakeReceived(uint8_t primary, uint8_t secondary)
+{
+	(void)primary;
+	(void)secondary;
+}
+
+void NetworkSimulatorHarness::Peer::onHandshakeAckReceived(uint8_t primary, uint8_t secondary)
+{
+	(void)primary;
+	(void)secondary;
+}
+
+void NetworkSimulatorHarness::Peer::fillSendBuffer(uint8_t * buffer, size_t bufferSize, size_t * bytesWritten, bool * isFullStateUpdate)
+{
+	*isFullStateUpdate = sendsFullStateUpdates && (nextInputNum % SHD_HARNESS_FULL_STATE_INTERVAL) == 0;
+	*bytesWritten = writeBody(nextInputNum, *isFullStateUpdate, buffer, (uint32_t)bufferSize);
+
+	if (*bytesWritten)
+	{
+		nextInputNum++;
+		numSent++;
+	}
+}
+
+void NetworkSimulatorHarness::Peer::parseRecvBuffer(void * buffer, size_t bufferSize, bool isFullStateUpdate)
+{
+	uint8_t expected[SHD_HARNESS_BODY_HEADER_SIZE + SHD_HARNESS_INPUT_SIZE + SHD_HARNESS_STATE_SIZE];
+	const uint8_t * body = (const uint8_t *)buffer;
+	uint16_t inputNum = 0;
+	uint32_t expectedSize = 0;
+
+	if (bufferSize < SHD_HARNESS_BODY_HEADER_SIZE)
+	{
+		numInvalid++;
+		return;
+	}
+
+	// Whatever the body says it is, it has to be exactly what the other side writes for that input number
+	inputNum = (uint16_t)(body[0] | (body[1] << 8));
+	expectedSize = writeBody(inputNum, isFullStateUpdate, expected, sizeof(expected));
+
+	if (bufferSize != expectedSize || memcmp(body, expected, expectedSize) != 0)
+	{
+		numInvalid++;
+		return;
+	}
+
+	numReceived++;
+
+	if (hasReceived == false || NetworkSequence::isNewer(inputNum, lastReceivedInputNum))
+	{
+		lastReceivedInputNum = inputNum;
+		hasReceived = true;
+	}
+}
+
+uint16_t NetworkSimulatorHarness::Peer::getLastReceivedSeqNum()
+{
+	return lastReceivedInputNum;
+}
+
+bool NetworkSimulatorHarness::Peer::popGameEvent(GameEvent * event)
+{
+	(void)event;
+	return false;
+}
+
+void NetworkSimulatorHarness::Peer::onGameEvent(const GameEvent & event)
+{
+	(void)event;
+}
+
+NetworkSimulatorHarness::NetworkSimulatorHarness() :	m_peerA(nullptr),
+														m_peerB(nullptr),
+														m_timeUs(0),
+														m_numTicks(0)
+{
+}
+
+NetworkSimulatorHarness::~NetworkSimulatorHarness()
+{
+	term();
+}
+
+bool NetworkSimulatorHarness::init(const NetworkConditionSimulator::Config & aToB, const NetworkConditionSimulator::Config & bToA)
+{
+	term();
+
+	if (m_loopbackA.init() == false || m_loopbackB.init() == false)
+	{
+		term();
+		return false;
+	}
+
+	NetworkBackendLoopback::connect(m_loopbackA, m_loopbackB);
+
+	if (m_simulatorA.init(&m_loopbackA, aToB) == false || m_simulatorB.init(&m_loopbackB, bToA) == false)
+	{
+		term();
+		return false;
+	}
+
+	m_handlerA.reset(true);
+	m_handlerB.reset(false);
+
+	m_peerA = new NetworkTransport();
+	m_peerB = new NetworkTransport();
+	m_peerA->setBackend(&m_simulatorA);
+	m_peerB->setBackend(&m_simulatorB);
+	m_peerA->setHandler(&m_handlerA);
+	m_peerB->setHandler(&m_handlerB);
+
+	// Start the clock somewhere that isn't 0, since 0 means use the real time
+	m_timeUs = 1000 * 1000;
+	m_numTicks = 0;
+
+	// A connects and B accepts. run() finishes the handshake on the simulated clock
+	NetworkClock::setSimulatedTimeMicroseconds(m_timeUs);
+	m_peerB->accept();
+	m_peerA->connect();
+	NetworkClock::setSimulatedTimeMicroseconds(0);
+
+	return true;
+}
+
+void NetworkSimulatorHarness::term()
+{
+	if (m_peerA)
+	{
+		delete m_peerA;
+		m_peerA = nullptr;
+	}
+
+	if (m_peerB)
+	{
+		delete m_peerB;
+		m_peerB = nullptr;
+	}
+
+	m_simulatorA.term();
+	m_simulatorB.term();
+	m_loopbackA.term();
+	m_loopbackB.term();
+}
+
+void NetworkSimulatorHarness::run(uint32_t numTicks, uint64_t tickUs, Result * resultA, Result * resultB)
+{
+	if (m_peerA == nullptr || m_peerB == nullptr)
+	{
+		SHD_ASSERT(false);
+		return;
+	}
+
+	NetworkTransport * peers[2] = { m_peerA, m_peerB };
+
+	for (uint32_t i = 0; i < numTicks; i++)
+	{
+		NetworkClock::setSimulatedTimeMicroseconds(m_timeUs);
+
+		for (uint32_t j = 0; j < 2; j++)
+		{
+			if (peers[j]->getConnectState() == NetworkTransport::CONNECT_STATE_CONNECTED)
+			{
+				peers[j]->sendData();
+			}
+		}
+
+		// Get anything that's due onto the wire before either side reads, so neither peer gets a head start
+		m_simulatorA.update();
+		m_simulatorB.update();
+
+		// Until a peer is connected it's still shaking hands, which resends the handshake if it goes missing
+		for (uint32_t j = 0; j < 2; j++)
+		{
+			if (peers[j]->getConnectState() == NetworkTransport::CONNECT_STATE_CONNECTED)
+			{
+				peers[j]->receiveData();
+			}
+			else
+			{
+				peers[j]->updateConnect();
+			}
+		}
+
+		m_timeUs += tickUs;
+		m_numTicks++;
+	}
+
+	// Back to the real clock
+	NetworkClock::setSimulatedTimeMicroseconds(0);
+
+	fillResult(m_peerA, m_handlerA, resultA);
+	fillResult(m_peerB, m_handlerB, resultB);
+}
+
+void NetworkSimulatorHarness::fillResult(NetworkTransport * peer, Peer & handler, Result * result)
+{
+	if (result == nullptr)
+	{
+		return;
+	}
+
+	result->isConnected = (peer->getConnectState() == NetworkTransport::CONNECT_STATE_CONNECTED);
+	result->numTicks = m_numTicks;
+	result->numInputsSent = handler.numSent;
+	result->numInputsReceived = handler.numReceived;
+	result->numInvalidInputs = handler.numInvalid;
+	result->rttUs = peer->getStats().getRttMicroseconds();
+	result->jitterUs = peer->getStats().getJitterMicroseconds();
+	result->lossPercent = peer->getStats().getTotalLossPercent();
+	result->numOutOfOrder = peer->getStats().getNumOutOfOrder();
+	result->numDuplicates = peer->getStats().getNumDuplicates();
+	result->numInputFramesRecovered = peer->getNumInputFramesRecovered();
+	result->bytesSent = peer->getTotalBytesSent();
+	result->averageSendCycles = peer->getAverageSendCycles();
+	result->averageReceiveCycles = peer->getAverageReceiveCycles();
+}
+
+bool NetworkSimulatorHarness::runProfile(NetworkConditionSimulator::Profile profile, uint32_t seed, uint32_t numTicks)
+{
+	NetworkSimulatorHarness * harness = new NetworkSimulatorHarness();
+	Result results[2];
+	bool ret = true;
+
+	// Different seeds each way, otherwise both directions lose the same packets
+	if (harness->init(	NetworkConditionSimulator::getProfileConfig(profile, seed),
+						NetworkConditionSimulator::getProfileConfig(profile, seed * 2654435761u + 1)) == false)
+	{
+		delete harness;
+		return false;
+	}
+
+	harness->run(numTicks, 1000 * 1000 / 60, &results[0], &results[1]);
+
+	for (int i = 0; i < 2; i++)
+	{
+		SHD_PRINTF("Profile %d peer %c: %s, %u ticks, inputs sent %u, received %u, invalid %u, rtt %u us, jitter %u us, loss %.2f%%, out of order %u, duplicates %u, inputs recovered %u, bytes sent %lld\n",
+			(int)profile,
+			'A' + i,
+			(results[i].isConnected) ? "connected" : "not connected",
+			results[i].numTicks,
+			results[i].numInputsSent,
+			results[i].numInputsReceived,
+			results[i].numInvalidInputs,
+			results[i].rttUs,
+			results[i].jitterUs,
+			results[i].lossPercent,
+			results[i].numOutOfOrder,
+			results[i].numDuplicates,
+			results[i].numInputFramesRecovered,
+			(long long)results[i].bytesSent);
+
+		if (results[i].isConnected == false || results[i].numInvalidInputs)
+		{
+			ret = false;
+		}
+	}
+
+	delete harness;
+	return ret;
+}
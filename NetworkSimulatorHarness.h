@@ -0,0 +1,119 @@
+//
+//  NetworkSimulatorHarness.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include "NetworkConditionSimulator.h"
+#include "NetworkBackendLoopback.h"
+#include "NetworkTransportHandler.h"
+
+namespace shd
+{
+	class NetworkTransport;
+
+	// Two NetworkTransports in the same process, connected through loopback backends with a
+	// NetworkConditionSimulator in each direction. Runs them tick by tick on a simulated clock, so a
+	// network profile can be replayed exactly and the results compared between builds.
+	// Each peer has its own handler, which makes up an input body every tick from a counter, and peer A sends a full
+	// state update every so often, the same as the host does in a match. The other side checks every body it gets is
+	// one that could have been sent. Nothing touches the game, so this measures the transport and not the match
+	class NetworkSimulatorHarness
+	{
+	public:
+
+		struct Result
+		{
+			bool isConnected;
+			uint32_t numTicks;
+			uint32_t numInputsSent;			// Bodies this peer sent
+			uint32_t numInputsReceived;		// Bodies this peer got that were what the other side sent
+			uint32_t numInvalidInputs;		// Bodies this peer got that the other side couldn't have sent
+			uint32_t rttUs;
+			uint32_t jitterUs;
+			float lossPercent;
+			uint32_t numOutOfOrder;
+			uint32_t numDuplicates;
+			uint32_t numInputFramesRecovered;
+			int64_t bytesSent;
+			uint64_t averageSendCycles;
+			uint64_t averageReceiveCycles;
+		};
+
+		NetworkSimulatorHarness();
+		~NetworkSimulatorHarness();
+
+		// aToB is what packets from peer A to peer B go through, bToA the other way
+		bool init(const NetworkConditionSimulator::Config & aToB, const NetworkConditionSimulator::Config & bToA);
+		void term();
+
+		// Run both peers for numTicks ticks, tickUs apart on the simulated clock. Fills in a result for each peer
+		void run(uint32_t numTicks, uint64_t tickUs, Result * resultA, Result * resultB);
+
+		// Run a profile in both directions for numTicks at 60 ticks a second, and print what happened. Returns false if
+		// the peers didn't connect, or either of them got a body that wasn't sent
+		static bool runProfile(NetworkConditionSimulator::Profile profile, uint32_t seed, uint32_t numTicks);
+
+		inline NetworkTransport * getPeerA() { return m_peerA; }
+		inline NetworkTransport * getPeerB() { return m_peerB; }
+
+	private:
+
+		class Peer : public NetworkTransportHandler
+		{
+		public:
+
+			Peer();
+			void reset(bool sendsFullStateUpdates);
+
+			// Write the body that goes with an input number. Returns its size, or 0 if it doesn't fit
+			static uint32_t writeBody(uint16_t inputNum, bool isFullStateUpdate, uint8_t * buffer, uint32_t bufferSize);
+
+			virtual void getTeamColours(uint8_t * primary, uint8_t * secondary);
+			virtual void onHandshakeReceived(uint8_t primary, uint8_t secondary);
+			virtual void onHandshakeAckReceived(uint8_t primary, uint8_t secondary);
+			virtual void fillSendBuffer(uint8_t * buffer, size_t bufferSize, size_t * bytesWritten, bool * isFullStateUpdate);
+			virtual void parseRecvBuffer(void * buffer, size_t bufferSize, bool isFullStateUpdate);
+			virtual uint16_t getLastReceivedSeqNum();
+			virtual bool popGameEvent(GameEvent * event);
+			virtual void onGameEvent(const GameEvent & event);
+
+			// Is this the side that sends full state updates
+			bool sendsFullStateUpdates;
+
+			// The next input number to send, and the newest one received
+			uint16_t nextInputNum;
+			uint16_t lastReceivedInputNum;
+			bool hasReceived;
+
+			uint32_t numSent;
+			uint32_t numReceived;
+			uint32_t numInvalid;
+		};
+
+		// Disable copying
+		NetworkSimulatorHarness(const NetworkSimulatorHarness &);
+		NetworkSimulatorHarness & operator=(const NetworkSimulatorHarness &);
+
+		void fillResult(NetworkTransport * peer, Peer & handler, Result * result);
+
+		NetworkBackendLoopback m_loopbackA;
+		NetworkBackendLoopback m_loopbackB;
+		NetworkConditionSimulator m_simulatorA;
+		NetworkConditionSimulator m_simulatorB;
+		Peer m_handlerA;
+		Peer m_handlerB;
+
+		// These are big, so they live on the heap
+		NetworkTransport * m_peerA;
+		NetworkTransport * m_peerB;
+
+		// Where the simulated clock is up to
+		uint64_t m_timeUs;
+		uint32_t m_numTicks;
+	};
+}
@@ -0,0 +1,341 @@
+//
+//  NetworkSpectatorBroadcast.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkSpectatorBroadcast.h"
+#include "NetworkTransport.h"
+#include "NetworkBackendLoopback.h"
+#include "NetworkSequence.h"
+#include "NetworkClock.h"
+#include "Common.h"
+
+using namespace shd;
+
+// The benchmark's spectators only ever have a frame or two waiting, so they don't need the default loopback queue
+#define SHD_SPECTATOR_BENCHMARK_QUEUE_SIZE 8
+
+// Size of the game state the benchmark sends, and how many bytes of it change each frame
+#define SHD_SPECTATOR_BENCHMARK_STATE_SIZE 1024
+#define SHD_SPECTATOR_BENCHMARK_CHANGED_BYTES 64
+
+NetworkSpectatorBroadcast::NetworkSpectatorBroadcast() :	m_frames(nullptr),
+															m_numFreeFrames(0),
+															m_numSpectators(0),
+															m_keyframe(nullptr),
+															m_encodeCycles(0),
+															m_sendCycles(0),
+															m_numFramesEncoded(0),
+															m_numFramesSent(0),
+															m_bytesSent(0)
+{
+	m_keyframeState.valid = false;
+
+	m_frames = (Frame *)SHD_MALLOC(sizeof(Frame) * FRAME_POOL_SIZE);
+	SHD_ASSERT(m_frames);
+
+	if (m_frames == nullptr)
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; i < FRAME_POOL_SIZE; i++)
+	{
+		m_freeFrames[m_numFreeFrames++] = &m_frames[i];
+	}
+}
+
+NetworkSpectatorBroadcast::~NetworkSpectatorBroadcast()
+{
+	reset();
+
+	// Everything should have been given back by now
+	SHD_ASSERT(m_frames == nullptr || m_numFreeFrames == FRAME_POOL_SIZE);
+
+	if (m_frames)
+	{
+		SHD_FREE(m_frames);
+		m_frames = nullptr;
+	}
+}
+
+bool NetworkSpectatorBroadcast::addSpectator(NetworkBackend * backend)
+{
+	if (backend == nullptr || m_numSpectators == MAX_SPECTATORS)
+	{
+		return false;
+	}
+
+	for (uint32_t i = 0; i < m_numSpectators; i++)
+	{
+		if (m_spectators[i].backend == backend)
+		{
+			return false;
+		}
+	}
+
+	m_spectators[m_numSpectators].backend = backend;
+	m_spectators[m_numSpectators].needsKeyframe = true;
+	m_numSpectators++;
+
+	return true;
+}
+
+bool NetworkSpectatorBroadcast::removeSpectator(NetworkBackend * backend)
+{
+	for (uint32_t i = 0; i < m_numSpectators; i++)
+	{
+		if (m_spectators[i].backend == backend)
+		{
+			// Order doesn't matter, so the last one fills the gap
+			m_spectators[i] = m_spectators[--m_numSpectators];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+NetworkSpectatorBroadcast::Frame * NetworkSpectatorBroadcast::acquireFrame()
+{
+	if (m_numFreeFrames == 0)
+	{
+		SHD_PRINTF("Out of spectator frames!\n");
+		return nullptr;
+	}
+
+	Frame * frame = m_freeFrames[--m_numFreeFrames];
+	frame->refCount = 1;
+	frame->sequenceNum = 0;
+	frame->isKeyframe = false;
+	frame->numPackets = 0;
+	frame->size = 0;
+
+	return frame;
+}
+
+void NetworkSpectatorBroadcast::addRef(Frame * frame)
+{
+	SHD_ASSERT(frame->refCount > 0);
+	frame->refCount++;
+}
+
+void NetworkSpectatorBroadcast::release(Frame * frame)
+{
+	SHD_ASSERT(frame >= m_frames && frame < m_frames + FRAME_POOL_SIZE);
+	SHD_ASSERT(frame->refCount > 0);
+
+	if (--frame->refCount == 0)
+	{
+		SHD_ASSERT(m_numFreeFrames < FRAME_POOL_SIZE);
+		m_freeFrames[m_numFreeFrames++] = frame;
+	}
+}
+
+bool NetworkSpectatorBroadcast::isKeyframeDue(uint16_t sequenceNum)
+{
+	return	m_keyframeState.valid == false ||
+			NetworkSequence::difference(sequenceNum, m_keyframeState.sequenceNum) >= KEYFRAME_INTERVAL;
+}
+
+bool NetworkSpectatorBroadcast::setKeyframeState(uint16_t sequenceNum, const uint8_t * state, uint32_t size)
+{
+	if (size > NetworkSnapshotRing::SNAPSHOT_MAX_SIZE)
+	{
+		m_keyframeState.valid = false;
+		return false;
+	}
+
+	memcpy(m_keyframeState.data, state, size);
+	m_keyframeState.size = size;
+	m_keyframeState.sequenceNum = sequenceNum;
+	m_keyframeState.valid = true;
+
+	return true;
+}
+
+void NetworkSpectatorBroadcast::sendFrame(Spectator & spectator, Frame * frame)
+{
+	for (uint32_t i = 0; i < frame->numPackets; i++)
+	{
+		spectator.backend->sendPacket(frame->data + frame->packetOffsets[i], frame->packetSizes[i], NetworkBackend::SEND_TYPE_UNRELIABLE);
+	}
+
+	// All of the frame's packets go out together
+	spectator.backend->flushSends();
+}
+
+void NetworkSpectatorBroadcast::broadcast(Frame * frame, uint64_t encodeCycles)
+{
+	uint64_t startCycles = NetworkClock::getCycles();
+	uint32_t numSent = 0;
+
+	// Hold on to the keyframe for anyone who joins before the next one
+	if (frame->isKeyframe)
+	{
+		if (m_keyframe)
+		{
+			release(m_keyframe);
+		}
+
+		addRef(frame);
+		m_keyframe = frame;
+	}
+
+	for (uint32_t i = 0; i < m_numSpectators; i++)
+	{
+		Spectator & spectator = m_spectators[i];
+
+		if (spectator.needsKeyframe && frame->isKeyframe == false)
+		{
+			if (m_keyframe == nullptr)
+			{
+				// Nothing they can decode yet
+				continue;
+			}
+
+			sendFrame(spectator, m_keyframe);
+			numSent++;
+			Atomic::add64(&m_bytesSent, m_keyframe->size);
+		}
+
+		sendFrame(spectator, frame);
+		spectator.needsKeyframe = false;
+		numSent++;
+		Atomic::add64(&m_bytesSent, frame->size);
+	}
+
+	release(frame);
+
+	Atomic::add64(&m_encodeCycles, (int64_t)encodeCycles);
+	Atomic::add32(&m_numFramesEncoded, 1);
+
+	if (numSent)
+	{
+		Atomic::add64(&m_sendCycles, (int64_t)(NetworkClock::getCycles() - startCycles));
+		Atomic::add32(&m_numFramesSent, numSent);
+	}
+}
+
+void NetworkSpectatorBroadcast::reset()
+{
+	if (m_keyframe)
+	{
+		release(m_keyframe);
+		m_keyframe = nullptr;
+	}
+
+	m_keyframeState.valid = false;
+
+	for (uint32_t i = 0; i < m_numSpectators; i++)
+	{
+		m_spectators[i].needsKeyframe = true;
+	}
+}
+
+void NetworkSpectatorBroadcast::resetCounters()
+{
+	Atomic::exchange64(&m_encodeCycles, 0);
+	Atomic::exchange64(&m_sendCycles, 0);
+	Atomic::exchange32(&m_numFramesEncoded, 0);
+	Atomic::exchange32(&m_numFramesSent, 0);
+	Atomic::exchange64(&m_bytesSent, 0);
+}
+
+bool NetworkSpectatorBroadcast::runBenchmark(uint32_t maxSpectators, uint32_t numFrames)
+{
+	NetworkTransport * transport = nullptr;
+	NetworkBackendLoopback * senders = nullptr;
+	NetworkBackendLoopback * receivers = nullptr;
+	uint8_t * packet = nullptr;
+	uint8_t state[SHD_SPECTATOR_BENCHMARK_STATE_SIZE];
+	uint32_t numSpectators = 0;
+	bool ret = true;
+
+	if (maxSpectators == 0 || maxSpectators > MAX_SPECTATORS)
+	{
+		return false;
+	}
+
+	transport = new NetworkTransport();
+	senders = new NetworkBackendLoopback[maxSpectators];
+	receivers = new NetworkBackendLoopback[maxSpectators];
+	packet = (uint8_t *)SHD_MALLOC(NetworkBackendLoopback::LOOPBACK_MAX_PACKET_SIZE);
+
+	if (packet == nullptr)
+	{
+		ret = false;
+	}
+
+	for (uint32_t i = 0; i < SHD_SPECTATOR_BENCHMARK_STATE_SIZE; i++)
+	{
+		state[i] = (uint8_t)(i * 31);
+	}
+
+	// 1, 10, 100, ... and then maxSpectators itself
+	for (uint32_t target = 1; ret && numSpectators < maxSpectators; target = (target * 10 < maxSpectators) ? target * 10 : maxSpectators)
+	{
+		uint32_t bytesRead = 0;
+
+		// Only the receiving side needs a queue
+		for (; numSpectators < target; numSpectators++)
+		{
+			if (receivers[numSpectators].init(SHD_SPECTATOR_BENCHMARK_QUEUE_SIZE) == false)
+			{
+				ret = false;
+				break;
+			}
+
+			NetworkBackendLoopback::connect(senders[numSpectators], receivers[numSpectators]);
+			transport->addSpectator(&senders[numSpectators]);
+		}
+
+		transport->getSpectators().resetCounters();
+
+		for (uint32_t frame = 0; ret && frame < numFrames; frame++)
+		{
+			// Change part of the state each frame, the way a match does
+			for (uint32_t i = 0; i < SHD_SPECTATOR_BENCHMARK_CHANGED_BYTES; i++)
+			{
+				state[(frame * 7 + i * 13) % SHD_SPECTATOR_BENCHMARK_STATE_SIZE] += (uint8_t)(frame + 1);
+			}
+
+			if (transport->broadcastSpectatorState(state, SHD_SPECTATOR_BENCHMARK_STATE_SIZE) == false)
+			{
+				ret = false;
+			}
+
+			for (uint32_t i = 0; i < numSpectators; i++)
+			{
+				while (receivers[i].readPacket(packet, NetworkBackendLoopback::LOOPBACK_MAX_PACKET_SIZE, &bytesRead))
+				{
+				}
+			}
+		}
+
+		SHD_PRINTF("%u spectators: %llu cycles to encode a frame, %llu cycles to send it to each spectator, %lld bytes sent\n",
+			numSpectators,
+			(unsigned long long)transport->getSpectators().getAverageEncodeCycles(),
+			(unsigned long long)transport->getSpectators().getAverageSendCycles(),
+			(long long)transport->getSpectators().getTotalBytesSent());
+	}
+
+	for (uint32_t i = 0; i < numSpectators; i++)
+	{
+		transport->removeSpectator(&senders[i]);
+	}
+
+	if (packet)
+	{
+		SHD_FREE(packet);
+	}
+
+	delete transport;
+	delete[] senders;
+	delete[] receivers;
+
+	return ret;
+}
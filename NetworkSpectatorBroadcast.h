@@ -0,0 +1,130 @@
+//
+//  NetworkSpectatorBroadcast.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include "NetworkBackend.h"
+#include "NetworkFragments.h"
+#include "NetworkPacketPool.h"
+#include "NetworkDeltaCompression.h"
+
+namespace shd
+{
+	// Sends the game state to any number of spectators. Each frame is encoded once by NetworkTransport, into
+	// ready to send packets, and then the same bytes go to every spectator. Nothing is encoded per spectator.
+	// Frames are deltas against the last keyframe, so a spectator that misses packets only needs the keyframe to
+	// catch up, and one that joins late is sent the keyframe first. Spectators never send anything back.
+	// Not thread safe, it belongs to whichever thread owns the NetworkTransport
+	class NetworkSpectatorBroadcast
+	{
+	public:
+
+		static const uint32_t MAX_SPECTATORS = 512;
+
+		// Enough for the keyframe, the frame being sent, and one spare
+		static const uint32_t FRAME_POOL_SIZE = 4;
+
+		// A new keyframe is sent this many frames after the last one. Must be less than NetworkSnapshotRing::SNAPSHOT_RING_SIZE,
+		// so the keyframe is still in the spectator's ring when the last delta against it arrives
+		static const uint16_t KEYFRAME_INTERVAL = 30;
+
+		// A frame is one packet, or the fragments of one
+		static const uint32_t FRAME_MAX_PACKETS = NetworkFragmentReassembler::MAX_FRAGMENTS;
+
+		// An encoded frame, shared by every spectator it's sent to. Goes back to the pool when the last reference is released
+		struct Frame
+		{
+			uint32_t refCount;
+			uint16_t sequenceNum;
+			bool isKeyframe;
+			uint32_t numPackets;
+			uint32_t packetOffsets[FRAME_MAX_PACKETS];
+			uint32_t packetSizes[FRAME_MAX_PACKETS];
+			uint32_t size;
+			uint8_t data[NetworkPacketPool::PACKET_BUFFER_SIZE];
+		};
+
+		NetworkSpectatorBroadcast();
+		~NetworkSpectatorBroadcast();
+
+		// Start sending to a spectator, from the next keyframe. The backend must stay valid until it's removed
+		bool addSpectator(NetworkBackend * backend);
+		bool removeSpectator(NetworkBackend * backend);
+		inline uint32_t getNumSpectators() { return m_numSpectators; }
+
+		// Get an empty frame, with one reference. Returns null if they're all in use
+		Frame * acquireFrame();
+		void addRef(Frame * frame);
+		void release(Frame * frame);
+
+		// Should the frame with this sequence number be a keyframe?
+		bool isKeyframeDue(uint16_t sequenceNum);
+
+		// The state the current keyframe was encoded from, for deltas to be encoded against
+		inline const NetworkSnapshotRing::Snapshot & getKeyframeState() { return m_keyframeState; }
+		bool setKeyframeState(uint16_t sequenceNum, const uint8_t * state, uint32_t size);
+
+		// Send a frame to every spectator, and release the caller's reference. Spectators that haven't had the current
+		// keyframe yet get it first. encodeCycles is how long the frame took to encode, for the stats
+		void broadcast(Frame * frame, uint64_t encodeCycles);
+
+		// Forget the keyframe, so the next frame is a keyframe that every spectator is sent
+		void reset();
+
+		// Average cost of encoding a frame, and of sending one to a single spectator, in NetworkClock::getCycles() units.
+		// The second should stay flat however many spectators there are
+		inline uint64_t getAverageEncodeCycles() { return (m_numFramesEncoded) ? (uint64_t)m_encodeCycles / m_numFramesEncoded : 0; }
+		inline uint64_t getAverageSendCycles() { return (m_numFramesSent) ? (uint64_t)m_sendCycles / m_numFramesSent : 0; }
+		inline int64_t getTotalBytesSent() { return m_bytesSent; }
+		void resetCounters();
+
+		// Broadcast numFrames frames from a NetworkTransport to 1, 10, 100 and so on up to maxSpectators loopback
+		// spectators, and print the send cost per spectator at each count
+		static bool runBenchmark(uint32_t maxSpectators, uint32_t numFrames);
+
+	private:
+
+		struct Spectator
+		{
+			NetworkBackend * backend;
+
+			// Hasn't been sent the current keyframe yet
+			bool needsKeyframe;
+		};
+
+		// Disable copying
+		NetworkSpectatorBroadcast(const NetworkSpectatorBroadcast &);
+		NetworkSpectatorBroadcast & operator=(const NetworkSpectatorBroadcast &);
+
+		// Send every packet in a frame to one spectator
+		void sendFrame(Spectator & spectator, Frame * frame);
+
+		// All of the frames, in one allocation
+		Frame * m_frames;
+
+		// Frames that aren't in use
+		Frame * m_freeFrames[FRAME_POOL_SIZE];
+		uint32_t m_numFreeFrames;
+
+		Spectator m_spectators[MAX_SPECTATORS];
+		uint32_t m_numSpectators;
+
+		// The last keyframe that was sent, held on to for spectators that join late
+		Frame * m_keyframe;
+
+		// What the keyframe was encoded from
+		NetworkSnapshotRing::Snapshot m_keyframeState;
+
+		// Time spent encoding frames, and sending them to spectators, and how many times for each
+		volatile int64_t m_encodeCycles;
+		volatile int64_t m_sendCycles;
+		volatile uint32_t m_numFramesEncoded;
+		volatile uint32_t m_numFramesSent;
+		volatile int64_t m_bytesSent;
+	};
+}
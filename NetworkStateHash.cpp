@@ -0,0 +1,445 @@
+//
+//  NetworkStateHash.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkStateHash.h"
+#include "NetworkClock.h"
+#include "Common.h"
+#include <string.h>
+
+using namespace shd;
+
+// xxHash32's primes
+#define SHD_STATE_HASH_PRIME1 2654435761u
+#define SHD_STATE_HASH_PRIME2 2246822519u
+#define SHD_STATE_HASH_PRIME3 3266489917u
+#define SHD_STATE_HASH_PRIME4 668265263u
+#define SHD_STATE_HASH_PRIME5 374761393u
+
+static inline uint32_t rotateLeft(uint32_t value, uint32_t bits)
+{
+	return (value << bits) | (value >> (32 - bits));
+}
+
+// Little endian on every platform, so both peers get the same hash
+static inline uint32_t readUint32(const uint8_t * data)
+{
+	return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static inline uint32_t mixLane(uint32_t lane, uint32_t input)
+{
+	lane += input * SHD_STATE_HASH_PRIME2;
+	lane = rotateLeft(lane, 13);
+
+	return lane * SHD_STATE_HASH_PRIME1;
+}
+
+NetworkStateHash::NetworkStateHash()
+{
+	begin(0);
+}
+
+void NetworkStateHash::begin(uint32_t seed)
+{
+	m_seed = seed;
+	m_lanes[0] = seed + SHD_STATE_HASH_PRIME1 + SHD_STATE_HASH_PRIME2;
+	m_lanes[1] = seed + SHD_STATE_HASH_PRIME2;
+	m_lanes[2] = seed;
+	m_lanes[3] = seed - SHD_STATE_HASH_PRIME1;
+	m_totalSize = 0;
+	m_stripeSize = 0;
+}
+
+void NetworkStateHash::update(const void * data, size_t size)
+{
+	const uint8_t * bytes = (const uint8_t *)data;
+	const uint8_t * end = bytes + size;
+
+	m_totalSize += size;
+
+	// Not enough for a whole stripe yet
+	if (m_stripeSize + size < sizeof(m_stripe))
+	{
+		memcpy(m_stripe + m_stripeSize, bytes, size);
+		m_stripeSize += (uint32_t)size;
+		return;
+	}
+
+	// Finish off the stripe that was started last time
+	if (m_stripeSize)
+	{
+		uint32_t numBytes = sizeof(m_stripe) - m_stripeSize;
+
+		memcpy(m_stripe + m_stripeSize, bytes, numBytes);
+		bytes += numBytes;
+
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			m_lanes[i] = mixLane(m_lanes[i], readUint32(m_stripe + i * 4));
+		}
+
+		m_stripeSize = 0;
+	}
+
+	while (end - bytes >= (ptrdiff_t)sizeof(m_stripe))
+	{
+		m_lanes[0] = mixLane(m_lanes[0], readUint32(bytes));
+		m_lanes[1] = mixLane(m_lanes[1], readUint32(bytes + 4));
+		m_lanes[2] = mixLane(m_lanes[2], readUint32(bytes + 8));
+		m_lanes[3] = mixLane(m_lanes[3], readUint32(bytes + 12));
+		bytes += sizeof(m_stripe);
+	}
+
+	// Keep the rest for next time
+	m_stripeSize = (uint32_t)(end - bytes);
+	memcpy(m_stripe, bytes, m_stripeSize);
+}
+
+void NetworkStateHash::add(uint32_t value)
+{
+	uint8_t bytes[4];
+
+	bytes[0] = (uint8_t)value;
+	bytes[1] = (uint8_t)(value >> 8);
+	bytes[2] = (uint8_t)(value >> 16);
+	bytes[3] = (uint8_t)(value >> 24);
+
+	update(bytes, sizeof(bytes));
+}
+
+void NetworkStateHash::add(float value)
+{
+	uint32_t bits = 0;
+
+	memcpy(&bits, &value, sizeof(bits));
+	add(bits);
+}
+
+uint32_t NetworkStateHash::finish()
+{
+	uint32_t hash = 0;
+	uint32_t i = 0;
+
+	if (m_totalSize >= sizeof(m_stripe))
+	{
+		hash = rotateLeft(m_lanes[0], 1) + rotateLeft(m_lanes[1], 7) + rotateLeft(m_lanes[2], 12) + rotateLeft(m_lanes[3], 18);
+	}
+	else
+	{
+		hash = m_seed + SHD_STATE_HASH_PRIME5;
+	}
+
+	hash += (uint32_t)m_totalSize;
+
+	for (; i + 4 <= m_stripeSize; i += 4)
+	{
+		hash += readUint32(m_stripe + i) * SHD_STATE_HASH_PRIME3;
+		hash = rotateLeft(hash, 17) * SHD_STATE_HASH_PRIME4;
+	}
+
+	for (; i < m_stripeSize; i++)
+	{
+		hash += m_stripe[i] * SHD_STATE_HASH_PRIME5;
+		hash = rotateLeft(hash, 11) * SHD_STATE_HASH_PRIME1;
+	}
+
+	// Mix the last few bits into all of them
+	hash ^= hash >> 15;
+	hash *= SHD_STATE_HASH_PRIME2;
+	hash ^= hash >> 13;
+	hash *= SHD_STATE_HASH_PRIME3;
+	hash ^= hash >> 16;
+
+	return hash;
+}
+
+uint32_t NetworkStateHash::hash(const void * data, size_t size, uint32_t seed)
+{
+	NetworkStateHash stateHash;
+
+	stateHash.begin(seed);
+	stateHash.update(data, size);
+
+	return stateHash.finish();
+}
+
+bool NetworkStateHash::runBenchmark(uint32_t stateSize, uint32_t numIterations)
+{
+	uint8_t * state = nullptr;
+	uint64_t startCycles = 0;
+	uint64_t startUs = 0;
+	uint64_t elapsedUs = 0;
+	uint32_t result = 0;
+
+	if (stateSize == 0 || numIterations == 0)
+	{
+		return false;
+	}
+
+	// The test vectors from the xxHash reference, so a port that gets it wrong doesn't go unnoticed
+	if (hash("", 0) != 0x02CC5D05 || hash("abc", 3) != 0x32D153FF)
+	{
+		SHD_PRINTF("State hash doesn't match xxHash32!\n");
+		return false;
+	}
+
+	state = (uint8_t *)SHD_MALLOC(stateSize);
+	if (state == nullptr)
+	{
+		return false;
+	}
+
+	for (uint32_t i = 0; i < stateSize; i++)
+	{
+		state[i] = (uint8_t)(i * 31);
+	}
+
+	startCycles = NetworkClock::getCycles();
+	startUs = NetworkClock::getTimeMicroseconds();
+
+	for (uint32_t i = 0; i < numIterations; i++)
+	{
+		// A different state each time, the way each tick is
+		state[i % stateSize]++;
+		result ^= hash(state, stateSize);
+	}
+
+	elapsedUs = NetworkClock::getTimeMicroseconds() - startUs;
+
+	SHD_PRINTF("%u byte state: %llu cycles a hash, %.3f us a hash, %.2f GB/s (%08x)\n",
+		stateSize,
+		(unsigned long long)((NetworkClock::getCycles() - startCycles) / numIterations),
+		(double)elapsedUs / (double)numIterations,
+		(elapsedUs) ? (double)stateSize * (double)numIterations / ((double)elapsedUs * 1000.0) : 0.0,
+		result);
+
+	SHD_FREE(state);
+
+	return true;
+}
+
+NetworkDesyncDetector::NetworkDesyncDetector()
+{
+	reset();
+}
+
+void NetworkDesyncDetector::reset()
+{
+	memset(m_local, 0, sizeof(m_local));
+	m_localWriteIndex = 0;
+	m_hasSent = false;
+	m_lastSentTick = 0;
+	m_numPending = 0;
+	m_isDesynced = 0;
+	m_isResyncRequested = false;
+	m_hasSentResync = false;
+	m_lastResyncUs = 0;
+
+	resetCounters();
+}
+
+void NetworkDesyncDetector::resetCounters()
+{
+	Atomic::exchange32(&m_numChecks, 0);
+	Atomic::exchange32(&m_numDesyncs, 0);
+	Atomic::exchange32(&m_lastDesyncTick, 0);
+	Atomic::exchange32(&m_numResyncsSent, 0);
+}
+
+void NetworkDesyncDetector::setLocalHash(uint32_t tick, uint32_t hash)
+{
+	uint32_t writeIndex = m_localWriteIndex;
+	TickHash & entry = m_local[writeIndex % HISTORY_SIZE];
+
+	entry.tick = tick;
+	entry.hash = hash;
+
+	// Publish the entry only after it has been filled
+	Atomic::exchange32(&m_localWriteIndex, writeIndex + 1);
+}
+
+bool NetworkDesyncDetector::findLocalHash(uint32_t tick, uint32_t * hash)
+{
+	uint32_t writeIndex = m_localWriteIndex;
+	uint32_t newestTick = 0;
+	uint32_t age = 0;
+	uint32_t index = 0;
+
+	if (writeIndex == 0)
+	{
+		return false;
+	}
+
+	newestTick = m_local[(writeIndex - 1) % HISTORY_SIZE].tick;
+	age = newestTick - tick;
+
+	// Not there yet, or too long ago. Leaves a few entries spare so the game thread can't be writing the one we read
+	if ((int32_t)age < 0 || age >= HISTORY_SIZE - 4 || age >= writeIndex)
+	{
+		return false;
+	}
+
+	// Ticks are hashed one after another, so it's age entries back
+	index = writeIndex - 1 - age;
+
+	if (m_local[index % HISTORY_SIZE].tick != tick)
+	{
+		return false;
+	}
+
+	*hash = m_local[index % HISTORY_SIZE].hash;
+
+	return true;
+}
+
+bool NetworkDesyncDetector::isAheadOfUs(uint32_t tick)
+{
+	uint32_t writeIndex = m_localWriteIndex;
+
+	return writeIndex == 0 || (int32_t)(tick - m_local[(writeIndex - 1) % HISTORY_SIZE].tick) > 0;
+}
+
+bool NetworkDesyncDetector::isSectionDue()
+{
+	uint32_t writeIndex = m_localWriteIndex;
+
+	return writeIndex != 0 && (m_hasSent == false || m_local[(writeIndex - 1) % HISTORY_SIZE].tick != m_lastSentTick);
+}
+
+void NetworkDesyncDetector::writeSection(BitWriter & writer)
+{
+	uint32_t writeIndex = m_localWriteIndex;
+	HashSection section;
+
+	if (writeIndex == 0)
+	{
+		return;
+	}
+
+	section.tick = m_local[(writeIndex - 1) % HISTORY_SIZE].tick;
+	section.hash = m_local[(writeIndex - 1) % HISTORY_SIZE].hash;
+	section.isResyncRequested = (m_isDesynced != 0);
+
+	serializeHashSection(writer, section);
+
+	m_hasSent = true;
+	m_lastSentTick = section.tick;
+
+	// Anything we've caught up with since the last section came in
+	checkPending();
+}
+
+bool NetworkDesyncDetector::readSection(BitReader & reader)
+{
+	HashSection section;
+	uint32_t localHash = 0;
+
+	memset(&section, 0, sizeof(section));
+
+	if (serializeHashSection(reader, section) == false)
+	{
+		return false;
+	}
+
+	m_isResyncRequested = section.isResyncRequested;
+
+	checkPending();
+
+	if (findLocalHash(section.tick, &localHash))
+	{
+		compare(section.tick, localHash, section.hash);
+	}
+	else if (isAheadOfUs(section.tick))
+	{
+		// They're ahead of us, so it's checked once we get there. The oldest is dropped if there's no room
+		if (m_numPending == PENDING_SIZE)
+		{
+			memmove(&m_pending[0], &m_pending[1], sizeof(TickHash) * (PENDING_SIZE - 1));
+			m_numPending--;
+		}
+
+		m_pending[m_numPending].tick = section.tick;
+		m_pending[m_numPending].hash = section.hash;
+		m_numPending++;
+	}
+
+	return true;
+}
+
+void NetworkDesyncDetector::checkPending()
+{
+	uint32_t numChecked = 0;
+
+	// Oldest first, so stop at the first one we haven't got to
+	while (numChecked < m_numPending)
+	{
+		uint32_t localHash = 0;
+
+		if (isAheadOfUs(m_pending[numChecked].tick))
+		{
+			break;
+		}
+
+		if (findLocalHash(m_pending[numChecked].tick, &localHash))
+		{
+			compare(m_pending[numChecked].tick, localHash, m_pending[numChecked].hash);
+		}
+
+		numChecked++;
+	}
+
+	if (numChecked)
+	{
+		memmove(&m_pending[0], &m_pending[numChecked], sizeof(TickHash) * (m_numPending - numChecked));
+		m_numPending -= numChecked;
+	}
+}
+
+void NetworkDesyncDetector::compare(uint32_t tick, uint32_t localHash, uint32_t remoteHash)
+{
+	Atomic::add32(&m_numChecks, 1);
+
+	if (localHash == remoteHash)
+	{
+		if (m_isDesynced)
+		{
+			SHD_PRINTF("Back in sync at tick %u\n", tick);
+			Atomic::exchange32(&m_isDesynced, 0);
+		}
+
+		return;
+	}
+
+	// Only reported once, not for every tick until the resync lands
+	if (m_isDesynced == 0)
+	{
+		SHD_PRINTF("Desync at tick %u! Our state hash is %08x, theirs is %08x. Asking for a full state update\n", tick, localHash, remoteHash);
+		Atomic::add32(&m_numDesyncs, 1);
+		Atomic::exchange32(&m_lastDesyncTick, tick);
+		Atomic::exchange32(&m_isDesynced, 1);
+	}
+}
+
+bool NetworkDesyncDetector::isResyncDue(uint64_t nowUs)
+{
+	if (m_isDesynced == 0 && m_isResyncRequested == false)
+	{
+		return false;
+	}
+
+	return m_hasSentResync == false || nowUs - m_lastResyncUs >= RESYNC_INTERVAL_US;
+}
+
+void NetworkDesyncDetector::onResyncSent(uint64_t nowUs)
+{
+	m_hasSentResync = true;
+	m_lastResyncUs = nowUs;
+	m_isResyncRequested = false;
+
+	Atomic::add32(&m_numResyncsSent, 1);
+}
@@ -0,0 +1,174 @@
+//
+//  NetworkStateHash.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include "NetworkBitStream.h"
+#include <stdint.h>
+#include <stddef.h>
+
+namespace shd
+{
+	// 32 bit xxHash of the match state, built up a piece at a time so the state never has to be copied into one buffer.
+	// The game feeds it the same fields in the same order on both peers, with add() for values so the bytes are the
+	// same whatever the platform. Fast enough to hash the whole state every tick
+	class NetworkStateHash
+	{
+	public:
+
+		NetworkStateHash();
+
+		// Start again. Both peers must use the same seed
+		void begin(uint32_t seed = 0);
+
+		// Add some bytes. Raw bytes have to already be in the same order on both peers
+		void update(const void * data, size_t size);
+
+		// Add a value, as little endian bytes. Floats are hashed by their bits, so both peers have to have simulated
+		// them the same way, which lockstep and rollback need anyway
+		void add(uint32_t value);
+		inline void add(int32_t value) { add((uint32_t)value); }
+		void add(float value);
+
+		// The hash of everything added since begin()
+		uint32_t finish();
+
+		// Hash a whole buffer in one go
+		static uint32_t hash(const void * data, size_t size, uint32_t seed = 0);
+
+		// Hash a stateSize byte state numIterations times, and print how long each hash takes
+		static bool runBenchmark(uint32_t stateSize, uint32_t numIterations);
+
+	private:
+
+		// The four lanes that each 16 byte stripe is spread over
+		uint32_t m_lanes[4];
+		uint32_t m_seed;
+
+		// Bytes added so far, and the ones that don't make up a whole stripe yet
+		uint64_t m_totalSize;
+		uint8_t m_stripe[16];
+		uint32_t m_stripeSize;
+	};
+
+	// Spots when the two peers' simulations stop agreeing. The game thread hashes the match state each tick with
+	// NetworkStateHash and hands it over with setLocalHash(). Game packets carry a hash section with the newest tick's
+	// hash, and each one that comes in is checked against our own hash for the same tick, as soon as we have it.
+	// On a mismatch a report is logged, and both sides ask for a resync: whichever side sends full state updates sends
+	// the next one whole instead of as a delta, so the other side is put back on the same state.
+	// Both sides have to count ticks from the same point, like NetworkClockSync, and only hash ticks whose inputs are
+	// final, after any rollback. Sections are written and read on the network thread, hashes are set on the game thread
+	class NetworkDesyncDetector
+	{
+	public:
+
+		// How many of our own tick hashes are kept, for the other side's to be checked against
+		static const uint32_t HISTORY_SIZE = 64;
+
+		// How many of the other side's hashes can wait for our simulation to catch up with theirs
+		static const uint32_t PENDING_SIZE = 16;
+
+		// The most bytes a hash section can take up
+		static const uint32_t MAX_SECTION_SIZE = 10;
+
+		// A resync isn't sent again until this long after the last one, while the first is still on its way
+		static const uint64_t RESYNC_INTERVAL_US = 1000000;
+
+		struct HashSection
+		{
+			uint32_t tick;
+			uint32_t hash;
+			bool isResyncRequested;		// The sender has seen a mismatch, and wants a full state update
+		};
+
+		template <typename Stream> static bool serializeHashSection(Stream & stream, HashSection & section)
+		{
+			return	serializeVarint(stream, section.tick) &&
+					serializeInt(stream, section.hash, 32) &&
+					serializeBool(stream, section.isResyncRequested) &&
+					stream.serializeAlign();
+		}
+
+		NetworkDesyncDetector();
+		void reset();
+
+		// The hash of the match state at the end of a tick. Called by the game thread every tick
+		void setLocalHash(uint32_t tick, uint32_t hash);
+
+		// Is there a hash we haven't sent yet
+		bool isSectionDue();
+
+		// Write a hash section, or read one and check it against our own hash for the same tick
+		void writeSection(BitWriter & writer);
+		bool readSection(BitReader & reader);
+
+		// Should the full state update we're about to send go out whole, to resync the other side
+		bool isResyncDue(uint64_t nowUs);
+		void onResyncSent(uint64_t nowUs);
+
+		// Has the last hash we checked been different
+		inline bool isDesynced() { return m_isDesynced != 0; }
+
+		// Ticks that have been checked, times they stopped agreeing, and the last tick that didn't
+		inline uint32_t getNumChecks() { return m_numChecks; }
+		inline uint32_t getNumDesyncs() { return m_numDesyncs; }
+		inline uint32_t getLastDesyncTick() { return m_lastDesyncTick; }
+
+		// Full state updates sent whole to resync the other side
+		inline uint32_t getNumResyncsSent() { return m_numResyncsSent; }
+
+		void resetCounters();
+
+	private:
+
+		struct TickHash
+		{
+			uint32_t tick;
+			uint32_t hash;
+		};
+
+		// Our hash for a tick. Returns false if it hasn't been hashed yet, or was too long ago
+		bool findLocalHash(uint32_t tick, uint32_t * hash);
+
+		// Have we not hashed this tick yet
+		bool isAheadOfUs(uint32_t tick);
+
+		// Check one of the other side's hashes against ours
+		void compare(uint32_t tick, uint32_t localHash, uint32_t remoteHash);
+
+		// Check any of the other side's hashes that we've caught up with
+		void checkPending();
+
+		// Our hashes, written by the game thread. m_localWriteIndex is published after the entry is filled in
+		TickHash m_local[HISTORY_SIZE];
+		volatile uint32_t m_localWriteIndex;
+
+		// The newest tick that went out in a hash section
+		bool m_hasSent;
+		uint32_t m_lastSentTick;
+
+		// The other side's hashes for ticks we haven't got to yet, oldest first
+		TickHash m_pending[PENDING_SIZE];
+		uint32_t m_numPending;
+
+		// Set from the first mismatch until a hash matches again
+		volatile uint32_t m_isDesynced;
+
+		// The other side's last hash section asked for a resync
+		bool m_isResyncRequested;
+
+		// When the last resync went out
+		bool m_hasSentResync;
+		uint64_t m_lastResyncUs;
+
+		volatile uint32_t m_numChecks;
+		volatile uint32_t m_numDesyncs;
+		volatile uint32_t m_lastDesyncTick;
+		volatile uint32_t m_numResyncsSent;
+	};
+}
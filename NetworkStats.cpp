@@ -0,0 +1,172 @@
+//
+//  NetworkStats.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkStats.h"
+#include "Common.h"
+#include <math.h>
+
+using namespace shd;
+
+NetworkStats::NetworkStats()
+{
+	reset();
+}
+
+void NetworkStats::reset()
+{
+	for (uint32_t i = 0; i < SENT_TIMES_SIZE; i++)
+	{
+		m_sentPackets[i].valid = false;
+	}
+
+	m_smoothedRttUs = 0.0f;
+	m_rttDeviationUs = 0.0f;
+	m_hasRttSample = false;
+	m_receiveWindow.reset();
+
+	shd::Atomic::exchange32(&m_numPacketsSent, 0);
+	shd::Atomic::exchange32(&m_numPacketsReceived, 0);
+	shd::Atomic::exchange32(&m_numPacketsExpected, 0);
+	shd::Atomic::exchange32(&m_numOutOfOrder, 0);
+	shd::Atomic::exchange32(&m_numDuplicates, 0);
+	shd::Atomic::exchange64(&m_numBytesSent, 0);
+	shd::Atomic::exchange64(&m_numBytesReceived, 0);
+	m_intervalPacketsSent = 0;
+	m_intervalPacketsReceived = 0;
+	m_intervalPacketsExpected = 0;
+	m_intervalBytesSent = 0;
+	m_intervalBytesReceived = 0;
+	m_intervalStartUs = 0;
+
+	shd::Atomic::exchange32(&m_rttUs, 0);
+	shd::Atomic::exchange32(&m_jitterUs, 0);
+	shd::Atomic::exchange32(&m_recentLossHundredths, 0);
+	shd::Atomic::exchange32(&m_packetsSentPerSecond, 0);
+	shd::Atomic::exchange32(&m_packetsReceivedPerSecond, 0);
+	shd::Atomic::exchange32(&m_bytesSentPerSecond, 0);
+	shd::Atomic::exchange32(&m_bytesReceivedPerSecond, 0);
+}
+
+void NetworkStats::onPacketSent(uint16_t sequenceNum, uint32_t size, uint64_t timeUs)
+{
+	SentPacket & sent = m_sentPackets[sequenceNum % SENT_TIMES_SIZE];
+
+	sent.sequenceNum = sequenceNum;
+	sent.valid = true;
+	sent.timeUs = timeUs;
+
+	shd::Atomic::add32(&m_numPacketsSent, 1);
+	shd::Atomic::add64(&m_numBytesSent, size);
+}
+
+void NetworkStats::onAckReceived(uint16_t sequenceNum, uint64_t timeUs)
+{
+	SentPacket & sent = m_sentPackets[sequenceNum % SENT_TIMES_SIZE];
+	float sampleUs = 0.0f;
+
+	// Every packet keeps ACKing the newest one it has, so only the first ACK for a packet is a real sample
+	if (sent.valid == false || sent.sequenceNum != sequenceNum || timeUs < sent.timeUs)
+	{
+		return;
+	}
+
+	sent.valid = false;
+	sampleUs = (float)(timeUs - sent.timeUs);
+
+	if (m_hasRttSample == false)
+	{
+		m_smoothedRttUs = sampleUs;
+		m_rttDeviationUs = sampleUs / 2.0f;
+		m_hasRttSample = true;
+	}
+	else
+	{
+		m_rttDeviationUs += (fabsf(sampleUs - m_smoothedRttUs) - m_rttDeviationUs) * 0.25f;
+		m_smoothedRttUs += (sampleUs - m_smoothedRttUs) * 0.125f;
+	}
+
+	shd::Atomic::exchange32(&m_rttUs, (uint32_t)m_smoothedRttUs);
+	shd::Atomic::exchange32(&m_jitterUs, (uint32_t)m_rttDeviationUs);
+}
+
+void NetworkStats::onPacketReceived(uint16_t sequenceNum, uint32_t size)
+{
+	bool hadReceived = m_receiveWindow.hasReceived();
+	uint16_t previousNewest = m_receiveWindow.getNewest();
+
+	shd::Atomic::add64(&m_numBytesReceived, size);
+
+	switch (m_receiveWindow.markReceived(sequenceNum))
+	{
+	case NetworkReceiveWindow::RESULT_NEWEST:
+		// Anything we skipped over might still turn up late, but until then it counts as lost
+		shd::Atomic::add32(&m_numPacketsExpected, (hadReceived) ? (uint32_t)NetworkSequence::difference(sequenceNum, previousNewest) : 1);
+		shd::Atomic::add32(&m_numPacketsReceived, 1);
+		break;
+
+	case NetworkReceiveWindow::RESULT_LATE:
+		shd::Atomic::add32(&m_numPacketsReceived, 1);
+		shd::Atomic::add32(&m_numOutOfOrder, 1);
+		break;
+
+	case NetworkReceiveWindow::RESULT_DUPLICATE:
+		shd::Atomic::add32(&m_numDuplicates, 1);
+		break;
+
+	case NetworkReceiveWindow::RESULT_TOO_OLD:
+		shd::Atomic::add32(&m_numOutOfOrder, 1);
+		break;
+	}
+}
+
+void NetworkStats::update(uint64_t timeUs)
+{
+	uint64_t elapsedUs = timeUs - m_intervalStartUs;
+	uint32_t expected = 0;
+	uint32_t received = 0;
+
+	if (m_intervalStartUs == 0)
+	{
+		m_intervalStartUs = timeUs;
+		return;
+	}
+
+	if (elapsedUs < RATE_INTERVAL_US)
+	{
+		return;
+	}
+
+	shd::Atomic::exchange32(&m_packetsSentPerSecond, (uint32_t)((uint64_t)(m_numPacketsSent - m_intervalPacketsSent) * 1000000 / elapsedUs));
+	shd::Atomic::exchange32(&m_packetsReceivedPerSecond, (uint32_t)((uint64_t)(m_numPacketsReceived - m_intervalPacketsReceived) * 1000000 / elapsedUs));
+	shd::Atomic::exchange32(&m_bytesSentPerSecond, (uint32_t)((uint64_t)(m_numBytesSent - m_intervalBytesSent) * 1000000 / elapsedUs));
+	shd::Atomic::exchange32(&m_bytesReceivedPerSecond, (uint32_t)((uint64_t)(m_numBytesReceived - m_intervalBytesReceived) * 1000000 / elapsedUs));
+
+	expected = m_numPacketsExpected - m_intervalPacketsExpected;
+	received = m_numPacketsReceived - m_intervalPacketsReceived;
+	shd::Atomic::exchange32(&m_recentLossHundredths, (expected > received) ? (expected - received) * 10000 / expected : 0);
+
+	m_intervalPacketsSent = m_numPacketsSent;
+	m_intervalPacketsReceived = m_numPacketsReceived;
+	m_intervalPacketsExpected = m_numPacketsExpected;
+	m_intervalBytesSent = m_numBytesSent;
+	m_intervalBytesReceived = m_numBytesReceived;
+	m_intervalStartUs = timeUs;
+}
+
+float NetworkStats::getTotalLossPercent()
+{
+	uint32_t expected = m_numPacketsExpected;
+	uint32_t received = m_numPacketsReceived;
+
+	if (expected == 0 || received >= expected)
+	{
+		return 0.0f;
+	}
+
+	return (float)(expected - received) * 100.0f / (float)expected;
+}
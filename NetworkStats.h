@@ -0,0 +1,100 @@
+//
+//  NetworkStats.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include "NetworkSequence.h"
+#include <stdint.h>
+
+namespace shd
+{
+	// Round trip time, jitter, loss and packet rates for the connection to the other peer.
+	// The network thread feeds it, and every get function can be called from any thread without locking
+	class NetworkStats
+	{
+	public:
+
+		// How many sent packets we remember the send time of, for working out the round trip time from ACKs
+		static const uint32_t SENT_TIMES_SIZE = 64;
+
+		// How often the per second rates and the recent loss are worked out
+		static const uint64_t RATE_INTERVAL_US = 1000 * 1000;
+
+		NetworkStats();
+		void reset();
+
+		// Called by the network thread
+		void onPacketSent(uint16_t sequenceNum, uint32_t size, uint64_t timeUs);
+		void onAckReceived(uint16_t sequenceNum, uint64_t timeUs);
+		void onPacketReceived(uint16_t sequenceNum, uint32_t size);
+		void update(uint64_t timeUs);
+
+		// Smoothed round trip time, and how much it varies from one packet to the next
+		inline uint32_t getRttMicroseconds() { return m_rttUs; }
+		inline uint32_t getJitterMicroseconds() { return m_jitterUs; }
+
+		// Percentage of the other side's packets that never arrived, over the last RATE_INTERVAL_US and since the start
+		inline float getRecentLossPercent() { return m_recentLossHundredths / 100.0f; }
+		float getTotalLossPercent();
+
+		inline uint32_t getPacketsSentPerSecond() { return m_packetsSentPerSecond; }
+		inline uint32_t getPacketsReceivedPerSecond() { return m_packetsReceivedPerSecond; }
+		inline uint32_t getBytesSentPerSecond() { return m_bytesSentPerSecond; }
+		inline uint32_t getBytesReceivedPerSecond() { return m_bytesReceivedPerSecond; }
+
+		inline uint32_t getNumPacketsSent() { return m_numPacketsSent; }
+		inline uint32_t getNumPacketsReceived() { return m_numPacketsReceived; }
+		inline uint32_t getNumOutOfOrder() { return m_numOutOfOrder; }
+		inline uint32_t getNumDuplicates() { return m_numDuplicates; }
+
+	private:
+
+		struct SentPacket
+		{
+			uint16_t sequenceNum;
+			bool valid;
+			uint64_t timeUs;
+		};
+
+		// Send times, indexed by sequence number. Cleared once a packet is ACKed, so each one only gives one RTT sample
+		SentPacket m_sentPackets[SENT_TIMES_SIZE];
+
+		// Smoothed RTT and its mean deviation, worked out like TCP does (RFC 6298). Only touched by the network thread
+		float m_smoothedRttUs;
+		float m_rttDeviationUs;
+		bool m_hasRttSample;
+
+		// Which packets have really arrived. Kept apart from the transport's window, which also counts packets
+		// whose inputs were recovered from later ones, so those aren't counted as duplicates when they turn up
+		NetworkReceiveWindow m_receiveWindow;
+
+		// Totals, and their values at the start of the current rate interval
+		volatile uint32_t m_numPacketsSent;
+		volatile uint32_t m_numPacketsReceived;
+		volatile uint32_t m_numPacketsExpected;
+		volatile uint32_t m_numOutOfOrder;
+		volatile uint32_t m_numDuplicates;
+		volatile int64_t m_numBytesSent;
+		volatile int64_t m_numBytesReceived;
+		uint32_t m_intervalPacketsSent;
+		uint32_t m_intervalPacketsReceived;
+		uint32_t m_intervalPacketsExpected;
+		int64_t m_intervalBytesSent;
+		int64_t m_intervalBytesReceived;
+		uint64_t m_intervalStartUs;
+
+		// Published for other threads to read
+		volatile uint32_t m_rttUs;
+		volatile uint32_t m_jitterUs;
+		volatile uint32_t m_recentLossHundredths;
+		volatile uint32_t m_packetsSentPerSecond;
+		volatile uint32_t m_packetsReceivedPerSecond;
+		volatile uint32_t m_bytesSentPerSecond;
+		volatile uint32_t m_bytesReceivedPerSecond;
+	};
+}
@@ -0,0 +1,127 @@
+//
+//  NetworkToolsMain.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#ifdef SHD_NETWORK_TOOLS
+
+#include "Common.h"
+#include "NetworkBackendUdp.h"
+#include "NetworkCapture.h"
+#include "NetworkPriorityAccumulator.h"
+#include "NetworkHuffman.h"
+#include "NetworkSendThread.h"
+#include "NetworkSimulatorHarness.h"
+#include "NetworkSpectatorBroadcast.h"
+#include "NetworkStateHash.h"
+#include "NetworkTransport.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace shd;
+
+// Frames broadcast at each spectator count by -spectatorbenchmark
+#define SHD_SPECTATOR_BENCHMARK_FRAMES 1000
+
+// Packets queued on each channel by -sendbenchmark, and how many go out together
+#define SHD_SEND_BENCHMARK_PACKETS 10000
+#define SHD_SEND_BENCHMARK_PACKETS_PER_FLUSH 4
+
+// Hashes timed by -hashbenchmark
+#define SHD_HASH_BENCHMARK_ITERATIONS 100000
+
+// Ticks run by -simulate, 10 seconds of a match, and the seed, so runs can be compared between builds
+#define SHD_SIMULATE_TICKS 600
+#define SHD_SIMULATE_SEED 1
+
+// Benchmarks and offline tools for the network code, kept out of the dedicated server. Runs one and exits.
+// Usage: -transportbenchmark <packets>, to show the cost of sending and receiving a game packet over loopback
+// Or: -udpbenchmark <packets>, to compare batched and single packet socket calls
+// Or: -prioritybenchmark <ticks>, to show state packets staying within their budget as the number of entities grows
+// Or: -spectatorbenchmark <max spectators>, to show the send cost per spectator staying flat as spectators are added
+// Or: -trainmodel <capture file>, to train a compression model on a capture and save it next to it as <capture file>.huff
+// Or: -compressionbenchmark <capture file>, to print the compression ratio and time per packet a model would get
+// Or: -replay <capture file>, to feed the packets a capture received back through a transport and time them
+// Or: -sendbenchmark <channels>, to compare queuing packets for the send thread with sending them directly
+// Or: -hashbenchmark <state size in bytes>, to show how long hashing the match state each tick takes
+// Or: -simulate <profile>, to run two peers through a NetworkConditionSimulator profile and print what got through
+int main(int argc, char ** argv)
+{
+	uint32_t value = 0;
+
+	if (argc != 3)
+	{
+		SHD_PRINTF("Usage: %s -<tool> <value>\n", argv[0]);
+		return 1;
+	}
+
+	value = (uint32_t)atoi(argv[2]);
+
+	if (strcmp(argv[1], "-transportbenchmark") == 0)
+	{
+		return (NetworkTransport::runBenchmark(value)) ? 0 : 1;
+	}
+	else if (strcmp(argv[1], "-udpbenchmark") == 0)
+	{
+		return (NetworkBackendUdp::runBenchmark(value)) ? 0 : 1;
+	}
+	else if (strcmp(argv[1], "-prioritybenchmark") == 0)
+	{
+		return (NetworkPriorityAccumulator::runBenchmark(NetworkPriorityAccumulator::MAX_ENTITIES, value)) ? 0 : 1;
+	}
+	else if (strcmp(argv[1], "-spectatorbenchmark") == 0)
+	{
+		return (NetworkSpectatorBroadcast::runBenchmark(value, SHD_SPECTATOR_BENCHMARK_FRAMES)) ? 0 : 1;
+	}
+	else if (strcmp(argv[1], "-trainmodel") == 0)
+	{
+		NetworkHuffmanModel model;
+		char modelFilename[1024];
+
+		snprintf(modelFilename, sizeof(modelFilename), "%s.huff", argv[2]);
+
+		if (model.trainFromCapture(argv[2]) == false || model.save(modelFilename) == false)
+		{
+			SHD_PRINTF("Failed to train a model from %s\n", argv[2]);
+			return 1;
+		}
+
+		SHD_PRINTF("Saved %s\n", modelFilename);
+		return 0;
+	}
+	else if (strcmp(argv[1], "-compressionbenchmark") == 0)
+	{
+		return (NetworkHuffmanModel::runBenchmark(argv[2])) ? 0 : 1;
+	}
+	else if (strcmp(argv[1], "-replay") == 0)
+	{
+		return (NetworkCaptureReplay::replay(argv[2], nullptr)) ? 0 : 1;
+	}
+	else if (strcmp(argv[1], "-sendbenchmark") == 0)
+	{
+		return (NetworkSendThread::runBenchmark(value, SHD_SEND_BENCHMARK_PACKETS, SHD_SEND_BENCHMARK_PACKETS_PER_FLUSH)) ? 0 : 1;
+	}
+	else if (strcmp(argv[1], "-hashbenchmark") == 0)
+	{
+		return (NetworkStateHash::runBenchmark(value, SHD_HASH_BENCHMARK_ITERATIONS)) ? 0 : 1;
+	}
+	else if (strcmp(argv[1], "-simulate") == 0)
+	{
+		if (value >= NetworkConditionSimulator::PROFILE_MAX)
+		{
+			SHD_PRINTF("Unknown profile: %u\n", value);
+			return 1;
+		}
+
+		return (NetworkSimulatorHarness::runProfile((NetworkConditionSimulator::Profile)value, SHD_SIMULATE_SEED, SHD_SIMULATE_TICKS)) ? 0 : 1;
+	}
+
+	SHD_PRINTF("Unknown tool: %s\n", argv[1]);
+	return 1;
+}
+
+#endif
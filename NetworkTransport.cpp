@@ -7,488 +7,1684 @@
 //
 
 #include "NetworkTransport.h"
-#include "Application.h"
+#include "NetworkClock.h"
+#include "NetworkBackendLoopback.h"
+#include "Common.h"
 
 #define SHD_HANDSHAKE_VERIFICATION 0x19881337
 
+// The handshake is sent again if there's no ack after this long, then twice as long each time after that, up to the max.
+// The first retry is past the round trip of all but the worst pairings, so it's rarely sent for nothing
+#define SHD_CONNECT_FIRST_RETRY_US 250000
+#define SHD_CONNECT_MAX_RETRY_US 1000000
+
+// Give up on the other side if there's still no ack after this long
+#define SHD_CONNECT_TIMEOUT_US 10000000
+
+// Give up waiting for a handshake after this long. Longer than the connect timeout, since the other side may not
+// have called connect() yet when we call accept()
+#define SHD_ACCEPT_TIMEOUT_US 20000000
+
+// Packets smaller than this aren't worth compressing
+#define SHD_COMPRESSION_MIN_PACKET_SIZE 16
+
+// Bytes of each benchmark body that change from one packet to the next, and packets sent before timing starts
+#define SHD_TRANSPORT_BENCHMARK_CHANGED_BYTES 8
+#define SHD_TRANSPORT_BENCHMARK_WARMUP_PACKETS 1000
+
+// The send and receive buffers the transport used to clear for every packet, for the benchmark's baseline
+#define SHD_TRANSPORT_BASELINE_SEND_SIZE 16384
+#define SHD_TRANSPORT_BASELINE_RECEIVE_SIZE 4096
+
 using namespace shd;
 
-NetworkTransport::NetworkTransport() :	m_callbackP2PSessionRequest(this, &NetworkTransport::onP2PSessionRequest),
-										m_callbackP2PSessionConnectFail(this, &NetworkTransport::onP2PSessionConnectFail),
-										m_packetsSent(0),
-										m_lastPacketNumReceived(0),
-										m_bytesReceived(0),
-										m_bytesSent(0)
-{
+template <typename Stream> bool NetworkTransport::serializeHeader(Stream & stream, MessageHeader & header)
+{
+	if (serializeInt(stream, header.messageType, MESSAGE_TYPE_BITS) == false)
+	{
+		return false;
+	}
+
+	switch (header.messageType)
+	{
+	case MESSAGE_TYPE_GAME_PACKET_FRAGMENT:
+		if (serializeInt(stream, header.fragmentDetails, 8) == false ||
+			serializeInt(stream, header.packetSequenceNum, 16) == false)
+		{
+			return false;
+		}
+		break;
+
+	case MESSAGE_TYPE_GAME_PACKET_STANDARD:
+	case MESSAGE_TYPE_GAME_PACKET_FULL_STATE_UPDATE:
+	case MESSAGE_TYPE_GAME_PACKET_DELTA_STATE_UPDATE:
+	case MESSAGE_TYPE_GAME_PACKET_EVENTS_ONLY:
+	{
+		bool hasAck = (header.fragmentDetails & MESSAGE_FLAG_HAS_ACK) != 0;
+		bool hasEventAck = (header.fragmentDetails & MESSAGE_FLAG_HAS_EVENT_ACK) != 0;
+		bool hasEvents = (header.fragmentDetails & MESSAGE_FLAG_HAS_EVENTS) != 0;
+		bool hasRedundancy = (header.fragmentDetails & MESSAGE_FLAG_HAS_REDUNDANCY) != 0;
+		bool hasTime = (header.fragmentDetails & MESSAGE_FLAG_HAS_TIME) != 0;
+		bool hasHash = (header.fragmentDetails & MESSAGE_FLAG_HAS_HASH) != 0;
+
+		if (serializeInt(stream, header.packetSequenceNum, 16) == false ||
+			serializeInt(stream, header.lastInputSequenceReceived, 16) == false ||
+			serializeBool(stream, hasAck) == false)
+		{
+			return false;
+		}
+
+		if (hasAck && (serializeInt(stream, header.lastPacketSequenceReceived, 16) == false || serializeInt(stream, header.ackBits, 32) == false))
+		{
+			return false;
+		}
+
+		if (serializeBool(stream, hasEventAck) == false)
+		{
+			return false;
+		}
+
+		if (hasEventAck && serializeInt(stream, header.lastEventIdReceived, 16) == false)
+		{
+			return false;
+		}
+
+		if (serializeBool(stream, hasEvents) == false ||
+			serializeBool(stream, hasRedundancy) == false ||
+			serializeBool(stream, hasTime) == false ||
+			serializeBool(stream, hasHash) == false)
+		{
+			return false;
+		}
+
+		header.fragmentDetails =	((hasAck) ? MESSAGE_FLAG_HAS_ACK : 0) |
+									((hasEventAck) ? MESSAGE_FLAG_HAS_EVENT_ACK : 0) |
+									((hasEvents) ? MESSAGE_FLAG_HAS_EVENTS : 0) |
+									((hasRedundancy) ? MESSAGE_FLAG_HAS_REDUNDANCY : 0) |
+									((hasTime) ? MESSAGE_FLAG_HAS_TIME : 0) |
+									((hasHash) ? MESSAGE_FLAG_HAS_HASH : 0);
+		break;
+	}
+
+	default:
+		break;
+	}
+
+	return stream.serializeAlign();
+}
+
+template <typename Stream> bool NetworkTransport::serializeDeltaStateUpdateHeader(Stream & stream, DeltaStateUpdateHeader & deltaHeader)
+{
+	return serializeInt(stream, deltaHeader.baselineSequenceNum, 16) && stream.serializeAlign();
+}
+
+template <typename Stream> bool NetworkTransport::serializeGameStartHandshake(Stream & stream, GameStartHandshake & handshake)
+{
+	return	serializeInt(stream, handshake.verification, 32) &&
+			serializeVarint(stream, handshake.gameType) &&
+			serializeInt(stream, handshake.teamColourPrimary, 8) &&
+			serializeInt(stream, handshake.teamColourSecondary, 8);
+}
+
+template <typename Stream> bool NetworkTransport::serializeGameStartHandshakeAck(Stream & stream, GameStartHandshakeAck & ack)
+{
+	return	serializeInt(stream, ack.teamColourPrimary, 8) &&
+			serializeInt(stream, ack.teamColourSecondary, 8) &&
+			serializeBool(stream, ack.isFullStateUpdate);
+}
+
+template <typename Stream> bool NetworkTransport::serializeThrownWeapon(Stream & stream, ThrownWeapon & weapon)
+{
+	return	serializeInt(stream, weapon.index, BitsRequired<NET_TRANSPORT_MAX_WEAPONS - 1>::value) &&
+			serializeQuantizedFloat<NetSchemaPosition>(stream, weapon.posX) &&
+			serializeQuantizedFloat<NetSchemaPosition>(stream, weapon.posY) &&
+			serializeQuantizedFloat<NetSchemaVelocity>(stream, weapon.velocityX) &&
+			serializeQuantizedFloat<NetSchemaVelocity>(stream, weapon.velocityY);
+}
+
+template <typename Stream> bool NetworkTransport::serializeGameEvent(Stream & stream, GameEvent & event)
+{
+	if (serializeInt(stream, event.type, MESSAGE_TYPE_BITS) == false)
+	{
+		return false;
+	}
+
+	switch (event.type)
+	{
+	// These events carry a small value with them
+	case MESSAGE_TYPE_GAME_EVENT_GOAL_TOP:
+	case MESSAGE_TYPE_GAME_EVENT_GOAL_BOTTOM:
+	case MESSAGE_TYPE_GAME_EVENT_REVIVE_HOME:
+	case MESSAGE_TYPE_GAME_EVENT_REVIVE_AWAY:
+		return serializeVarint(stream, event.value);
+
+	case MESSAGE_TYPE_GAME_EVENT_WEAPON_THROW:
+		return serializeThrownWeapon(stream, event.weapon);
+
+	case MESSAGE_TYPE_GAME_EVENT_HALFTIME:
+	case MESSAGE_TYPE_GAME_EVENT_REMATCH:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+NetworkTransport::NetworkTransport() :	m_compressionModel(nullptr),
+										m_numPacketsCompressed(0),
+										m_compressionBytesSaved(0),
+										m_spectatorSequenceNum(0),
+										m_connectState(CONNECT_STATE_DISCONNECTED),
+										m_connectStartUs(0),
+										m_nextHandshakeUs(0),
+										m_connectRetryIntervalUs(0),
+										m_connectTimeUs(0),
+										m_handshakeAckStateSize(0),
+										m_handshakeAckIsFullStateUpdate(false),
+										m_hasHandshakeAckState(false),
+										m_numInputFramesRecovered(0),
+										m_lastEventAckSent(0),
+										m_hasSentEventAck(false),
+										m_packetsSent(0),
+										m_bytesSent(0),
+										m_bytesReceived(0),
+										m_sendCycles(0),
+										m_receiveCycles(0),
+										m_numPacketsTimedSend(0),
+										m_numPacketsTimedReceive(0),
+										m_baselineBuffer(nullptr)
+{
+#ifndef SHD_NO_STEAM
+	m_backend = &m_steamBackend;
+#else
+	m_backend = nullptr;
+#endif
+
+#ifndef SHD_DEDICATED_SERVER
+	m_handler = &m_applicationHandler;
+	m_applicationHandler.setDesyncDetector(&m_desyncDetector);
+	m_applicationHandler.setClockSync(&m_clockSync);
+#else
+	m_handler = nullptr;
+#endif
+}
+
+void NetworkTransport::setBackend(NetworkBackend * backend)
+{
+	m_backend = backend;
+	reset();
+}
+
+uint8_t * NetworkTransport::writeHeaderBefore(MessageHeader & header, uint8_t * msgBody)
+{
+	uint8_t headerBytes[NET_TRANSPORT_MAX_HEADER_SIZE + NET_TRANSPORT_MAX_EVENT_SECTION_SIZE + NET_TRANSPORT_MAX_REDUNDANCY_SECTION_SIZE + NET_TRANSPORT_MAX_TIME_SECTION_SIZE + NET_TRANSPORT_MAX_HASH_SECTION_SIZE];
+	BitWriter writer(headerBytes, sizeof(headerBytes));
+	uint32_t headerSize = 0;
+
+	serializeHeader(writer, header);
+
+	if (header.fragmentDetails & MESSAGE_FLAG_HAS_EVENTS)
+	{
+		m_eventChannel.writeSection(writer, NET_TRANSPORT_MAX_EVENT_SECTION_SIZE);
+		writer.align();
+	}
+
+	if (header.fragmentDetails & MESSAGE_FLAG_HAS_REDUNDANCY)
+	{
+		m_inputRedundancy.writeSection(writer, header.packetSequenceNum, NET_TRANSPORT_MAX_REDUNDANCY_SECTION_SIZE);
+		writer.align();
+	}
+
+	if (header.fragmentDetails & MESSAGE_FLAG_HAS_HASH)
+	{
+		m_desyncDetector.writeSection(writer);
+	}
+
+	// Written last, as close to the send as possible
+	if (header.fragmentDetails & MESSAGE_FLAG_HAS_TIME)
+	{
+		m_clockSync.writeSection(writer, NetworkClock::getTimeMicroseconds());
+	}
+
+	headerSize = writer.flush();
+	SHD_ASSERT(writer.hasOverflowed() == false);
+
+	memcpy(msgBody - headerSize, headerBytes, headerSize);
+
+	return msgBody - headerSize;
+}
+
+bool NetworkTransport::sendMessage(NetworkPacketPool::Packet * buffer, MessageHeader & header, uint32_t bodySize, NetworkBackend::SendType sendType)
+{
+	uint8_t * msgBody = getSendBodyStart(buffer);
+	uint8_t * packet = writeHeaderBefore(header, msgBody);
+
+	return m_backend->sendPacket(packet, (uint32_t)(msgBody - packet) + bodySize, sendType);
+}
+
+bool NetworkTransport::connect()
+{
+	bool ret = false;
+
+	m_connectState = CONNECT_STATE_CONNECTING;
+	m_connectStartUs = NetworkClock::getTimeMicroseconds();
+	m_connectRetryIntervalUs = SHD_CONNECT_FIRST_RETRY_US;
+	m_nextHandshakeUs = m_connectStartUs + m_connectRetryIntervalUs;
+	m_connectTimeUs = 0;
+
+	ret = sendHandshake();
+	m_backend->flushSends();
+
+	return ret;
+}
+
+void NetworkTransport::accept()
+{
+	m_connectState = CONNECT_STATE_ACCEPTING;
+	m_connectStartUs = NetworkClock::getTimeMicroseconds();
+	m_connectTimeUs = 0;
+	m_hasHandshakeAckState = false;
+}
+
+NetworkTransport::ConnectState NetworkTransport::updateConnect()
+{
+	uint64_t nowUs = 0;
+
+	// Handshakes and acks go through processPacket() like everything else
+	receiveData();
+
+	nowUs = NetworkClock::getTimeMicroseconds();
+
+	if (m_connectState == CONNECT_STATE_ACCEPTING)
+	{
+		if (nowUs - m_connectStartUs >= SHD_ACCEPT_TIMEOUT_US)
+		{
+			SHD_PRINTF("Timed out waiting for a handshake!\n");
+			m_connectState = CONNECT_STATE_TIMED_OUT;
+		}
+
+		return m_connectState;
+	}
+
+	if (m_connectState != CONNECT_STATE_CONNECTING)
+	{
+		return m_connectState;
+	}
+
+	if (nowUs - m_connectStartUs >= SHD_CONNECT_TIMEOUT_US)
+	{
+		SHD_PRINTF("Timed out waiting for a handshake ack!\n");
+		m_connectState = CONNECT_STATE_TIMED_OUT;
+	}
+	else if (nowUs >= m_nextHandshakeUs)
+	{
+		// Either the handshake or the ack went missing. Back off, in case it's because the other side is swamped
+		sendHandshake();
+		m_backend->flushSends();
+
+		m_connectRetryIntervalUs *= 2;
+
+		if (m_connectRetryIntervalUs > SHD_CONNECT_MAX_RETRY_US)
+		{
+			m_connectRetryIntervalUs = SHD_CONNECT_MAX_RETRY_US;
+		}
+
+		m_nextHandshakeUs = nowUs + m_connectRetryIntervalUs;
+	}
+
+	return m_connectState;
+}
+
+bool NetworkTransport::sendHandshake()
+{
+	bool ret;
+	MessageHeader msgHeader;
+	GameStartHandshake msgBody;
+	NetworkPacketPool::Packet * buffer = m_packetPool.acquire();
+
+	if (buffer == nullptr)
+	{
+		return false;
+	}
+
+	BitWriter writer(getSendBodyStart(buffer), NET_TRANSPORT_MAX_PACKET_SIZE);
+
+	memset(&msgHeader, 0, sizeof(MessageHeader));
+	msgHeader.messageType = MESSAGE_TYPE_START_GAME_HANDSHAKE;
+	msgBody.verification = SHD_HANDSHAKE_VERIFICATION;
+	msgBody.gameType = 0; // TODO
+	m_handler->getTeamColours(&msgBody.teamColourPrimary, &msgBody.teamColourSecondary);
+
+	if (serializeGameStartHandshake(writer, msgBody) == false)
+	{
+		SHD_PRINTF("Failed to write the handshake!\n");
+		m_packetPool.release(buffer);
+		return false;
+	}
+
+	// Start the clock sync off straight away, so there's an offset by the time the game starts
+	m_clockSync.writeSection(writer, NetworkClock::getTimeMicroseconds());
+
+	// Not reliable, since updateConnect() sends it again if there's no ack
+	ret = sendMessage(buffer, msgHeader, writer.flush(), NetworkBackend::SEND_TYPE_UNRELIABLE);
+	m_packetPool.release(buffer);
+
+	if (ret == false)
+	{
+		SHD_PRINTF("SendP2PPacket failed.\n");
+	}
+
+	return ret;
+}
+
+bool NetworkTransport::sendHandshakeAck()
+{
+	bool ret = false;
+	MessageHeader msgHeader;
+	GameStartHandshakeAck ackBody;
+	NetworkPacketPool::Packet * buffer = m_packetPool.acquire();
+	uint8_t ackBytes[NET_TRANSPORT_MAX_ACK_SIZE];
+	uint8_t * msgBody = nullptr;
+	uint8_t * ackStart = nullptr;
+	uint8_t * packet = nullptr;
+	size_t stateSize = 0;
+	uint32_t ackSize = 0;
+	bool isFullStateUpdate = false;
+
+	if (buffer == nullptr)
+	{
+		return false;
+	}
+
+	// The game's first state goes in first, and the ack is written in front of it, the same way as a game packet.
+	// It has to fit in a single packet alongside the ack, otherwise it's left for the first game packet.
+	// The game is only asked for it once. A repeated handshake gets the same state again, with a fresh ack and time section
+	if (m_hasHandshakeAckState == false)
+	{
+		m_handler->fillSendBuffer(m_handshakeAckState, NET_TRANSPORT_MAX_PACKET_SIZE - NET_TRANSPORT_MAX_HEADER_SIZE - NET_TRANSPORT_MAX_ACK_SIZE, &stateSize, &isFullStateUpdate);
+		m_handshakeAckStateSize = (uint32_t)stateSize;
+		m_handshakeAckIsFullStateUpdate = isFullStateUpdate;
+		m_hasHandshakeAckState = true;
+	}
+
+	msgBody = getSendBodyStart(buffer);
+	stateSize = m_handshakeAckStateSize;
+	isFullStateUpdate = m_handshakeAckIsFullStateUpdate;
+	memcpy(msgBody, m_handshakeAckState, stateSize);
+
+	memset(&msgHeader, 0, sizeof(MessageHeader));
+	msgHeader.messageType = MESSAGE_TYPE_START_GAME_ACK;
+	m_handler->getTeamColours(&ackBody.teamColourPrimary, &ackBody.teamColourSecondary);
+	ackBody.isFullStateUpdate = isFullStateUpdate;
+
+	BitWriter writer(ackBytes, sizeof(ackBytes));
+
+	if (serializeGameStartHandshakeAck(writer, ackBody) == false)
+	{
+		SHD_PRINTF("Failed to write the handshake ack!\n");
+		m_packetPool.release(buffer);
+		return false;
+	}
+
+	// This echoes the time section in the handshake, so it gives the first sample
+	m_clockSync.writeSection(writer, NetworkClock::getTimeMicroseconds());
+
+	ackSize = writer.flush();
+	ackStart = msgBody - ackSize;
+	memcpy(ackStart, ackBytes, ackSize);
+
+	packet = writeHeaderBefore(msgHeader, ackStart);
+	ret = m_backend->sendPacket(packet, (uint32_t)(msgBody - packet + stateSize), NetworkBackend::SEND_TYPE_UNRELIABLE);
+	m_packetPool.release(buffer);
+
+	if (ret == false)
+	{
+		SHD_PRINTF("SendP2PPacket in sendHandshakeAck() failed.\n");
+	}
+
+	return ret;
+}
+
+bool NetworkTransport::processHandshake(BitReader & reader)
+{
+	GameStartHandshake msgBody;
+
+	memset(&msgBody, 0, sizeof(GameStartHandshake));
+
+	if (serializeGameStartHandshake(reader, msgBody) == false || msgBody.verification != SHD_HANDSHAKE_VERIFICATION)
+	{
+		SHD_PRINTF("The handshake wasn't what we expected! Error!\n");
+		return false;
+	}
+
+	// Not having a time section isn't fatal, the game packets will carry them too
+	m_clockSync.readSection(reader, NetworkClock::getTimeMicroseconds());
+
+	switch (m_connectState)
+	{
+	case CONNECT_STATE_ACCEPTING:
+		SHD_PRINTF("Received handshake from other guy. Game type is %d\n", msgBody.gameType);
+		m_handler->onHandshakeReceived(msgBody.teamColourPrimary, msgBody.teamColourSecondary);
+		m_connectState = CONNECT_STATE_CONNECTED;
+		m_connectTimeUs = NetworkClock::getTimeMicroseconds() - m_connectStartUs;
+		break;
+
+	case CONNECT_STATE_CONNECTED:
+		// Our ack went missing, so they've sent the handshake again
+		break;
+
+	default:
+		// We're not expecting anyone
+		return false;
+	}
+
+	return sendHandshakeAck();
+}
+
+bool NetworkTransport::processHandshakeAck(BitReader & reader, uint8_t * data, uint32_t size)
+{
+	GameStartHandshakeAck msgBody;
+	uint32_t stateOffset = 0;
+
+	memset(&msgBody, 0, sizeof(GameStartHandshakeAck));
+
+	if (serializeGameStartHandshakeAck(reader, msgBody) == false)
+	{
+		SHD_PRINTF("The handshake ack wasn't what we expected! Error!\n");
+		return false;
+	}
+
+	// Only the first one counts. The rest are replies to handshakes that were sent again
+	if (m_connectState != CONNECT_STATE_CONNECTING)
+	{
+		return false;
+	}
+
+	if (m_clockSync.readSection(reader, NetworkClock::getTimeMicroseconds()) == false)
+	{
+		return false;
+	}
+
+	SHD_PRINTF("Received handshake ack from other guy\n");
+	m_handler->onHandshakeAckReceived(msgBody.teamColourPrimary, msgBody.teamColourSecondary);
+	m_connectState = CONNECT_STATE_CONNECTED;
+	m_connectTimeUs = NetworkClock::getTimeMicroseconds() - m_connectStartUs;
+
+	// Anything left is the other side's first game state, so the game can start without waiting for a game packet
+	stateOffset = reader.getBytesRead();
+
+	if (stateOffset < size)
+	{
+		m_handler->parseRecvBuffer(data + stateOffset, size - stateOffset, msgBody.isFullStateUpdate);
+	}
+
+	return true;
+}
+
+bool NetworkTransport::sendSpecialEvents()
+{
+	bool ret = false;
+	GameEvent event;
+	uint8_t eventBytes[NetworkEventChannel::EVENT_MAX_SIZE];
+	NetworkTransportHandler::GameEvent handlerEvent;
+
+	// Leave events with the handler until there's room for them
+	while (m_eventChannel.isFull() == false && m_handler->popGameEvent(&handlerEvent))
+	{
+		BitWriter writer(eventBytes, sizeof(eventBytes));
+
+		if (handlerEvent.type >= NetworkTransportHandler::EVENT_TYPE_MAX)
+		{
+			SHD_PRINTF("Dropping special event of unknown type: %i\n", handlerEvent.type);
+			continue;
+		}
+
+		// The event types are in the same order as the MESSAGE_TYPE_GAME_EVENT_* types
+		memset(&event, 0, sizeof(GameEvent));
+		event.type = MESSAGE_TYPE_GAME_EVENT_GOAL_TOP + handlerEvent.type;
+		event.value = handlerEvent.value;
+
+		if (handlerEvent.type == NetworkTransportHandler::EVENT_TYPE_WEAPON_THROW)
+		{
+			event.weapon.index = handlerEvent.weaponIndex;
+			event.weapon.posX = handlerEvent.weaponPosX;
+			event.weapon.posY = handlerEvent.weaponPosY;
+			event.weapon.velocityX = handlerEvent.weaponVelocityX;
+			event.weapon.velocityY = handlerEvent.weaponVelocityY;
+		}
+
+		if (serializeGameEvent(writer, event) == false || m_eventChannel.queue(eventBytes, writer.flush()) == false)
+		{
+			SHD_PRINTF("Failed to queue special event: %i\n", handlerEvent.type);
+			continue;
+		}
+
+		ret = true;
+	}
+
+	return ret;
+}
+
+bool NetworkTransport::sendData()
+{
+	bool ret = false;
+	uint64_t startCycles = NetworkClock::getCycles();
+	NetworkPacketPool::Packet * buffer = nullptr;
+
+	sendSpecialEvents();
+
+	if (m_baselineBuffer)
+	{
+		memset(m_baselineBuffer, 0, SHD_TRANSPORT_BASELINE_SEND_SIZE);
+	}
+
+	buffer = m_packetPool.acquire();
+	if (buffer == nullptr)
+	{
+		return false;
+	}
+
+	ret = sendGamePacketData(buffer);
+	m_packetPool.release(buffer);
+
+	// The game packet, or all of its fragments, go out together
+	m_backend->flushSends();
+
+	if (ret)
+	{
+		shd::Atomic::add64(&m_sendCycles, (int64_t)(NetworkClock::getCycles() - startCycles));
+		shd::Atomic::add32(&m_numPacketsTimedSend, 1);
+	}
+
+	return ret;
+}
+
+bool NetworkTransport::sendGamePacketData(NetworkPacketPool::Packet * buffer)
+{
+	size_t bodySize = 0;
+	uint8_t * packet = nullptr;
+	uint8_t * msgBody = getSendBodyStart(buffer);
+	MessageHeader msgHeader;
+	bool hasFullStateUpdate = false;
+	bool ret = false;
+	size_t packetSize = 0;
+	NetworkPacketPool::Packet * compressedBuffer = nullptr;
+	bool isResyncDue = m_desyncDetector.isResyncDue(NetworkClock::getTimeMicroseconds());
+
+	// The simulations have drifted apart, so ask for a full state update to put the other side right
+	if (isResyncDue)
+	{
+		m_handler->onResyncRequested();
+	}
+
+	// The body goes in first. Once we know what type of packet it is, the header is written in front of it.
+	// Nothing in the buffer is cleared beforehand, only the bytes that are written get sent
+	m_handler->fillSendBuffer(msgBody, NET_TRANSPORT_MAX_BODY_SIZE, &bodySize, &hasFullStateUpdate);
+
+	memset(&msgHeader, 0, sizeof(MessageHeader));
+
+	// ACK the last events we got
+	if (m_eventChannel.getAck(&msgHeader.lastEventIdReceived))
+	{
+		msgHeader.fragmentDetails |= MESSAGE_FLAG_HAS_EVENT_ACK;
+	}
+
+	if (m_eventChannel.hasUnacked())
+	{
+		msgHeader.fragmentDetails |= MESSAGE_FLAG_HAS_EVENTS;
+	}
+
+	if (bodySize == 0)
+	{
+		// Still send a packet if there are events to go out, or the other side is waiting on an ACK for its events
+		bool eventAckChanged = (msgHeader.fragmentDetails & MESSAGE_FLAG_HAS_EVENT_ACK) &&
+								(m_hasSentEventAck == false || m_lastEventAckSent != msgHeader.lastEventIdReceived);
+
+		if ((msgHeader.fragmentDetails & MESSAGE_FLAG_HAS_EVENTS) == 0 && eventAckChanged == false)
+		{
+			// Nothing to send!
+			return false;
+		}
+	}
+
+	if (msgHeader.fragmentDetails & MESSAGE_FLAG_HAS_EVENT_ACK)
+	{
+		m_lastEventAckSent = msgHeader.lastEventIdReceived;
+		m_hasSentEventAck = true;
+	}
+
+	msgHeader.packetSequenceNum = m_packetsSent++;
+	msgHeader.lastInputSequenceReceived = m_handler->getLastReceivedSeqNum();
+
+	if (bodySize == 0)
+	{
+		msgHeader.messageType = MESSAGE_TYPE_GAME_PACKET_EVENTS_ONLY;
+	}
+	else
+	{
+		msgHeader.messageType = (hasFullStateUpdate) ? MESSAGE_TYPE_GAME_PACKET_FULL_STATE_UPDATE : MESSAGE_TYPE_GAME_PACKET_STANDARD;
+	}
+
+	// ACK the last game packet we got, and the ones before it, so the other side knows which state it can
+	// delta against and which inputs it doesn't need to send again
+	if (m_packetWindow.hasReceived())
+	{
+		msgHeader.fragmentDetails |= MESSAGE_FLAG_HAS_ACK;
+		msgHeader.lastPacketSequenceReceived = m_packetWindow.getNewest();
+		msgHeader.ackBits = m_packetWindow.getAckBits();
+	}
+
+	// Send any inputs that might have been lost again
+	if (m_inputRedundancy.hasUnacked(msgHeader.packetSequenceNum))
+	{
+		msgHeader.fragmentDetails |= MESSAGE_FLAG_HAS_REDUNDANCY;
+	}
+
+	// Keep the clock offset and tick alignment up to date
+	if (m_clockSync.isSectionDue(msgHeader.packetSequenceNum))
+	{
+		msgHeader.fragmentDetails |= MESSAGE_FLAG_HAS_TIME;
+	}
+
+	// The newest tick's state hash, if it hasn't gone out yet
+	if (m_desyncDetector.isSectionDue())
+	{
+		msgHeader.fragmentDetails |= MESSAGE_FLAG_HAS_HASH;
+	}
+
+	if (hasFullStateUpdate)
+	{
+		// Spectators get the full state before it's turned into a delta for the other peer
+		if (m_spectators.getNumSpectators())
+		{
+			broadcastSpectatorState(msgBody, (uint32_t)bodySize);
+		}
+
+		if (isResyncDue)
+		{
+			// Whole, so it doesn't depend on anything the other side already has. Later deltas can still use it
+			m_sentSnapshots.insert(msgHeader.packetSequenceNum, msgBody, (uint32_t)bodySize);
+			m_desyncDetector.onResyncSent(NetworkClock::getTimeMicroseconds());
+			SHD_PRINTF("Sent a full state update to resync\n");
+		}
+		else
+		{
+			deltaCompressStateUpdate(&msgHeader, msgBody, &bodySize);
+		}
+	}
+
+	packet = writeHeaderBefore(msgHeader, msgBody);
+
+	if (msgHeader.messageType == MESSAGE_TYPE_GAME_PACKET_STANDARD)
+	{
+		m_inputRedundancy.store(msgHeader.packetSequenceNum, msgBody, (uint32_t)bodySize);
+	}
+
+	packetSize = (msgBody - packet) + bodySize;
+
+	// Squeeze the whole packet, header and all
+	if (m_compressionModel)
+	{
+		compressedBuffer = compressGamePacket(packet, packetSize, &packet, &packetSize);
+	}
+
+	m_stats.onPacketSent(msgHeader.packetSequenceNum, (uint32_t)packetSize, NetworkClock::getTimeMicroseconds());
+
+	if (compressedBuffer)
+	{
+		ret = sendGamePacket(compressedBuffer, packet, packetSize, msgHeader.packetSequenceNum);
+		m_packetPool.release(compressedBuffer);
+		return ret;
+	}
+
+	return sendGamePacket(buffer, packet, packetSize, msgHeader.packetSequenceNum);
+}
+
+NetworkPacketPool::Packet * NetworkTransport::compressGamePacket(const uint8_t * packet, size_t size, uint8_t ** compressedPacket, size_t * compressedSize)
+{
+	MessageHeader msgHeader;
+	uint32_t headerSize = 0;
+	uint32_t encodedSize = 0;
+	uint8_t * data = nullptr;
+	NetworkPacketPool::Packet * buffer = nullptr;
+
+	if (size < SHD_COMPRESSION_MIN_PACKET_SIZE)
+	{
+		return nullptr;
+	}
+
+	buffer = m_packetPool.acquire();
+	if (buffer == nullptr)
+	{
+		return nullptr;
+	}
+
+	// After the headroom, so it can still be sent as fragments
+	data = buffer->data + NET_TRANSPORT_SEND_HEADROOM;
+
+	BitWriter writer(data, NET_TRANSPORT_MAX_HEADER_SIZE);
+
+	memset(&msgHeader, 0, sizeof(MessageHeader));
+	msgHeader.messageType = MESSAGE_TYPE_GAME_PACKET_COMPRESSED;
+	serializeHeader(writer, msgHeader);
+	headerSize = writer.flush();
+
+	// Only worth it if it comes out at least a byte smaller, header and all
+	if (m_compressionModel->encode(packet, (uint32_t)size, data + headerSize, (uint32_t)size - headerSize - 1, &encodedSize) == false)
+	{
+		m_packetPool.release(buffer);
+		return nullptr;
+	}
+
+	*compressedPacket = data;
+	*compressedSize = headerSize + encodedSize;
+
+	shd::Atomic::add32(&m_numPacketsCompressed, 1);
+	shd::Atomic::add64(&m_compressionBytesSaved, (int64_t)(size - *compressedSize));
+
+	return buffer;
+}
+
+bool NetworkTransport::broadcastSpectatorState(const uint8_t * state, uint32_t size)
+{
+	uint64_t startCycles = NetworkClock::getCycles();
+	uint32_t deltaHeaderSize = 0;
+	uint32_t deltaSize = 0;
+	size_t bodySize = 0;
+	uint8_t * msgBody = nullptr;
+	uint8_t * packet = nullptr;
+	bool isKeyframe = false;
+	MessageHeader msgHeader;
+	DeltaStateUpdateHeader deltaHeader;
+	NetworkPacketPool::Packet * buffer = nullptr;
+	NetworkSpectatorBroadcast::Frame * frame = nullptr;
+
+	if (m_spectators.getNumSpectators() == 0 || size == 0 || size > NetworkSnapshotRing::SNAPSHOT_MAX_SIZE)
+	{
+		return false;
+	}
+
+	buffer = m_packetPool.acquire();
+	if (buffer == nullptr)
+	{
+		return false;
+	}
+
+	msgBody = getSendBodyStart(buffer);
+
+	// No ACKs, events or resent inputs, nothing that's different for each spectator
+	memset(&msgHeader, 0, sizeof(MessageHeader));
+	msgHeader.packetSequenceNum = m_spectatorSequenceNum++;
+	msgHeader.messageType = MESSAGE_TYPE_GAME_PACKET_DELTA_STATE_UPDATE;
+
+	isKeyframe = m_spectators.isKeyframeDue(msgHeader.packetSequenceNum);
+
+	if (isKeyframe == false)
+	{
+		// Every delta is against the keyframe, not the frame before, so a lost frame doesn't stop the next one being decoded
+		const NetworkSnapshotRing::Snapshot & keyframeState = m_spectators.getKeyframeState();
+		BitWriter writer(msgBody, NET_TRANSPORT_MAX_BODY_SIZE);
+
+		deltaHeader.baselineSequenceNum = keyframeState.sequenceNum;
+
+		if (serializeDeltaStateUpdateHeader(writer, deltaHeader))
+		{
+			deltaHeaderSize = writer.flush();
+			isKeyframe = NetworkDelta::encode(	keyframeState.data,
+												keyframeState.size,
+												state,
+												size,
+												msgBody + deltaHeaderSize,
+												NET_TRANSPORT_MAX_BODY_SIZE - deltaHeaderSize,
+												&deltaSize) == false;
+		}
+		else
+		{
+			isKeyframe = true;
+		}
+
+		bodySize = deltaHeaderSize + deltaSize;
+	}
+
+	// Also used when the delta wouldn't have been any smaller
+	if (isKeyframe)
+	{
+		msgHeader.messageType = MESSAGE_TYPE_GAME_PACKET_FULL_STATE_UPDATE;
+		memcpy(msgBody, state, size);
+		bodySize = size;
+		m_spectators.setKeyframeState(msgHeader.packetSequenceNum, state, size);
+	}
+
+	packet = writeHeaderBefore(msgHeader, msgBody);
+
+	frame = m_spectators.acquireFrame();
+	if (frame && buildSpectatorFrame(frame, packet, (msgBody - packet) + bodySize, msgHeader.packetSequenceNum) == false)
+	{
+		m_spectators.release(frame);
+		frame = nullptr;
+	}
+
+	m_packetPool.release(buffer);
+
+	if (frame == nullptr)
+	{
+		// The keyframe's state may already have been replaced, so start again from a new one
+		m_spectators.reset();
+		return false;
+	}
+
+	frame->isKeyframe = isKeyframe;
+	m_spectators.broadcast(frame, NetworkClock::getCycles() - startCycles);
+
+	return true;
+}
+
+bool NetworkTransport::buildSpectatorFrame(NetworkSpectatorBroadcast::Frame * frame, const uint8_t * packet, size_t size, uint16_t sequenceNum)
+{
+	uint32_t numFragments = 0;
+	uint32_t fragmentHeaderSize = 0;
+	MessageHeader fragmentHeader;
+
+	frame->sequenceNum = sequenceNum;
+	frame->numPackets = 0;
+	frame->size = 0;
+
+	if (size <= NET_TRANSPORT_MAX_PACKET_SIZE)
+	{
+		memcpy(frame->data, packet, size);
+		frame->packetOffsets[0] = 0;
+		frame->packetSizes[0] = (uint32_t)size;
+		frame->numPackets = 1;
+		frame->size = (uint32_t)size;
+		return true;
+	}
+
+	numFragments = (uint32_t)((size + NET_TRANSPORT_FRAGMENT_DATA_MAX_SIZE - 1) / NET_TRANSPORT_FRAGMENT_DATA_MAX_SIZE);
+	if (numFragments > NetworkSpectatorBroadcast::FRAME_MAX_PACKETS)
+	{
+		SHD_PRINTF("Spectator frame of size %d is too big to send, even in fragments.\n", (int)size);
+		return false;
+	}
+
+	memset(&fragmentHeader, 0, sizeof(MessageHeader));
+	fragmentHeader.messageType = MESSAGE_TYPE_GAME_PACKET_FRAGMENT;
+	fragmentHeader.packetSequenceNum = sequenceNum;
+
+	// Unlike sendGamePacket(), the fragments are laid out one after the other, so they can be sent again and again
+	for (uint32_t i = 0; i < numFragments; i++)
+	{
+		size_t fragmentSize = size - i * NET_TRANSPORT_FRAGMENT_DATA_MAX_SIZE;
+
+		if (fragmentSize > NET_TRANSPORT_FRAGMENT_DATA_MAX_SIZE)
+		{
+			fragmentSize = NET_TRANSPORT_FRAGMENT_DATA_MAX_SIZE;
+		}
+
+		if (frame->size + NET_TRANSPORT_MAX_HEADER_SIZE + fragmentSize > sizeof(frame->data))
+		{
+			return false;
+		}
+
+		BitWriter writer(frame->data + frame->size, NET_TRANSPORT_MAX_HEADER_SIZE);
+
+		fragmentHeader.fragmentDetails = NetworkFragmentReassembler::packFragmentDetails(numFragments, i);
+		serializeHeader(writer, fragmentHeader);
+		fragmentHeaderSize = writer.flush();
+
+		memcpy(frame->data + frame->size + fragmentHeaderSize, packet + i * NET_TRANSPORT_FRAGMENT_DATA_MAX_SIZE, fragmentSize);
+
+		frame->packetOffsets[i] = frame->size;
+		frame->packetSizes[i] = (uint32_t)(fragmentHeaderSize + fragmentSize);
+		frame->size += frame->packetSizes[i];
+		frame->numPackets++;
+	}
+
+	return true;
+}
+
+void NetworkTransport::deltaCompressStateUpdate(MessageHeader * msgHeader, uint8_t * msgBody, size_t * bodySize)
+{
+	uint32_t deltaSize = 0;
+	uint32_t deltaHeaderSize = 0;
+	bool hasDelta = false;
+	DeltaStateUpdateHeader deltaHeader;
+	const NetworkSnapshotRing::Snapshot * snapshot = nullptr;
+	const NetworkSnapshotRing::Snapshot * baseline = m_sentSnapshots.getNewestAcked();
+
+	// The baseline has to still be in the other side's ring, and not share a slot with this snapshot
+	int32_t baselineAge = (baseline) ? NetworkSequence::difference(msgHeader->packetSequenceNum, baseline->sequenceNum) : 0;
+	bool hasBaseline = baselineAge > 0 && baselineAge < NetworkSnapshotRing::SNAPSHOT_RING_SIZE;
+
+	// Keep the full state, so later updates can be encoded against it once it's ACKed
+	if (m_sentSnapshots.insert(msgHeader->packetSequenceNum, msgBody, (uint32_t)*bodySize) == false || hasBaseline == false)
+	{
+		return;
+	}
+
+	// The delta is encoded from the stored copy straight over the top of the body, so there's no extra copy when it works
+	snapshot = m_sentSnapshots.find(msgHeader->packetSequenceNum);
+
+	BitWriter writer(msgBody, (uint32_t)*bodySize);
+	deltaHeader.baselineSequenceNum = baseline->sequenceNum;
+
+	if (serializeDeltaStateUpdateHeader(writer, deltaHeader))
+	{
+		deltaHeaderSize = writer.flush();
+		hasDelta = NetworkDelta::encode(baseline->data,
+										baseline->size,
+										snapshot->data,
+										snapshot->size,
+										msgBody + deltaHeaderSize,
+										(uint32_t)*bodySize - deltaHeaderSize,
+										&deltaSize);
+	}
+
+	if (hasDelta == false)
+	{
+		// Not worth it, so put the full state back
+		memcpy(msgBody, snapshot->data, snapshot->size);
+		return;
+	}
+
+	msgHeader->messageType = MESSAGE_TYPE_GAME_PACKET_DELTA_STATE_UPDATE;
+	*bodySize = deltaHeaderSize + deltaSize;
+}
+
+bool NetworkTransport::sendGamePacket(NetworkPacketPool::Packet * buffer, uint8_t * packet, size_t size, uint16_t sequenceNum)
+{
+	bool ret = true;
+	uint32_t numFragments = 0;
+	uint32_t fragmentHeaderSize = 0;
+	MessageHeader fragmentHeader;
+	uint8_t fragmentHeaderBytes[NET_TRANSPORT_MAX_HEADER_SIZE];
+	uint8_t savedBytes[NET_TRANSPORT_MAX_HEADER_SIZE];
+
+	if (size <= NET_TRANSPORT_MAX_PACKET_SIZE)
+	{
+		ret = m_backend->sendPacket(packet, (uint32_t)size, NetworkBackend::SEND_TYPE_UNRELIABLE);
+		if (ret == false)
+		{
+			SHD_PRINTF("SendP2PPacket failed.\n");
+		}
+
+		shd::Atomic::add64(&m_bytesSent, size);
+		return ret;
+	}
+
+	numFragments = (uint32_t)((size + NET_TRANSPORT_FRAGMENT_DATA_MAX_SIZE - 1) / NET_TRANSPORT_FRAGMENT_DATA_MAX_SIZE);
+	if (numFragments > NET_TRANSPORT_MAX_FRAGMENTS)
+	{
+		SHD_PRINTF("Packet of size %d is too big to send, even in fragments.\n", (int)size);
+		return false;
+	}
+
+	memset(&fragmentHeader, 0, sizeof(MessageHeader));
+	fragmentHeader.messageType = MESSAGE_TYPE_GAME_PACKET_FRAGMENT;
+	fragmentHeader.packetSequenceNum = sequenceNum;
+
+	// Send each fragment straight out of the send buffer. The fragment header temporarily overwrites
+	// the end of the previous fragment (or the headroom), and is put back afterwards
+	for (uint32_t i = 0; i < numFragments; i++)
+	{
+		BitWriter writer(fragmentHeaderBytes, NET_TRANSPORT_MAX_HEADER_SIZE);
+		uint8_t * fragmentData = packet + i * NET_TRANSPORT_FRAGMENT_DATA_MAX_SIZE;
+		size_t fragmentSize = size - i * NET_TRANSPORT_FRAGMENT_DATA_MAX_SIZE;
+
+		if (fragmentSize > NET_TRANSPORT_FRAGMENT_DATA_MAX_SIZE)
+		{
+			fragmentSize = NET_TRANSPORT_FRAGMENT_DATA_MAX_SIZE;
+		}
+
+		fragmentHeader.fragmentDetails = NetworkFragmentReassembler::packFragmentDetails(numFragments, i);
+		serializeHeader(writer, fragmentHeader);
+		fragmentHeaderSize = writer.flush();
+
+		// The packet must have been written after the headroom, otherwise there's no room for the first fragment header
+		SHD_ASSERT(fragmentData - fragmentHeaderSize >= buffer->data);
+
+		memcpy(savedBytes, fragmentData - fragmentHeaderSize, fragmentHeaderSize);
+		memcpy(fragmentData - fragmentHeaderSize, fragmentHeaderBytes, fragmentHeaderSize);
+
+		if (m_backend->sendPacket(fragmentData - fragmentHeaderSize, (uint32_t)(fragmentSize + fragmentHeaderSize), NetworkBackend::SEND_TYPE_UNRELIABLE) == false)
+		{
+			SHD_PRINTF("SendP2PPacket failed for fragment %d of %d.\n", i, numFragments);
+			ret = false;
+		}
+
+		memcpy(fragmentData - fragmentHeaderSize, savedBytes, fragmentHeaderSize);
+		shd::Atomic::add64(&m_bytesSent, fragmentSize + fragmentHeaderSize);
+	}
+
+	return ret;
+}
+
+bool NetworkTransport::receiveData()
+{
+	bool ret = false;
+	uint32_t numRead = 0;
+	uint64_t startCycles = 0;
+
+	if (m_baselineBuffer)
+	{
+		return receiveDataBaseline();
+	}
+
+	// Forget about any fragmented packets that will never be completed
+	m_reassembler.evictExpired(NetworkClock::getTimeMicroseconds());
+	m_stats.update(NetworkClock::getTimeMicroseconds());
+
+	// Read everything that's waiting, a batch at a time. A full batch means there could be more
+	do
+	{
+		startCycles = NetworkClock::getCycles();
+		numRead = m_backend->readPackets(m_receiveBatch, NET_TRANSPORT_RECEIVE_BUFFER_SIZE, m_receiveSizes, NET_TRANSPORT_RECEIVE_BATCH_SIZE);
+
+		for (uint32_t i = 0; i < numRead; i++)
+		{
+			// Thrown away by the backend
+			if (m_receiveSizes[i] == 0)
+			{
+				continue;
+			}
+
+			shd::Atomic::add64(&m_bytesReceived, m_receiveSizes[i]);
+
+			if (processPacket(m_receiveBatch + i * NET_TRANSPORT_RECEIVE_BUFFER_SIZE, m_receiveSizes[i]))
+			{
+				ret = true;
+			}
+		}
+
+		// The read is shared between the whole batch, so the cost per packet includes its share of it
+		if (numRead)
+		{
+			shd::Atomic::add64(&m_receiveCycles, (int64_t)(NetworkClock::getCycles() - startCycles));
+			shd::Atomic::add32(&m_numPacketsTimedReceive, numRead);
+		}
+	}
+	while (numRead == NET_TRANSPORT_RECEIVE_BATCH_SIZE);
 
+	// Anything sent in reply, like handshake acks
+	m_backend->flushSends();
+
+	return ret;
 }
 
-bool NetworkTransport::sendStartGameHandshake()
+bool NetworkTransport::receiveDataBaseline()
 {
-	// First, reset the send buffer
-	memset(m_sendBuffer, 0, NET_TRANSPORT_SEND_BUFF_SIZE);
+	bool ret = false;
+	uint32_t msgSize = 0;
+	uint32_t bytesRead = 0;
 
-	bool ret;
-	size_t bytesToSend = 0;
-	MessageHeader * msgHeader = nullptr;
-	GameStartHandshake * msgBody = nullptr;
-	
-	// Set the positions in the send buffer or the header and the body
-	msgHeader = (MessageHeader *)m_sendBuffer;
-	bytesToSend += sizeof(MessageHeader);
-
-	msgBody = (GameStartHandshake *)(m_sendBuffer + bytesToSend);
-	bytesToSend += sizeof(GameStartHandshake);
-
-	msgHeader->messageType = MESSAGE_TYPE_START_GAME_HANDSHAKE;
-	msgBody->verification = SHD_HANDSHAKE_VERIFICATION;
-	msgBody->gameType = 0; // TODO
-	msgBody->teamColourPrimary = Application::getInstance().globalSettings.teamColourPrimary;
-	msgBody->teamColourSecondary = Application::getInstance().globalSettings.teamColourSecondary;
-
-	if (bytesToSend > NET_TRANSPORT_SEND_BUFF_SIZE)
-	{
-		SHD_ASSERT(false);
-		return false;
-	}
+	m_reassembler.evictExpired(NetworkClock::getTimeMicroseconds());
+	m_stats.update(NetworkClock::getTimeMicroseconds());
 
-	ret = SteamNetworking()->SendP2PPacket(	Application::getInstance().networkThread.getLobby().getOpponentID(),
-											m_sendBuffer,
-											bytesToSend,
-											k_EP2PSendReliable);
-	if (ret == false)
+	// One packet at a time, into a buffer that's cleared first
+	while (m_backend->isPacketAvailable(&msgSize))
 	{
-		SHD_PRINTF("SendP2PPacket failed.\n");
+		uint64_t startCycles = NetworkClock::getCycles();
+
+		memset(m_baselineBuffer, 0, SHD_TRANSPORT_BASELINE_RECEIVE_SIZE);
+
+		if (m_backend->readPacket(m_baselineBuffer, SHD_TRANSPORT_BASELINE_RECEIVE_SIZE, &bytesRead) == false)
+		{
+			break;
+		}
+
+		shd::Atomic::add64(&m_bytesReceived, bytesRead);
+
+		if (bytesRead && processPacket(m_baselineBuffer, bytesRead))
+		{
+			ret = true;
+		}
+
+		shd::Atomic::add64(&m_receiveCycles, (int64_t)(NetworkClock::getCycles() - startCycles));
+		shd::Atomic::add32(&m_numPacketsTimedReceive, 1);
 	}
 
+	m_backend->flushSends();
+
 	return ret;
 }
 
-bool NetworkTransport::recvStartGameHandshake()
+bool NetworkTransport::processPacket(uint8_t * data, uint32_t size)
 {
 	bool ret = false;
-	uint32_t msgSize = 0;
-	uint32_t bytesRead = 0;
-	CSteamID steamIDRemote;
-	MessageHeader * msgHeader = nullptr;
-	GameStartHandshake * msgBody = nullptr;
+	MessageHeader msgHeader;
+	BitReader reader(data, size);
+	uint8_t * msgBody = nullptr;
+	uint32_t bodySize = 0;
+	NetworkInputRedundancy::Payload redundantPayloads[NetworkInputRedundancy::MAX_REDUNDANT_PAYLOADS];
+	uint32_t numRedundantPayloads = 0;
+	NetworkReceiveWindow::Result sequenceResult = NetworkReceiveWindow::RESULT_NEWEST;
+
+	memset(&msgHeader, 0, sizeof(MessageHeader));
+
+	if (serializeHeader(reader, msgHeader) == false)
+	{
+		return false;
+	}
 
-	while (SteamNetworking()->IsP2PPacketAvailable(&msgSize))
+	// Events are processed straight away, even if the rest of the packet turns out to be too old
+	if (msgHeader.fragmentDetails & MESSAGE_FLAG_HAS_EVENTS)
 	{
-		SHD_PRINTF("Received a packet of size: %d!\n", msgSize);
+		NetworkEventChannel::Event events[NetworkEventChannel::EVENT_QUEUE_SIZE];
+		uint32_t numEvents = 0;
 
-		if (msgSize > NET_TRANSPORT_RECV_BUFF_SIZE)
+		if (m_eventChannel.readSection(reader, events, NetworkEventChannel::EVENT_QUEUE_SIZE, &numEvents) == false)
 		{
-			SHD_PRINTF("Receive buffer too small!\n");
-			SHD_ASSERT(false);
 			return false;
 		}
 
-		memset(m_recvBuffer, 0, NET_TRANSPORT_RECV_BUFF_SIZE);
+		reader.align();
 
-		if (SteamNetworking()->ReadP2PPacket(m_recvBuffer, msgSize, &bytesRead, &steamIDRemote))
+		for (uint32_t i = 0; i < numEvents; i++)
 		{
-			msgHeader = (MessageHeader *)m_recvBuffer;
-			msgBody = (GameStartHandshake *)(m_recvBuffer + sizeof(MessageHeader));
-
-			SHD_PRINTF("Received handshake from other guy\n");
-
-			if (msgHeader->messageType == MESSAGE_TYPE_START_GAME_HANDSHAKE && msgBody->verification == SHD_HANDSHAKE_VERIFICATION)
-			{
-				ret = true;
-				SHD_PRINTF("And it's all good. Message type is %d\n", msgBody->gameType);
-
-				if (Application::getInstance().globalSettings.teamColourPrimary == (Team::TeamColour)msgBody->teamColourPrimary)
-				{
-					Application::getInstance().globalSettings.teamColourPrimaryOnline = Application::getInstance().globalSettings.teamColourPrimary;
-					Application::getInstance().globalSettings.teamColourSecondaryOnline = Application::getInstance().globalSettings.teamColourSecondary;
+			BitReader eventReader(events[i].data, events[i].size);
+			GameEvent event;
 
-				}
-				else
-				{
-					Application::getInstance().globalSettings.teamColourPrimaryOnline = (Team::TeamColour)msgBody->teamColourPrimary;
-					Application::getInstance().globalSettings.teamColourSecondaryOnline = Application::getInstance().globalSettings.teamColourPrimary;
-				}
-			}
-			else
+			if (serializeGameEvent(eventReader, event))
 			{
-				SHD_PRINTF("The message wasn't what we expected! Error!\n");
-				SHD_ASSERT(false);
+				handleGameEvent(event);
 			}
 		}
 	}
 
-	return ret;
-}
+	if (msgHeader.fragmentDetails & MESSAGE_FLAG_HAS_REDUNDANCY)
+	{
+		if (NetworkInputRedundancy::readSection(reader, msgHeader.packetSequenceNum, redundantPayloads, NetworkInputRedundancy::MAX_REDUNDANT_PAYLOADS, &numRedundantPayloads) == false)
+		{
+			return false;
+		}
 
-bool NetworkTransport::sendHandshakeAck()
-{
-	// First, reset the send buffer
-	memset(m_sendBuffer, 0, NET_TRANSPORT_SEND_BUFF_SIZE);
+		reader.align();
+	}
 
-	bool ret = false;
-	size_t bytesToSend = 0;
-	MessageHeader * msgHeader = nullptr;
-	GameStartHandshakeAck * msgBody = nullptr;
-
-	msgHeader = (MessageHeader *)m_sendBuffer;
-	bytesToSend += sizeof(MessageHeader);
-	
-	msgBody = (GameStartHandshakeAck *)(m_sendBuffer + bytesToSend);
-	bytesToSend += sizeof(GameStartHandshakeAck);
-
-	msgHeader->messageType = MESSAGE_TYPE_START_GAME_ACK;
-	msgBody->teamColourPrimary = Application::getInstance().globalSettings.teamColourPrimary;
-	msgBody->teamColourSecondary = Application::getInstance().globalSettings.teamColourSecondary;
-
-	ret = SteamNetworking()->SendP2PPacket(	Application::getInstance().networkThread.getLobby().getOpponentID(),
-											m_sendBuffer,
-											bytesToSend,
-											k_EP2PSendReliable);
-	if (ret == false)
+	// Hashes are for a tick, not a packet, so an out of order one can still be checked
+	if (msgHeader.fragmentDetails & MESSAGE_FLAG_HAS_HASH)
 	{
-		SHD_PRINTF("SendP2PPacket in sendHandshakeAck() failed.\n");
+		if (m_desyncDetector.readSection(reader) == false)
+		{
+			return false;
+		}
 	}
 
-	return ret;
-}
-
-bool NetworkTransport::recvHandshakeAck()
-{
-	bool ret = false;
-	uint32_t msgSize = 0;
-	uint32_t bytesRead = 0;
-	CSteamID steamIDRemote;
-	MessageHeader * msgHeader = nullptr;
-	GameStartHandshakeAck * msgBody = nullptr;
-
-	while (SteamNetworking()->IsP2PPacketAvailable(&msgSize))
+	// Even a packet that arrives out of order gives a good sample, since it carries its own send time
+	if (msgHeader.fragmentDetails & MESSAGE_FLAG_HAS_TIME)
 	{
-		SHD_PRINTF("Received a packet of size: %d!\n", msgSize);
-
-		if (msgSize > NET_TRANSPORT_RECV_BUFF_SIZE)
+		if (m_clockSync.readSection(reader, NetworkClock::getTimeMicroseconds()) == false)
 		{
-			SHD_PRINTF("Receive buffer too small!\n");
-			SHD_ASSERT(false);
 			return false;
 		}
 
-		memset(m_recvBuffer, 0, NET_TRANSPORT_RECV_BUFF_SIZE);
+		reader.align();
+	}
 
-		if (SteamNetworking()->ReadP2PPacket(m_recvBuffer, msgSize, &bytesRead, &steamIDRemote))
-		{
-			msgHeader = (MessageHeader *)m_recvBuffer;
-			msgBody = (GameStartHandshakeAck *)(m_recvBuffer + sizeof(MessageHeader));
+	msgBody = data + reader.getBytesRead();
+	bodySize = size - reader.getBytesRead();
 
-			SHD_PRINTF("Received ACK from other guy\n");
+	switch (msgHeader.messageType)
+	{
+	case MESSAGE_TYPE_START_GAME_HANDSHAKE:
+	{
+		BitReader bodyReader(msgBody, bodySize);
+		ret = processHandshake(bodyReader);
+		break;
+	}
+	case MESSAGE_TYPE_START_GAME_ACK:
+	{
+		BitReader bodyReader(msgBody, bodySize);
+		ret = processHandshakeAck(bodyReader, msgBody, bodySize);
+		break;
+	}
+	case MESSAGE_TYPE_GAME_PACKET_STANDARD:
+	case MESSAGE_TYPE_GAME_PACKET_FULL_STATE_UPDATE:
+	case MESSAGE_TYPE_GAME_PACKET_DELTA_STATE_UPDATE:
+	case MESSAGE_TYPE_GAME_PACKET_EVENTS_ONLY:
 
-			if (msgHeader->messageType == MESSAGE_TYPE_START_GAME_ACK)
-			{
-				SHD_PRINTF("And it's all good.\n");
-				ret = true;
+		// Even an old packet can tell us what the other side has received
+		if (msgHeader.fragmentDetails & MESSAGE_FLAG_HAS_ACK)
+		{
+			m_sentSnapshots.markAcked(msgHeader.lastPacketSequenceReceived);
 
-				if (Application::getInstance().globalSettings.teamColourPrimary == (Team::TeamColour)msgBody->teamColourPrimary)
-				{
-					Application::getInstance().globalSettings.teamColourSecondary = (Team::TeamColour)msgBody->teamColourSecondary;
-				}
-				else
+			for (uint32_t i = 0; i < 32; i++)
+			{
+				if (msgHeader.ackBits & (1u << i))
 				{
-					Application::getInstance().globalSettings.teamColourSecondary = (Team::TeamColour)msgBody->teamColourPrimary;
+					m_sentSnapshots.markAcked((uint16_t)(msgHeader.lastPacketSequenceReceived - 1 - i));
 				}
 			}
-			else
+
+			m_inputRedundancy.processAck(msgHeader.lastPacketSequenceReceived, msgHeader.ackBits);
+			m_stats.onAckReceived(msgHeader.lastPacketSequenceReceived, NetworkClock::getTimeMicroseconds());
+		}
+
+		if (msgHeader.fragmentDetails & MESSAGE_FLAG_HAS_EVENT_ACK)
+		{
+			m_eventChannel.processAck(msgHeader.lastEventIdReceived);
+		}
+
+		// Pick up the inputs from any packets we missed, oldest first, before this packet's own
+		for (uint32_t i = 0; i < numRedundantPayloads; i++)
+		{
+			if (m_packetWindow.isReceived(redundantPayloads[i].sequenceNum))
 			{
-				SHD_PRINTF("The message wasn't what we expected! Error!\n");
+				continue;
 			}
-		}
-	}
 
-	return ret;
-}
+			m_handler->parseRecvBuffer(redundantPayloads[i].data, redundantPayloads[i].size, false);
+			m_packetWindow.markReceived(redundantPayloads[i].sequenceNum);
+			shd::Atomic::add32(&m_numInputFramesRecovered, 1);
+		}
 
-bool NetworkTransport::sendSpecialEvents()
-{
-	bool ret = false;
-	size_t bytesToSend = 0;
-	MessageHeader * msgHeader = nullptr;
-	uint8_t * msgBody = nullptr;
-	NetworkInputBuffer::SpecialEventData specialEvent;
+		sequenceResult = m_packetWindow.classify(msgHeader.packetSequenceNum);
+		m_stats.onPacketReceived(msgHeader.packetSequenceNum, size);
 
-	bool hasFullStateUpdate = false;
+		if (sequenceResult != NetworkReceiveWindow::RESULT_NEWEST)
+		{
+			SHD_PRINTF("Received out of order packet: %d, newest was: %d\n", msgHeader.packetSequenceNum, m_packetWindow.getNewest());
 
-	// Set the positions in the send buffer or the header and the body
-	msgHeader = (MessageHeader *)m_sendBuffer;
-	msgBody = (uint8_t *)(m_sendBuffer + sizeof(MessageHeader));
+			// A late packet's inputs can still fill a gap, but its state is older than what we already have
+			if (sequenceResult == NetworkReceiveWindow::RESULT_LATE &&
+				(msgHeader.messageType == MESSAGE_TYPE_GAME_PACKET_STANDARD || msgHeader.messageType == MESSAGE_TYPE_GAME_PACKET_EVENTS_ONLY))
+			{
+				if (msgHeader.messageType == MESSAGE_TYPE_GAME_PACKET_STANDARD)
+				{
+					m_handler->parseRecvBuffer(msgBody, bodySize, false);
+				}
 
-	while (Application::getInstance().networkThread.getNetInputBuffer()->popSpecialEvent(&specialEvent))
-	{
-		bytesToSend = 0;
-		memset(m_sendBuffer, 0, NET_TRANSPORT_SEND_BUFF_SIZE);
+				m_packetWindow.markReceived(msgHeader.packetSequenceNum);
+				ret = true;
+			}
 
-		bytesToSend += sizeof(MessageHeader);
-		SHD_PRINTF("Sending special event: %i\n", specialEvent.type);
+			break;
+		}
 
-		// Pack extra data in the fragmentDetails member of the header
-		switch (specialEvent.type)
+		if (msgHeader.messageType == MESSAGE_TYPE_GAME_PACKET_EVENTS_ONLY)
 		{
-		case NetworkInputBuffer::NET_SPECIAL_EVENT_GOAL_TOP:
-			msgHeader->messageType = MESSAGE_TYPE_GAME_EVENT_GOAL_TOP;
-			msgHeader->fragmentDetails = specialEvent.nextTeamToKickoff;
+			// Nothing else in it
+			m_packetWindow.markReceived(msgHeader.packetSequenceNum);
 			break;
+		}
+		else if (msgHeader.messageType == MESSAGE_TYPE_GAME_PACKET_STANDARD)
+		{
+			m_handler->parseRecvBuffer(msgBody, bodySize, false);
+		}
+		else if (msgHeader.messageType == MESSAGE_TYPE_GAME_PACKET_FULL_STATE_UPDATE)
+		{
+			// Keep it around for deltas to be decoded against
+			m_recvSnapshots.insert(msgHeader.packetSequenceNum, msgBody, bodySize);
+			m_handler->parseRecvBuffer(msgBody, bodySize, true);
+		}
+		else
+		{
+			BitReader deltaReader(msgBody, bodySize);
+			DeltaStateUpdateHeader deltaHeader;
+			const NetworkSnapshotRing::Snapshot * baseline = nullptr;
+			NetworkSnapshotRing::Snapshot * snapshot = nullptr;
+			uint32_t snapshotSize = 0;
+			int32_t baselineAge = 0;
+
+			if (serializeDeltaStateUpdateHeader(deltaReader, deltaHeader) == false)
+			{
+				break;
+			}
 
-		case NetworkInputBuffer::NET_SPECIAL_EVENT_GOAL_BOTTOM:
-			msgHeader->messageType = MESSAGE_TYPE_GAME_EVENT_GOAL_BOTTOM;
-			msgHeader->fragmentDetails = specialEvent.nextTeamToKickoff;
-			break;
+			// The baseline has to be older, and not in the slot this snapshot is about to be decoded into
+			baselineAge = NetworkSequence::difference(msgHeader.packetSequenceNum, deltaHeader.baselineSequenceNum);
+			if (baselineAge <= 0 || baselineAge >= NetworkSnapshotRing::SNAPSHOT_RING_SIZE)
+			{
+				break;
+			}
 
-		case NetworkInputBuffer::NET_SPECIAL_EVENT_WEAPON_THROW:
-			msgHeader->messageType = MESSAGE_TYPE_GAME_EVENT_WEAPON_THROW;
-			((NetworkInputBuffer::PackedThrownWeapon *)msgBody)->index = specialEvent.weaponIndex;
-			((NetworkInputBuffer::PackedThrownWeapon *)msgBody)->posX = specialEvent.weaponPos.x * 50;
-			((NetworkInputBuffer::PackedThrownWeapon *)msgBody)->posY = specialEvent.weaponPos.y * 50;
-			((NetworkInputBuffer::PackedThrownWeapon *)msgBody)->velocityX = specialEvent.weaponVel.x * 100;
-			((NetworkInputBuffer::PackedThrownWeapon *)msgBody)->velocityY = specialEvent.weaponVel.y * 100;
-			bytesToSend += sizeof(NetworkInputBuffer::PackedThrownWeapon);
+			baseline = m_recvSnapshots.find(deltaHeader.baselineSequenceNum);
+			if (baseline == nullptr)
+			{
+				SHD_PRINTF("Received delta against snapshot %d, which we don't have\n", deltaHeader.baselineSequenceNum);
+				break;
+			}
 
-			break;
+			snapshot = m_recvSnapshots.beginInsert(msgHeader.packetSequenceNum);
 
-		case NetworkInputBuffer::NET_SPECIAL_EVENT_HALFTIME:
-			msgHeader->messageType = MESSAGE_TYPE_GAME_EVENT_HALFTIME;
-			break;
+			if (NetworkDelta::decode(	baseline->data,
+										baseline->size,
+										msgBody + deltaReader.getBytesRead(),
+										bodySize - deltaReader.getBytesRead(),
+										snapshot->data,
+										NetworkSnapshotRing::SNAPSHOT_MAX_SIZE,
+										&snapshotSize) == false)
+			{
+				SHD_PRINTF("Failed to decode delta state update\n");
+				break;
+			}
 
-		case NetworkInputBuffer::NET_SPECIAL_EVENT_REMATCH:
-			msgHeader->messageType = MESSAGE_TYPE_GAME_EVENT_REMATCH;
-			break;
+			m_recvSnapshots.commit(snapshot, snapshotSize);
+			m_handler->parseRecvBuffer(snapshot->data, snapshotSize, true);
+		}
+
+		ret = true;
+		m_packetWindow.markReceived(msgHeader.packetSequenceNum);
+
+		break;
+	case MESSAGE_TYPE_GAME_PACKET_COMPRESSED:
+	{
+		uint32_t decodedSize = 0;
+		uint8_t innerType = 0;
 
-		case NetworkInputBuffer::NET_SPECIAL_EVENT_REVIVE_HOME:
-			msgHeader->messageType = MESSAGE_TYPE_GAME_EVENT_REVIVE_HOME;
-			msgHeader->fragmentDetails = specialEvent.reviveHome;
+		if (m_compressionModel == nullptr || m_compressionModel->decode(msgBody, bodySize, m_decompressBuffer, sizeof(m_decompressBuffer), &decodedSize) == false)
+		{
+			SHD_PRINTF("Couldn't decompress a game packet\n");
 			break;
+		}
 
-		case NetworkInputBuffer::NET_SPECIAL_EVENT_REVIVE_AWAY:
-			msgHeader->messageType = MESSAGE_TYPE_GAME_EVENT_REVIVE_AWAY;
-			msgHeader->fragmentDetails = specialEvent.reviveAway;
+		// Packets are compressed before they're split into fragments, and only ever once
+		innerType = m_decompressBuffer[0] & ((1 << MESSAGE_TYPE_BITS) - 1);
+		if (decodedSize == 0 || innerType == MESSAGE_TYPE_GAME_PACKET_FRAGMENT || innerType == MESSAGE_TYPE_GAME_PACKET_COMPRESSED)
+		{
 			break;
+		}
 
-		default:
-			SHD_ASSERT(false);
+		ret = processPacket(m_decompressBuffer, decodedSize);
+		break;
+	}
+	case MESSAGE_TYPE_GAME_PACKET_FRAGMENT:
+	{
+		const uint8_t * packet = nullptr;
+		uint32_t packetSize = 0;
+
+		if (m_reassembler.addFragment(	msgHeader.packetSequenceNum,
+										msgHeader.fragmentDetails,
+										msgBody,
+										bodySize,
+										NetworkClock::getTimeMicroseconds(),
+										&packet,
+										&packetSize) == false)
+		{
 			break;
 		}
 
-		ret = SteamNetworking()->SendP2PPacket(Application::getInstance().networkThread.getLobby().getOpponentID(),
-			m_sendBuffer,
-			bytesToSend,
-			k_EP2PSendReliable);
-		if (ret == false)
+		// Fragments can't contain more fragments
+		if (packetSize == 0 || (packet[0] & ((1 << MESSAGE_TYPE_BITS) - 1)) == MESSAGE_TYPE_GAME_PACKET_FRAGMENT)
 		{
-			SHD_PRINTF("SendP2PPacket in sendSpecialEvents() failed.\n");
+			break;
 		}
+
+		ret = processPacket((uint8_t *)packet, packetSize);
+		break;
+	}
+	default:
+		// Anyone can send us anything, so it's dropped rather than trusted
+		SHD_PRINTF("Dropping packet with unknown message type: %d\n", msgHeader.messageType);
+		break;
 	}
 
 	return ret;
 }
 
-bool NetworkTransport::sendData()
+void NetworkTransport::handleGameEvent(GameEvent & event)
 {
-	sendSpecialEvents();
-
-	// First, reset the send buffer
-	memset(m_sendBuffer, 0, NET_TRANSPORT_SEND_BUFF_SIZE);
-
-	bool ret;
-	size_t bytesWritten = 0;
-	size_t bytesToSend = 0;
-	MessageHeader * msgHeader = nullptr;
-	uint8_t * msgBody = nullptr;
-	bool hasFullStateUpdate = false;
-	
-	// Set the positions in the send buffer or the header and the body
-	msgHeader = (MessageHeader *)m_sendBuffer;
-	bytesToSend += sizeof(MessageHeader);
-	msgBody = (uint8_t *)(m_sendBuffer + bytesToSend);
+	NetworkTransportHandler::GameEvent handlerEvent;
 
-	Application::getInstance().networkThread.getNetInputBuffer()->fillSendBuffer(msgBody, NET_TRANSPORT_SEND_BUFF_SIZE - bytesToSend, &bytesWritten, &hasFullStateUpdate);
-	if (bytesWritten == 0)
+	if (event.type < MESSAGE_TYPE_GAME_EVENT_GOAL_TOP || event.type > MESSAGE_TYPE_GAME_EVENT_REVIVE_AWAY)
 	{
-		// Nothing to send!
-		return false;
+		SHD_PRINTF("Dropping special event with unknown type: %d\n", event.type);
+		return;
 	}
 
-	bytesToSend += bytesWritten;
-	msgHeader->packetSequenceNum = m_packetsSent++;
-	msgHeader->lastInputSequenceReceived = Application::getInstance().networkThread.getNetInputBuffer()->getLastReceivedSeqNum();
-	msgHeader->messageType = (hasFullStateUpdate) ? MESSAGE_TYPE_GAME_PACKET_FULL_STATE_UPDATE : MESSAGE_TYPE_GAME_PACKET_STANDARD;
+	memset(&handlerEvent, 0, sizeof(NetworkTransportHandler::GameEvent));
+	handlerEvent.type = (NetworkTransportHandler::EventType)(event.type - MESSAGE_TYPE_GAME_EVENT_GOAL_TOP);
+	handlerEvent.value = event.value;
 
-	// Also check if bytesToSend is greater than 1200 bytes - the Steam UDP max send size
-	if (bytesToSend > NET_TRANSPORT_SEND_BUFF_SIZE || bytesToSend > 1200)
+	if (event.type == MESSAGE_TYPE_GAME_EVENT_WEAPON_THROW)
 	{
-		SHD_ASSERT(false);
-		return false;
+		ThrownWeapon & weapon = event.weapon;
+
+		// The index came off the wire
+		if (weapon.index >= NET_TRANSPORT_MAX_WEAPONS)
+		{
+			SHD_PRINTF("NetworkTransport: dropped a weapon throw for weapon %u\n", (uint32_t)weapon.index);
+			return;
+		}
+
+		handlerEvent.weaponIndex = weapon.index;
+		handlerEvent.weaponPosX = weapon.posX;
+		handlerEvent.weaponPosY = weapon.posY;
+		handlerEvent.weaponVelocityX = weapon.velocityX;
+		handlerEvent.weaponVelocityY = weapon.velocityY;
 	}
 
-	ret = SteamNetworking()->SendP2PPacket(	Application::getInstance().networkThread.getLobby().getOpponentID(),
-											m_sendBuffer,
-											bytesToSend,
-											k_EP2PSendUnreliable);
-	if (ret == false)
+	m_handler->onGameEvent(handlerEvent);
+}
+
+void NetworkTransport::resetSendReceiveCounters()
+{
+	shd::Atomic::exchange64(&m_bytesSent, 0);
+	shd::Atomic::exchange64(&m_bytesReceived, 0);
+	shd::Atomic::exchange64(&m_sendCycles, 0);
+	shd::Atomic::exchange64(&m_receiveCycles, 0);
+	shd::Atomic::exchange32(&m_numPacketsTimedSend, 0);
+	shd::Atomic::exchange32(&m_numPacketsTimedReceive, 0);
+	shd::Atomic::exchange32(&m_numInputFramesRecovered, 0);
+	shd::Atomic::exchange32(&m_numPacketsCompressed, 0);
+	shd::Atomic::exchange64(&m_compressionBytesSaved, 0);
+}
+
+void NetworkTransport::reset()
+{
+	m_packetWindow.reset();
+	m_stats.reset();
+	m_inputRedundancy.reset();
+	m_reassembler.reset();
+	m_sentSnapshots.reset();
+	m_recvSnapshots.reset();
+	m_eventChannel.reset();
+	m_hasSentEventAck = false;
+	m_spectators.reset();
+	m_clockSync.reset();
+	m_desyncDetector.reset();
+	m_connectState = CONNECT_STATE_DISCONNECTED;
+	m_connectTimeUs = 0;
+	m_hasHandshakeAckState = false;
+}
+
+bool NetworkTransport::readPacketInfo(const uint8_t * data, uint32_t size, uint8_t * messageType, uint16_t * sequenceNum)
+{
+	MessageHeader msgHeader;
+	BitReader reader(data, size);
+
+	memset(&msgHeader, 0, sizeof(MessageHeader));
+
+	if (serializeHeader(reader, msgHeader) == false)
 	{
-		SHD_PRINTF("SendP2PPacket failed.\n");
+		return false;
 	}
 
-	shd::Atomic::add64(&m_bytesSent, bytesToSend);
+	*messageType = msgHeader.messageType;
+	*sequenceNum = msgHeader.packetSequenceNum;
 
-	return ret;
+	return true;
 }
 
-bool NetworkTransport::receiveData()
+namespace
 {
-	bool ret = false;
-	uint32_t msgSize = 0;
-	uint32_t bytesRead = 0;
-	CSteamID steamIDRemote;
-	MessageHeader * msgHeader = nullptr;
-	void * msgBody = nullptr;
-
-	while (SteamNetworking()->IsP2PPacketAvailable(&msgSize))
+	// Writes a body of a fixed size each time it's asked, with a few bytes changed from the last one the way a
+	// match's state changes, and counts the bodies it gets
+	class NetworkBenchmarkHandler : public shd::NetworkTransportHandler
 	{
-		if (msgSize > NET_TRANSPORT_RECV_BUFF_SIZE)
+	public:
+
+		NetworkBenchmarkHandler() : bodySize(0), isFullStateUpdate(false), numSent(0), numReceived(0)
 		{
-			SHD_PRINTF("Receive buffer too small!\n");
-			SHD_ASSERT(false);
-			return false;
+			memset(body, 0, sizeof(body));
 		}
 
-		shd::Atomic::add64(&m_bytesReceived, msgSize);
-		memset(m_recvBuffer, 0, NET_TRANSPORT_RECV_BUFF_SIZE);
+		virtual void getTeamColours(uint8_t * primary, uint8_t * secondary) { *primary = 0; *secondary = 1; }
+		virtual void onHandshakeReceived(uint8_t primary, uint8_t secondary) { (void)primary; (void)secondary; }
+		virtual void onHandshakeAckReceived(uint8_t primary, uint8_t secondary) { (void)primary; (void)secondary; }
 
-		if (SteamNetworking()->ReadP2PPacket(m_recvBuffer, msgSize, &bytesRead, &steamIDRemote))
+		virtual void fillSendBuffer(uint8_t * buffer, size_t bufferSize, size_t * bytesWritten, bool * isFullState)
 		{
-			// If the message was received from someone who isn't our opponent, ignore it
-			if (steamIDRemote != Application::getInstance().networkThread.getLobby().getOpponentID())
+			for (uint32_t i = 0; i < SHD_TRANSPORT_BENCHMARK_CHANGED_BYTES && bodySize; i++)
 			{
-				continue;
+				body[(numSent * 7 + i * 13) % bodySize] += (uint8_t)(numSent + 1);
 			}
 
-			msgHeader = (MessageHeader *)m_recvBuffer;
-			msgBody = (void *)(m_recvBuffer + sizeof(MessageHeader));
+			*bytesWritten = (bodySize < bufferSize) ? bodySize : bufferSize;
+			*isFullState = isFullStateUpdate;
+			memcpy(buffer, body, *bytesWritten);
+			numSent++;
+		}
 
+		virtual void parseRecvBuffer(void * buffer, size_t bufferSize, bool isFullState) { (void)buffer; (void)bufferSize; (void)isFullState; numReceived++; }
+		virtual uint16_t getLastReceivedSeqNum() { return 0; }
+		virtual bool popGameEvent(GameEvent * event) { (void)event; return false; }
+		virtual void onGameEvent(const GameEvent & event) { (void)event; }
+
+		uint8_t body[shd::NetworkPacketPool::PACKET_BUFFER_SIZE];
+		uint32_t bodySize;
+		bool isFullStateUpdate;
+		uint32_t numSent;
+		uint32_t numReceived;
+	};
+}
 
-			switch (msgHeader->messageType)
-			{
-			case MESSAGE_TYPE_START_GAME_HANDSHAKE:
-				break;
-			case MESSAGE_TYPE_START_GAME_ACK:
-				break;
-			case MESSAGE_TYPE_GAME_PACKET_STANDARD:
-			case MESSAGE_TYPE_GAME_PACKET_FULL_STATE_UPDATE:
+bool NetworkTransport::runBenchmark(uint32_t numPackets)
+{
+	struct Case
+	{
+		const char * name;
+		uint32_t bodySize;
+		bool isFullStateUpdate;
+	};
+
+	const Case cases[] =
+	{
+		{ "40 byte standard packet", 40, false },
+		{ "600 byte standard packet", 600, false },
+		{ "600 byte full state update", 600, true }
+	};
+
+	bool ret = true;
+	uint8_t * baselineBuffer = (uint8_t *)SHD_MALLOC(SHD_TRANSPORT_BASELINE_SEND_SIZE);
+
+	if (baselineBuffer == nullptr)
+	{
+		return false;
+	}
+
+	for (uint32_t c = 0; ret && c < sizeof(cases) / sizeof(cases[0]); c++)
+	{
+		uint64_t baselineSendCycles = 0;
+		uint64_t baselineReceiveCycles = 0;
 
-				// If there was a gap in received packets (maybe the counter wrapped around), reset it
-				if ((int)m_lastPacketNumReceived - (int)msgHeader->packetSequenceNum > 60 ||
-					(int)m_lastPacketNumReceived - (int)msgHeader->packetSequenceNum < -60)
+		// Each case is run the way the transport used to send and receive first, and then the way it does now
+		for (uint32_t pass = 0; ret && pass < 2; pass++)
+		{
+			bool isBaseline = (pass == 0);
+
+			// Big, so they live on the heap. A fresh pair for each run, so one run's snapshots don't help the next
+			NetworkTransport * peerA = new NetworkTransport();
+			NetworkTransport * peerB = new NetworkTransport();
+			NetworkBackendLoopback * loopbackA = new NetworkBackendLoopback();
+			NetworkBackendLoopback * loopbackB = new NetworkBackendLoopback();
+			NetworkBenchmarkHandler * handlerA = new NetworkBenchmarkHandler();
+			NetworkBenchmarkHandler * handlerB = new NetworkBenchmarkHandler();
+
+			if (loopbackA->init() == false || loopbackB->init() == false)
+			{
+				ret = false;
+			}
+			else
+			{
+				NetworkBackendLoopback::connect(*loopbackA, *loopbackB);
+				peerA->setBackend(loopbackA);
+				peerB->setBackend(loopbackB);
+				peerA->setHandler(handlerA);
+				peerB->setHandler(handlerB);
+				handlerA->bodySize = handlerB->bodySize = cases[c].bodySize;
+				handlerA->isFullStateUpdate = cases[c].isFullStateUpdate;
+
+				// The two peers take turns, so they can share the buffer
+				if (isBaseline)
 				{
-					SHD_PRINTF("Reset m_lastPacketNumReceived\n");
-					m_lastPacketNumReceived = msgHeader->packetSequenceNum;
+					peerA->m_baselineBuffer = baselineBuffer;
+					peerB->m_baselineBuffer = baselineBuffer;
 				}
 
-				if (msgHeader->packetSequenceNum < m_lastPacketNumReceived)
+				peerB->accept();
+				peerA->connect();
+
+				for (uint32_t i = 0; i < 100 && (peerA->getConnectState() != CONNECT_STATE_CONNECTED || peerB->getConnectState() != CONNECT_STATE_CONNECTED); i++)
 				{
-					SHD_PRINTF("Received out of order packet: %d, last was: %i\n", msgHeader->packetSequenceNum, m_lastPacketNumReceived);
-					continue;
+					peerB->updateConnect();
+					peerA->updateConnect();
 				}
 
-				ret = true;
-				m_lastPacketNumReceived = msgHeader->packetSequenceNum;
-				
-				if (msgHeader->messageType == MESSAGE_TYPE_GAME_PACKET_STANDARD)
-					Application::getInstance().networkThread.getNetInputBuffer()->parseRecvBuffer(msgBody, false);
-				else
-					Application::getInstance().networkThread.getNetInputBuffer()->parseRecvBuffer(msgBody, true);
+				if (peerA->getConnectState() != CONNECT_STATE_CONNECTED || peerB->getConnectState() != CONNECT_STATE_CONNECTED)
+				{
+					SHD_PRINTF("%s: the peers didn't connect\n", cases[c].name);
+					ret = false;
+				}
+			}
 
-				break;
-			case MESSAGE_TYPE_GAME_PACKET_FRAGMENT:
-				break;
-			case MESSAGE_TYPE_GAME_EVENT_GOAL_TOP:
-				shd::Atomic::exchange32(&Application::getInstance().matchState.nextTeamToKickoff, msgHeader->fragmentDetails);
-				shd::Atomic::exchange32(&Application::getInstance().networkThread.specialEvents.goalTop, 1);
-				break;
-			case MESSAGE_TYPE_GAME_EVENT_GOAL_BOTTOM:
-				shd::Atomic::exchange32(&Application::getInstance().matchState.nextTeamToKickoff, msgHeader->fragmentDetails);
-				shd::Atomic::exchange32(&Application::getInstance().networkThread.specialEvents.goalBottom, 1);
-				break;
-			case MESSAGE_TYPE_GAME_EVENT_WEAPON_THROW:
+			if (ret)
 			{
-				NetworkInputBuffer::PackedThrownWeapon * weapon = (NetworkInputBuffer::PackedThrownWeapon *)msgBody;
+				uint64_t sendCycles = 0;
+				uint64_t receiveCycles = 0;
 
-				if (weapon->index < 0 || weapon->index >= WeaponManager::MAX_WEAPONS)
+				// Both sides send every tick, so the full state updates are deltas against what the other side ACKed.
+				// The first packets warm things up, and aren't timed
+				for (uint32_t i = 0; i < SHD_TRANSPORT_BENCHMARK_WARMUP_PACKETS + numPackets; i++)
 				{
-					break;
+					if (i == SHD_TRANSPORT_BENCHMARK_WARMUP_PACKETS)
+					{
+						peerA->resetSendReceiveCounters();
+						peerB->resetSendReceiveCounters();
+						handlerB->numReceived = 0;
+					}
+
+					peerA->sendData();
+					peerB->sendData();
+					peerB->receiveData();
+					peerA->receiveData();
 				}
-				
-				Application::getInstance().networkThread.packedWeapons[weapon->index] = *weapon;
-				shd::Atomic::exchange32(&Application::getInstance().networkThread.specialEvents.weaponThrown[weapon->index], 1);
-				
-				break;
-			}
-			case MESSAGE_TYPE_GAME_EVENT_HALFTIME:
-				break;
-			case MESSAGE_TYPE_GAME_EVENT_REMATCH:
-				Application::getInstance().networkThread.setOpponentWantsRematch(true);
-				break;
-			case MESSAGE_TYPE_GAME_EVENT_REVIVE_HOME:
-				shd::Atomic::exchange32(&Application::getInstance().matchState.numPlayersRevived, msgHeader->fragmentDetails);
-				shd::Atomic::exchange32(&Application::getInstance().networkThread.specialEvents.reviveHome, 1);
-				break;
-			case MESSAGE_TYPE_GAME_EVENT_REVIVE_AWAY:
-				shd::Atomic::exchange32(&Application::getInstance().matchState.numPlayersRevived, msgHeader->fragmentDetails);
-				shd::Atomic::exchange32(&Application::getInstance().networkThread.specialEvents.reviveAway, 1);
-				break;
-			default:
-				SHD_ASSERT(false);
-				break;
-			}
-		}
-	}
-
-	return ret;
-}
 
-void NetworkTransport::resetSendReceiveCounters()
-{
-	shd::Atomic::exchange64(&m_bytesSent, 0);
-	shd::Atomic::exchange64(&m_bytesReceived, 0);
-}
+				sendCycles = peerA->getAverageSendCycles();
+				receiveCycles = peerB->getAverageReceiveCycles();
 
-void NetworkTransport::reset()
-{
-	shd::Atomic::exchange32(&m_lastPacketNumReceived, 0);
-}
+				SHD_PRINTF("%s, %s: %llu cycles to send, %llu cycles to receive, %u of %u received, %lld bytes sent\n",
+					cases[c].name,
+					(isBaseline) ? "clearing whole buffers" : "pooled buffers",
+					(unsigned long long)sendCycles,
+					(unsigned long long)receiveCycles,
+					handlerB->numReceived,
+					numPackets,
+					(long long)peerA->getTotalBytesSent());
 
-//-----------------------------------------------------------------------------
-// Purpose: another user has sent us a packet - do we accept?
-//-----------------------------------------------------------------------------
-void NetworkTransport::onP2PSessionRequest(P2PSessionRequest_t *pP2PSessionRequest)
-{
-	SHD_PRINTF("A user wants to create a session with us...\n");
+				if (isBaseline)
+				{
+					baselineSendCycles = sendCycles;
+					baselineReceiveCycles = receiveCycles;
+				}
+				else if (sendCycles && receiveCycles)
+				{
+					SHD_PRINTF("%s: sending is %.2fx and receiving %.2fx as fast as clearing whole buffers\n",
+						cases[c].name,
+						(double)baselineSendCycles / (double)sendCycles,
+						(double)baselineReceiveCycles / (double)receiveCycles);
+				}
+			}
 
-	if (Application::getInstance().networkThread.getLobby().getOpponentID() == pP2PSessionRequest->m_steamIDRemote)
-	{
-		SteamNetworking()->AcceptP2PSessionWithUser(pP2PSessionRequest->m_steamIDRemote);
-		SHD_PRINTF("The user was the other member of the lobby. Accepting communication.\n");
-	}
-	else
-	{
-		SHD_PRINTF("The requesting user is not in a lobby with us... Who is it? Denied.\n");
+			delete peerA;
+			delete peerB;
+			delete loopbackA;
+			delete loopbackB;
+			delete handlerA;
+			delete handlerB;
+		}
 	}
-}
 
-//-----------------------------------------------------------------------------
-// Purpose: We sent a packet to another user but it failed
-//-----------------------------------------------------------------------------
-void NetworkTransport::onP2PSessionConnectFail(P2PSessionConnectFail_t *pP2PSessionConnectFail)
-{
-	(void)pP2PSessionConnectFail;
+	SHD_FREE(baselineBuffer);
 
-	// we've sent a packet to the user, but it never got through
-	// we can just use the normal timeout
-	SHD_PRINTF("Failed to send a packet to the other user.\n");
-}
\ No newline at end of file
+	return ret;
+}
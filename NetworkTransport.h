@@ -8,8 +8,35 @@
 
 #pragma once
 
-#include <steam_api.h>
+#include "NetworkBackend.h"
+#include "NetworkFragments.h"
+#include "NetworkDeltaCompression.h"
+#include "NetworkBitStream.h"
+#include "NetworkEventChannel.h"
+#include "NetworkPacketPool.h"
+#include "NetworkInputRedundancy.h"
+#include "NetworkSequence.h"
+#include "NetworkStats.h"
+#include "NetworkTransportHandler.h"
+#include "NetworkSpectatorBroadcast.h"
+#include "NetworkClockSync.h"
+#include "NetworkStateHash.h"
+#include "NetworkHuffman.h"
 #include <stdint.h>
+#include <stddef.h>
+
+// The dedicated server has no Steam and no Application, only UDP sockets and its own handlers
+#if defined(SHD_DEDICATED_SERVER) && !defined(SHD_NO_STEAM)
+#define SHD_NO_STEAM
+#endif
+
+#ifndef SHD_NO_STEAM
+#include "NetworkBackendSteam.h"
+#endif
+
+#ifndef SHD_DEDICATED_SERVER
+#include "NetworkTransportApplication.h"
+#endif
 
 namespace shd
 {
@@ -17,11 +44,42 @@ namespace shd
 	{
 	public:
 
-		// The size of the receive buffer
-		static const int NET_TRANSPORT_SEND_BUFF_SIZE = 16 * 1024;
-		static const int NET_TRANSPORT_RECV_BUFF_SIZE = 4 * 1024;
-		static const int NET_TRANSPORT_FRAGMENT_DATA_MAX_SIZE = 1024;
-		static const int NET_TRANSPORT_MAX_FRAGMENTS = 4;
+		static const int NET_TRANSPORT_FRAGMENT_DATA_MAX_SIZE = NetworkFragmentReassembler::FRAGMENT_DATA_MAX_SIZE;
+		static const int NET_TRANSPORT_MAX_FRAGMENTS = NetworkFragmentReassembler::MAX_FRAGMENTS;
+
+		// The Steam UDP max send size. Anything bigger than this is sent as fragments
+		static const int NET_TRANSPORT_MAX_PACKET_SIZE = 1200;
+
+		// Space left at the start of the send buffer, so fragment headers can be written in front of the data without copying it
+		static const int NET_TRANSPORT_SEND_HEADROOM = 8;
+
+		// The most bytes a serialized MessageHeader can take up
+		static const int NET_TRANSPORT_MAX_HEADER_SIZE = 16;
+
+		// The most bytes of special events that can ride along with a game packet
+		static const int NET_TRANSPORT_MAX_EVENT_SECTION_SIZE = 256;
+
+		// The most bytes of resent input payloads that can ride along with a game packet
+		static const int NET_TRANSPORT_MAX_REDUNDANCY_SECTION_SIZE = 512;
+
+		// The most bytes of clock sync that can ride along with a packet
+		static const int NET_TRANSPORT_MAX_TIME_SECTION_SIZE = NetworkClockSync::MAX_SECTION_SIZE;
+
+		// The most bytes of state hash that can ride along with a game packet
+		static const int NET_TRANSPORT_MAX_HASH_SECTION_SIZE = NetworkDesyncDetector::MAX_SECTION_SIZE;
+
+		// Packets are read this many at a time, into buffers this big. Nothing bigger than a fragment is ever sent
+		static const int NET_TRANSPORT_RECEIVE_BATCH_SIZE = 16;
+		static const int NET_TRANSPORT_RECEIVE_BUFFER_SIZE = 1500;
+
+		// The most thrown weapons there can be. Must be at least WeaponManager::MAX_WEAPONS
+		static const int NET_TRANSPORT_MAX_WEAPONS = 16;
+
+		// Ranges used to quantize positions and velocities on the wire. Values outside them are clamped, so they cover
+		// everything the old int16 fixed point format could carry (x50 for positions, x100 for velocities), including
+		// a thrown weapon's velocity, at 16 bits each
+		typedef QuantizedFloat<-655, 655, 50> NetSchemaPosition;
+		typedef QuantizedFloat<-327, 327, 100> NetSchemaVelocity;
 
 		struct NetPackedBall
 		{
@@ -31,19 +89,110 @@ namespace shd
 			float velocityY;
 		};
 
+		template <typename Stream> static bool serializePackedBall(Stream & stream, NetPackedBall & ball)
+		{
+			return	serializeQuantizedFloat<NetSchemaPosition>(stream, ball.posX) &&
+					serializeQuantizedFloat<NetSchemaPosition>(stream, ball.posY) &&
+					serializeQuantizedFloat<NetSchemaVelocity>(stream, ball.velocityX) &&
+					serializeQuantizedFloat<NetSchemaVelocity>(stream, ball.velocityY);
+		}
+
 		NetworkTransport();
-		bool sendStartGameHandshake();
-		bool recvStartGameHandshake();
-		bool sendHandshakeAck();
-		bool recvHandshakeAck();
+
+		// Use a different backend for sending and receiving packets (UDP, loopback, etc). Steam is used by default
+		void setBackend(NetworkBackend * backend);
+		inline NetworkBackend * getBackend() { return m_backend; }
+
+		// Use a different handler for the data that's sent and received. The game's Application is used by default,
+		// and the dedicated server must set one before using the transport
+		inline void setHandler(NetworkTransportHandler * handler) { m_handler = handler; }
+		inline NetworkTransportHandler * getHandler() { return m_handler; }
+
+#ifndef SHD_DEDICATED_SERVER
+		// The default handler, for the game thread to hash the match state through each tick
+		inline NetworkApplicationHandler & getApplicationHandler() { return m_applicationHandler; }
+#endif
+
+		enum ConnectState
+		{
+			CONNECT_STATE_DISCONNECTED = 0,
+			CONNECT_STATE_CONNECTING,		// Sent the handshake, waiting for the ack
+			CONNECT_STATE_ACCEPTING,		// Waiting for a handshake
+			CONNECT_STATE_CONNECTED,
+			CONNECT_STATE_TIMED_OUT			// The other side never answered
+		};
+
+		// Starting a match takes one round trip. One side calls connect(), which sends the handshake, and the other
+		// calls accept(). The accepting side is connected as soon as the handshake arrives, and its ack carries its
+		// first game state, so the connecting side can start as soon as the ack arrives.
+		// Both sides then call updateConnect() each tick until they're connected. It receives packets, and sends the
+		// handshake again if the ack is taking too long. Either side gives up if it isn't connected in time
+		bool connect();
+		void accept();
+		ConnectState updateConnect();
+		inline ConnectState getConnectState() { return m_connectState; }
+
+		// How long it took from connect() or accept() to being connected
+		inline uint64_t getConnectTimeMicroseconds() { return m_connectTimeUs; }
+
+		// Queue up any special events. They go out with the next game packet, and keep going out until they're ACKed
 		bool sendSpecialEvents();
+
 		bool sendData();
 		bool receiveData();
 		inline int64_t getTotalBytesSent() { return m_bytesSent; }
 		inline int64_t getTotalBytesReceived() { return m_bytesReceived; }
+
+		// Average cost of sending or receiving a game packet, in NetworkClock::getCycles() units
+		inline uint64_t getAverageSendCycles() { return (m_numPacketsTimedSend) ? (uint64_t)m_sendCycles / m_numPacketsTimedSend : 0; }
+		// RTT, jitter, loss and packet rates. Safe to read from the game thread
+		inline NetworkStats & getStats() { return m_stats; }
+
+		// The newest game packet sequence number that has arrived from the other side. Only valid once one has
+		inline bool hasReceivedGamePacket() { return m_packetWindow.hasReceived(); }
+		inline uint16_t getNewestSequenceReceived() { return m_packetWindow.getNewest(); }
+
+		// Number of input payloads that were lost, but then picked up from a later packet
+		inline uint32_t getNumInputFramesRecovered() { return m_numInputFramesRecovered; }
+
+		// Compress game packets with a model trained from captured traffic, or null for no compression. Both peers must
+		// use the same model. A packet only goes out compressed when that makes it smaller. The model must outlive the transport
+		inline void setCompressionModel(NetworkHuffmanModel * model) { m_compressionModel = model; }
+
+		// Game packets that went out compressed, and how many bytes that saved
+		inline uint32_t getNumPacketsCompressed() { return m_numPacketsCompressed; }
+		inline int64_t getCompressionBytesSaved() { return m_compressionBytesSaved; }
+
+		inline uint64_t getAverageReceiveCycles() { return (m_numPacketsTimedReceive) ? (uint64_t)m_receiveCycles / m_numPacketsTimedReceive : 0; }
+
+		// Spectators are sent every full state update, encoded once and shared between all of them. A spectator is a
+		// NetworkTransport on the other end of the backend that only ever calls receiveData()
+		inline bool addSpectator(NetworkBackend * backend) { return m_spectators.addSpectator(backend); }
+		inline bool removeSpectator(NetworkBackend * backend) { return m_spectators.removeSpectator(backend); }
+		inline NetworkSpectatorBroadcast & getSpectators() { return m_spectators; }
+
+		// The other peer's clock offset, and how far our simulation is ahead of theirs. The game thread tells it which
+		// tick it's on with setLocalTick(), and scales its tick length by getTickScale()
+		inline NetworkClockSync & getClockSync() { return m_clockSync; }
+
+		// Checks the other peer's state hashes against ours. The game thread hashes its state each tick with
+		// NetworkStateHash and hands it over with setLocalHash(), and a mismatch asks the handler for a resync
+		inline NetworkDesyncDetector & getDesyncDetector() { return m_desyncDetector; }
+
+		// Encode a game state once and send it to every spectator. Called by sendData() for full state updates
+		bool broadcastSpectatorState(const uint8_t * state, uint32_t size);
+
 		void resetSendReceiveCounters();
 		void reset();
 
+		// Send numPackets game packets each way between two transports over loopback, for a few body sizes, and print
+		// the average cost of sending and receiving one. Each size is run clearing whole buffers for every packet the
+		// way the transport used to, and then with the pooled buffers, so the two can be compared
+		static bool runBenchmark(uint32_t numPackets);
+
+		// Read the message type and sequence number from the front of a packet, without processing it. Used by packet captures
+		static bool readPacketInfo(const uint8_t * data, uint32_t size, uint8_t * messageType, uint16_t * sequenceNum);
+
 	private:
 
 		enum MessageType
@@ -61,15 +210,42 @@ namespace shd
 			MESSAGE_TYPE_GAME_EVENT_REMATCH,
 			MESSAGE_TYPE_GAME_EVENT_REVIVE_HOME,
 			MESSAGE_TYPE_GAME_EVENT_REVIVE_AWAY,
+			MESSAGE_TYPE_GAME_PACKET_DELTA_STATE_UPDATE,
+			MESSAGE_TYPE_GAME_PACKET_EVENTS_ONLY,
+			MESSAGE_TYPE_GAME_PACKET_COMPRESSED,	// The rest is a whole game packet, encoded with the compression model
 			MESSAGE_TYPE_MAX
 		};
 
+		static const uint32_t MESSAGE_TYPE_BITS = BitsRequired<MESSAGE_TYPE_MAX - 1>::value;
+
+		// Everything is serialized with a BitWriter / BitReader, so these structs are never sent as they are.
+		// The serialize functions decide which fields go on the wire for each message type
 		struct MessageHeader
 		{
 			uint8_t		messageType;				// What type of message is this
-			uint8_t		fragmentDetails;			// If the packet is fragment, first 4 bytes are number of fragments. Second 4 bytes is the fragment index
+			uint8_t		fragmentDetails;			// If the packet is fragment, first 4 bits are number of fragments. Second 4 bits is the fragment index
 			uint16_t	packetSequenceNum;			// What number is this in the packet sequence
 			uint16_t	lastInputSequenceReceived;	// Used to ACK the last input that was received
+			uint16_t	lastPacketSequenceReceived;	// Used to ACK the last game packet that was received. Only valid if MESSAGE_FLAG_HAS_ACK is set
+			uint32_t	ackBits;					// Bit n is set if packet (lastPacketSequenceReceived - 1 - n) was received. Only valid if MESSAGE_FLAG_HAS_ACK is set
+			uint16_t	lastEventIdReceived;		// Used to ACK the last special event that was received. Only valid if MESSAGE_FLAG_HAS_EVENT_ACK is set
+		};
+
+		// Flags stored in fragmentDetails for game packets that aren't fragments
+		enum MessageFlags
+		{
+			MESSAGE_FLAG_HAS_ACK = 1 << 0,
+			MESSAGE_FLAG_HAS_EVENT_ACK = 1 << 1,
+			MESSAGE_FLAG_HAS_EVENTS = 1 << 2,		// The header is followed by a NetworkEventChannel section
+			MESSAGE_FLAG_HAS_REDUNDANCY = 1 << 3,	// Then a NetworkInputRedundancy section
+			MESSAGE_FLAG_HAS_TIME = 1 << 4,			// Then a NetworkClockSync time section
+			MESSAGE_FLAG_HAS_HASH = 1 << 5			// Then a NetworkDesyncDetector hash section
+		};
+
+		// Body of a MESSAGE_TYPE_GAME_PACKET_DELTA_STATE_UPDATE. The delta follows straight after
+		struct DeltaStateUpdateHeader
+		{
+			uint16_t	baselineSequenceNum;		// The snapshot this delta was encoded against
 		};
 
 		struct GameStartHandshake
@@ -80,32 +256,186 @@ namespace shd
 			uint8_t		teamColourSecondary;	// The clients primary team colour
 		};
 
+		// Followed by a time section, and then the sender's first game state, if it had one that fit
 		struct GameStartHandshakeAck
 		{
 			uint8_t		teamColourPrimary;		// The clients primary team colour
 			uint8_t		teamColourSecondary;	// The clients secondary team colour
+			bool		isFullStateUpdate;		// The game state is a full state update
 		};
 
-		// Callback used when initial connection is made. Asks if we should accept a connection with the other user
-		STEAM_CALLBACK(NetworkTransport, onP2PSessionRequest, P2PSessionRequest_t, m_callbackP2PSessionRequest);
+		struct ThrownWeapon
+		{
+			uint32_t	index;					// Index of the weapon in the WeaponManager
+			float		posX;
+			float		posY;
+			float		velocityX;
+			float		velocityY;
+		};
+
+		template <typename Stream> static bool serializeHeader(Stream & stream, MessageHeader & header);
+		template <typename Stream> static bool serializeDeltaStateUpdateHeader(Stream & stream, DeltaStateUpdateHeader & deltaHeader);
+		template <typename Stream> static bool serializeGameStartHandshake(Stream & stream, GameStartHandshake & handshake);
+		template <typename Stream> static bool serializeGameStartHandshakeAck(Stream & stream, GameStartHandshakeAck & ack);
+		// A special event, sent through m_eventChannel. Uses the MESSAGE_TYPE_GAME_EVENT_* types
+		struct GameEvent
+		{
+			uint8_t		type;					// What type of event is this
+			uint8_t		value;					// Team to kickoff, or number of players revived
+			ThrownWeapon weapon;				// Only for MESSAGE_TYPE_GAME_EVENT_WEAPON_THROW
+		};
+
+		template <typename Stream> static bool serializeThrownWeapon(Stream & stream, ThrownWeapon & weapon);
+		template <typename Stream> static bool serializeGameEvent(Stream & stream, GameEvent & event);
+
+		// Apply an event that the other side sent us
+		void handleGameEvent(GameEvent & event);
+
+		// Serialize a header (and the event and redundancy sections, if it has them) into the bytes just in front of msgBody, and return where the packet starts
+		uint8_t * writeHeaderBefore(MessageHeader & header, uint8_t * msgBody);
+
+		// Send a message that's just a header and an optional body, built in buffer
+		bool sendMessage(NetworkPacketPool::Packet * buffer, MessageHeader & header, uint32_t bodySize, NetworkBackend::SendType sendType);
+
+		// Build this tick's game packet in buffer and send it
+		bool sendGamePacketData(NetworkPacketPool::Packet * buffer);
+
+#ifndef SHD_NO_STEAM
+		// The default backend
+		NetworkBackendSteam m_steamBackend;
+#endif
+
+		// The backend that's currently used to send and receive packets
+		NetworkBackend * m_backend;
+
+#ifndef SHD_DEDICATED_SERVER
+		// The default handler
+		NetworkApplicationHandler m_applicationHandler;
+#endif
+
+		// Where game packets and events come from and go to
+		NetworkTransportHandler * m_handler;
+
+		// Process a single packet that was received
+		bool processPacket(uint8_t * data, uint32_t size);
+
+		// Send the handshake, or the ack with our first game state in it
+		bool sendHandshake();
+		bool sendHandshakeAck();
+
+		// Handle the body of a handshake or an ack. The ack's game state is the rest of data, after what reader has read
+		bool processHandshake(BitReader & reader);
+		bool processHandshakeAck(BitReader & reader, uint8_t * data, uint32_t size);
+
+		// The most bytes the ack and its time section can take up, in front of the game state
+		static const int NET_TRANSPORT_MAX_ACK_SIZE = 4 + NET_TRANSPORT_MAX_TIME_SECTION_SIZE;
+
+		// Send a game packet, splitting it into fragments if it's too big. The packet must be in buffer, after the headroom
+		bool sendGamePacket(NetworkPacketPool::Packet * buffer, uint8_t * packet, size_t size, uint16_t sequenceNum);
+
+		// Where message bodies are written in a send buffer. The header is written in front of it once the body is done
+		inline uint8_t * getSendBodyStart(NetworkPacketPool::Packet * buffer) { return buffer->data + NET_TRANSPORT_SEND_HEADROOM + NET_TRANSPORT_MAX_HEADER_SIZE + NET_TRANSPORT_MAX_EVENT_SECTION_SIZE + NET_TRANSPORT_MAX_REDUNDANCY_SECTION_SIZE + NET_TRANSPORT_MAX_TIME_SECTION_SIZE + NET_TRANSPORT_MAX_HASH_SECTION_SIZE; }
+
+		// The most a game packet body can be, so it still fits in a send buffer and in the fragments
+		static const int NET_TRANSPORT_MAX_BODY_SIZE = NET_TRANSPORT_FRAGMENT_DATA_MAX_SIZE * NET_TRANSPORT_MAX_FRAGMENTS - NET_TRANSPORT_MAX_HEADER_SIZE - NET_TRANSPORT_MAX_EVENT_SECTION_SIZE - NET_TRANSPORT_MAX_REDUNDANCY_SECTION_SIZE - NET_TRANSPORT_MAX_TIME_SECTION_SIZE - NET_TRANSPORT_MAX_HASH_SECTION_SIZE;
+
+		// Buffers that packets are built in
+		NetworkPacketPool m_packetPool;
 
-		// Callback used when a connection error occurs
-		STEAM_CALLBACK(NetworkTransport, onP2PSessionConnectFail, P2PSessionConnectFail_t, m_callbackP2PSessionConnectFail);
+		// Where each batch of received packets is read into, and their sizes
+		uint8_t m_receiveBatch[NET_TRANSPORT_RECEIVE_BATCH_SIZE * NET_TRANSPORT_RECEIVE_BUFFER_SIZE];
+		uint32_t m_receiveSizes[NET_TRANSPORT_RECEIVE_BATCH_SIZE];
 
-		// The send buffer
-		char m_sendBuffer[NET_TRANSPORT_SEND_BUFF_SIZE];
+		// Turn a full state update into a delta against the newest snapshot the other peer has acked, if that's smaller
+		void deltaCompressStateUpdate(MessageHeader * msgHeader, uint8_t * msgBody, size_t * bodySize);
 
-		// The receive buffer
-		char m_recvBuffer[NET_TRANSPORT_RECV_BUFF_SIZE];
+		// Full state updates we have sent, so later ones can be delta compressed against them
+		NetworkSnapshotRing m_sentSnapshots;
+
+		// Full state updates we have received, to decode deltas against
+		NetworkSnapshotRing m_recvSnapshots;
+
+		// Encode a whole game packet into a new buffer from the pool, behind a MESSAGE_TYPE_GAME_PACKET_COMPRESSED header.
+		// Returns null if it wouldn't be any smaller. The caller releases the buffer
+		NetworkPacketPool::Packet * compressGamePacket(const uint8_t * packet, size_t size, uint8_t ** compressedPacket, size_t * compressedSize);
+
+		// The model game packets are compressed with, if any
+		NetworkHuffmanModel * m_compressionModel;
+
+		// Where a compressed packet is decoded to before it's processed
+		uint8_t m_decompressBuffer[NetworkPacketPool::PACKET_BUFFER_SIZE];
+
+		volatile uint32_t m_numPacketsCompressed;
+		volatile int64_t m_compressionBytesSaved;
+
+		// Split a packet into the frame's packets, as fragments if it's too big, the same way sendGamePacket() would send it
+		bool buildSpectatorFrame(NetworkSpectatorBroadcast::Frame * frame, const uint8_t * packet, size_t size, uint16_t sequenceNum);
+
+		// Spectators, and the sequence numbers of the frames sent to them. They have their own, separate from m_packetsSent
+		NetworkSpectatorBroadcast m_spectators;
+		uint16_t m_spectatorSequenceNum;
+
+		// Time sections go out with the handshake and every so often with game packets
+		NetworkClockSync m_clockSync;
+
+		// State hashes go out with game packets, once per tick the game has hashed
+		NetworkDesyncDetector m_desyncDetector;
+
+		// Where we're up to with starting the match, when it started, and when the handshake is next sent again
+		ConnectState m_connectState;
+		uint64_t m_connectStartUs;
+		uint64_t m_nextHandshakeUs;
+		uint64_t m_connectRetryIntervalUs;
+		uint64_t m_connectTimeUs;
+
+		// The game state that went out with our handshake ack. If the ack goes missing and the handshake comes again,
+		// the same state goes out again rather than the game filling another one
+		uint8_t m_handshakeAckState[NET_TRANSPORT_MAX_PACKET_SIZE];
+		uint32_t m_handshakeAckStateSize;
+		bool m_handshakeAckIsFullStateUpdate;
+		bool m_hasHandshakeAckState;
+
+		// Which game packets we've received. Packets older than the newest one are dropped, and this is what gets ACKed
+		NetworkReceiveWindow m_packetWindow;
+
+		// Input payloads we've sent, so they can be sent again until they're ACKed
+		NetworkInputRedundancy m_inputRedundancy;
+
+		// Connection statistics
+		NetworkStats m_stats;
+
+		// Number of lost input payloads that were recovered from later packets
+		volatile uint32_t m_numInputFramesRecovered;
+
+		// Special events that are waiting to be ACKed, and the ones we've received
+		NetworkEventChannel m_eventChannel;
+
+		// The last event ACK we sent, so we know if the other side needs a new one
+		uint16_t m_lastEventAckSent;
+		bool m_hasSentEventAck;
+
+		// Puts fragmented packets back together
+		NetworkFragmentReassembler m_reassembler;
 
 		// A counter for the number of packets sent
 		uint16_t m_packetsSent;
 
-		// The last packet number received. Drop a packet if we received a newer one
-		volatile uint32_t m_lastPacketNumReceived;
-
 		// Number of bytes sent and received
 		volatile int64_t m_bytesSent;
 		volatile int64_t m_bytesReceived;
+
+		// Time spent sending and receiving game packets, and how many packets that was for
+		volatile int64_t m_sendCycles;
+		volatile int64_t m_receiveCycles;
+		volatile uint32_t m_numPacketsTimedSend;
+		volatile uint32_t m_numPacketsTimedReceive;
+
+		// Only set by runBenchmark(), to measure what sending and receiving used to cost. The whole of this buffer is
+		// cleared before each send, and the start of it before each packet is read into it one at a time.
+		// Owned by runBenchmark()
+		uint8_t * m_baselineBuffer;
+
+		// receiveData() the way it used to be done, for the benchmark's baseline
+		bool receiveDataBaseline();
 	};
 }
\ No newline at end of file
@@ -0,0 +1,410 @@
+//
+//  NetworkTransportApplication.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "NetworkTransportApplication.h"
+#include "NetworkClock.h"
+#include "Application.h"
+
+using namespace shd;
+
+// The NetworkInputBuffer's body size goes in front of it
+#define SHD_APPLICATION_BODY_SIZE_BYTES 2
+
+// Bytes of each game packet for thrown weapons. Each one takes 9 or 10, so about three go in each packet
+#define SHD_APPLICATION_ENTITY_BUDGET_BYTES 32
+
+// How fast a thrown weapon gains priority, a second. Ones that haven't been thrown again since they were last sent
+// gain it ten times more slowly
+#define SHD_APPLICATION_WEAPON_PRIORITY 20.0f
+
+// Thrown weapon indices are sent in just enough bits for the transport's limit
+static_assert(NetworkTransport::NET_TRANSPORT_MAX_WEAPONS >= WeaponManager::MAX_WEAPONS, "NET_TRANSPORT_MAX_WEAPONS is less than WeaponManager::MAX_WEAPONS");
+static_assert(NetworkApplicationHandler::MAX_WEAPONS >= WeaponManager::MAX_WEAPONS, "NetworkApplicationHandler::MAX_WEAPONS is less than WeaponManager::MAX_WEAPONS");
+
+NetworkApplicationHandler::NetworkApplicationHandler() :	m_desyncDetector(nullptr),
+															m_clockSync(nullptr),
+															m_lastBodyUs(0)
+{
+	resetWeaponThrows();
+}
+
+template <typename Stream> bool NetworkApplicationHandler::serializeWeaponThrow(Stream & stream, WeaponThrow & weaponThrow)
+{
+	return	serializeVarint(stream, weaponThrow.numThrows) &&
+			serializeQuantizedFloat<NetworkTransport::NetSchemaPosition>(stream, weaponThrow.posX) &&
+			serializeQuantizedFloat<NetworkTransport::NetSchemaPosition>(stream, weaponThrow.posY) &&
+			serializeQuantizedFloat<NetworkTransport::NetSchemaVelocity>(stream, weaponThrow.velocityX) &&
+			serializeQuantizedFloat<NetworkTransport::NetSchemaVelocity>(stream, weaponThrow.velocityY);
+}
+
+void NetworkApplicationHandler::resetWeaponThrows()
+{
+	m_weaponPriority.init(MAX_WEAPONS, SHD_APPLICATION_ENTITY_BUDGET_BYTES);
+
+	// Nothing is sent until it's been thrown
+	for (uint32_t i = 0; i < MAX_WEAPONS; i++)
+	{
+		m_weaponPriority.setBasePriority(i, 0.0f);
+	}
+
+	memset(m_sentThrows, 0, sizeof(m_sentThrows));
+	memset(m_numThrowEventsReceived, 0, sizeof(m_numThrowEventsReceived));
+	memset(m_numThrowsApplied, 0, sizeof(m_numThrowsApplied));
+	m_lastBodyUs = 0;
+}
+
+void NetworkApplicationHandler::onTickSimulated(uint32_t tick)
+{
+	NetworkStateHash stateHash;
+
+	if (m_clockSync)
+	{
+		m_clockSync->setLocalTick(tick + 1, NetworkClock::getTimeMicroseconds());
+	}
+
+	if (m_desyncDetector == nullptr)
+	{
+		return;
+	}
+
+	// Field by field, so padding and the layout of the struct don't end up in the hash. Add any new match state
+	// that both peers simulate here, in the same order on both
+	stateHash.begin();
+	stateHash.add(tick);
+	stateHash.add((uint32_t)Application::getInstance().matchState.nextTeamToKickoff);
+	stateHash.add((uint32_t)Application::getInstance().matchState.numPlayersRevived);
+
+	m_desyncDetector->setLocalHash(tick, stateHash.finish());
+}
+
+void NetworkApplicationHandler::getTeamColours(uint8_t * primary, uint8_t * secondary)
+{
+	*primary = Application::getInstance().globalSettings.teamColourPrimary;
+	*secondary = Application::getInstance().globalSettings.teamColourSecondary;
+}
+
+void NetworkApplicationHandler::onHandshakeReceived(uint8_t primary, uint8_t secondary)
+{
+	(void)secondary;
+
+	// A new match
+	resetWeaponThrows();
+
+	if (Application::getInstance().globalSettings.teamColourPrimary == (Team::TeamColour)primary)
+	{
+		Application::getInstance().globalSettings.teamColourPrimaryOnline = Application::getInstance().globalSettings.teamColourPrimary;
+		Application::getInstance().globalSettings.teamColourSecondaryOnline = Application::getInstance().globalSettings.teamColourSecondary;
+
+	}
+	else
+	{
+		Application::getInstance().globalSettings.teamColourPrimaryOnline = (Team::TeamColour)primary;
+		Application::getInstance().globalSettings.teamColourSecondaryOnline = Application::getInstance().globalSettings.teamColourPrimary;
+	}
+}
+
+void NetworkApplicationHandler::onHandshakeAckReceived(uint8_t primary, uint8_t secondary)
+{
+	resetWeaponThrows();
+
+	if (Application::getInstance().globalSettings.teamColourPrimary == (Team::TeamColour)primary)
+	{
+		Application::getInstance().globalSettings.teamColourSecondary = (Team::TeamColour)secondary;
+	}
+	else
+	{
+		Application::getInstance().globalSettings.teamColourSecondary = (Team::TeamColour)primary;
+	}
+}
+
+void NetworkApplicationHandler::fillSendBuffer(uint8_t * buffer, size_t bufferSize, size_t * bytesWritten, bool * isFullStateUpdate)
+{
+	uint64_t nowUs = NetworkClock::getTimeMicroseconds();
+	float elapsedSeconds = (m_lastBodyUs) ? (float)(nowUs - m_lastBodyUs) / 1000000.0f : 0.0f;
+	size_t inputSize = 0;
+	uint32_t weaponsSize = 0;
+
+	*bytesWritten = 0;
+	*isFullStateUpdate = false;
+
+	if (bufferSize < SHD_APPLICATION_BODY_SIZE_BYTES + SHD_APPLICATION_ENTITY_BUDGET_BYTES)
+	{
+		return;
+	}
+
+	// The input buffer always has room for the thrown weapons after it. They only use what they need
+	Application::getInstance().networkThread.getNetInputBuffer()->fillSendBuffer(	buffer + SHD_APPLICATION_BODY_SIZE_BYTES,
+																					bufferSize - SHD_APPLICATION_BODY_SIZE_BYTES - SHD_APPLICATION_ENTITY_BUDGET_BYTES,
+																					&inputSize,
+																					isFullStateUpdate);
+
+	// No body means no packet, so the weapons wait for the next one
+	if (inputSize == 0 || inputSize > 0xFFFF)
+	{
+		return;
+	}
+
+	m_lastBodyUs = nowUs;
+
+	buffer[0] = (uint8_t)(inputSize & 0xFF);
+	buffer[1] = (uint8_t)(inputSize >> 8);
+
+	weaponsSize = m_weaponPriority.write(	buffer + SHD_APPLICATION_BODY_SIZE_BYTES + inputSize,
+											(uint32_t)(bufferSize - SHD_APPLICATION_BODY_SIZE_BYTES - inputSize),
+											elapsedSeconds,
+											*this);
+
+	*bytesWritten = SHD_APPLICATION_BODY_SIZE_BYTES + inputSize + weaponsSize;
+}
+
+void NetworkApplicationHandler::parseRecvBuffer(void * buffer, size_t bufferSize, bool isFullStateUpdate)
+{
+	uint8_t * body = (uint8_t *)buffer;
+	size_t inputSize = 0;
+
+	if (bufferSize < SHD_APPLICATION_BODY_SIZE_BYTES)
+	{
+		SHD_PRINTF("NetworkApplicationHandler: dropped a game packet body of %u bytes\n", (uint32_t)bufferSize);
+		return;
+	}
+
+	inputSize = (size_t)body[0] | ((size_t)body[1] << 8);
+
+	if (inputSize > bufferSize - SHD_APPLICATION_BODY_SIZE_BYTES)
+	{
+		SHD_PRINTF("NetworkApplicationHandler: dropped a game packet body of %u bytes, with %u bytes of input\n", (uint32_t)bufferSize, (uint32_t)inputSize);
+		return;
+	}
+
+	Application::getInstance().networkThread.getNetInputBuffer()->parseRecvBuffer(body + SHD_APPLICATION_BODY_SIZE_BYTES, isFullStateUpdate);
+
+	if (NetworkPriorityAccumulator::read(	body + SHD_APPLICATION_BODY_SIZE_BYTES + inputSize,
+											(uint32_t)(bufferSize - SHD_APPLICATION_BODY_SIZE_BYTES - inputSize),
+											*this) == false)
+	{
+		SHD_PRINTF("NetworkApplicationHandler: couldn't read the thrown weapons in a game packet\n");
+	}
+}
+
+uint16_t NetworkApplicationHandler::getLastReceivedSeqNum()
+{
+	return Application::getInstance().networkThread.getNetInputBuffer()->getLastReceivedSeqNum();
+}
+
+bool NetworkApplicationHandler::popGameEvent(GameEvent * event)
+{
+	NetworkInputBuffer::SpecialEventData specialEvent;
+
+	while (Application::getInstance().networkThread.getNetInputBuffer()->popSpecialEvent(&specialEvent))
+	{
+		memset(event, 0, sizeof(GameEvent));
+		SHD_PRINTF("Sending special event: %i\n", specialEvent.type);
+
+		switch (specialEvent.type)
+		{
+		case NetworkInputBuffer::NET_SPECIAL_EVENT_GOAL_TOP:
+			event->type = EVENT_TYPE_GOAL_TOP;
+			event->value = specialEvent.nextTeamToKickoff;
+			return true;
+
+		case NetworkInputBuffer::NET_SPECIAL_EVENT_GOAL_BOTTOM:
+			event->type = EVENT_TYPE_GOAL_BOTTOM;
+			event->value = specialEvent.nextTeamToKickoff;
+			return true;
+
+		case NetworkInputBuffer::NET_SPECIAL_EVENT_WEAPON_THROW:
+			event->type = EVENT_TYPE_WEAPON_THROW;
+			event->weaponIndex = specialEvent.weaponIndex;
+			event->weaponPosX = specialEvent.weaponPos.x;
+			event->weaponPosY = specialEvent.weaponPos.y;
+			event->weaponVelocityX = specialEvent.weaponVel.x;
+			event->weaponVelocityY = specialEvent.weaponVel.y;
+
+			// Sent in game packets too, until it's thrown again
+			if (event->weaponIndex < MAX_WEAPONS)
+			{
+				WeaponThrow & weaponThrow = m_sentThrows[event->weaponIndex];
+
+				weaponThrow.numThrows++;
+				weaponThrow.posX = event->weaponPosX;
+				weaponThrow.posY = event->weaponPosY;
+				weaponThrow.velocityX = event->weaponVelocityX;
+				weaponThrow.velocityY = event->weaponVelocityY;
+
+				m_weaponPriority.setBasePriority(event->weaponIndex, SHD_APPLICATION_WEAPON_PRIORITY);
+				m_weaponPriority.markChanged(event->weaponIndex);
+			}
+
+			return true;
+
+		case NetworkInputBuffer::NET_SPECIAL_EVENT_HALFTIME:
+			event->type = EVENT_TYPE_HALFTIME;
+			return true;
+
+		case NetworkInputBuffer::NET_SPECIAL_EVENT_REMATCH:
+			event->type = EVENT_TYPE_REMATCH;
+			return true;
+
+		case NetworkInputBuffer::NET_SPECIAL_EVENT_REVIVE_HOME:
+			event->type = EVENT_TYPE_REVIVE_HOME;
+			event->value = specialEvent.reviveHome;
+			return true;
+
+		case NetworkInputBuffer::NET_SPECIAL_EVENT_REVIVE_AWAY:
+			event->type = EVENT_TYPE_REVIVE_AWAY;
+			event->value = specialEvent.reviveAway;
+			return true;
+
+		default:
+			SHD_ASSERT(false);
+			break;
+		}
+	}
+
+	return false;
+}
+
+void NetworkApplicationHandler::onGameEvent(const GameEvent & event)
+{
+	// Events arrive once each, in order, so counting them gives the throw's number
+	if (event.type == EVENT_TYPE_WEAPON_THROW && event.weaponIndex < MAX_WEAPONS)
+	{
+		WeaponThrow weaponThrow;
+
+		weaponThrow.numThrows = ++m_numThrowEventsReceived[event.weaponIndex];
+		weaponThrow.posX = event.weaponPosX;
+		weaponThrow.posY = event.weaponPosY;
+		weaponThrow.velocityX = event.weaponVelocityX;
+		weaponThrow.velocityY = event.weaponVelocityY;
+
+		onWeaponThrowReceived(event.weaponIndex, weaponThrow);
+		return;
+	}
+
+	if (m_receivedEvents.push(event, NetworkClock::getTimeMicroseconds()) == false)
+	{
+		SHD_PRINTF("NetworkApplicationHandler: dropped a game event, the game thread has fallen behind\n");
+	}
+}
+
+bool NetworkApplicationHandler::writeEntity(uint32_t entity, BitWriter & writer)
+{
+	if (entity >= MAX_WEAPONS || m_sentThrows[entity].numThrows == 0)
+	{
+		return false;
+	}
+
+	return serializeWeaponThrow(writer, m_sentThrows[entity]);
+}
+
+bool NetworkApplicationHandler::readEntity(uint32_t entity, BitReader & reader)
+{
+	WeaponThrow weaponThrow;
+
+	if (entity >= MAX_WEAPONS || serializeWeaponThrow(reader, weaponThrow) == false)
+	{
+		return false;
+	}
+
+	onWeaponThrowReceived(entity, weaponThrow);
+
+	return true;
+}
+
+void NetworkApplicationHandler::onWeaponThrowReceived(uint32_t weaponIndex, const WeaponThrow & weaponThrow)
+{
+	GameEvent event;
+
+	// Already applied, from whichever of the event or a game packet got here first
+	if (weaponThrow.numThrows <= m_numThrowsApplied[weaponIndex])
+	{
+		return;
+	}
+
+	memset(&event, 0, sizeof(GameEvent));
+	event.type = EVENT_TYPE_WEAPON_THROW;
+	event.weaponIndex = weaponIndex;
+	event.weaponPosX = weaponThrow.posX;
+	event.weaponPosY = weaponThrow.posY;
+	event.weaponVelocityX = weaponThrow.velocityX;
+	event.weaponVelocityY = weaponThrow.velocityY;
+
+	if (m_receivedEvents.push(event, NetworkClock::getTimeMicroseconds()) == false)
+	{
+		SHD_PRINTF("NetworkApplicationHandler: dropped a weapon throw, the game thread has fallen behind\n");
+		return;
+	}
+
+	m_numThrowsApplied[weaponIndex] = weaponThrow.numThrows;
+}
+
+void NetworkApplicationHandler::applyGameEvents()
+{
+	NetworkGameEventQueue::Entry entries[NetworkGameEventQueue::QUEUE_SIZE];
+	uint32_t numEntries = m_receivedEvents.drain(entries, NetworkGameEventQueue::QUEUE_SIZE);
+
+	for (uint32_t i = 0; i < numEntries; i++)
+	{
+		applyGameEvent(entries[i].event);
+	}
+}
+
+void NetworkApplicationHandler::applyGameEvent(const GameEvent & event)
+{
+	// Events come straight off the wire, so anything out of range is dropped rather than trusted. This is the game
+	// thread, which is the only one that touches the match state and flags
+	switch (event.type)
+	{
+	case EVENT_TYPE_GOAL_TOP:
+		Application::getInstance().matchState.nextTeamToKickoff = event.value;
+		Application::getInstance().networkThread.specialEvents.goalTop = 1;
+		break;
+	case EVENT_TYPE_GOAL_BOTTOM:
+		Application::getInstance().matchState.nextTeamToKickoff = event.value;
+		Application::getInstance().networkThread.specialEvents.goalBottom = 1;
+		break;
+	case EVENT_TYPE_WEAPON_THROW:
+	{
+		NetworkInputBuffer::PackedThrownWeapon packedWeapon;
+
+		if (event.weaponIndex >= WeaponManager::MAX_WEAPONS)
+		{
+			SHD_PRINTF("NetworkApplicationHandler: dropped a weapon throw for weapon %u\n", (uint32_t)event.weaponIndex);
+			break;
+		}
+
+		// The game thread still unpacks the weapon with the old fixed point scaling
+		packedWeapon.index = event.weaponIndex;
+		packedWeapon.posX = event.weaponPosX * 50;
+		packedWeapon.posY = event.weaponPosY * 50;
+		packedWeapon.velocityX = event.weaponVelocityX * 100;
+		packedWeapon.velocityY = event.weaponVelocityY * 100;
+
+		Application::getInstance().networkThread.packedWeapons[event.weaponIndex] = packedWeapon;
+		Application::getInstance().networkThread.specialEvents.weaponThrown[event.weaponIndex] = 1;
+
+		break;
+	}
+	case EVENT_TYPE_HALFTIME:
+		break;
+	case EVENT_TYPE_REMATCH:
+		Application::getInstance().networkThread.setOpponentWantsRematch(true);
+		break;
+	case EVENT_TYPE_REVIVE_HOME:
+		Application::getInstance().matchState.numPlayersRevived = event.value;
+		Application::getInstance().networkThread.specialEvents.reviveHome = 1;
+		break;
+	case EVENT_TYPE_REVIVE_AWAY:
+		Application::getInstance().matchState.numPlayersRevived = event.value;
+		Application::getInstance().networkThread.specialEvents.reviveAway = 1;
+		break;
+	default:
+		SHD_PRINTF("NetworkApplicationHandler: dropped a game event of unknown type %u\n", (uint32_t)event.type);
+		break;
+	}
+}
@@ -0,0 +1,103 @@
+//
+//  NetworkTransportApplication.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include "NetworkTransportHandler.h"
+#include "NetworkStateHash.h"
+#include "NetworkClockSync.h"
+#include "NetworkGameEventQueue.h"
+#include "NetworkPriorityAccumulator.h"
+
+namespace shd
+{
+	// The game's NetworkTransportHandler. Game packets go to and from the network thread's NetworkInputBuffer,
+	// and handshakes read and write the Application's settings. Special events the other side sends are queued by the
+	// network thread, and applied to the match state by the game thread at the start of a tick.
+	// Each game packet body is the NetworkInputBuffer's body, after its size, and then as many of our thrown weapons as
+	// a NetworkPriorityAccumulator fits in its budget. A throw is applied from whichever of its event or a game packet
+	// arrives first
+	class NetworkApplicationHandler : public NetworkTransportHandler, public NetworkEntitySerializer
+	{
+	public:
+
+		// Weapons that can be thrown, and so the number of entities. At least WeaponManager::MAX_WEAPONS
+		static const uint32_t MAX_WEAPONS = 16;
+
+		NetworkApplicationHandler();
+
+		// Where the per tick hashes and tick times go. Set by the NetworkTransport that owns the handler
+		inline void setDesyncDetector(NetworkDesyncDetector * desyncDetector) { m_desyncDetector = desyncDetector; }
+		inline void setClockSync(NetworkClockSync * clockSync) { m_clockSync = clockSync; }
+
+		// Hash the match state at the end of a tick, once the tick's inputs are final, and hand it to the desync
+		// detector. Also tells the clock sync the next tick starts now. Called on the game thread by
+		// Controllers::update(), once the game has given it this handler with Controllers::setNetworkHandler().
+		// Both peers count ticks from the start of the match
+		void onTickSimulated(uint32_t tick);
+
+		// Apply every special event the other side has sent since last time to the Application, in the order they
+		// arrived. Called on the game thread by Controllers::update(), once a tick, in or out of a match
+		void applyGameEvents();
+
+		// Multiply the length of the next tick by this, to keep our simulation in line with the other side's
+		inline float getTickScale() { return (m_clockSync) ? m_clockSync->getTickScale() : 1.0f; }
+
+		virtual void getTeamColours(uint8_t * primary, uint8_t * secondary);
+		virtual void onHandshakeReceived(uint8_t primary, uint8_t secondary);
+		virtual void onHandshakeAckReceived(uint8_t primary, uint8_t secondary);
+		virtual void fillSendBuffer(uint8_t * buffer, size_t bufferSize, size_t * bytesWritten, bool * isFullStateUpdate);
+		virtual void parseRecvBuffer(void * buffer, size_t bufferSize, bool isFullStateUpdate);
+		virtual uint16_t getLastReceivedSeqNum();
+		virtual bool popGameEvent(GameEvent * event);
+		virtual void onGameEvent(const GameEvent & event);
+
+		// Entity n is weapon n
+		virtual bool writeEntity(uint32_t entity, BitWriter & writer);
+		virtual bool readEntity(uint32_t entity, BitReader & reader);
+
+	private:
+
+		struct WeaponThrow
+		{
+			uint32_t numThrows;		// How many times the weapon has been thrown this match, this one included
+			float posX;
+			float posY;
+			float velocityX;
+			float velocityY;
+		};
+
+		template <typename Stream> static bool serializeWeaponThrow(Stream & stream, WeaponThrow & weaponThrow);
+
+		// Apply one received special event. Anything out of range is dropped
+		void applyGameEvent(const GameEvent & event);
+
+		// Forget every throw, at the start of a match
+		void resetWeaponThrows();
+
+		// Queue a throw of the other side's for the game thread, unless it's been applied already
+		void onWeaponThrowReceived(uint32_t weaponIndex, const WeaponThrow & weaponThrow);
+
+		NetworkDesyncDetector * m_desyncDetector;
+		NetworkClockSync * m_clockSync;
+
+		// Special events on their way from the network thread to the game thread
+		NetworkGameEventQueue m_receivedEvents;
+
+		// Decides which of our thrown weapons go in each game packet
+		NetworkPriorityAccumulator m_weaponPriority;
+		uint64_t m_lastBodyUs;
+
+		// Our last throw of each weapon
+		WeaponThrow m_sentThrows[MAX_WEAPONS];
+
+		// The other side's throws of each weapon that have arrived as events, and that have been applied either way
+		uint32_t m_numThrowEventsReceived[MAX_WEAPONS];
+		uint32_t m_numThrowsApplied[MAX_WEAPONS];
+	};
+}
@@ -0,0 +1,75 @@
+//
+//  NetworkTransportHandler.h
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace shd
+{
+	// Where NetworkTransport gets the data it sends, and hands over what it receives. The game uses
+	// NetworkApplicationHandler, which talks to the Application. A dedicated server gives each of its
+	// transports its own handler, so many matches can run in the same process
+	class NetworkTransportHandler
+	{
+	public:
+
+		enum EventType
+		{
+			EVENT_TYPE_GOAL_TOP = 0,
+			EVENT_TYPE_GOAL_BOTTOM,
+			EVENT_TYPE_WEAPON_THROW,
+			EVENT_TYPE_HALFTIME,
+			EVENT_TYPE_REMATCH,
+			EVENT_TYPE_REVIVE_HOME,
+			EVENT_TYPE_REVIVE_AWAY,
+			EVENT_TYPE_MAX
+		};
+
+		struct GameEvent
+		{
+			EventType	type;
+			uint32_t	value;				// Team to kickoff, or number of players revived
+			uint32_t	weaponIndex;		// The rest are only for EVENT_TYPE_WEAPON_THROW
+			float		weaponPosX;
+			float		weaponPosY;
+			float		weaponVelocityX;
+			float		weaponVelocityY;
+		};
+
+		virtual ~NetworkTransportHandler() {}
+
+		// Our team colours, sent in the handshake
+		virtual void getTeamColours(uint8_t * primary, uint8_t * secondary) = 0;
+
+		// The other side's team colours, from their handshake or their ACK of ours
+		virtual void onHandshakeReceived(uint8_t primary, uint8_t secondary) = 0;
+		virtual void onHandshakeAckReceived(uint8_t primary, uint8_t secondary) = 0;
+
+		// Write this tick's game packet body. isFullStateUpdate is set if it's a full state update
+		virtual void fillSendBuffer(uint8_t * buffer, size_t bufferSize, size_t * bytesWritten, bool * isFullStateUpdate) = 0;
+
+		// A game packet body that was received
+		virtual void parseRecvBuffer(void * buffer, size_t bufferSize, bool isFullStateUpdate) = 0;
+
+		// The last input sequence number that was received, to ACK back
+		virtual uint16_t getLastReceivedSeqNum() = 0;
+
+		// Special events to send. Return false when there are no more
+		virtual bool popGameEvent(GameEvent * event) = 0;
+
+		// A special event the other side sent us
+		virtual void onGameEvent(const GameEvent & event) = 0;
+
+		// The two simulations have stopped agreeing. If this side sends full state updates, the next body should be
+		// one, and it's sent whole to put the other side back on our state. Called before each body until one is.
+		// A handler that can't bring a full state update forward leaves this alone, and the next one it writes is sent whole
+		virtual void onResyncRequested() {}
+	};
+}
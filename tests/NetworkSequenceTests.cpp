@@ -0,0 +1,217 @@
+//
+//  NetworkSequenceTests.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "Common.h"
+#include "NetworkSequence.h"
+#include "NetworkDeltaCompression.h"
+#include <string.h>
+
+using namespace shd;
+
+static int s_numFailures = 0;
+
+#define SHD_TEST_CHECK(condition) \
+	do \
+	{ \
+		if ((condition) == false) \
+		{ \
+			SHD_PRINTF("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			s_numFailures++; \
+		} \
+	} while (0)
+
+static void testDifferenceWrapsAround()
+{
+	SHD_TEST_CHECK(NetworkSequence::difference(0, 0) == 0);
+	SHD_TEST_CHECK(NetworkSequence::difference(100, 50) == 50);
+	SHD_TEST_CHECK(NetworkSequence::difference(50, 100) == -50);
+
+	// Across the wrap, in both directions
+	SHD_TEST_CHECK(NetworkSequence::difference(1, 65535) == 2);
+	SHD_TEST_CHECK(NetworkSequence::difference(65535, 1) == -2);
+	SHD_TEST_CHECK(NetworkSequence::difference(0, 65535) == 1);
+	SHD_TEST_CHECK(NetworkSequence::difference(65535, 0) == -1);
+	SHD_TEST_CHECK(NetworkSequence::difference(10, 65526) == 20);
+
+	// The furthest apart two numbers can be and still be ordered
+	SHD_TEST_CHECK(NetworkSequence::difference(32767, 0) == 32767);
+	SHD_TEST_CHECK(NetworkSequence::difference(0, 32767) == -32767);
+	SHD_TEST_CHECK(NetworkSequence::difference(32766, 65535) == 32767);
+
+	// Exactly half the range apart is ambiguous, and neither is newer
+	SHD_TEST_CHECK(NetworkSequence::difference(32768, 0) == -32768);
+	SHD_TEST_CHECK(NetworkSequence::difference(0, 32768) == -32768);
+	SHD_TEST_CHECK(NetworkSequence::isNewer(32768, 0) == false);
+	SHD_TEST_CHECK(NetworkSequence::isNewer(0, 32768) == false);
+
+	SHD_TEST_CHECK(NetworkSequence::isNewer(0, 65535));
+	SHD_TEST_CHECK(NetworkSequence::isNewer(65535, 0) == false);
+	SHD_TEST_CHECK(NetworkSequence::isNewer(5, 5) == false);
+}
+
+static void testReceiveWindowOutOfOrder()
+{
+	NetworkReceiveWindow window;
+
+	// Starts just before the wrap and ends just after it
+	const uint16_t first = 65530;
+	const uint16_t order[] = { 2, 0, 1, 5, 3, 4, 9, 6, 8, 7, 11, 10 };
+	const uint32_t numPackets = sizeof(order) / sizeof(order[0]);
+	uint16_t newest = first + order[0];
+
+	SHD_TEST_CHECK(window.hasReceived() == false);
+	SHD_TEST_CHECK(window.markReceived(newest) == NetworkReceiveWindow::RESULT_NEWEST);
+
+	for (uint32_t i = 1; i < numPackets; i++)
+	{
+		uint16_t sequenceNum = first + order[i];
+		NetworkReceiveWindow::Result expected = NetworkSequence::isNewer(sequenceNum, newest) ? NetworkReceiveWindow::RESULT_NEWEST : NetworkReceiveWindow::RESULT_LATE;
+
+		SHD_TEST_CHECK(window.isReceived(sequenceNum) == false);
+		SHD_TEST_CHECK(window.markReceived(sequenceNum) == expected);
+		SHD_TEST_CHECK(window.isReceived(sequenceNum));
+
+		if (expected == NetworkReceiveWindow::RESULT_NEWEST)
+		{
+			newest = sequenceNum;
+		}
+	}
+
+	SHD_TEST_CHECK(window.getNewest() == (uint16_t)(first + 11));
+	SHD_TEST_CHECK(window.getNewest() == 5);
+
+	// Every one of the 11 before the newest has arrived
+	SHD_TEST_CHECK((window.getAckBits() & 0x7FF) == 0x7FF);
+	SHD_TEST_CHECK((window.getAckBits() & ~0x7FFu) == 0);
+
+	// Each of them again, from either side of the wrap, is a duplicate
+	for (uint32_t i = 0; i < numPackets; i++)
+	{
+		SHD_TEST_CHECK(window.markReceived((uint16_t)(first + order[i])) == NetworkReceiveWindow::RESULT_DUPLICATE);
+	}
+
+	SHD_TEST_CHECK(window.getNewest() == 5);
+}
+
+static void testReceiveWindowGapsAndAge()
+{
+	NetworkReceiveWindow window;
+
+	SHD_TEST_CHECK(window.markReceived(65535) == NetworkReceiveWindow::RESULT_NEWEST);
+
+	// 0 and 1 are lost for now, 2 arrives first
+	SHD_TEST_CHECK(window.markReceived(2) == NetworkReceiveWindow::RESULT_NEWEST);
+	SHD_TEST_CHECK(window.getAckBits() == (1u << 2));
+	SHD_TEST_CHECK(window.classify(0) == NetworkReceiveWindow::RESULT_LATE);
+	SHD_TEST_CHECK(window.classify(1) == NetworkReceiveWindow::RESULT_LATE);
+
+	SHD_TEST_CHECK(window.markReceived(0) == NetworkReceiveWindow::RESULT_LATE);
+	SHD_TEST_CHECK(window.getAckBits() == ((1u << 2) | (1u << 1)));
+
+	// The last one the window can still tell about, and the first one it can't
+	SHD_TEST_CHECK(window.classify((uint16_t)(2 - NetworkReceiveWindow::WINDOW_SIZE)) == NetworkReceiveWindow::RESULT_LATE);
+	SHD_TEST_CHECK(window.classify((uint16_t)(2 - NetworkReceiveWindow::WINDOW_SIZE - 1)) == NetworkReceiveWindow::RESULT_TOO_OLD);
+	SHD_TEST_CHECK(window.isReceived((uint16_t)(2 - NetworkReceiveWindow::WINDOW_SIZE - 1)));
+
+	// Moving exactly a window ahead keeps the old newest in the last bit
+	SHD_TEST_CHECK(window.markReceived((uint16_t)(2 + NetworkReceiveWindow::WINDOW_SIZE)) == NetworkReceiveWindow::RESULT_NEWEST);
+	SHD_TEST_CHECK(window.getAckBits() == (1u << (NetworkReceiveWindow::WINDOW_SIZE - 1)));
+	SHD_TEST_CHECK(window.classify(2) == NetworkReceiveWindow::RESULT_DUPLICATE);
+	SHD_TEST_CHECK(window.classify(1) == NetworkReceiveWindow::RESULT_TOO_OLD);
+
+	// Moving further than that forgets everything before it
+	SHD_TEST_CHECK(window.markReceived(1000) == NetworkReceiveWindow::RESULT_NEWEST);
+	SHD_TEST_CHECK(window.getAckBits() == 0);
+}
+
+static void insertSnapshot(NetworkSnapshotRing & ring, uint16_t sequenceNum)
+{
+	uint8_t data[8];
+
+	// The contents say which sequence number they were stored under
+	memset(data, 0, sizeof(data));
+	data[0] = (uint8_t)(sequenceNum & 0xFF);
+	data[1] = (uint8_t)(sequenceNum >> 8);
+
+	SHD_TEST_CHECK(ring.insert(sequenceNum, data, sizeof(data)));
+}
+
+static bool isSnapshot(const NetworkSnapshotRing::Snapshot * snapshot, uint16_t sequenceNum)
+{
+	return	snapshot != nullptr &&
+			snapshot->sequenceNum == sequenceNum &&
+			snapshot->size == 8 &&
+			snapshot->data[0] == (uint8_t)(sequenceNum & 0xFF) &&
+			snapshot->data[1] == (uint8_t)(sequenceNum >> 8);
+}
+
+static void testSnapshotRingOutOfOrder()
+{
+	NetworkSnapshotRing ring;
+	const uint16_t order[] = { 65532, 65534, 65533, 1, 65535, 0, 3, 2 };
+	const uint32_t numSnapshots = sizeof(order) / sizeof(order[0]);
+
+	for (uint32_t i = 0; i < numSnapshots; i++)
+	{
+		insertSnapshot(ring, order[i]);
+	}
+
+	for (uint32_t i = 0; i < numSnapshots; i++)
+	{
+		SHD_TEST_CHECK(isSnapshot(ring.find(order[i]), order[i]));
+	}
+
+	SHD_TEST_CHECK(ring.find(4) == nullptr);
+	SHD_TEST_CHECK(ring.getNewestAcked() == nullptr);
+
+	// ACKs arrive out of order too. The newest one wins, even though it wrapped around
+	ring.markAcked(65534);
+	SHD_TEST_CHECK(isSnapshot(ring.getNewestAcked(), 65534));
+	ring.markAcked(1);
+	SHD_TEST_CHECK(isSnapshot(ring.getNewestAcked(), 1));
+	ring.markAcked(65535);
+	SHD_TEST_CHECK(isSnapshot(ring.getNewestAcked(), 1));
+	ring.markAcked(0);
+	SHD_TEST_CHECK(isSnapshot(ring.getNewestAcked(), 1));
+	SHD_TEST_CHECK(ring.find(0)->acked);
+	SHD_TEST_CHECK(ring.find(2)->acked == false);
+
+	// An ACK for something that was never stored changes nothing
+	ring.markAcked(10);
+	SHD_TEST_CHECK(isSnapshot(ring.getNewestAcked(), 1));
+
+	// Storing a whole ring later reuses the newest acked one's slot, so there's no baseline left to trust
+	insertSnapshot(ring, (uint16_t)(1 + NetworkSnapshotRing::SNAPSHOT_RING_SIZE));
+	SHD_TEST_CHECK(ring.find(1) == nullptr);
+	SHD_TEST_CHECK(ring.getNewestAcked() == nullptr);
+	SHD_TEST_CHECK(isSnapshot(ring.find((uint16_t)(1 + NetworkSnapshotRing::SNAPSHOT_RING_SIZE)), (uint16_t)(1 + NetworkSnapshotRing::SNAPSHOT_RING_SIZE)));
+
+	// A late ACK for the overwritten one can't bring it back
+	ring.markAcked(1);
+	SHD_TEST_CHECK(ring.getNewestAcked() == nullptr);
+
+	// Too big to store
+	SHD_TEST_CHECK(ring.insert(7, ring.find(0)->data, NetworkSnapshotRing::SNAPSHOT_MAX_SIZE + 1) == false);
+}
+
+int main()
+{
+	testDifferenceWrapsAround();
+	testReceiveWindowOutOfOrder();
+	testReceiveWindowGapsAndAge();
+	testSnapshotRingOutOfOrder();
+
+	if (s_numFailures)
+	{
+		SHD_PRINTF("%d checks failed\n", s_numFailures);
+		return 1;
+	}
+
+	SHD_PRINTF("All checks passed\n");
+	return 0;
+}
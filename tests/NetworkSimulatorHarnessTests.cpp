@@ -0,0 +1,114 @@
+//
+//  NetworkSimulatorHarnessTests.cpp
+//  Snakebite
+//
+//  Created by Stephen Harrison-Daly on 17/10/2026.
+//  Copyright  2026 Stephen Harrison-Daly. All rights reserved.
+//
+
+#include "Common.h"
+#include "NetworkSimulatorHarness.h"
+
+using namespace shd;
+
+static int s_numFailures = 0;
+
+#define SHD_TEST_CHECK(condition) \
+	do \
+	{ \
+		if ((condition) == false) \
+		{ \
+			SHD_PRINTF("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			s_numFailures++; \
+		} \
+	} while (0)
+
+// 10 seconds at 60 ticks a second
+static const uint32_t NUM_TICKS = 600;
+static const uint64_t TICK_US = 1000 * 1000 / 60;
+
+static bool runHarness(NetworkConditionSimulator::Profile profile, uint32_t seed, NetworkSimulatorHarness::Result * resultA, NetworkSimulatorHarness::Result * resultB)
+{
+	NetworkSimulatorHarness * harness = new NetworkSimulatorHarness();
+	bool ret = harness->init(NetworkConditionSimulator::getProfileConfig(profile, seed), NetworkConditionSimulator::getProfileConfig(profile, seed + 1));
+
+	if (ret)
+	{
+		harness->run(NUM_TICKS, TICK_US, resultA, resultB);
+	}
+
+	delete harness;
+	return ret;
+}
+
+static void testPerfectNetworkDeliversEverything()
+{
+	NetworkSimulatorHarness::Result resultA;
+	NetworkSimulatorHarness::Result resultB;
+
+	SHD_TEST_CHECK(runHarness(NetworkConditionSimulator::PROFILE_PERFECT, 1, &resultA, &resultB));
+	SHD_TEST_CHECK(resultA.isConnected);
+	SHD_TEST_CHECK(resultB.isConnected);
+	SHD_TEST_CHECK(resultA.numTicks == NUM_TICKS);
+
+	// Every tick's body gets there, full state updates and all, and each one is what was sent. A only starts sending
+	// once B's ACK has come back, a couple of ticks in
+	SHD_TEST_CHECK(resultA.numInputsSent >= NUM_TICKS - 2);
+	SHD_TEST_CHECK(resultB.numInputsSent >= NUM_TICKS - 2);
+	SHD_TEST_CHECK(resultB.numInputsReceived == resultA.numInputsSent);
+	SHD_TEST_CHECK(resultA.numInputsReceived == resultB.numInputsSent);
+	SHD_TEST_CHECK(resultA.numInvalidInputs == 0);
+	SHD_TEST_CHECK(resultB.numInvalidInputs == 0);
+}
+
+static void testBadNetworkLosesButNeverCorrupts()
+{
+	NetworkSimulatorHarness::Result resultA;
+	NetworkSimulatorHarness::Result resultB;
+
+	SHD_TEST_CHECK(runHarness(NetworkConditionSimulator::PROFILE_BAD_MOBILE, 7, &resultA, &resultB));
+	SHD_TEST_CHECK(resultA.isConnected);
+	SHD_TEST_CHECK(resultB.isConnected);
+
+	// Some are lost for good, but whatever arrives, late or recovered from a later packet, is what was sent
+	SHD_TEST_CHECK(resultA.numInvalidInputs == 0);
+	SHD_TEST_CHECK(resultB.numInvalidInputs == 0);
+	SHD_TEST_CHECK(resultB.numInputsReceived > 0);
+	SHD_TEST_CHECK(resultA.numInputsReceived > 0);
+	SHD_TEST_CHECK(resultB.numInputsReceived <= resultA.numInputsSent);
+	SHD_TEST_CHECK(resultA.numInputsReceived <= resultB.numInputsSent);
+}
+
+static void testSameSeedSameResult()
+{
+	NetworkSimulatorHarness::Result first[2];
+	NetworkSimulatorHarness::Result second[2];
+
+	SHD_TEST_CHECK(runHarness(NetworkConditionSimulator::PROFILE_AVERAGE_WIFI, 3, &first[0], &first[1]));
+	SHD_TEST_CHECK(runHarness(NetworkConditionSimulator::PROFILE_AVERAGE_WIFI, 3, &second[0], &second[1]));
+
+	for (int i = 0; i < 2; i++)
+	{
+		SHD_TEST_CHECK(first[i].numInvalidInputs == 0);
+		SHD_TEST_CHECK(first[i].numInputsSent == second[i].numInputsSent);
+		SHD_TEST_CHECK(first[i].numInputsReceived == second[i].numInputsReceived);
+		SHD_TEST_CHECK(first[i].numInputFramesRecovered == second[i].numInputFramesRecovered);
+		SHD_TEST_CHECK(first[i].bytesSent == second[i].bytesSent);
+	}
+}
+
+int main()
+{
+	testPerfectNetworkDeliversEverything();
+	testBadNetworkLosesButNeverCorrupts();
+	testSameSeedSameResult();
+
+	if (s_numFailures)
+	{
+		SHD_PRINTF("%d checks failed\n", s_numFailures);
+		return 1;
+	}
+
+	SHD_PRINTF("All checks passed\n");
+	return 0;
+}